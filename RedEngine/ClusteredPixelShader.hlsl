@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------
+// ClusteredPixelShader.hlsl - Vertex colour lit by the point lights binned into the pixel's cluster
+//--------------------------------------------------------------------
+
+cbuffer ClusterConstants : register(b2)
+{
+    uint4 gridSize; // Tiles across, tiles down, slices, lights
+    float4 clusterScale; // Tiles per pixel across and down, then the slice scale and bias on log(view z)
+    float4 ambient;
+}
+
+Buffer<float4> lights : register(t0); // View space position and radius, then colour and 1 / radius^2
+Buffer<uint2> clusters : register(t1); // Offset into lightIndices and count
+Buffer<uint> lightIndices : register(t2);
+
+struct PS_INPUT
+{
+    float4 position : SV_Position;
+    float4 color : COLOR0;
+    float3 viewPosition : TEXCOORD0;
+};
+
+struct PS_OUTPUT
+{
+    float4 color : SV_Target;
+};
+
+PS_OUTPUT main(PS_INPUT In)
+{
+    // No normals in the vertex format, so the face's own from the screen space derivatives, turned to the camera
+    float3 normal = normalize(cross(ddx(In.viewPosition), ddy(In.viewPosition)));
+    normal = dot(normal, In.viewPosition) > 0.0f ? -normal : normal;
+
+    const uint2 tile = min(uint2(In.position.xy * clusterScale.xy), gridSize.xy - 1);
+    const uint slice = min(uint(max(log(In.viewPosition.z) * clusterScale.z + clusterScale.w, 0.0f)), gridSize.z - 1);
+    const uint2 cluster = clusters[(slice * gridSize.y + tile.y) * gridSize.x + tile.x];
+
+    float3 lit = ambient.rgb;
+    for (uint i = 0; i < cluster.y; ++i)
+    {
+        const uint light = lightIndices[cluster.x + i];
+        const float4 positionRadius = lights[light * 2];
+        const float4 colorInverseRadiusSquared = lights[light * 2 + 1];
+
+        const float3 toLight = positionRadius.xyz - In.viewPosition;
+        const float distanceSquared = dot(toLight, toLight);
+        const float falloff = saturate(1.0f - distanceSquared * colorInverseRadiusSquared.w);
+        const float diffuse = saturate(dot(normal, toLight * rsqrt(max(distanceSquared, 1e-6f))));
+        lit += colorInverseRadiusSquared.rgb * (falloff * falloff * diffuse);
+    }
+
+    PS_OUTPUT Out;
+    Out.color = float4(In.color.rgb * lit, In.color.a);
+    return Out;
+}
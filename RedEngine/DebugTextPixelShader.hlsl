@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------
+// DebugTextPixelShader.hlsl - Glyph coverage from the atlas alpha, tinted per glyph
+//--------------------------------------------------------------------
+
+Texture2D atlas : register(t0);
+SamplerState atlasSampler : register(s0);
+
+struct PS_INPUT
+{
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR0;
+};
+
+struct PS_OUTPUT
+{
+    float4 color : SV_Target;
+};
+
+PS_OUTPUT main(PS_INPUT In)
+{
+    PS_OUTPUT Out;
+    Out.color = In.color * atlas.Sample(atlasSampler, In.uv);
+    return Out;
+}
@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------
+// DebugTextVertexShader.hlsl - One instance per glyph, expanded to a screen space quad
+//--------------------------------------------------------------------
+
+cbuffer DebugTextConstants : register(b0)
+{
+    float4 screenScale; // xy: 2 / screen size, zw: glyph cell size in pixels
+    float4 atlasScale; // xy: glyph cell size in atlas UVs
+}
+
+struct VS_INPUT
+{
+    float2 corner : POSITION0; // Per vertex, 0 to 1 across the quad
+    float2 position : POSITION1; // Per instance, pixels from the top left
+    float2 uv : TEXCOORD0; // Per instance, top left of the glyph in the atlas
+    float4 color : COLOR0;
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR0;
+};
+
+VS_OUTPUT main(VS_INPUT input)
+{
+    VS_OUTPUT output = (VS_OUTPUT) 0;
+    float2 pixel = input.position + input.corner * screenScale.zw;
+    output.position = float4(pixel.x * screenScale.x - 1.0f, 1.0f - pixel.y * screenScale.y, 0.0f, 1.0f);
+    output.uv = input.uv + input.corner * atlasScale.xy;
+    output.color = input.color;
+
+    return output;
+}
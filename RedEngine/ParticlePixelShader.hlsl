@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------
+// ParticlePixelShader.hlsl - A soft round spot in the particle's colour
+//--------------------------------------------------------------------
+
+struct PS_INPUT
+{
+    float4 position : SV_Position;
+    float4 color : COLOR0;
+    float2 corner : TEXCOORD0;
+};
+
+struct PS_OUTPUT
+{
+    float4 color : SV_Target;
+};
+
+PS_OUTPUT main(PS_INPUT In)
+{
+    const float falloff = saturate(1.0f - dot(In.corner, In.corner));
+
+    PS_OUTPUT Out;
+    Out.color = float4(In.color.rgb, In.color.a * falloff * falloff);
+    return Out;
+}
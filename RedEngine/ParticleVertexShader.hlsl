@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------
+// ParticleVertexShader.hlsl - VertexShader.hlsl's transform, one instance per particle, as a camera-facing quad
+//--------------------------------------------------------------------
+
+cbuffer Constants : register(b0)
+{
+    float4x4 mView;
+    float4x4 mProjection;
+}
+
+struct VS_INPUT
+{
+    float2 corner : POSITION0; // Per vertex, -1 to 1 across the quad
+    float4 positionSize : POSITION1; // Per instance, world position and size across
+    float4 color : COLOR0;
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR0;
+    float2 corner : TEXCOORD0;
+};
+
+VS_OUTPUT main(VS_INPUT input)
+{
+    VS_OUTPUT output = (VS_OUTPUT) 0;
+    output.color = input.color;
+    output.corner = input.corner;
+
+    // Spread in view space, so the quad always faces the camera
+    float4 viewPosition = mul(float4(input.positionSize.xyz, 1.0f), mView);
+    viewPosition.xy += input.corner * (input.positionSize.w * 0.5f);
+    output.position = mul(viewPosition, mProjection);
+
+    return output;
+}
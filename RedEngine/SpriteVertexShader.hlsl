@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------
+// SpriteVertexShader.hlsl - One instance per sprite, expanded to a screen space quad
+//--------------------------------------------------------------------
+
+cbuffer SpriteConstants : register(b0)
+{
+    float4 screenScale; // xy: 2 / screen size
+}
+
+struct VS_INPUT
+{
+    float2 corner : POSITION0; // Per vertex, 0 to 1 across the quad
+    float4 rect : POSITION1; // Per instance, top left and size in pixels
+    float4 uvRect : TEXCOORD0; // Per instance, the atlas rectangle's corners
+    float4 color : COLOR0;
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+    float4 color : COLOR0;
+};
+
+VS_OUTPUT main(VS_INPUT input)
+{
+    VS_OUTPUT output = (VS_OUTPUT) 0;
+    float2 pixel = input.rect.xy + input.corner * input.rect.zw;
+    output.position = float4(pixel.x * screenScale.x - 1.0f, 1.0f - pixel.y * screenScale.y, 0.0f, 1.0f);
+    output.uv = lerp(input.uvRect.xy, input.uvRect.zw, input.corner);
+    output.color = input.color;
+
+    return output;
+}
@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------
+// UpscalePixelShader.hlsl - Bilinear stretch of the scene rendered at the dynamic resolution
+//--------------------------------------------------------------------
+
+Texture2D scene : register(t0);
+SamplerState sceneSampler : register(s0);
+
+struct PS_INPUT
+{
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD0;
+};
+
+struct PS_OUTPUT
+{
+    float4 color : SV_Target;
+};
+
+PS_OUTPUT main(PS_INPUT In)
+{
+    PS_OUTPUT Out;
+    Out.color = scene.Sample(sceneSampler, In.uv);
+    return Out;
+}
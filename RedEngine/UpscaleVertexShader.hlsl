@@ -0,0 +1,23 @@
+//--------------------------------------------------------------------
+// UpscaleVertexShader.hlsl - One triangle covering the screen, with UVs spanning the scaled scene target
+//--------------------------------------------------------------------
+
+struct VS_INPUT
+{
+    float2 position : POSITION0; // Clip space, the corners run off the screen
+};
+
+struct VS_OUTPUT
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+VS_OUTPUT main(VS_INPUT input)
+{
+    VS_OUTPUT output = (VS_OUTPUT) 0;
+    output.position = float4(input.position, 0.0f, 1.0f);
+    output.uv = float2(input.position.x * 0.5f + 0.5f, 0.5f - input.position.y * 0.5f);
+
+    return output;
+}
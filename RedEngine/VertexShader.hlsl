@@ -23,6 +23,7 @@ struct VS_OUTPUT
 {
     float4 position : SV_POSITION;
     float4 color : COLOR0;
+    float3 viewPosition : TEXCOORD0; // For the clustered lighting, after what the unlit shader reads
 };
 
 VS_OUTPUT main(VS_INPUT input)
@@ -32,6 +33,7 @@ VS_OUTPUT main(VS_INPUT input)
     float4 inputPos = float4(input.position, 1.0f);
     output.position = mul(inputPos, mWorld);
     output.position = mul(output.position, mView);
+    output.viewPosition = output.position.xyz;
     output.position = mul(output.position, mProjection);
 
     return output;
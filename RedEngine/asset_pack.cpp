@@ -0,0 +1,197 @@
+#include "red_engine.h"
+#include "asset_pack.h"
+#include "compression.h"
+
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace assets
+{
+
+	AssetPack::AssetPack() :
+		m_path(nullptr),
+		m_data(nullptr),
+		m_size(0),
+		m_header(nullptr),
+		m_toc(nullptr),
+#if defined(_WIN32)
+		m_file(INVALID_HANDLE_VALUE),
+		m_mapping(nullptr)
+#else
+		m_file(-1)
+#endif
+	{
+	}
+
+	AssetPack::~AssetPack()
+	{
+		Unmount();
+	}
+
+	bool AssetPack::Mount(const char* path)
+	{
+		ASSERT(!IsMounted(), "Asset pack %s is already mounted.\n", m_path);
+
+#if defined(_WIN32)
+		m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			DEBUG_MESSAGE("Unable to open asset pack %s.\n", path);
+			return false;
+		}
+
+		LARGE_INTEGER fileSize = {};
+		GetFileSizeEx(m_file, &fileSize);
+		m_size = size_t(fileSize.QuadPart);
+
+		if (m_size >= sizeof(PackHeader))
+		{
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping != nullptr)
+				m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+#else
+		m_file = open(path, O_RDONLY | O_CLOEXEC);
+		if (m_file < 0)
+		{
+			DEBUG_MESSAGE("Unable to open asset pack %s.\n", path);
+			return false;
+		}
+
+		struct stat fileStat = {};
+		fstat(m_file, &fileStat);
+		m_size = size_t(fileStat.st_size);
+
+		if (m_size >= sizeof(PackHeader))
+		{
+			void* const mapping = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+			if (mapping != MAP_FAILED)
+			{
+				m_data = static_cast<const uint8_t*>(mapping);
+				madvise(mapping, m_size, MADV_RANDOM);
+			}
+		}
+#endif
+
+		if (m_data == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to map asset pack %s.\n", path);
+			Unmount();
+			return false;
+		}
+
+		const PackHeader* const header = reinterpret_cast<const PackHeader*>(m_data);
+		const bool valid = header->magic == PackMagic && header->version == PackVersion && header->totalSize <= m_size &&
+			header->tocOffset + uint64_t(header->entryCount) * sizeof(PackEntry) <= header->totalSize;
+		if (!valid)
+		{
+			DEBUG_MESSAGE("%s is not a valid asset pack.\n", path);
+			Unmount();
+			return false;
+		}
+
+		m_header = header;
+		m_toc = reinterpret_cast<const PackEntry*>(m_data + header->tocOffset);
+
+		m_index.reserve(header->entryCount);
+		for (uint32_t entry = 0; entry < header->entryCount; ++entry)
+			m_index.insert(m_toc[entry].nameHash, entry);
+
+		const size_t pathLength = strlen(path);
+		m_path = new char[pathLength + 1];
+		memcpy(m_path, path, pathLength + 1);
+
+		DEBUG_MESSAGE("Mounted asset pack %s, %u entries.\n", path, header->entryCount);
+		return true;
+	}
+
+	void AssetPack::Unmount()
+	{
+#if defined(_WIN32)
+		if (m_data != nullptr)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != nullptr)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+
+		m_mapping = nullptr;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data != nullptr)
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+		if (m_file >= 0)
+			close(m_file);
+
+		m_file = -1;
+#endif
+
+		delete[] m_path;
+		m_path = nullptr;
+
+		m_data = nullptr;
+		m_size = 0;
+		m_header = nullptr;
+		m_toc = nullptr;
+		m_index.clear();
+	}
+
+	const PackEntry* AssetPack::Find(uint64_t nameHash) const
+	{
+		if (m_header == nullptr)
+			return nullptr;
+
+		const uint32_t* const entry = m_index.find(nameHash);
+		return entry != nullptr ? &m_toc[*entry] : nullptr;
+	}
+
+	const void* AssetPack::GetData(const PackEntry* entry) const
+	{
+		ASSERT(entry != nullptr && entry >= m_toc && entry < m_toc + m_header->entryCount, "Entry doesn't belong to this pack.\n");
+		ASSERT((entry->flags & PackEntryCompressed) == 0, "Compressed entries can't be used in place.\n");
+		ASSERT(entry->offset + entry->size <= m_header->totalSize, "Entry runs past the end of the pack.\n");
+
+		return m_data + entry->offset;
+	}
+
+	bool AssetPack::Decompress(const PackEntry* entry, void* destination, size_t destinationSize) const
+	{
+		ASSERT(entry != nullptr && entry >= m_toc && entry < m_toc + m_header->entryCount, "Entry doesn't belong to this pack.\n");
+
+		if (destinationSize < entry->uncompressedSize || entry->offset + entry->size > m_header->totalSize)
+			return false;
+
+		const uint8_t* const source = m_data + entry->offset;
+		if ((entry->flags & PackEntryCompressed) == 0)
+		{
+			memcpy(destination, source, size_t(entry->size));
+			return true;
+		}
+
+		return compression::Lz4Decompress(source, size_t(entry->size), destination, size_t(entry->uncompressedSize));
+	}
+
+	void AssetPack::Prefetch(const PackEntry* entry) const
+	{
+		ASSERT(entry != nullptr, "Trying to prefetch a null entry.\n");
+
+#if defined(_WIN32)
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = const_cast<uint8_t*>(m_data + entry->offset);
+		range.NumberOfBytes = size_t(entry->size);
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+		// madvise needs a page aligned start
+		const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+		const size_t start = size_t(entry->offset) & ~(pageSize - 1);
+		madvise(const_cast<uint8_t*>(m_data) + start, size_t(entry->offset + entry->size) - start, MADV_WILLNEED);
+#endif
+	}
+
+} // namespace assets
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "pack_format.h"
+#include "hash.h"
+#include "hash_map.h"
+#include "string_interner.h"
+
+namespace assets
+{
+
+	// A read-only, memory-mapped asset pack. Nothing is read up front beyond the header and table of
+	// contents, which is indexed by name hash so Find is a single probe; entry data is paged in by the OS the
+	// first time it is touched.
+	class AssetPack
+	{
+	public:
+		AssetPack();
+		~AssetPack();
+
+		bool							Mount(const char* path);
+		void							Unmount();
+
+		bool							IsMounted() const
+		{
+			return m_header != nullptr;
+		}
+
+		const char*						GetPath() const
+		{
+			return m_path;
+		}
+
+		uint32_t						GetEntryCount() const
+		{
+			return m_header != nullptr ? m_header->entryCount : 0;
+		}
+
+		const PackEntry*				Find(uint64_t nameHash) const;
+		const PackEntry*				Find(const char* name) const
+		{
+			return Find(utils::HashName(name));
+		}
+
+		const PackEntry*				Find(containers::StringId name) const
+		{
+			return Find(name.Get());
+		}
+
+		// Pointer to the entry's bytes inside the mapping. Compressed entries must go through Decompress instead.
+		const void*						GetData(const PackEntry* entry) const;
+
+		// Decompresses (or copies, for stored entries) into a caller provided buffer of uncompressedSize bytes
+		bool							Decompress(const PackEntry* entry, void* destination, size_t destinationSize) const;
+
+		// Hints the OS to start paging the entry in ahead of use
+		void							Prefetch(const PackEntry* entry) const;
+
+	private:
+		char*							m_path;
+
+		const uint8_t*					m_data;
+		size_t							m_size;
+		const PackHeader*				m_header;
+		const PackEntry*				m_toc;
+		containers::HashMap<uint64_t, uint32_t> m_index; // Name hash to table of contents entry, built at mount
+
+#if defined(_WIN32)
+		HANDLE							m_file;
+		HANDLE							m_mapping;
+#else
+		int								m_file;
+#endif
+	};
+
+} // namespace assets
@@ -0,0 +1,502 @@
+#include "red_engine.h"
+#include "asset_streamer.h"
+#include "asset_pack.h"
+#include "compression.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <chrono>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace assets
+{
+
+	namespace
+	{
+		utils::PerfCounter s_allocations("memory.allocations");
+		utils::PerfCounter s_allocatedBytes("memory.allocated_bytes");
+		utils::PerfCounter s_residentBytes("streaming.resident_bytes", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_uploads("streaming.uploads");
+
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+	}
+
+	AssetStreamer::AssetStreamer(const AssetPack& pack, uint64_t budgetBytes, unsigned int ioThreadCount) :
+		m_pack(pack),
+		m_budgetBytes(budgetBytes),
+		m_committedBytes(0),
+		m_cameraPosition{ 0.0f, 0.0f, 0.0f },
+		m_frame(1),
+		m_quit(false),
+		m_stats{}
+	{
+		ASSERT(pack.IsMounted(), "Streaming from a pack that isn't mounted.\n");
+
+		// Reads go through our own handle with explicit offsets rather than faulting in the pack's mapping,
+		// so the I/O threads block in the kernel instead of the main thread taking page faults
+#if defined(_WIN32)
+		m_file = CreateFileA(pack.GetPath(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		ASSERT(m_file != INVALID_HANDLE_VALUE, "Unable to open %s for streaming.\n", pack.GetPath());
+#else
+		m_file = open(pack.GetPath(), O_RDONLY | O_CLOEXEC);
+		ASSERT(m_file >= 0, "Unable to open %s for streaming.\n", pack.GetPath());
+#endif
+
+		m_stats.budgetBytes = budgetBytes;
+
+		if (ioThreadCount == 0)
+			ioThreadCount = 1;
+
+		for (unsigned int i = 0; i < ioThreadCount; ++i)
+			m_ioThreads.emplace_back(&AssetStreamer::IoThreadMain, this);
+	}
+
+	AssetStreamer::~AssetStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+
+		for (std::thread& thread : m_ioThreads)
+			thread.join();
+
+		// Decompression jobs may still be running, and Finish touches m_wake after it lets go of the mutex, so
+		// wait for the jobs themselves to return rather than for their requests to leave Decompressing
+		if (utils::JobSystem::Get() != nullptr)
+			utils::JobSystem::Get()->Wait(m_decompressJobs);
+		ASSERT(m_decompressJobs.IsDone(), "Decompression jobs outlived the job system.\n");
+
+		for (StreamRequest& request : m_requests)
+			delete[] request.data;
+
+#if defined(_WIN32)
+		CloseHandle(m_file);
+#else
+		close(m_file);
+#endif
+	}
+
+	AssetStreamer::Handle AssetStreamer::Request(uint64_t nameHash, const float position[3], const Callbacks& callbacks)
+	{
+		const PackEntry* const entry = m_pack.Find(nameHash);
+		if (entry == nullptr)
+		{
+			DEBUG_MESSAGE("Can't stream %016llx, it isn't in %s.\n", static_cast<unsigned long long>(nameHash), m_pack.GetPath());
+			return InvalidHandle;
+		}
+
+		StreamRequest request = {};
+		request.nameHash = nameHash;
+		request.offset = entry->offset;
+		request.size = entry->size;
+		request.uncompressedSize = entry->uncompressedSize;
+		request.compressed = (entry->flags & PackEntryCompressed) != 0;
+		memcpy(request.position, position, sizeof(request.position));
+		request.callbacks = callbacks;
+		request.state = State::Queued;
+
+		uint32_t index;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_freeRequests.empty())
+			{
+				index = m_freeRequests.back();
+				m_freeRequests.pop_back();
+				m_requests[index] = request;
+			}
+			else
+			{
+				index = uint32_t(m_requests.size());
+				m_requests.push_back(request);
+			}
+
+			m_requests[index].lastUsedFrame = m_frame;
+			m_queued.push_back(index);
+		}
+		m_wake.notify_one();
+
+		return Handle(index + 1);
+	}
+
+	void AssetStreamer::Release(Handle handle)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ASSERT(handle != InvalidHandle && handle <= m_requests.size(), "Releasing an invalid stream handle.\n");
+
+		const uint32_t index = handle - 1;
+		StreamRequest& request = m_requests[index];
+
+		switch (request.state)
+		{
+		case State::Reading:
+		case State::Decompressing:
+			// Finish() cleans up when the I/O comes back
+			request.released = true;
+			return;
+
+		case State::Queued:
+			for (size_t i = 0; i < m_queued.size(); ++i)
+			{
+				if (m_queued[i] == index)
+				{
+					m_queued[i] = m_queued.back();
+					m_queued.pop_back();
+					break;
+				}
+			}
+			break;
+
+		case State::ReadyToUpload:
+			for (size_t i = 0; i < m_ready.size(); ++i)
+			{
+				if (m_ready[i] == index)
+				{
+					m_ready.erase(m_ready.begin() + i);
+					break;
+				}
+			}
+			delete[] request.data;
+			request.data = nullptr;
+			m_committedBytes -= request.uncompressedSize;
+			break;
+
+		case State::Resident:
+			// The owner is releasing its handle, so it is also responsible for the GPU copy
+			m_committedBytes -= request.uncompressedSize;
+			m_stats.residentBytes -= request.uncompressedSize;
+			break;
+
+		default:
+			break;
+		}
+
+		request.state = State::Evicted;
+		request.released = true;
+		m_freeRequests.push_back(index);
+		m_wake.notify_all();
+	}
+
+	void AssetStreamer::Touch(Handle handle)
+	{
+		bool requeued = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			ASSERT(handle != InvalidHandle && handle <= m_requests.size(), "Touching an invalid stream handle.\n");
+
+			StreamRequest& request = m_requests[handle - 1];
+			request.lastUsedFrame = m_frame;
+
+			// Evicted assets come back when they are wanted again
+			if (request.state == State::Evicted && !request.released)
+			{
+				request.state = State::Queued;
+				m_queued.push_back(handle - 1);
+				requeued = true;
+			}
+		}
+
+		if (requeued)
+			m_wake.notify_one();
+	}
+
+	AssetStreamer::State AssetStreamer::GetState(Handle handle) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ASSERT(handle != InvalidHandle && handle <= m_requests.size(), "Querying an invalid stream handle.\n");
+		return m_requests[handle - 1].state;
+	}
+
+	void AssetStreamer::SetCameraPosition(const float position[3])
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		memcpy(m_cameraPosition, position, sizeof(m_cameraPosition));
+	}
+
+	void AssetStreamer::PumpUploads(double budgetSeconds)
+	{
+		const double start = Seconds();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		++m_frame;
+
+		// Evictions go first so an asset that was evicted and requested again can't lose its new upload
+		std::vector<Callbacks> evicted;
+		evicted.swap(m_evicted);
+		lock.unlock();
+
+		for (const Callbacks& callbacks : evicted)
+		{
+			if (callbacks.evict != nullptr)
+				callbacks.evict(callbacks.userData);
+		}
+
+		lock.lock();
+
+		while (!m_ready.empty())
+		{
+			const uint32_t index = m_ready.front();
+			m_ready.erase(m_ready.begin());
+
+			StreamRequest& request = m_requests[index];
+			uint8_t* const data = request.data;
+			const size_t size = size_t(request.uncompressedSize);
+			const Callbacks callbacks = request.callbacks;
+
+			request.data = nullptr;
+			request.state = State::Resident;
+			request.lastUsedFrame = m_frame;
+			m_stats.residentBytes += request.uncompressedSize;
+			++m_stats.uploads;
+			s_uploads.Add();
+
+			// Uploads can take a while, don't hold up the I/O threads
+			lock.unlock();
+			if (callbacks.upload != nullptr)
+				callbacks.upload(data, size, callbacks.userData);
+			delete[] data;
+			lock.lock();
+
+			// Always make progress, but stop once the frame's share is spent
+			if (Seconds() - start >= budgetSeconds)
+				break;
+		}
+
+		s_residentBytes.Set(int64_t(m_stats.residentBytes));
+		lock.unlock();
+
+		// A new frame means last frame's assets are now eviction candidates
+		m_wake.notify_all();
+	}
+
+	AssetStreamer::Stats AssetStreamer::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Stats stats = m_stats;
+		stats.pending = 0;
+		for (const StreamRequest& request : m_requests)
+		{
+			if (!request.released && (request.state == State::Queued || request.state == State::Reading ||
+				request.state == State::Decompressing || request.state == State::ReadyToUpload))
+				++stats.pending;
+		}
+		return stats;
+	}
+
+	void AssetStreamer::IoThreadMain()
+	{
+		for (;;)
+		{
+			uint32_t index;
+			uint64_t offset, size;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this, &index]() { return m_quit || PopBestRequest(index); });
+
+				if (m_quit)
+					return;
+
+				StreamRequest& request = m_requests[index];
+				request.state = State::Reading;
+				offset = request.offset;
+				size = request.size;
+			}
+
+			const double readStart = Seconds();
+			uint8_t* data = new uint8_t[size_t(size)];
+			s_allocations.Add();
+			s_allocatedBytes.Add(int64_t(size));
+			const bool ok = ReadAt(offset, data, size_t(size));
+			const double readTime = Seconds() - readStart;
+
+			bool compressed;
+			uint64_t uncompressedSize;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.bytesRead += size;
+				m_stats.readSeconds += readTime;
+				compressed = m_requests[index].compressed;
+				uncompressedSize = m_requests[index].uncompressedSize;
+				if (ok && compressed)
+					m_requests[index].state = State::Decompressing;
+			}
+
+			if (!ok)
+			{
+				delete[] data;
+				Finish(index, nullptr, State::Failed);
+				continue;
+			}
+
+			if (!compressed)
+			{
+				Finish(index, data, State::ReadyToUpload);
+				continue;
+			}
+
+			auto decompress = [this, index, data, size, uncompressedSize]()
+				{
+					uint8_t* const output = new uint8_t[size_t(uncompressedSize)];
+					s_allocations.Add();
+					s_allocatedBytes.Add(int64_t(uncompressedSize));
+					const bool decompressed = compression::Lz4Decompress(data, size_t(size), output, size_t(uncompressedSize));
+					delete[] data;
+
+					if (decompressed)
+					{
+						Finish(index, output, State::ReadyToUpload);
+					}
+					else
+					{
+						delete[] output;
+						Finish(index, nullptr, State::Failed);
+					}
+				};
+
+			if (utils::JobSystem::Get() != nullptr)
+				utils::JobSystem::Get()->Submit(decompress, &m_decompressJobs);
+			else
+				decompress();
+		}
+	}
+
+	bool AssetStreamer::PopBestRequest(uint32_t& index)
+	{
+		if (m_queued.empty())
+			return false;
+
+		// Closest to the camera first. The queue is short enough that a scan beats keeping a heap up to date as the camera moves.
+		size_t best = 0;
+		float bestDistance = DistanceSq(m_requests[m_queued[0]]);
+		for (size_t i = 1; i < m_queued.size(); ++i)
+		{
+			const float distance = DistanceSq(m_requests[m_queued[i]]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = i;
+			}
+		}
+
+		const uint32_t candidate = m_queued[best];
+		if (!MakeRoom(m_requests[candidate].uncompressedSize))
+			return false;
+
+		m_queued[best] = m_queued.back();
+		m_queued.pop_back();
+
+		m_committedBytes += m_requests[candidate].uncompressedSize;
+		index = candidate;
+		return true;
+	}
+
+	bool AssetStreamer::MakeRoom(uint64_t bytes)
+	{
+		// Something bigger than the whole budget can still load once everything else is gone
+		while (m_committedBytes + bytes > m_budgetBytes && m_committedBytes > 0)
+		{
+			// Evict the least recently used resident asset that wasn't touched this frame
+			StreamRequest* oldest = nullptr;
+			for (StreamRequest& request : m_requests)
+			{
+				if (request.state == State::Resident && !request.released && request.lastUsedFrame < m_frame &&
+					(oldest == nullptr || request.lastUsedFrame < oldest->lastUsedFrame))
+				{
+					oldest = &request;
+				}
+			}
+
+			if (oldest == nullptr)
+				return false;
+
+			// The GPU copy has to be released on the render thread, so hand it to the next PumpUploads
+			oldest->state = State::Evicted;
+			m_evicted.push_back(oldest->callbacks);
+			m_committedBytes -= oldest->uncompressedSize;
+			m_stats.residentBytes -= oldest->uncompressedSize;
+			++m_stats.evictions;
+		}
+
+		return true;
+	}
+
+	bool AssetStreamer::ReadAt(uint64_t offset, void* destination, size_t size)
+	{
+		uint8_t* out = static_cast<uint8_t*>(destination);
+
+		while (size > 0)
+		{
+#if defined(_WIN32)
+			// A synchronous ReadFile with an OVERLAPPED offset is a positional read, safe across threads
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+			overlapped.OffsetHigh = DWORD(offset >> 32);
+
+			const DWORD chunk = size > 0x40000000 ? 0x40000000 : DWORD(size);
+			DWORD read = 0;
+			if (!ReadFile(m_file, out, chunk, &read, &overlapped) || read == 0)
+				return false;
+#else
+			const ssize_t read = pread(m_file, out, size, off_t(offset));
+			if (read <= 0)
+				return false;
+#endif
+			out += read;
+			offset += uint64_t(read);
+			size -= size_t(read);
+		}
+
+		return true;
+	}
+
+	void AssetStreamer::Finish(uint32_t index, uint8_t* data, State state)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			StreamRequest& request = m_requests[index];
+			if (state == State::ReadyToUpload)
+				m_stats.bytesDecompressed += request.uncompressedSize;
+
+			if (request.released || state == State::Failed)
+			{
+				// Nobody wants it any more, or it couldn't be loaded
+				delete[] data;
+				m_committedBytes -= request.uncompressedSize;
+				request.state = state == State::Failed ? State::Failed : State::Evicted;
+				if (request.released)
+					m_freeRequests.push_back(index);
+				if (state == State::Failed)
+					DEBUG_MESSAGE("Failed to stream %016llx from %s.\n", static_cast<unsigned long long>(request.nameHash), m_pack.GetPath());
+			}
+			else
+			{
+				request.data = data;
+				request.state = State::ReadyToUpload;
+				m_ready.push_back(index);
+			}
+		}
+
+		m_wake.notify_all();
+	}
+
+	float AssetStreamer::DistanceSq(const StreamRequest& request) const
+	{
+		const float dx = request.position[0] - m_cameraPosition[0];
+		const float dy = request.position[1] - m_cameraPosition[1];
+		const float dz = request.position[2] - m_cameraPosition[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+} // namespace assets
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+
+namespace assets
+{
+
+	class AssetPack;
+
+	// Streams pack entries in the background. Reads happen on dedicated I/O threads, decompression on the
+	// job system, and the upload callback always runs on whichever thread calls PumpUploads (the render thread).
+	class AssetStreamer
+	{
+	public:
+		typedef uint32_t Handle;
+		static const Handle InvalidHandle = 0;
+
+		struct Callbacks
+		{
+			// Create GPU resources from the data. The data is freed once this returns.
+			void						(*upload)(const void* data, size_t size, void* userData);
+			// Release whatever upload created, the entry has been evicted to stay inside the budget
+			void						(*evict)(void* userData);
+			void*						userData;
+		};
+
+		enum class State : uint8_t
+		{
+			Queued,
+			Reading,
+			Decompressing,
+			ReadyToUpload,
+			Resident,
+			Evicted,
+			Failed,
+		};
+
+		struct Stats
+		{
+			uint64_t					bytesRead;
+			uint64_t					bytesDecompressed;
+			double						readSeconds; // Summed across I/O threads
+			uint32_t					uploads;
+			uint32_t					evictions;
+			uint32_t					pending; // Queued or in flight
+			uint64_t					residentBytes;
+			uint64_t					budgetBytes;
+		};
+
+		AssetStreamer(const AssetPack& pack, uint64_t budgetBytes, unsigned int ioThreadCount = 1);
+		~AssetStreamer();
+
+		// position is where the asset lives in the world, closer to the camera streams first
+		Handle							Request(uint64_t nameHash, const float position[3], const Callbacks& callbacks);
+		void							Release(Handle handle);
+
+		// Marks the asset as used this frame so the LRU keeps it
+		void							Touch(Handle handle);
+
+		State							GetState(Handle handle) const;
+
+		void							SetCameraPosition(const float position[3]);
+
+		// Runs pending upload callbacks until the time budget is spent. Call once per frame on the render thread.
+		void							PumpUploads(double budgetSeconds);
+
+		Stats							GetStats() const;
+
+	private:
+		struct StreamRequest
+		{
+			uint64_t					nameHash;
+			uint64_t					offset;
+			uint64_t					size;
+			uint64_t					uncompressedSize;
+			bool						compressed;
+
+			float						position[3];
+			Callbacks					callbacks;
+
+			State						state;
+			uint64_t					lastUsedFrame;
+			uint8_t*					data; // Read or decompressed bytes awaiting upload
+			bool						released;
+		};
+
+		void							IoThreadMain();
+		bool							PopBestRequest(uint32_t& index); // Called with m_mutex held
+		bool							MakeRoom(uint64_t bytes); // Called with m_mutex held
+		bool							ReadAt(uint64_t offset, void* destination, size_t size);
+		void							Finish(uint32_t index, uint8_t* data, State state);
+
+		float							DistanceSq(const StreamRequest& request) const;
+
+		const AssetPack&				m_pack;
+		uint64_t						m_budgetBytes;
+		uint64_t						m_committedBytes; // Resident plus in flight
+
+#if defined(_WIN32)
+		HANDLE							m_file;
+#else
+		int								m_file;
+#endif
+
+		mutable std::mutex				m_mutex;
+		std::condition_variable			m_wake;
+		std::vector<StreamRequest>		m_requests; // Indexed by handle - 1
+		std::vector<uint32_t>			m_freeRequests;
+		std::vector<uint32_t>			m_queued;
+		std::vector<uint32_t>			m_ready;
+		std::vector<Callbacks>			m_evicted; // Waiting for PumpUploads to run their evict callbacks
+		float							m_cameraPosition[3];
+		uint64_t						m_frame;
+		bool							m_quit;
+
+		std::vector<std::thread>		m_ioThreads;
+		utils::JobCounter				m_decompressJobs; // Drained before anything they touch is torn down
+
+		Stats							m_stats;
+	};
+
+} // namespace assets
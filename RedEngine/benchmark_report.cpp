@@ -0,0 +1,92 @@
+#include "red_engine.h"
+#include "benchmark_report.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace utils
+{
+
+	const char* FramePhases::GetName(Phase phase)
+	{
+		static const char* const c_Names[] = { "update", "cull", "record", "submit", "frame" };
+		static_assert(sizeof(c_Names) / sizeof(c_Names[0]) == Count + 1, "A phase is missing its name");
+		return c_Names[phase];
+	}
+
+	BenchmarkReport::BenchmarkReport(uint32_t expectedFrames)
+	{
+		m_frames.reserve(expectedFrames);
+	}
+
+	void BenchmarkReport::AddFrame(const FramePhases& phases)
+	{
+		m_frames.push_back(phases);
+	}
+
+	BenchmarkReport::Summary BenchmarkReport::Summarise(FramePhases::Phase phase) const
+	{
+		Summary summary = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+		if (m_frames.empty())
+			return summary;
+
+		std::vector<double> times;
+		times.reserve(m_frames.size());
+		for (const FramePhases& frame : m_frames)
+		{
+			double time = 0.0;
+			if (phase == FramePhases::Count)
+			{
+				for (uint32_t i = 0; i < FramePhases::Count; ++i)
+					time += frame.seconds[i];
+			}
+			else
+			{
+				time = frame.seconds[phase];
+			}
+
+			times.push_back(time * 1000.0);
+			summary.mean += time * 1000.0;
+		}
+
+		std::sort(times.begin(), times.end());
+		const size_t count = times.size();
+		summary.mean /= double(count);
+		summary.p50 = times[count / 2];
+		summary.p90 = times[std::min(count - 1, count * 90 / 100)];
+		summary.p99 = times[std::min(count - 1, count * 99 / 100)];
+		summary.max = times.back();
+		return summary;
+	}
+
+	bool BenchmarkReport::WriteJson(const char* path, const char* source, double timeStep) const
+	{
+		FILE* const file = fopen(path, "w");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write benchmark report %s.\n", path);
+			return false;
+		}
+
+		// One phase per line, so tools/bench_compare can read it back without a JSON parser. The source is a
+		// path from the command line; backslashes are the only thing in one that needs escaping.
+		fprintf(file, "{\n  \"source\": \"");
+		for (const char* c = source; *c != 0; ++c)
+			fprintf(file, *c == '\\' ? "\\\\" : "%c", *c);
+		fprintf(file, "\",\n  \"frames\": %u,\n  \"timeStep\": %.9g,\n  \"phases\": {\n", GetFrameCount(), timeStep);
+
+		for (uint32_t phase = 0; phase <= FramePhases::Count; ++phase)
+		{
+			const FramePhases::Phase id = FramePhases::Phase(phase);
+			const Summary summary = Summarise(id);
+			fprintf(file, "    \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+				FramePhases::GetName(id), summary.mean, summary.p50, summary.p90, summary.p99, summary.max,
+				phase < FramePhases::Count ? "," : "");
+		}
+
+		fprintf(file, "  }\n}\n");
+		fclose(file);
+		return true;
+	}
+
+} // namespace utils
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+	// Where a frame's CPU time went, filled in by Core as it runs each phase
+	struct FramePhases
+	{
+		enum Phase : uint32_t
+		{
+			Update, // Input, simulation
+			Cull, // LOD selection and the occlusion depth buffer
+			Record, // Streaming uploads and every device context call for the frame
+			Submit, // Present, or the flush standing in for it when headless
+			Count,
+		};
+
+		static const char*				GetName(Phase phase);
+
+		double							seconds[Count];
+	};
+
+	// Per-phase timings over a benchmark run, written as JSON so builds can be compared on the same replay
+	class BenchmarkReport
+	{
+	public:
+		struct Summary
+		{
+			double						mean; // Milliseconds
+			double						p50;
+			double						p90;
+			double						p99;
+			double						max;
+		};
+
+		explicit BenchmarkReport(uint32_t expectedFrames = 0);
+
+		void							AddFrame(const FramePhases& phases);
+
+		uint32_t						GetFrameCount() const
+		{
+			return uint32_t(m_frames.size());
+		}
+
+		// Count for the whole frame, the sum of every phase
+		Summary							Summarise(FramePhases::Phase phase) const;
+
+		// source and timeStep are only recorded, to say what was measured
+		bool							WriteJson(const char* path, const char* source, double timeStep) const;
+
+	private:
+		std::vector<FramePhases>		m_frames;
+	};
+
+} // namespace utils
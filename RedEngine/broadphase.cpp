@@ -0,0 +1,345 @@
+#include "red_engine.h"
+#include "broadphase.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace scene
+{
+
+	namespace
+	{
+		// Bodies per job when finding which regions each is in
+		const unsigned int c_GatherBatch = 4096;
+
+		// Keeps far-flung boxes from overflowing the cell coordinates
+		const float c_MaxCell = float(1 << 24);
+
+		// Past this many shifts per body the order has lost track and is sorted from scratch instead
+		const uint32_t c_ShiftsPerBody = 8;
+
+		utils::PerfCounter s_bodies("collision.bodies", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_pairs("collision.pairs");
+		utils::PerfCounter s_shifts("collision.sort_shifts");
+
+		// Index of the lowest set bit, value must not be 0
+		uint32_t LowestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(__builtin_ctz(value));
+#endif
+		}
+
+		// Orders as the float does, with the id to break ties
+		uint64_t SortKey(float value, uint32_t body)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			bits = (bits & 0x80000000) != 0 ? ~bits : bits | 0x80000000;
+			return uint64_t(bits) << 32 | body;
+		}
+
+		void ParallelFor(unsigned int count, unsigned int batchSize, const utils::JobSystem::RangeJob& job)
+		{
+			if (utils::JobSystem::Get() != nullptr)
+				utils::JobSystem::Get()->ParallelFor(count, batchSize, job);
+			else
+				job(0, count);
+		}
+	}
+
+	Broadphase::Broadphase(uint32_t axis, float regionSize) :
+		m_axes{ axis, (axis + 1) % 3, (axis + 2) % 3 },
+		m_inverseRegionSize(1.0f / regionSize),
+		m_stats{}
+	{
+		ASSERT(axis < 3, "Sweep axis %u isn't x, y or z.\n", axis);
+		ASSERT(regionSize > 0.0f, "Broadphase regions need a size.\n");
+	}
+
+	uint32_t Broadphase::AddBody(const Box& box)
+	{
+		// In no region until the next Update puts it in some
+		const CellRange none = { { 0, 0 }, { -1, -1 } };
+
+		uint32_t body;
+		if (!m_freeBodies.empty())
+		{
+			body = m_freeBodies.back();
+			m_freeBodies.pop_back();
+			m_boxes[body] = box;
+			m_cells[body] = none;
+			m_alive[body] = 1;
+		}
+		else
+		{
+			body = uint32_t(m_boxes.size());
+			m_boxes.push_back(box);
+			m_cells.push_back(none);
+			m_alive.push_back(1);
+		}
+		return body;
+	}
+
+	void Broadphase::RemoveBody(uint32_t body)
+	{
+		ASSERT(body < m_alive.size() && m_alive[body] != 0, "Removing body %u, which isn't in the broadphase.\n", body);
+		m_alive[body] = 0;
+		m_removedBodies.push_back(body);
+	}
+
+	int32_t Broadphase::CellOf(float value) const
+	{
+		const float cell = std::floor(std::min(std::max(value * m_inverseRegionSize, -c_MaxCell), c_MaxCell));
+		return int32_t(cell);
+	}
+
+	Broadphase::CellRange Broadphase::CellsOf(const Box& box) const
+	{
+		CellRange range;
+		for (uint32_t axis = 0; axis < 2; ++axis)
+		{
+			range.min[axis] = CellOf(box.min[m_axes[1 + axis]]);
+			range.max[axis] = CellOf(box.max[m_axes[1 + axis]]);
+		}
+		return range;
+	}
+
+	uint32_t Broadphase::FindRegion(int32_t cellA, int32_t cellB)
+	{
+		const uint64_t key = uint64_t(uint32_t(cellA)) << 32 | uint32_t(cellB);
+		const uint32_t* const found = m_regionLookup.find(key);
+		if (found != nullptr)
+			return *found;
+
+		m_regions.emplace_back();
+		Region& region = m_regions.back();
+		region.cell[0] = cellA;
+		region.cell[1] = cellB;
+		region.shifts = 0;
+		region.resorted = false;
+
+		const uint32_t index = uint32_t(m_regions.size() - 1);
+		m_regionLookup.insert(key, index);
+		return index;
+	}
+
+	void Broadphase::MoveBodies()
+	{
+		const uint32_t bodyCount = uint32_t(m_boxes.size());
+		m_newCells.resize(bodyCount);
+		ParallelFor(bodyCount, c_GatherBatch, [this](unsigned int begin, unsigned int end)
+		{
+			const CellRange none = { { 0, 0 }, { -1, -1 } };
+			for (unsigned int body = begin; body < end; ++body)
+				m_newCells[body] = m_alive[body] != 0 ? CellsOf(m_boxes[body]) : none;
+		});
+
+		// Only joining needs doing here; each region drops the bodies that left it as it sorts
+		for (uint32_t body = 0; body < bodyCount; ++body)
+		{
+			const CellRange& before = m_cells[body];
+			const CellRange& after = m_newCells[body];
+			if (memcmp(&before, &after, sizeof(CellRange)) == 0)
+				continue;
+
+			for (int32_t a = after.min[0]; a <= after.max[0]; ++a)
+			{
+				for (int32_t b = after.min[1]; b <= after.max[1]; ++b)
+				{
+					const bool wasIn = before.min[0] <= a && a <= before.max[0] && before.min[1] <= b && b <= before.max[1];
+					if (!wasIn)
+						m_regions[FindRegion(a, b)].entering.push_back(body);
+				}
+			}
+		}
+	}
+
+	void Broadphase::SortRegion(Region& region)
+	{
+		// The dead are in no region, so they go with the bodies that moved out
+		const int32_t cellA = region.cell[0];
+		const int32_t cellB = region.cell[1];
+		region.order.erase(std::remove_if(region.order.begin(), region.order.end(), [this, cellA, cellB](uint32_t body)
+		{
+			const CellRange& range = m_newCells[body];
+			return cellA < range.min[0] || cellA > range.max[0] || cellB < range.min[1] || cellB > range.max[1];
+		}), region.order.end());
+		region.order.insert(region.order.end(), region.entering.begin(), region.entering.end());
+		region.entering.clear();
+
+		const uint32_t axis = m_axes[0];
+		const uint32_t count = uint32_t(region.order.size());
+		region.sortedMin.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+			region.sortedMin[i] = m_boxes[region.order[i]].min[axis];
+
+		// Last frame's order is nearly right, so most bodies don't move at all
+		const uint64_t budget = uint64_t(count) * c_ShiftsPerBody;
+		uint64_t shifts = 0;
+		uint32_t sorted = 1;
+		for (; sorted < count && shifts <= budget; ++sorted)
+		{
+			const float value = region.sortedMin[sorted];
+			const uint32_t body = region.order[sorted];
+			uint32_t to = sorted;
+			while (to > 0 && region.sortedMin[to - 1] > value)
+			{
+				region.sortedMin[to] = region.sortedMin[to - 1];
+				region.order[to] = region.order[to - 1];
+				--to;
+			}
+			region.sortedMin[to] = value;
+			region.order[to] = body;
+			shifts += sorted - to;
+		}
+
+		region.shifts = uint32_t(std::min<uint64_t>(shifts, 0xffffffff));
+		region.resorted = sorted < count;
+		if (region.resorted)
+		{
+			std::vector<uint64_t> keys(count);
+			for (uint32_t i = 0; i < count; ++i)
+				keys[i] = SortKey(region.sortedMin[i], region.order[i]);
+			std::sort(keys.begin(), keys.end());
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				region.order[i] = uint32_t(keys[i]);
+				region.sortedMin[i] = m_boxes[region.order[i]].min[axis];
+			}
+		}
+	}
+
+	void Broadphase::SweepRegion(Region& region)
+	{
+		region.pairs.clear();
+
+		const uint32_t count = uint32_t(region.order.size());
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			region.sweepMin[axis].resize(count + 4);
+			region.sweepMax[axis].resize(count + 4);
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const Box& box = m_boxes[region.order[i]];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				region.sweepMin[axis][i] = box.min[m_axes[axis]];
+				region.sweepMax[axis][i] = box.max[m_axes[axis]];
+			}
+		}
+
+		// Comparisons with NaN fail, so the padding overlaps nothing
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			for (uint32_t i = count; i < count + 4; ++i)
+			{
+				region.sweepMin[axis][i] = std::numeric_limits<float>::quiet_NaN();
+				region.sweepMax[axis][i] = std::numeric_limits<float>::quiet_NaN();
+			}
+		}
+
+		const float* const minX = region.sweepMin[0].data();
+		const float* const maxX = region.sweepMax[0].data();
+		const float* const minY = region.sweepMin[1].data();
+		const float* const minZ = region.sweepMin[2].data();
+		const float* const maxY = region.sweepMax[1].data();
+		const float* const maxZ = region.sweepMax[2].data();
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const float endX = maxX[i];
+			const __m128 end = _mm_set1_ps(endX);
+			const __m128 startY = _mm_set1_ps(minY[i]);
+			const __m128 endY = _mm_set1_ps(maxY[i]);
+			const __m128 startZ = _mm_set1_ps(minZ[i]);
+			const __m128 endZ = _mm_set1_ps(maxZ[i]);
+			const uint32_t body = region.order[i];
+
+			// Everything starting before this body ends is a candidate; sorted, so the first to start after ends the scan
+			for (uint32_t j = i + 1; j < count && minX[j] <= endX; j += 4)
+			{
+				const __m128 alongX = _mm_cmple_ps(_mm_loadu_ps(minX + j), end);
+				const __m128 acrossY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + j), endY), _mm_cmpge_ps(_mm_loadu_ps(maxY + j), startY));
+				const __m128 acrossZ = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minZ + j), endZ), _mm_cmpge_ps(_mm_loadu_ps(maxZ + j), startZ));
+				uint32_t mask = uint32_t(_mm_movemask_ps(_mm_and_ps(alongX, _mm_and_ps(acrossY, acrossZ))));
+				while (mask != 0)
+				{
+					const uint32_t other = j + LowestBit(mask);
+					mask &= mask - 1;
+
+					// Both bodies are in every region their overlap touches; only the one with its low corner reports it
+					if (CellOf(std::max(minY[i], minY[other])) != region.cell[0] || CellOf(std::max(minZ[i], minZ[other])) != region.cell[1])
+						continue;
+
+					const uint32_t otherBody = region.order[other];
+					region.pairs.push_back(body < otherBody ? Pair{ body, otherBody } : Pair{ otherBody, body });
+				}
+			}
+		}
+	}
+
+	void Broadphase::Update()
+	{
+		MoveBodies();
+
+		// Regions are independent, each sorts and sweeps in one job
+		const uint32_t regionCount = uint32_t(m_regions.size());
+		ParallelFor(regionCount, 1, [this](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				SortRegion(m_regions[i]);
+				SweepRegion(m_regions[i]);
+			}
+		});
+
+		m_cells.swap(m_newCells);
+		m_freeBodies.insert(m_freeBodies.end(), m_removedBodies.begin(), m_removedBodies.end());
+		m_removedBodies.clear();
+
+		// Each region's pairs in turn, copied in parallel once their offsets are known
+		m_stats = {};
+		m_regionOffsets.resize(regionCount + 1);
+		m_regionOffsets[0] = 0;
+		for (uint32_t i = 0; i < regionCount; ++i)
+		{
+			const Region& region = m_regions[i];
+			m_regionOffsets[i + 1] = m_regionOffsets[i] + uint32_t(region.pairs.size());
+			m_stats.memberships += uint32_t(region.order.size());
+			m_stats.shifts += region.shifts;
+			m_stats.resorts += region.resorted ? 1 : 0;
+		}
+		m_pairs.resize(m_regionOffsets[regionCount]);
+		ParallelFor(regionCount, 16, [this](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+			{
+				if (!m_regions[i].pairs.empty())
+					memcpy(&m_pairs[m_regionOffsets[i]], m_regions[i].pairs.data(), m_regions[i].pairs.size() * sizeof(Pair));
+			}
+		});
+
+		m_stats.bodies = uint32_t(m_boxes.size() - m_freeBodies.size());
+		m_stats.regions = regionCount;
+		m_stats.pairs = uint32_t(m_pairs.size());
+		s_bodies.Set(m_stats.bodies);
+		s_pairs.Add(m_stats.pairs);
+		s_shifts.Add(m_stats.shifts);
+	}
+
+} // namespace scene
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "hash_map.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+
+	// Sweep and prune collision broadphase. A single sweep over a big world sees every body in a slice across
+	// it, so space is cut into a grid of regions over the two axes not swept, and each region sweeps only the bodies
+	// touching it. A region keeps its bodies sorted by where their boxes start along the sweep axis, and the order
+	// carries over between frames, so each Update only insertion sorts the few that moved past a neighbour. Each
+	// body then scans forward through the bodies starting before it ends, testing the other two axes four at a time
+	// with SSE. Regions sort and sweep as jobs of their own. A pair in several regions is reported only by the one
+	// holding the low corner of where the two boxes overlap, so every pair comes out exactly once.
+	// Bodies much bigger than a region join every region they touch, so size regions above the typical body.
+	// Boxes are set from the update thread; Update and the pairs belong to it too.
+	class Broadphase
+	{
+	public:
+		struct Box
+		{
+			float						min[3];
+			float						max[3];
+		};
+
+		// Body ids, first < second
+		struct Pair
+		{
+			uint32_t					first;
+			uint32_t					second;
+		};
+
+		struct Stats
+		{
+			uint32_t					bodies;
+			uint32_t					regions;
+			uint32_t					memberships; // Bodies in regions, counting a body once per region it touches
+			uint32_t					pairs;
+			uint32_t					shifts; // Places moved by the insertion sorts
+			uint32_t					resorts; // Regions where too much moved and the order was sorted afresh
+		};
+
+		// axis is the one swept along; regionSize is in world units across the other two
+		explicit Broadphase(uint32_t axis = 0, float regionSize = 16.0f);
+
+		uint32_t						AddBody(const Box& box);
+		void							RemoveBody(uint32_t body);
+
+		void							SetBox(uint32_t body, const Box& box)
+		{
+			m_boxes[body] = box;
+		}
+
+		const Box&						GetBox(uint32_t body) const
+		{
+			return m_boxes[body];
+		}
+
+		// Every body id is below this, with gaps where bodies were removed
+		uint32_t						GetBodyLimit() const
+		{
+			return uint32_t(m_boxes.size());
+		}
+
+		bool							IsAlive(uint32_t body) const
+		{
+			return m_alive[body] != 0;
+		}
+
+		// Moves bodies between regions, re-sorts and finds every overlapping pair, across the job system
+		void							Update();
+
+		// Boxes that touch count as overlapping. Region by region in sweep order, which is the same however many
+		// workers there are.
+		const std::vector<Pair>&		GetPairs() const
+		{
+			return m_pairs;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		// The cells of the region grid a box touches, inclusive; empty when min passes max
+		struct CellRange
+		{
+			int32_t						min[2];
+			int32_t						max[2];
+		};
+
+		struct Region
+		{
+			int32_t						cell[2];
+
+			// Sorted by where each box starts on the sweep axis; the order is what carries between frames
+			std::vector<uint32_t>		order;
+			std::vector<float>			sortedMin;
+			std::vector<uint32_t>		entering; // Joined since the last Update
+
+			// The boxes in sorted order as streams for the sweep, padded with bodies that overlap nothing
+			std::vector<float>			sweepMin[3];
+			std::vector<float>			sweepMax[3];
+
+			std::vector<Pair>			pairs;
+			uint32_t					shifts;
+			bool						resorted;
+		};
+
+		CellRange						CellsOf(const Box& box) const;
+		int32_t							CellOf(float value) const;
+		uint32_t						FindRegion(int32_t cellA, int32_t cellB); // Made if it isn't there
+		void							MoveBodies();
+		void							SortRegion(Region& region);
+		void							SweepRegion(Region& region);
+
+		uint32_t						m_axes[3]; // Swept, then the two the regions are laid over
+		float							m_inverseRegionSize;
+
+		std::vector<Box>				m_boxes; // By body id
+		std::vector<CellRange>			m_cells; // What each body was in at the last Update
+		std::vector<CellRange>			m_newCells; // And what it is in now, while updating
+		std::vector<uint8_t>			m_alive;
+		std::vector<uint32_t>			m_freeBodies;
+		std::vector<uint32_t>			m_removedBodies; // Free once the next Update has taken them out of their regions
+
+		std::vector<Region>				m_regions; // In the order they were first needed
+		containers::HashMap<uint64_t, uint32_t> m_regionLookup; // Packed cell to index in m_regions
+
+		std::vector<uint32_t>			m_regionOffsets; // Of each region's pairs in m_pairs
+		std::vector<Pair>				m_pairs;
+
+		Stats							m_stats;
+	};
+
+} // namespace scene
@@ -0,0 +1,349 @@
+#include "red_engine.h"
+#include "buffer_manager.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_bufferAllocations("buffers.allocations");
+		utils::PerfCounter s_bufferUploadBytes("buffers.upload_bytes");
+		utils::PerfCounter s_bufferFenceStalls("buffers.fence_stalls");
+
+		const char* const c_KindNames[BufferManager::KindCount] = { "vertex", "index", "constant" };
+
+		// Offsets in bytes are units of this, so every allocation starts aligned to it.
+		// Constant buffer offsets go in 16-constant steps.
+		const uint32_t c_Granularity[BufferManager::KindCount] = { 16, 16, 256 };
+	}
+
+	BufferManager* BufferManager::g_bufferManager = nullptr;
+
+	void BufferManager::Create(ID3D11Device1* device)
+	{
+		ASSERT(g_bufferManager == nullptr, "The buffer manager already exists.\n");
+		g_bufferManager = new BufferManager(device);
+	}
+
+	void BufferManager::Destroy()
+	{
+		delete g_bufferManager;
+		g_bufferManager = nullptr;
+	}
+
+	BufferManager::BufferManager(ID3D11Device1* device) :
+		m_device(nullptr),
+		m_context(nullptr),
+		m_constantOffsetting(false),
+		m_constantPartialUpdate(false),
+		m_frames{},
+		m_frameNumber(0),
+		m_retiredFrames(0)
+	{
+		AcquireDevice(device);
+	}
+
+	BufferManager::~BufferManager()
+	{
+		// Shutdown has waited for the GPU, so pending frees can go straight back before the leak check counts them
+		for (Frame& frame : m_frames)
+			Retire(frame);
+		ReleaseDevice();
+
+		for (uint32_t kind = 0; kind < KindCount; ++kind)
+		{
+			for (Pool& pool : m_pools[kind])
+			{
+				const utils::OffsetAllocator::Stats stats = pool.allocator->GetStats();
+				if (stats.allocations > 0)
+					DEBUG_MESSAGE("%u %s buffer allocations still live at shutdown.\n", stats.allocations, c_KindNames[kind]);
+
+#if defined(_WIN32)
+				if (pool.registryHandle != ResourceRegistry::InvalidHandle)
+					ResourceRegistry::Get()->Unregister(pool.registryHandle);
+#endif
+				delete pool.allocator;
+			}
+		}
+	}
+
+	bool BufferManager::Allocate(Kind kind, uint32_t size, const void* initialData, Allocation& allocation)
+	{
+		allocation = Allocation();
+		allocation.kind = kind;
+		allocation.node = utils::OffsetAllocator::InvalidNode;
+
+		if (size == 0 || size > PoolSize || (kind == Constant && !(m_constantOffsetting && m_constantPartialUpdate)))
+			return false;
+
+		const uint32_t granularity = c_Granularity[kind];
+		const uint32_t units = (size + granularity - 1) / granularity;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// First pool with room, then a new one
+			std::deque<Pool>& pools = m_pools[kind];
+			utils::OffsetAllocator::Allocation range = { 0, utils::OffsetAllocator::InvalidNode };
+			uint32_t pool = 0;
+			for (; pool < pools.size(); ++pool)
+			{
+				range = pools[pool].allocator->Allocate(units);
+				if (range.node != utils::OffsetAllocator::InvalidNode)
+					break;
+			}
+
+			if (pool == pools.size())
+			{
+				if (!CreatePool(kind))
+					return false;
+				range = pools[pool].allocator->Allocate(units);
+			}
+
+			allocation.buffer = &pools[pool].buffer;
+			allocation.offset = range.offset * granularity;
+			allocation.size = units * granularity;
+			allocation.bytes = size;
+			allocation.pool = pool;
+			allocation.node = range.node;
+		}
+
+		s_bufferAllocations.Add();
+
+		if (initialData != nullptr)
+			Update(allocation, initialData);
+		return true;
+	}
+
+	void BufferManager::Free(const Allocation& allocation)
+	{
+		if (allocation.node == utils::OffsetAllocator::InvalidNode)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frames[m_frameNumber % (MaxFramesInFlight + 1)].frees.push_back(allocation);
+	}
+
+	void BufferManager::Update(const Allocation& allocation, const void* data)
+	{
+		ASSERT(allocation.node != utils::OffsetAllocator::InvalidNode, "Updating a buffer allocation that failed.\n");
+		s_bufferUploadBytes.Add(allocation.bytes);
+
+#if defined(_WIN32)
+		uint32_t registryHandle;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			registryHandle = m_pools[allocation.kind][allocation.pool].registryHandle;
+		}
+
+		// The registry's copy is what the pool is rebuilt from after device loss, so it is kept up while the device is gone
+		if (registryHandle != ResourceRegistry::InvalidHandle)
+			ResourceRegistry::Get()->UpdateData(registryHandle, allocation.offset, data, allocation.bytes);
+
+		if (m_context == nullptr)
+			return;
+
+		// The driver copies the data aside if the GPU is still reading the range, so this never stalls
+		const D3D11_BOX box = { allocation.offset, 0, 0, allocation.offset + allocation.bytes, 1, 1 };
+		m_context->UpdateSubresource1(*allocation.buffer, 0, &box, data, 0, 0, 0);
+#else
+		(void)data;
+#endif
+	}
+
+	void BufferManager::OnDeviceLost()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Nothing is in flight on a device that has gone, including what the current frame freed
+		for (Frame& frame : m_frames)
+			Retire(frame);
+		m_retiredFrames = m_frameNumber;
+		ReleaseDevice();
+	}
+
+	void BufferManager::OnDeviceRestored(ID3D11Device1* device)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		AcquireDevice(device);
+	}
+
+	void BufferManager::EndFrame()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+#if defined(_WIN32)
+		Frame& submitted = m_frames[m_frameNumber % (MaxFramesInFlight + 1)];
+		if (m_context != nullptr)
+			m_context->End(submitted.fence);
+#endif
+
+		++m_frameNumber;
+
+		// Oldest first; the frame whose slot is needed next has to finish, the rest only if they already have
+		while (m_retiredFrames < m_frameNumber)
+		{
+			Frame& frame = m_frames[m_retiredFrames % (MaxFramesInFlight + 1)];
+			const bool mustFinish = m_frameNumber - m_retiredFrames > MaxFramesInFlight;
+
+			bool finished = mustFinish;
+#if defined(_WIN32)
+			if (m_context != nullptr)
+			{
+				finished = m_context->GetData(frame.fence, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+				if (!finished && mustFinish)
+				{
+					s_bufferFenceStalls.Add();
+					while (m_context->GetData(frame.fence, nullptr, 0, 0) == S_FALSE)
+						;
+					finished = true;
+				}
+			}
+#endif
+			if (!finished)
+				break;
+
+			Retire(frame);
+			++m_retiredFrames;
+		}
+	}
+
+	BufferManager::Stats BufferManager::GetStats(Kind kind) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Stats stats = {};
+		const uint32_t granularity = c_Granularity[kind];
+		uint64_t splinteredBytes = 0;
+		for (const Pool& pool : m_pools[kind])
+		{
+			const utils::OffsetAllocator::Stats poolStats = pool.allocator->GetStats();
+			++stats.pools;
+			stats.allocations += poolStats.allocations;
+			stats.capacity += uint64_t(poolStats.size) * granularity;
+			stats.usedBytes += uint64_t(poolStats.usedUnits) * granularity;
+			stats.freeBytes += uint64_t(poolStats.freeUnits) * granularity;
+			stats.freeBlocks += poolStats.freeBlocks;
+			if (uint64_t(poolStats.largestFree) * granularity > stats.largestFree)
+				stats.largestFree = uint64_t(poolStats.largestFree) * granularity;
+			splinteredBytes += uint64_t(poolStats.freeUnits - poolStats.largestFree) * granularity;
+		}
+
+		for (const Frame& frame : m_frames)
+		{
+			for (const Allocation& allocation : frame.frees)
+			{
+				if (allocation.kind == kind)
+					++stats.pendingFrees;
+			}
+		}
+
+		stats.fragmentation = stats.freeBytes > 0 ? float(double(splinteredBytes) / double(stats.freeBytes)) : 0.0f;
+		return stats;
+	}
+
+	void BufferManager::LogReport() const
+	{
+		for (uint32_t kind = 0; kind < KindCount; ++kind)
+		{
+			const Stats stats = GetStats(Kind(kind));
+			if (stats.pools == 0)
+				continue;
+
+			DEBUG_MESSAGE("%s buffers: %u allocations in %u pools, %.2f of %.2f MB used, %u free blocks, largest %.2f MB, "
+				"fragmentation %.1f%%, %u frees pending.\n", c_KindNames[kind], stats.allocations, stats.pools,
+				double(stats.usedBytes) / (1024.0 * 1024.0), double(stats.capacity) / (1024.0 * 1024.0), stats.freeBlocks,
+				double(stats.largestFree) / (1024.0 * 1024.0), stats.fragmentation * 100.0f, stats.pendingFrees);
+		}
+	}
+
+	void BufferManager::AcquireDevice(ID3D11Device1* device)
+	{
+		m_device = device;
+		m_constantOffsetting = device == nullptr;
+		m_constantPartialUpdate = device == nullptr;
+
+#if defined(_WIN32)
+		if (m_device != nullptr)
+		{
+			m_device->AddRef();
+			m_device->GetImmediateContext1(&m_context);
+
+			// Binding at an offset and writing a box of a constant buffer are separate caps; the pool needs both
+			D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+			if (SUCCEEDED(m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+			{
+				m_constantOffsetting = options.ConstantBufferOffsetting != FALSE;
+				m_constantPartialUpdate = options.ConstantBufferPartialUpdate != FALSE;
+			}
+
+			const D3D11_QUERY_DESC fenceDesc = { D3D11_QUERY_EVENT, 0 };
+			for (Frame& frame : m_frames)
+			{
+				HRESULT hr = m_device->CreateQuery(&fenceDesc, &frame.fence);
+				ASSERT_HANDLE(hr);
+			}
+		}
+#endif
+	}
+
+	void BufferManager::ReleaseDevice()
+	{
+		for (Frame& frame : m_frames)
+		{
+#if defined(_WIN32)
+			if (frame.fence != nullptr)
+				frame.fence->Release();
+#endif
+			frame.fence = nullptr;
+		}
+
+#if defined(_WIN32)
+		if (m_context != nullptr)
+			m_context->Release();
+		if (m_device != nullptr)
+			m_device->Release();
+#endif
+		m_context = nullptr;
+		m_device = nullptr;
+	}
+
+	bool BufferManager::CreatePool(Kind kind)
+	{
+		// In place first, the registry writes the buffer straight into the pool
+		m_pools[kind].push_back(Pool{ nullptr, nullptr, ResourceRegistry::InvalidHandle });
+		Pool& pool = m_pools[kind].back();
+
+#if defined(_WIN32)
+		if (m_device != nullptr)
+		{
+			static const UINT bindFlags[KindCount] = { D3D11_BIND_VERTEX_BUFFER, D3D11_BIND_INDEX_BUFFER, D3D11_BIND_CONSTANT_BUFFER };
+
+			const CD3D11_BUFFER_DESC desc(PoolSize, bindFlags[kind], D3D11_USAGE_DEFAULT);
+			pool.registryHandle = ResourceRegistry::Get()->RegisterBuffer(&pool.buffer, desc);
+			if (pool.registryHandle == ResourceRegistry::InvalidHandle)
+			{
+				DEBUG_MESSAGE("Unable to create a %u MB %s buffer pool.\n", PoolSize / (1024 * 1024), c_KindNames[kind]);
+				m_pools[kind].pop_back();
+				return false;
+			}
+		}
+#endif
+
+		pool.allocator = new utils::OffsetAllocator(PoolSize / c_Granularity[kind]);
+		return true;
+	}
+
+	void BufferManager::Retire(Frame& frame)
+	{
+		for (const Allocation& allocation : frame.frees)
+		{
+			const utils::OffsetAllocator::Allocation range = { allocation.offset / c_Granularity[allocation.kind], allocation.node };
+			m_pools[allocation.kind][allocation.pool].allocator->Free(range);
+		}
+		frame.frees.clear();
+	}
+
+} // namespace DX
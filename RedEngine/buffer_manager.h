@@ -0,0 +1,126 @@
+#pragma once
+
+#include "offset_allocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct ID3D11Buffer;
+struct ID3D11Device1;
+struct ID3D11DeviceContext1;
+struct ID3D11Query;
+
+namespace DX
+{
+
+	// Carves vertex, index and constant data out of a few big buffers instead of a device allocation each.
+	// Frees are held until the GPU has finished the frame they were made in, fenced with event queries, so
+	// nothing is reused while a draw in flight may still read it. Without a device (headless tools) the buffers
+	// are null and frames are taken to finish MaxFramesInFlight frames later. With a device the pools are registered
+	// with the ResourceRegistry, which keeps a copy of what is written to them so they survive device loss.
+	class BufferManager
+	{
+	public:
+		enum Kind : uint32_t
+		{
+			Vertex,
+			Index,
+			Constant, // Bound with *SSetConstantBuffers1 and boxed updates, so needs offsetting and partial updates (D3D11.1)
+			KindCount,
+		};
+
+		struct Allocation
+		{
+			ID3D11Buffer* const*		buffer; // The pool's, read at draw time as device loss replaces it
+			uint32_t					offset; // Bytes
+			uint32_t					size; // Bytes taken from the pool, rounded up to its granularity
+			uint32_t					bytes; // Bytes asked for, all Update reads from data
+			Kind						kind;
+			uint32_t					pool;
+			uint32_t					node; // OffsetAllocator::InvalidNode if the allocation failed
+		};
+
+		struct Stats
+		{
+			uint32_t					pools;
+			uint32_t					allocations;
+			uint64_t					capacity;
+			uint64_t					usedBytes;
+			uint64_t					freeBytes;
+			uint64_t					largestFree;
+			uint32_t					freeBlocks;
+			uint32_t					pendingFrees; // Waiting on the GPU
+			float						fragmentation; // Over all pools, 0 when each pool's free space is one block
+		};
+
+		static const uint32_t			PoolSize = 32 * 1024 * 1024;
+		static const uint32_t			MaxFramesInFlight = 3;
+
+		static void						Create(ID3D11Device1* device);
+		static void						Destroy();
+
+		static BufferManager*			Get()
+		{
+			return g_bufferManager;
+		}
+
+		// initialData may be null. Anything bigger than PoolSize fails.
+		bool							Allocate(Kind kind, uint32_t size, const void* initialData, Allocation& allocation);
+
+		// Released once the GPU is done with the current frame
+		void							Free(const Allocation& allocation);
+
+		// Whole allocation updates on the immediate context, for the allocations that change now and then.
+		// data holds the bytes asked for at Allocate, not the rounded up size.
+		void							Update(const Allocation& allocation, const void* data);
+
+		// The GPU is gone: pending frees go back straight away and the device references are dropped
+		void							OnDeviceLost();
+		void							OnDeviceRestored(ID3D11Device1* device);
+
+		// Fences the frame just submitted and hands back what earlier frames freed, if the GPU has finished them
+		void							EndFrame();
+
+		Stats							GetStats(Kind kind) const;
+		void							LogReport() const;
+
+	private:
+		struct Pool
+		{
+			ID3D11Buffer*				buffer;
+			utils::OffsetAllocator*		allocator;
+			uint32_t					registryHandle;
+		};
+
+		struct Frame
+		{
+			ID3D11Query*				fence;
+			std::vector<Allocation>		frees;
+		};
+
+		BufferManager(ID3D11Device1* device);
+		~BufferManager();
+
+		void							AcquireDevice(ID3D11Device1* device);
+		void							ReleaseDevice();
+		bool							CreatePool(Kind kind);
+		void							Retire(Frame& frame);
+
+		static BufferManager*			g_bufferManager;
+
+		ID3D11Device1*					m_device;
+		ID3D11DeviceContext1*			m_context;
+		bool							m_constantOffsetting;
+		bool							m_constantPartialUpdate;
+
+		mutable std::mutex				m_mutex; // Meshes are created off the render thread during startup
+		std::deque<Pool>				m_pools[KindCount]; // Deques, so the registry can keep pointers to the buffers
+
+		Frame							m_frames[MaxFramesInFlight + 1]; // Ring, indexed by frame number
+		uint64_t						m_frameNumber; // The frame being recorded
+		uint64_t						m_retiredFrames; // Every frame before this one has finished on the GPU
+	};
+
+} // namespace DX
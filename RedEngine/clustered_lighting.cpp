@@ -0,0 +1,160 @@
+#include "red_engine.h"
+#include "clustered_lighting.h"
+#include "light_clusters.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+#include "ClusteredPixelShader.h"
+
+#include <algorithm>
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_uploadBytes("render.light_upload_bytes");
+
+		// Rewritten whole every frame
+		void Fill(ID3D11DeviceContext* deviceContext, ID3D11Buffer* buffer, const void* data, size_t size)
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			const HRESULT hr = deviceContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+			ASSERT_HANDLE(hr);
+			if (size > 0)
+				memcpy(mapped.pData, data, size);
+			deviceContext->Unmap(buffer, 0);
+			s_uploadBytes.Add(int64_t(size));
+		}
+	}
+
+	ClusteredLighting::ClusteredLighting() :
+		m_pixelShader(nullptr),
+		m_constantBuffer(nullptr),
+		m_lightBuffer(nullptr),
+		m_clusterBuffer(nullptr),
+		m_indexBuffer(nullptr),
+		m_views{},
+		m_maxLights(0),
+		m_clusterCount(0),
+		m_maxIndices(0),
+		m_ambient{ 0.2f, 0.2f, 0.2f }
+	{
+	}
+
+	ClusteredLighting::~ClusteredLighting()
+	{
+		Release();
+	}
+
+	bool ClusteredLighting::Create(ID3D11Device* device, uint32_t maxLights, uint32_t clusterCount, uint32_t maxIndices)
+	{
+		ASSERT(!IsCreated(), "The clustered lighting has already been created.\n");
+
+		if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+		{
+			DEBUG_MESSAGE("No clustered lighting below feature level 10_0.\n");
+			return false;
+		}
+
+		m_maxLights = maxLights;
+		m_clusterCount = clusterCount;
+		m_maxIndices = maxIndices;
+
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		m_resources.push_back(registry->RegisterPixelShader(&m_pixelShader, g_ClusteredPixelShader, sizeof(g_ClusteredPixelShader)));
+
+		CD3D11_BUFFER_DESC constantDesc(sizeof(Constants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_constantBuffer, constantDesc));
+
+		// Each light is two float4s, each cluster a uint2, each index a uint16
+		struct TypedBuffer
+		{
+			ID3D11Buffer**				buffer;
+			ID3D11ShaderResourceView**	view;
+			DXGI_FORMAT					format;
+			uint32_t					elements;
+			uint32_t					elementSize;
+		};
+		const TypedBuffer buffers[] =
+		{
+			{ &m_lightBuffer, &m_views[0], DXGI_FORMAT_R32G32B32A32_FLOAT, maxLights * 2, 16 },
+			{ &m_clusterBuffer, &m_views[1], DXGI_FORMAT_R32G32_UINT, clusterCount, 8 },
+			{ &m_indexBuffer, &m_views[2], DXGI_FORMAT_R16_UINT, maxIndices, 2 },
+		};
+
+		for (const TypedBuffer& typed : buffers)
+		{
+			CD3D11_BUFFER_DESC bufferDesc(std::max(typed.elements, 1u) * typed.elementSize, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC,
+				D3D11_CPU_ACCESS_WRITE);
+			const ResourceRegistry::Handle buffer = registry->RegisterBuffer(typed.buffer, bufferDesc);
+			m_resources.push_back(buffer);
+			if (buffer == ResourceRegistry::InvalidHandle)
+				break;
+
+			CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(D3D11_SRV_DIMENSION_BUFFER, typed.format, 0, std::max(typed.elements, 1u));
+			m_resources.push_back(registry->RegisterShaderResourceView(typed.view, buffer, &viewDesc));
+		}
+
+		for (ResourceRegistry::Handle handle : m_resources)
+		{
+			if (handle == ResourceRegistry::InvalidHandle)
+			{
+				Release();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void ClusteredLighting::Release()
+	{
+		// Views were registered after their buffers, so they go first
+		while (!m_resources.empty())
+		{
+			if (m_resources.back() != ResourceRegistry::InvalidHandle)
+				ResourceRegistry::Get()->Unregister(m_resources.back());
+			m_resources.pop_back();
+		}
+	}
+
+	void ClusteredLighting::Upload(ID3D11DeviceContext* deviceContext, const scene::LightClusters& clusters, const D3D11_VIEWPORT& viewport)
+	{
+		ASSERT(IsCreated(), "Uploading lights without the clustered lighting.\n");
+		ASSERT(clusters.GetClusters().size() == m_clusterCount, "%zu clusters, but the buffer was made for %u.\n", clusters.GetClusters().size(),
+			m_clusterCount);
+
+		const std::vector<scene::LightClusters::GpuLight>& lights = clusters.GetGpuLights();
+		const std::vector<uint16_t>& indices = clusters.GetLightIndices();
+		const uint32_t lightCount = uint32_t(lights.size());
+		ASSERT(lightCount <= m_maxLights, "%u lights, but the buffer was made for %u.\n", lightCount, m_maxLights);
+		const uint32_t indexCount = std::min(uint32_t(indices.size()), m_maxIndices);
+
+		Constants constants = {};
+		constants.gridSize[0] = clusters.GetTilesX();
+		constants.gridSize[1] = clusters.GetTilesY();
+		constants.gridSize[2] = clusters.GetSlices();
+		constants.gridSize[3] = lightCount;
+		constants.clusterScale[0] = float(clusters.GetTilesX()) / viewport.Width;
+		constants.clusterScale[1] = float(clusters.GetTilesY()) / viewport.Height;
+		clusters.GetSliceScaleBias(constants.clusterScale[2], constants.clusterScale[3]);
+		constants.ambient[0] = m_ambient[0];
+		constants.ambient[1] = m_ambient[1];
+		constants.ambient[2] = m_ambient[2];
+
+		Fill(deviceContext, m_constantBuffer, &constants, sizeof(constants));
+		Fill(deviceContext, m_lightBuffer, lights.data(), lightCount * sizeof(scene::LightClusters::GpuLight));
+		Fill(deviceContext, m_clusterBuffer, clusters.GetClusters().data(), m_clusterCount * sizeof(scene::LightClusters::Cluster));
+		Fill(deviceContext, m_indexBuffer, indices.data(), indexCount * sizeof(uint16_t));
+	}
+
+	void ClusteredLighting::Bind(ID3D11DeviceContext* deviceContext)
+	{
+		ASSERT(IsCreated(), "Binding lights without the clustered lighting.\n");
+
+		deviceContext->PSSetShaderResources(0, _countof(m_views), m_views);
+		deviceContext->PSSetConstantBuffers(2, 1, &m_constantBuffer);
+	}
+
+} // namespace DX
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+	class LightClusters;
+}
+
+namespace DX
+{
+
+	// The GPU half of the clustered lighting: LightClusters' lights, cluster offsets and counts and light index
+	// list go up once a frame into dynamic typed buffers, and are bound for ClusteredPixelShader. Typed buffer
+	// views need feature level 10_0; below that Create fails and the scene stays unlit.
+	class ClusteredLighting
+	{
+	public:
+		// Register b2 of ClusteredPixelShader
+		struct Constants
+		{
+			uint32_t					gridSize[4]; // Tiles across, tiles down, slices, lights
+			float						clusterScale[4]; // Tiles per pixel across and down, slice scale and bias
+			float						ambient[4];
+		};
+		static_assert((sizeof(Constants) % 16) == 0, "Constant buffer must always be 16-byte aligned");
+
+		ClusteredLighting();
+		~ClusteredLighting();
+
+		bool							Create(ID3D11Device* device, uint32_t maxLights, uint32_t clusterCount, uint32_t maxIndices);
+		void							Release();
+
+		bool							IsCreated() const
+		{
+			return !m_resources.empty();
+		}
+
+		// The clusters must have been made for at most maxLights, so every index they hold is uploaded
+		void							Upload(ID3D11DeviceContext* deviceContext, const scene::LightClusters& clusters, const D3D11_VIEWPORT& viewport);
+
+		// The buffers at t0 to t2 and the constants at b2, for whatever draws with GetPixelShader
+		void							Bind(ID3D11DeviceContext* deviceContext);
+
+		ID3D11PixelShader*				GetPixelShader() const
+		{
+			return m_pixelShader;
+		}
+
+		void							SetAmbient(float red, float green, float blue)
+		{
+			m_ambient[0] = red;
+			m_ambient[1] = green;
+			m_ambient[2] = blue;
+		}
+
+	private:
+		ID3D11PixelShader*				m_pixelShader;
+		ID3D11Buffer*					m_constantBuffer;
+		ID3D11Buffer*					m_lightBuffer;
+		ID3D11Buffer*					m_clusterBuffer;
+		ID3D11Buffer*					m_indexBuffer;
+		ID3D11ShaderResourceView*		m_views[3]; // Lights, clusters, indices
+		std::vector<uint32_t>			m_resources; // ResourceRegistry handles
+
+		uint32_t						m_maxLights;
+		uint32_t						m_clusterCount;
+		uint32_t						m_maxIndices;
+		float							m_ambient[3];
+	};
+
+} // namespace DX
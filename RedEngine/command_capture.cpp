@@ -0,0 +1,981 @@
+#include "red_engine.h"
+#include "command_capture.h"
+
+#include <cstring>
+
+namespace DX
+{
+
+	namespace
+	{
+		uint32_t FloatBits(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+	}
+
+	CommandCapture::CommandCapture() :
+		m_context(nullptr),
+		m_unrecorded(0)
+	{
+	}
+
+	CommandCapture::~CommandCapture()
+	{
+		for (IUnknown* object : m_objects)
+			object->Release();
+	}
+
+	void CommandCapture::StartCapture(ID3D11DeviceContext1* context)
+	{
+		ASSERT(!IsCapturing(), "Already capturing commands.\n");
+
+		m_context = context;
+		m_writer.Reset();
+		m_unrecorded = 0;
+	}
+
+	bool CommandCapture::FinishCapture(const char* path)
+	{
+		ASSERT(IsCapturing(), "Finishing a command capture that was never started.\n");
+
+		if (!m_mappings.empty())
+			DEBUG_MESSAGE("%u resources were still mapped at the end of the capture, their writes are missing.\n", uint32_t(m_mappings.size()));
+
+		const bool ok = m_writer.Save(path);
+		if (ok)
+		{
+			DEBUG_MESSAGE("Captured %u commands using %u objects, %u KB, to %s.\n", m_writer.GetCommandCount(), uint32_t(m_objects.size()),
+				uint32_t(m_writer.GetSize() / 1024), path);
+		}
+		if (m_unrecorded > 0)
+			DEBUG_MESSAGE("%u context calls in the capture weren't recorded, command_replay lists them.\n", m_unrecorded);
+
+		for (IUnknown* object : m_objects)
+			object->Release();
+		m_objects.clear();
+		m_objectIds.clear();
+		m_mappings.clear();
+		m_writer.Reset();
+		m_context = nullptr;
+		return ok;
+	}
+
+	HRESULT CommandCapture::QueryInterface(REFIID riid, void** object)
+	{
+		if (object == nullptr)
+			return E_POINTER;
+
+		if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild) || riid == __uuidof(ID3D11DeviceContext) ||
+			riid == __uuidof(ID3D11DeviceContext1))
+		{
+			*object = static_cast<ID3D11DeviceContext1*>(this);
+			return S_OK;
+		}
+
+		// Annotations and the like go to the real context, outside the capture
+		return m_context->QueryInterface(riid, object);
+	}
+
+	ULONG CommandCapture::AddRef()
+	{
+		return 1;
+	}
+
+	ULONG CommandCapture::Release()
+	{
+		return 1;
+	}
+
+	uint32_t CommandCapture::GetObjectId(ID3D11DeviceChild* object, CommandObjectType type)
+	{
+		if (object == nullptr)
+			return 0;
+
+		const auto found = m_objectIds.find(object);
+		if (found != m_objectIds.end())
+			return found->second;
+
+		const uint32_t id = uint32_t(m_objects.size()) + 1;
+		object->AddRef();
+		m_objects.push_back(object);
+		m_objectIds.emplace(object, id);
+
+		uint32_t args[8] = { id, type };
+		uint32_t argCount = 2;
+		if (type == CommandObjectBuffer)
+		{
+			D3D11_BUFFER_DESC desc;
+			static_cast<ID3D11Buffer*>(object)->GetDesc(&desc);
+			args[argCount++] = desc.ByteWidth;
+			args[argCount++] = desc.Usage;
+			args[argCount++] = desc.BindFlags;
+			args[argCount++] = desc.CPUAccessFlags;
+			args[argCount++] = desc.MiscFlags;
+			args[argCount++] = desc.StructureByteStride;
+		}
+
+		m_writer.Write(CommandDeclareObject, args, argCount);
+		return id;
+	}
+
+	uint32_t CommandCapture::GetResourceId(ID3D11Resource* resource)
+	{
+		if (resource == nullptr)
+			return 0;
+
+		D3D11_RESOURCE_DIMENSION dimension;
+		resource->GetType(&dimension);
+		return GetObjectId(resource, dimension == D3D11_RESOURCE_DIMENSION_BUFFER ? CommandObjectBuffer : CommandObjectTexture);
+	}
+
+	template<typename T>
+	void CommandCapture::WriteSlots(CommandOp op, UINT startSlot, UINT count, T* const* objects, CommandObjectType type)
+	{
+		m_args.clear();
+		m_args.push_back(startSlot);
+		for (UINT i = 0; i < count; ++i)
+			m_args.push_back(GetObjectId(objects != nullptr ? objects[i] : nullptr, type));
+		m_writer.Write(op, m_args.data(), uint32_t(m_args.size()));
+	}
+
+	void CommandCapture::Unrecorded(const char* method)
+	{
+		m_writer.Write(CommandUnrecorded, nullptr, 0, method, uint32_t(strlen(method)));
+		++m_unrecorded;
+	}
+
+	void CommandCapture::VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		WriteSlots(CommandSetVertexConstantBuffers, StartSlot, NumBuffers, ppConstantBuffers, CommandObjectBuffer);
+		m_context->VSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		WriteSlots(CommandSetPixelConstantBuffers, StartSlot, NumBuffers, ppConstantBuffers, CommandObjectBuffer);
+		m_context->PSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::VSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		WriteSlots(CommandSetVertexShaderResources, StartSlot, NumViews, ppShaderResourceViews, CommandObjectShaderResourceView);
+		m_context->VSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		WriteSlots(CommandSetPixelShaderResources, StartSlot, NumViews, ppShaderResourceViews, CommandObjectShaderResourceView);
+		m_context->PSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::VSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		WriteSlots(CommandSetVertexSamplers, StartSlot, NumSamplers, ppSamplers, CommandObjectSamplerState);
+		m_context->VSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		WriteSlots(CommandSetPixelSamplers, StartSlot, NumSamplers, ppSamplers, CommandObjectSamplerState);
+		m_context->PSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	// Class instances aren't used by the engine and aren't recorded
+	void CommandCapture::VSSetShader(ID3D11VertexShader* pVertexShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		const uint32_t args[] = { GetObjectId(pVertexShader, CommandObjectVertexShader) };
+		m_writer.Write(CommandSetVertexShader, args, 1);
+		m_context->VSSetShader(pVertexShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::PSSetShader(ID3D11PixelShader* pPixelShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		const uint32_t args[] = { GetObjectId(pPixelShader, CommandObjectPixelShader) };
+		m_writer.Write(CommandSetPixelShader, args, 1);
+		m_context->PSSetShader(pPixelShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation)
+	{
+		const uint32_t args[] = { IndexCount, StartIndexLocation, uint32_t(BaseVertexLocation) };
+		m_writer.Write(CommandDrawIndexed, args, 3);
+		m_context->DrawIndexed(IndexCount, StartIndexLocation, BaseVertexLocation);
+	}
+
+	void CommandCapture::Draw(UINT VertexCount, UINT StartVertexLocation)
+	{
+		const uint32_t args[] = { VertexCount, StartVertexLocation };
+		m_writer.Write(CommandDraw, args, 2);
+		m_context->Draw(VertexCount, StartVertexLocation);
+	}
+
+	void CommandCapture::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation,
+		UINT StartInstanceLocation)
+	{
+		const uint32_t args[] = { IndexCountPerInstance, InstanceCount, StartIndexLocation, uint32_t(BaseVertexLocation), StartInstanceLocation };
+		m_writer.Write(CommandDrawIndexedInstanced, args, 5);
+		m_context->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+	}
+
+	void CommandCapture::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+	{
+		const uint32_t args[] = { VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation };
+		m_writer.Write(CommandDrawInstanced, args, 4);
+		m_context->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+	}
+
+	// The written bytes are only known at Unmap, so the command goes in then. A NO_OVERWRITE map records the whole
+	// buffer, not just the part written, as there's no telling which part that was.
+	HRESULT CommandCapture::Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags,
+		D3D11_MAPPED_SUBRESOURCE* pMappedResource)
+	{
+		const HRESULT hr = m_context->Map(pResource, Subresource, MapType, MapFlags, pMappedResource);
+		if (SUCCEEDED(hr) && pMappedResource != nullptr && MapType != D3D11_MAP_READ)
+		{
+			Mapping mapping;
+			mapping.resource = pResource;
+			mapping.subresource = Subresource;
+			mapping.type = MapType;
+			mapping.data = pMappedResource->pData;
+
+			D3D11_RESOURCE_DIMENSION dimension;
+			pResource->GetType(&dimension);
+			if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+			{
+				D3D11_BUFFER_DESC desc;
+				static_cast<ID3D11Buffer*>(pResource)->GetDesc(&desc);
+				mapping.size = desc.ByteWidth;
+			}
+			else
+			{
+				mapping.size = pMappedResource->DepthPitch;
+			}
+
+			m_mappings.push_back(mapping);
+		}
+		return hr;
+	}
+
+	void CommandCapture::Unmap(ID3D11Resource* pResource, UINT Subresource)
+	{
+		for (size_t i = 0; i < m_mappings.size(); ++i)
+		{
+			const Mapping& mapping = m_mappings[i];
+			if (mapping.resource == pResource && mapping.subresource == Subresource)
+			{
+				const uint32_t args[] = { GetResourceId(pResource), Subresource, uint32_t(mapping.type) };
+				m_writer.Write(CommandMapWrite, args, 3, mapping.data, mapping.size);
+				m_mappings.erase(m_mappings.begin() + i);
+				break;
+			}
+		}
+
+		m_context->Unmap(pResource, Subresource);
+	}
+
+	void CommandCapture::IASetInputLayout(ID3D11InputLayout* pInputLayout)
+	{
+		const uint32_t args[] = { GetObjectId(pInputLayout, CommandObjectInputLayout) };
+		m_writer.Write(CommandSetInputLayout, args, 1);
+		m_context->IASetInputLayout(pInputLayout);
+	}
+
+	void CommandCapture::IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides,
+		const UINT* pOffsets)
+	{
+		m_args.clear();
+		m_args.push_back(StartSlot);
+		for (UINT i = 0; i < NumBuffers; ++i)
+		{
+			m_args.push_back(GetObjectId(ppVertexBuffers != nullptr ? ppVertexBuffers[i] : nullptr, CommandObjectBuffer));
+			m_args.push_back(pStrides != nullptr ? pStrides[i] : 0);
+			m_args.push_back(pOffsets != nullptr ? pOffsets[i] : 0);
+		}
+		m_writer.Write(CommandSetVertexBuffers, m_args.data(), uint32_t(m_args.size()));
+
+		m_context->IASetVertexBuffers(StartSlot, NumBuffers, ppVertexBuffers, pStrides, pOffsets);
+	}
+
+	void CommandCapture::IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset)
+	{
+		const uint32_t args[] = { GetObjectId(pIndexBuffer, CommandObjectBuffer), uint32_t(Format), Offset };
+		m_writer.Write(CommandSetIndexBuffer, args, 3);
+		m_context->IASetIndexBuffer(pIndexBuffer, Format, Offset);
+	}
+
+	void CommandCapture::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology)
+	{
+		const uint32_t args[] = { uint32_t(Topology) };
+		m_writer.Write(CommandSetPrimitiveTopology, args, 1);
+		m_context->IASetPrimitiveTopology(Topology);
+	}
+
+	void CommandCapture::OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews,
+		ID3D11DepthStencilView* pDepthStencilView)
+	{
+		m_args.clear();
+		m_args.push_back(GetObjectId(pDepthStencilView, CommandObjectDepthStencilView));
+		for (UINT i = 0; i < NumViews; ++i)
+			m_args.push_back(GetObjectId(ppRenderTargetViews != nullptr ? ppRenderTargetViews[i] : nullptr, CommandObjectRenderTargetView));
+		m_writer.Write(CommandSetRenderTargets, m_args.data(), uint32_t(m_args.size()));
+
+		m_context->OMSetRenderTargets(NumViews, ppRenderTargetViews, pDepthStencilView);
+	}
+
+	void CommandCapture::OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask)
+	{
+		// A null factor means all ones
+		const uint32_t args[] = { GetObjectId(pBlendState, CommandObjectBlendState),
+			FloatBits(BlendFactor != nullptr ? BlendFactor[0] : 1.0f), FloatBits(BlendFactor != nullptr ? BlendFactor[1] : 1.0f),
+			FloatBits(BlendFactor != nullptr ? BlendFactor[2] : 1.0f), FloatBits(BlendFactor != nullptr ? BlendFactor[3] : 1.0f), SampleMask };
+		m_writer.Write(CommandSetBlendState, args, 6);
+		m_context->OMSetBlendState(pBlendState, BlendFactor, SampleMask);
+	}
+
+	void CommandCapture::OMSetDepthStencilState(ID3D11DepthStencilState* pDepthStencilState, UINT StencilRef)
+	{
+		const uint32_t args[] = { GetObjectId(pDepthStencilState, CommandObjectDepthStencilState), StencilRef };
+		m_writer.Write(CommandSetDepthStencilState, args, 2);
+		m_context->OMSetDepthStencilState(pDepthStencilState, StencilRef);
+	}
+
+	void CommandCapture::RSSetState(ID3D11RasterizerState* pRasterizerState)
+	{
+		const uint32_t args[] = { GetObjectId(pRasterizerState, CommandObjectRasterizerState) };
+		m_writer.Write(CommandSetRasterizerState, args, 1);
+		m_context->RSSetState(pRasterizerState);
+	}
+
+	void CommandCapture::RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports)
+	{
+		m_args.clear();
+		for (UINT i = 0; i < NumViewports; ++i)
+		{
+			const D3D11_VIEWPORT& viewport = pViewports[i];
+			m_args.push_back(FloatBits(viewport.TopLeftX));
+			m_args.push_back(FloatBits(viewport.TopLeftY));
+			m_args.push_back(FloatBits(viewport.Width));
+			m_args.push_back(FloatBits(viewport.Height));
+			m_args.push_back(FloatBits(viewport.MinDepth));
+			m_args.push_back(FloatBits(viewport.MaxDepth));
+		}
+		m_writer.Write(CommandSetViewports, m_args.data(), uint32_t(m_args.size()));
+
+		m_context->RSSetViewports(NumViewports, pViewports);
+	}
+
+	// Whole buffer updates are recorded, anything partial or to a texture is only noted
+	void CommandCapture::UpdateSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox, const void* pSrcData,
+		UINT SrcRowPitch, UINT SrcDepthPitch)
+	{
+		D3D11_RESOURCE_DIMENSION dimension;
+		pDstResource->GetType(&dimension);
+		if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER && pDstBox == nullptr)
+		{
+			D3D11_BUFFER_DESC desc;
+			static_cast<ID3D11Buffer*>(pDstResource)->GetDesc(&desc);
+
+			const uint32_t args[] = { GetResourceId(pDstResource), DstSubresource };
+			m_writer.Write(CommandUpdateSubresource, args, 2, pSrcData, desc.ByteWidth);
+		}
+		else
+		{
+			Unrecorded("UpdateSubresource");
+		}
+
+		m_context->UpdateSubresource(pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch, SrcDepthPitch);
+	}
+
+	void CommandCapture::ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4])
+	{
+		const uint32_t args[] = { GetObjectId(pRenderTargetView, CommandObjectRenderTargetView),
+			FloatBits(ColorRGBA[0]), FloatBits(ColorRGBA[1]), FloatBits(ColorRGBA[2]), FloatBits(ColorRGBA[3]) };
+		m_writer.Write(CommandClearRenderTargetView, args, 5);
+		m_context->ClearRenderTargetView(pRenderTargetView, ColorRGBA);
+	}
+
+	void CommandCapture::ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil)
+	{
+		const uint32_t args[] = { GetObjectId(pDepthStencilView, CommandObjectDepthStencilView), ClearFlags, FloatBits(Depth), Stencil };
+		m_writer.Write(CommandClearDepthStencilView, args, 4);
+		m_context->ClearDepthStencilView(pDepthStencilView, ClearFlags, Depth, Stencil);
+	}
+
+	void CommandCapture::GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		Unrecorded("GSSetConstantBuffers");
+		m_context->GSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::GSSetShader(ID3D11GeometryShader* pShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		Unrecorded("GSSetShader");
+		m_context->GSSetShader(pShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::Begin(ID3D11Asynchronous* pAsync)
+	{
+		Unrecorded("Begin");
+		m_context->Begin(pAsync);
+	}
+
+	void CommandCapture::End(ID3D11Asynchronous* pAsync)
+	{
+		Unrecorded("End");
+		m_context->End(pAsync);
+	}
+
+	HRESULT CommandCapture::GetData(ID3D11Asynchronous* pAsync, void* pData, UINT DataSize, UINT GetDataFlags)
+	{
+		return m_context->GetData(pAsync, pData, DataSize, GetDataFlags);
+	}
+
+	void CommandCapture::SetPredication(ID3D11Predicate* pPredicate, BOOL PredicateValue)
+	{
+		Unrecorded("SetPredication");
+		m_context->SetPredication(pPredicate, PredicateValue);
+	}
+
+	void CommandCapture::GSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		Unrecorded("GSSetShaderResources");
+		m_context->GSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::GSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		Unrecorded("GSSetSamplers");
+		m_context->GSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::OMSetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView, UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts)
+	{
+		Unrecorded("OMSetRenderTargetsAndUnorderedAccessViews");
+		m_context->OMSetRenderTargetsAndUnorderedAccessViews(NumRTVs, ppRenderTargetViews, pDepthStencilView, UAVStartSlot, NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+	}
+
+	void CommandCapture::SOSetTargets(UINT NumBuffers, ID3D11Buffer* const* ppSOTargets, const UINT* pOffsets)
+	{
+		Unrecorded("SOSetTargets");
+		m_context->SOSetTargets(NumBuffers, ppSOTargets, pOffsets);
+	}
+
+	void CommandCapture::DrawAuto()
+	{
+		Unrecorded("DrawAuto");
+		m_context->DrawAuto();
+	}
+
+	void CommandCapture::DrawIndexedInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+	{
+		Unrecorded("DrawIndexedInstancedIndirect");
+		m_context->DrawIndexedInstancedIndirect(pBufferForArgs, AlignedByteOffsetForArgs);
+	}
+
+	void CommandCapture::DrawInstancedIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+	{
+		Unrecorded("DrawInstancedIndirect");
+		m_context->DrawInstancedIndirect(pBufferForArgs, AlignedByteOffsetForArgs);
+	}
+
+	void CommandCapture::Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ)
+	{
+		Unrecorded("Dispatch");
+		m_context->Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
+	}
+
+	void CommandCapture::DispatchIndirect(ID3D11Buffer* pBufferForArgs, UINT AlignedByteOffsetForArgs)
+	{
+		Unrecorded("DispatchIndirect");
+		m_context->DispatchIndirect(pBufferForArgs, AlignedByteOffsetForArgs);
+	}
+
+	void CommandCapture::RSSetScissorRects(UINT NumRects, const D3D11_RECT* pRects)
+	{
+		Unrecorded("RSSetScissorRects");
+		m_context->RSSetScissorRects(NumRects, pRects);
+	}
+
+	void CommandCapture::CopySubresourceRegion(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ, ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox)
+	{
+		Unrecorded("CopySubresourceRegion");
+		m_context->CopySubresourceRegion(pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource, SrcSubresource, pSrcBox);
+	}
+
+	void CommandCapture::CopyResource(ID3D11Resource* pDstResource, ID3D11Resource* pSrcResource)
+	{
+		Unrecorded("CopyResource");
+		m_context->CopyResource(pDstResource, pSrcResource);
+	}
+
+	void CommandCapture::CopyStructureCount(ID3D11Buffer* pDstBuffer, UINT DstAlignedByteOffset, ID3D11UnorderedAccessView* pSrcView)
+	{
+		Unrecorded("CopyStructureCount");
+		m_context->CopyStructureCount(pDstBuffer, DstAlignedByteOffset, pSrcView);
+	}
+
+	void CommandCapture::ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* pUnorderedAccessView, const UINT Values[4])
+	{
+		Unrecorded("ClearUnorderedAccessViewUint");
+		m_context->ClearUnorderedAccessViewUint(pUnorderedAccessView, Values);
+	}
+
+	void CommandCapture::ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView* pUnorderedAccessView, const FLOAT Values[4])
+	{
+		Unrecorded("ClearUnorderedAccessViewFloat");
+		m_context->ClearUnorderedAccessViewFloat(pUnorderedAccessView, Values);
+	}
+
+	void CommandCapture::GenerateMips(ID3D11ShaderResourceView* pShaderResourceView)
+	{
+		Unrecorded("GenerateMips");
+		m_context->GenerateMips(pShaderResourceView);
+	}
+
+	void CommandCapture::SetResourceMinLOD(ID3D11Resource* pResource, FLOAT MinLOD)
+	{
+		Unrecorded("SetResourceMinLOD");
+		m_context->SetResourceMinLOD(pResource, MinLOD);
+	}
+
+	FLOAT CommandCapture::GetResourceMinLOD(ID3D11Resource* pResource)
+	{
+		return m_context->GetResourceMinLOD(pResource);
+	}
+
+	void CommandCapture::ResolveSubresource(ID3D11Resource* pDstResource, UINT DstSubresource, ID3D11Resource* pSrcResource, UINT SrcSubresource, DXGI_FORMAT Format)
+	{
+		Unrecorded("ResolveSubresource");
+		m_context->ResolveSubresource(pDstResource, DstSubresource, pSrcResource, SrcSubresource, Format);
+	}
+
+	void CommandCapture::ExecuteCommandList(ID3D11CommandList* pCommandList, BOOL RestoreContextState)
+	{
+		Unrecorded("ExecuteCommandList");
+		m_context->ExecuteCommandList(pCommandList, RestoreContextState);
+	}
+
+	void CommandCapture::HSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		Unrecorded("HSSetShaderResources");
+		m_context->HSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::HSSetShader(ID3D11HullShader* pHullShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		Unrecorded("HSSetShader");
+		m_context->HSSetShader(pHullShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::HSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		Unrecorded("HSSetSamplers");
+		m_context->HSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::HSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		Unrecorded("HSSetConstantBuffers");
+		m_context->HSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::DSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		Unrecorded("DSSetShaderResources");
+		m_context->DSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::DSSetShader(ID3D11DomainShader* pDomainShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		Unrecorded("DSSetShader");
+		m_context->DSSetShader(pDomainShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::DSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		Unrecorded("DSSetSamplers");
+		m_context->DSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::DSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		Unrecorded("DSSetConstantBuffers");
+		m_context->DSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::CSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+	{
+		Unrecorded("CSSetShaderResources");
+		m_context->CSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::CSSetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView* const* ppUnorderedAccessViews, const UINT* pUAVInitialCounts)
+	{
+		Unrecorded("CSSetUnorderedAccessViews");
+		m_context->CSSetUnorderedAccessViews(StartSlot, NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+	}
+
+	void CommandCapture::CSSetShader(ID3D11ComputeShader* pComputeShader, ID3D11ClassInstance* const* ppClassInstances, UINT NumClassInstances)
+	{
+		Unrecorded("CSSetShader");
+		m_context->CSSetShader(pComputeShader, ppClassInstances, NumClassInstances);
+	}
+
+	void CommandCapture::CSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+	{
+		Unrecorded("CSSetSamplers");
+		m_context->CSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::CSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+	{
+		Unrecorded("CSSetConstantBuffers");
+		m_context->CSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::VSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->VSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::PSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->PSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::PSGetShader(ID3D11PixelShader** ppPixelShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->PSGetShader(ppPixelShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::PSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->PSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::VSGetShader(ID3D11VertexShader** ppVertexShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->VSGetShader(ppVertexShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::PSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->PSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::IAGetInputLayout(ID3D11InputLayout** ppInputLayout)
+	{
+		m_context->IAGetInputLayout(ppInputLayout);
+	}
+
+	void CommandCapture::IAGetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppVertexBuffers, UINT* pStrides, UINT* pOffsets)
+	{
+		m_context->IAGetVertexBuffers(StartSlot, NumBuffers, ppVertexBuffers, pStrides, pOffsets);
+	}
+
+	void CommandCapture::IAGetIndexBuffer(ID3D11Buffer** pIndexBuffer, DXGI_FORMAT* Format, UINT* Offset)
+	{
+		m_context->IAGetIndexBuffer(pIndexBuffer, Format, Offset);
+	}
+
+	void CommandCapture::GSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->GSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::GSGetShader(ID3D11GeometryShader** ppGeometryShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->GSGetShader(ppGeometryShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY* pTopology)
+	{
+		m_context->IAGetPrimitiveTopology(pTopology);
+	}
+
+	void CommandCapture::VSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->VSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::VSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->VSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::GetPredication(ID3D11Predicate** ppPredicate, BOOL* pPredicateValue)
+	{
+		m_context->GetPredication(ppPredicate, pPredicateValue);
+	}
+
+	void CommandCapture::GSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->GSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::GSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->GSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::OMGetRenderTargets(UINT NumViews, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView)
+	{
+		m_context->OMGetRenderTargets(NumViews, ppRenderTargetViews, ppDepthStencilView);
+	}
+
+	void CommandCapture::OMGetRenderTargetsAndUnorderedAccessViews(UINT NumRTVs, ID3D11RenderTargetView** ppRenderTargetViews, ID3D11DepthStencilView** ppDepthStencilView, UINT UAVStartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews)
+	{
+		m_context->OMGetRenderTargetsAndUnorderedAccessViews(NumRTVs, ppRenderTargetViews, ppDepthStencilView, UAVStartSlot, NumUAVs, ppUnorderedAccessViews);
+	}
+
+	void CommandCapture::OMGetBlendState(ID3D11BlendState** ppBlendState, FLOAT BlendFactor[4], UINT* pSampleMask)
+	{
+		m_context->OMGetBlendState(ppBlendState, BlendFactor, pSampleMask);
+	}
+
+	void CommandCapture::OMGetDepthStencilState(ID3D11DepthStencilState** ppDepthStencilState, UINT* pStencilRef)
+	{
+		m_context->OMGetDepthStencilState(ppDepthStencilState, pStencilRef);
+	}
+
+	void CommandCapture::SOGetTargets(UINT NumBuffers, ID3D11Buffer** ppSOTargets)
+	{
+		m_context->SOGetTargets(NumBuffers, ppSOTargets);
+	}
+
+	void CommandCapture::RSGetState(ID3D11RasterizerState** ppRasterizerState)
+	{
+		m_context->RSGetState(ppRasterizerState);
+	}
+
+	void CommandCapture::RSGetViewports(UINT* pNumViewports, D3D11_VIEWPORT* pViewports)
+	{
+		m_context->RSGetViewports(pNumViewports, pViewports);
+	}
+
+	void CommandCapture::RSGetScissorRects(UINT* pNumRects, D3D11_RECT* pRects)
+	{
+		m_context->RSGetScissorRects(pNumRects, pRects);
+	}
+
+	void CommandCapture::HSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->HSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::HSGetShader(ID3D11HullShader** ppHullShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->HSGetShader(ppHullShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::HSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->HSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::HSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->HSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::DSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->DSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::DSGetShader(ID3D11DomainShader** ppDomainShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->DSGetShader(ppDomainShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::DSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->DSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::DSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->DSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::CSGetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView** ppShaderResourceViews)
+	{
+		m_context->CSGetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+	}
+
+	void CommandCapture::CSGetUnorderedAccessViews(UINT StartSlot, UINT NumUAVs, ID3D11UnorderedAccessView** ppUnorderedAccessViews)
+	{
+		m_context->CSGetUnorderedAccessViews(StartSlot, NumUAVs, ppUnorderedAccessViews);
+	}
+
+	void CommandCapture::CSGetShader(ID3D11ComputeShader** ppComputeShader, ID3D11ClassInstance** ppClassInstances, UINT* pNumClassInstances)
+	{
+		m_context->CSGetShader(ppComputeShader, ppClassInstances, pNumClassInstances);
+	}
+
+	void CommandCapture::CSGetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState** ppSamplers)
+	{
+		m_context->CSGetSamplers(StartSlot, NumSamplers, ppSamplers);
+	}
+
+	void CommandCapture::CSGetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers)
+	{
+		m_context->CSGetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+	}
+
+	void CommandCapture::ClearState()
+	{
+		Unrecorded("ClearState");
+		m_context->ClearState();
+	}
+
+	void CommandCapture::Flush()
+	{
+		m_context->Flush();
+	}
+
+	D3D11_DEVICE_CONTEXT_TYPE CommandCapture::GetType()
+	{
+		return m_context->GetType();
+	}
+
+	UINT CommandCapture::GetContextFlags()
+	{
+		return m_context->GetContextFlags();
+	}
+
+	HRESULT CommandCapture::FinishCommandList(BOOL RestoreDeferredContextState, ID3D11CommandList** ppCommandList)
+	{
+		Unrecorded("FinishCommandList");
+		return m_context->FinishCommandList(RestoreDeferredContextState, ppCommandList);
+	}
+
+	void CommandCapture::CopySubresourceRegion1(ID3D11Resource* pDstResource, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ, ID3D11Resource* pSrcResource, UINT SrcSubresource, const D3D11_BOX* pSrcBox, UINT CopyFlags)
+	{
+		Unrecorded("CopySubresourceRegion1");
+		m_context->CopySubresourceRegion1(pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource, SrcSubresource, pSrcBox, CopyFlags);
+	}
+
+	void CommandCapture::UpdateSubresource1(ID3D11Resource* pDstResource, UINT DstSubresource, const D3D11_BOX* pDstBox, const void* pSrcData, UINT SrcRowPitch, UINT SrcDepthPitch, UINT CopyFlags)
+	{
+		Unrecorded("UpdateSubresource1");
+		m_context->UpdateSubresource1(pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch, SrcDepthPitch, CopyFlags);
+	}
+
+	void CommandCapture::DiscardResource(ID3D11Resource* pResource)
+	{
+		m_context->DiscardResource(pResource);
+	}
+
+	void CommandCapture::DiscardView(ID3D11View* pResourceView)
+	{
+		m_context->DiscardView(pResourceView);
+	}
+
+	void CommandCapture::VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("VSSetConstantBuffers1");
+		m_context->VSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::HSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("HSSetConstantBuffers1");
+		m_context->HSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::DSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("DSSetConstantBuffers1");
+		m_context->DSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::GSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("GSSetConstantBuffers1");
+		m_context->GSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("PSSetConstantBuffers1");
+		m_context->PSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::CSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		Unrecorded("CSSetConstantBuffers1");
+		m_context->CSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::VSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->VSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::HSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->HSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::DSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->DSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::GSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->GSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::PSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->PSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::CSGetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer** ppConstantBuffers, UINT* pFirstConstant, UINT* pNumConstants)
+	{
+		m_context->CSGetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+	}
+
+	void CommandCapture::SwapDeviceContextState(ID3DDeviceContextState* pState, ID3DDeviceContextState** ppPreviousState)
+	{
+		Unrecorded("SwapDeviceContextState");
+		m_context->SwapDeviceContextState(pState, ppPreviousState);
+	}
+
+	void CommandCapture::ClearView(ID3D11View* pView, const FLOAT Color[4], const D3D11_RECT* pRect, UINT NumRects)
+	{
+		Unrecorded("ClearView");
+		m_context->ClearView(pView, Color, pRect, NumRects);
+	}
+
+	void CommandCapture::DiscardView1(ID3D11View* pResourceView, const D3D11_RECT* pRects, UINT NumRects)
+	{
+		m_context->DiscardView1(pResourceView, pRects, NumRects);
+	}
+
+	void CommandCapture::GetDevice(ID3D11Device** ppDevice)
+	{
+		m_context->GetDevice(ppDevice);
+	}
+
+	HRESULT CommandCapture::GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData)
+	{
+		return m_context->GetPrivateData(guid, pDataSize, pData);
+	}
+
+	HRESULT CommandCapture::SetPrivateData(REFGUID guid, UINT DataSize, const void* pData)
+	{
+		return m_context->SetPrivateData(guid, DataSize, pData);
+	}
+
+	HRESULT CommandCapture::SetPrivateDataInterface(REFGUID guid, const IUnknown* pData)
+	{
+		return m_context->SetPrivateDataInterface(guid, pData);
+	}
+
+} // namespace DX
@@ -0,0 +1,127 @@
+#include "red_engine.h"
+#include "command_stream.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace DX
+{
+
+	CommandWriter::CommandWriter() :
+		m_commandCount(0),
+		m_objectCount(0)
+	{
+	}
+
+	void CommandWriter::Reset()
+	{
+		m_stream.clear();
+		m_commandCount = 0;
+		m_objectCount = 0;
+	}
+
+	void CommandWriter::Write(CommandOp op, const uint32_t* args, uint32_t argCount, const void* data, uint32_t dataSize)
+	{
+		ASSERT(argCount <= 0xffff, "Too many arguments to a command.\n");
+
+		const size_t offset = m_stream.size();
+		m_stream.resize(offset + CommandReader::GetCommandSize(argCount, dataSize), 0);
+
+		CommandHeader header;
+		header.op = uint16_t(op);
+		header.argCount = uint16_t(argCount);
+		header.dataSize = dataSize;
+
+		uint8_t* cursor = &m_stream[offset];
+		memcpy(cursor, &header, sizeof(header));
+		cursor += sizeof(header);
+		if (argCount > 0)
+			memcpy(cursor, args, argCount * sizeof(uint32_t));
+		cursor += argCount * sizeof(uint32_t);
+		if (dataSize > 0)
+			memcpy(cursor, data, dataSize);
+
+		++m_commandCount;
+		if (op == CommandDeclareObject)
+			++m_objectCount;
+	}
+
+	bool CommandWriter::Save(const char* path) const
+	{
+		FILE* const file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write command stream %s.\n", path);
+			return false;
+		}
+
+		CommandStreamHeader header = {};
+		header.magic = CommandStreamMagic;
+		header.version = CommandStreamVersion;
+		header.commandCount = m_commandCount;
+		header.objectCount = m_objectCount;
+		header.streamSize = m_stream.size();
+
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		if (!m_stream.empty())
+			ok = ok && fwrite(m_stream.data(), 1, m_stream.size(), file) == m_stream.size();
+		fclose(file);
+
+		if (!ok)
+			DEBUG_MESSAGE("Failed writing command stream %s.\n", path);
+		return ok;
+	}
+
+	CommandReader::CommandReader() :
+		m_header()
+	{
+	}
+
+	bool CommandReader::Load(const char* path)
+	{
+		m_stream.clear();
+
+		FILE* const file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to open command stream %s.\n", path);
+			return false;
+		}
+
+		bool ok = fread(&m_header, sizeof(m_header), 1, file) == 1 && m_header.magic == CommandStreamMagic &&
+			m_header.version == CommandStreamVersion;
+		if (ok)
+		{
+			m_stream.resize(size_t(m_header.streamSize));
+			ok = m_stream.empty() || fread(m_stream.data(), 1, m_stream.size(), file) == m_stream.size();
+		}
+		fclose(file);
+
+		// Every command has to fit, and there have to be as many as the header says
+		uint32_t commands = 0;
+		size_t offset = 0;
+		while (ok && offset < m_stream.size())
+		{
+			if (offset + sizeof(CommandHeader) > m_stream.size())
+			{
+				ok = false;
+				break;
+			}
+
+			CommandHeader header;
+			memcpy(&header, &m_stream[offset], sizeof(header));
+			ok = header.op < CommandOpCount;
+			offset += GetCommandSize(header.argCount, header.dataSize);
+			++commands;
+		}
+		ok = ok && offset == m_stream.size() && commands == m_header.commandCount;
+
+		if (!ok)
+		{
+			DEBUG_MESSAGE("Command stream %s is damaged or from another version.\n", path);
+			m_stream.clear();
+		}
+		return ok;
+	}
+
+} // namespace DX
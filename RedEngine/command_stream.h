@@ -0,0 +1,88 @@
+#pragma once
+
+#include "command_stream_format.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace DX
+{
+
+	// Builds a command stream in memory and saves it. Knows nothing of D3D, so tools can write streams too.
+	class CommandWriter
+	{
+	public:
+		CommandWriter();
+
+		void							Reset();
+
+		void							Write(CommandOp op, const uint32_t* args, uint32_t argCount, const void* data = nullptr,
+											uint32_t dataSize = 0);
+
+		uint32_t						GetCommandCount() const
+		{
+			return m_commandCount;
+		}
+
+		size_t							GetSize() const
+		{
+			return m_stream.size();
+		}
+
+		bool							Save(const char* path) const;
+
+	private:
+		std::vector<uint8_t>			m_stream;
+		uint32_t						m_commandCount;
+		uint32_t						m_objectCount;
+	};
+
+	// Loads a saved stream and walks it. Load checks every command fits in the stream, so Next doesn't have to.
+	class CommandReader
+	{
+	public:
+		struct Command
+		{
+			CommandOp					op;
+			uint32_t					argCount;
+			const uint32_t*				args;
+			uint32_t					dataSize;
+			const uint8_t*				data;
+		};
+
+		CommandReader();
+
+		bool							Load(const char* path);
+
+		const CommandStreamHeader&		GetHeader() const
+		{
+			return m_header;
+		}
+
+		// Start with offset 0, false at the end of the stream
+		bool							Next(size_t& offset, Command& command) const
+		{
+			if (offset >= m_stream.size())
+				return false;
+
+			const CommandHeader* const header = reinterpret_cast<const CommandHeader*>(&m_stream[offset]);
+			command.op = CommandOp(header->op);
+			command.argCount = header->argCount;
+			command.args = reinterpret_cast<const uint32_t*>(header + 1);
+			command.dataSize = header->dataSize;
+			command.data = reinterpret_cast<const uint8_t*>(command.args + command.argCount);
+			offset += GetCommandSize(header->argCount, header->dataSize);
+			return true;
+		}
+
+		static size_t					GetCommandSize(uint32_t argCount, uint32_t dataSize)
+		{
+			return sizeof(CommandHeader) + argCount * sizeof(uint32_t) + ((size_t(dataSize) + 3) & ~size_t(3));
+		}
+
+	private:
+		CommandStreamHeader				m_header;
+		std::vector<uint8_t>			m_stream; // 4-byte aligned, as the arguments are read in place
+	};
+
+} // namespace DX
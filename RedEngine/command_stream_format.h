@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary layout of a captured frame of device context commands, written by DX::CommandCapture and read back by
+// tools/command_replay. After the header the stream is a run of commands, each a CommandHeader, argCount uint32
+// arguments and dataSize bytes of payload padded to 4. Objects (buffers, views, shaders, states) are referred to by
+// ids given out in the order they were first used, each introduced by a DeclareObject before anything refers to it;
+// 0 is null. Floats are stored as their bits.
+namespace DX
+{
+
+	static const uint32_t CommandStreamMagic = 0x444D4352; // 'RCMD'
+	static const uint32_t CommandStreamVersion = 1;
+
+	enum CommandOp : uint16_t
+	{
+		// id, CommandObjectType; buffers add ByteWidth, Usage, BindFlags, CPUAccessFlags, MiscFlags, StructureByteStride
+		CommandDeclareObject,
+
+		CommandClearRenderTargetView, // view, r, g, b, a
+		CommandClearDepthStencilView, // view, flags, depth, stencil
+		CommandSetRenderTargets, // depth view, then a render target view each
+		CommandSetViewports, // x, y, width, height, min depth, max depth each
+		CommandSetRasterizerState, // state
+		CommandSetBlendState, // state, factor r, g, b, a (all 1 for null), sample mask
+		CommandSetDepthStencilState, // state, stencil ref
+		CommandSetInputLayout, // layout
+		CommandSetVertexBuffers, // start slot, then buffer, stride, offset each
+		CommandSetIndexBuffer, // buffer, DXGI_FORMAT, offset
+		CommandSetPrimitiveTopology, // D3D11_PRIMITIVE_TOPOLOGY
+		CommandSetVertexShader, // shader
+		CommandSetPixelShader, // shader
+		CommandSetVertexConstantBuffers, // start slot, then a buffer each
+		CommandSetPixelConstantBuffers, // start slot, then a buffer each
+		CommandSetVertexShaderResources, // start slot, then a view each
+		CommandSetPixelShaderResources, // start slot, then a view each
+		CommandSetVertexSamplers, // start slot, then a sampler each
+		CommandSetPixelSamplers, // start slot, then a sampler each
+		CommandMapWrite, // resource, subresource, D3D11_MAP; payload is everything written before the Unmap
+		CommandUpdateSubresource, // resource, subresource; payload is the new contents, whole subresource updates only
+		CommandDraw, // vertex count, start vertex
+		CommandDrawIndexed, // index count, start index, base vertex
+		CommandDrawInstanced, // vertex count, instance count, start vertex, start instance
+		CommandDrawIndexedInstanced, // index count, instance count, start index, base vertex, start instance
+		CommandUnrecorded, // A context call the capture passed through without recording; the method's name is the payload
+
+		CommandOpCount,
+	};
+
+	enum CommandObjectType : uint32_t
+	{
+		CommandObjectBuffer,
+		CommandObjectTexture,
+		CommandObjectShaderResourceView,
+		CommandObjectRenderTargetView,
+		CommandObjectDepthStencilView,
+		CommandObjectInputLayout,
+		CommandObjectVertexShader,
+		CommandObjectPixelShader,
+		CommandObjectSamplerState,
+		CommandObjectBlendState,
+		CommandObjectDepthStencilState,
+		CommandObjectRasterizerState,
+		CommandObjectOther,
+	};
+
+	struct CommandStreamHeader
+	{
+		uint32_t		magic;
+		uint32_t		version;
+		uint32_t		commandCount;
+		uint32_t		objectCount;
+		uint64_t		streamSize; // Bytes of commands after the header
+		uint64_t		reserved;
+	};
+	static_assert(sizeof(CommandStreamHeader) == 32, "CommandStreamHeader layout changed");
+
+	struct CommandHeader
+	{
+		uint16_t		op; // CommandOp
+		uint16_t		argCount;
+		uint32_t		dataSize; // Unpadded
+	};
+	static_assert(sizeof(CommandHeader) == 8, "CommandHeader layout changed");
+
+} // namespace DX
@@ -0,0 +1,195 @@
+#include "compression.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace compression
+{
+
+	namespace
+	{
+		const size_t c_MinMatch = 4;
+		const size_t c_LastLiterals = 5; // The format requires the block to end in at least 5 literals
+		const size_t c_MatchFindLimit = 12; // No match may start within 12 bytes of the end
+		const size_t c_MaxOffset = 65535;
+		const unsigned int c_HashBits = 12;
+
+		inline uint32_t Read32(const uint8_t* p)
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+
+		inline uint32_t HashSequence(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - c_HashBits);
+		}
+
+		// Writes a length continuation: runs of 255 followed by the remainder
+		inline uint8_t* WriteLength(uint8_t* out, size_t length)
+		{
+			while (length >= 255)
+			{
+				*out++ = 255;
+				length -= 255;
+			}
+			*out++ = uint8_t(length);
+			return out;
+		}
+
+		inline uint8_t* WriteSequence(uint8_t* out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+		{
+			uint8_t* const token = out++;
+			*token = uint8_t((literalLength >= 15 ? 15 : literalLength) << 4);
+			if (literalLength >= 15)
+				out = WriteLength(out, literalLength - 15);
+
+			memcpy(out, literals, literalLength);
+			out += literalLength;
+
+			if (matchLength == 0)
+				return out; // Final, literal only sequence
+
+			*out++ = uint8_t(offset & 0xFF);
+			*out++ = uint8_t(offset >> 8);
+
+			const size_t length = matchLength - c_MinMatch;
+			*token |= uint8_t(length >= 15 ? 15 : length);
+			if (length >= 15)
+				out = WriteLength(out, length - 15);
+
+			return out;
+		}
+	}
+
+	size_t Lz4CompressBound(size_t sourceSize)
+	{
+		return sourceSize + sourceSize / 255 + 16;
+	}
+
+	size_t Lz4Compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity)
+	{
+		if (destinationCapacity < Lz4CompressBound(sourceSize))
+			return 0;
+
+		const uint8_t* const input = static_cast<const uint8_t*>(source);
+		const uint8_t* const inputEnd = input + sourceSize;
+		uint8_t* out = static_cast<uint8_t*>(destination);
+
+		const uint8_t* anchor = input;
+
+		if (sourceSize > c_MatchFindLimit)
+		{
+			uint32_t table[1u << c_HashBits] = {};
+			const uint8_t* const matchLimit = inputEnd - c_MatchFindLimit;
+			const uint8_t* ip = input;
+
+			while (ip < matchLimit)
+			{
+				const uint32_t sequence = Read32(ip);
+				const uint32_t hash = HashSequence(sequence);
+				const uint8_t* const candidate = input + table[hash];
+				table[hash] = uint32_t(ip - input);
+
+				if (candidate >= ip || size_t(ip - candidate) > c_MaxOffset || Read32(candidate) != sequence)
+				{
+					++ip;
+					continue;
+				}
+
+				// Extend the match as far as the tail rule allows
+				const uint8_t* const extendLimit = inputEnd - c_LastLiterals;
+				size_t matchLength = c_MinMatch;
+				while (ip + matchLength < extendLimit && candidate[matchLength] == ip[matchLength])
+					++matchLength;
+
+				out = WriteSequence(out, anchor, size_t(ip - anchor), size_t(ip - candidate), matchLength);
+
+				ip += matchLength;
+				anchor = ip;
+			}
+		}
+
+		out = WriteSequence(out, anchor, size_t(inputEnd - anchor), 0, 0);
+		return size_t(out - static_cast<uint8_t*>(destination));
+	}
+
+	bool Lz4Decompress(const void* source, size_t sourceSize, void* destination, size_t destinationSize)
+	{
+		const uint8_t* ip = static_cast<const uint8_t*>(source);
+		const uint8_t* const inputEnd = ip + sourceSize;
+		uint8_t* const output = static_cast<uint8_t*>(destination);
+		uint8_t* op = output;
+		uint8_t* const outputEnd = output + destinationSize;
+
+		while (ip < inputEnd)
+		{
+			const uint8_t token = *ip++;
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15)
+			{
+				uint8_t extra;
+				do
+				{
+					if (ip >= inputEnd)
+						return false;
+					extra = *ip++;
+					literalLength += extra;
+				} while (extra == 255);
+			}
+
+			if (size_t(inputEnd - ip) < literalLength || size_t(outputEnd - op) < literalLength)
+				return false;
+
+			memcpy(op, ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+
+			if (ip == inputEnd)
+				break; // The last sequence has no match
+
+			if (inputEnd - ip < 2)
+				return false;
+
+			const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+			ip += 2;
+			if (offset == 0 || offset > size_t(op - output))
+				return false;
+
+			size_t matchLength = (token & 15);
+			if (matchLength == 15)
+			{
+				uint8_t extra;
+				do
+				{
+					if (ip >= inputEnd)
+						return false;
+					extra = *ip++;
+					matchLength += extra;
+				} while (extra == 255);
+			}
+			matchLength += c_MinMatch;
+
+			if (size_t(outputEnd - op) < matchLength)
+				return false;
+
+			// Matches may overlap the bytes they produce, so copy forwards a byte at a time when they do
+			const uint8_t* match = op - offset;
+			if (offset >= matchLength)
+			{
+				memcpy(op, match, matchLength);
+				op += matchLength;
+			}
+			else
+			{
+				for (size_t i = 0; i < matchLength; ++i)
+					*op++ = *match++;
+			}
+		}
+
+		return op == outputEnd;
+	}
+
+} // namespace compression
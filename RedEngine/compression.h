@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// LZ4 block format compression. Shared with the offline tools, so it must not pull in any engine headers.
+namespace compression
+{
+
+	// Worst case size of compressing sourceSize bytes
+	size_t			Lz4CompressBound(size_t sourceSize);
+
+	// Returns the compressed size, or 0 if destination is too small
+	size_t			Lz4Compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity);
+
+	// Returns false if the stream is corrupt or doesn't decode to exactly destinationSize bytes
+	bool			Lz4Decompress(const void* source, size_t sourceSize, void* destination, size_t destinationSize);
+
+} // namespace compression
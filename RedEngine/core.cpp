@@ -3,24 +3,68 @@
 #include "scene.h"
 #include "view.h"
 #include "input.h"
+#include "asset_pack.h"
+#include "asset_streamer.h"
+#include "replay.h"
+#include "command_capture.h"
+#include "init_graph.h"
+#include "buffer_manager.h"
+#include "resource_registry.h"
+
+#include <chrono>
 
 using namespace DirectX;
 
+static const char* const AssetPackPath = "assets.rpak";
+static const uint64_t StreamingBudget = 512ull * 1024 * 1024;
+static const double StreamingUploadTime = 0.002; // Render thread time spent creating streamed resources each frame
+static const char* const PerfCountersCsvPath = "perf_counters.csv";
+static const char* const PerfCountersJsonPath = "perf_counters.json";
+static const char* const TelemetryName = "red_engine_telemetry";
+static const char* const StartupTracePath = "startup_trace.json";
+static const double DefaultTargetFrameTime = 1.0 / 60.0; // Until the main loop says what it is aiming for
+static const uint32_t MaxSceneLights = 4096; // What the GPU light buffer holds, and so what the clusters bin
+static const uint32_t MaxSceneParticles = 256 * 1024; // Simulated and drawn
+
+static double Seconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Taken during static initialisation, as near to process start as we can get portably
+static const double ProcessStart = Seconds();
+
 Core* Core::g_core = nullptr;
 
-Core::Core() noexcept(false) :
+Core::Core(bool headless) noexcept(false) :
 	m_deviceResources(nullptr),
 	m_view(nullptr),
 	m_scene(nullptr),
-	m_input(nullptr)
+	m_input(nullptr),
+	m_assetPack(nullptr),
+	m_assetStreamer(nullptr),
+	m_resolutionScaler(utils::ResolutionScaler::GetDefaultSettings(DefaultTargetFrameTime)),
+	m_debugText(nullptr),
+	m_lightClusters(MaxSceneLights),
+	m_particles(MaxSceneParticles),
+	m_fixedTimeStep(0.0),
+	m_recording(nullptr),
+	m_framePhases(),
+	m_commandCapture(nullptr),
+	m_capturePath(nullptr),
+	m_initialiseEnd(0.0),
+	m_firstFrameShown(false),
+	m_deviceLostTime(0.0)
 {
 	// DirectX Tool Kit supports all feature levels
 	m_deviceResources = new DX::DeviceResources(
 		DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D24_UNORM_S8_UINT, 2,
-		D3D_FEATURE_LEVEL_9_1);
+		D3D_FEATURE_LEVEL_9_1, headless ? DX::DeviceResources::c_Headless : 0);
 	m_deviceResources->RegisterDeviceNotify(this);
 
 	m_view = new DX::View(m_deviceResources);
+	m_debugText = new DX::DebugText();
+	m_commandCapture = new DX::CommandCapture();
 
 	ASSERT(g_core == nullptr, "A core object alread exists.\n");
 	g_core = this;
@@ -28,30 +72,75 @@ Core::Core() noexcept(false) :
 
 Core::~Core()
 {
+	delete m_commandCapture;
+	delete m_debugText;
 	delete m_view;
 	delete m_deviceResources;
 
 	g_core = nullptr;
 }
 
-// Perform any one-time initialisation
+// Perform any one-time initialisation, as much of it at once as the dependencies allow
 void Core::Initialise(HWND window, int width, int height)
 {
-	m_deviceResources->SetWindow(window, width, height);
+	const double initialiseStart = Seconds();
+	m_startupTrace.Add("before_initialise", ProcessStart, initialiseStart);
+
+	utils::InitGraph graph;
+
+	// The immediate context and the swap chain belong to this thread
+	const unsigned int device = graph.AddStep("device", [this, window, width, height]()
+	{
+		m_deviceResources->SetWindow(window, width, height);
+		m_deviceResources->CreateDeviceResources();
+
+		// Before anything creates GPU resources
+		DX::ResourceRegistry::Create();
+		DX::ResourceRegistry::Get()->SetDevice(m_deviceResources->GetD3DDevice(), uint32_t(width), uint32_t(height));
+		DX::BufferManager::Create(m_deviceResources->GetD3DDevice());
+	}, {}, utils::InitGraph::c_MainThread);
+
+	const unsigned int windowSize = graph.AddStep("window_size", [this]()
+	{
+		m_deviceResources->CreateWindowSizeDependentResources();
+		CreateWindowSizeDependentResources();
+	}, { device }, utils::InitGraph::c_MainThread);
 
-	m_deviceResources->CreateDeviceResources();
-	CreateDeviceDependentResources();
+	const unsigned int view = graph.AddStep("view", [this]() { m_view->Initialise(); }, { windowSize }, utils::InitGraph::c_MainThread);
 
-	m_deviceResources->CreateWindowSizeDependentResources();
-	CreateWindowSizeDependentResources();
+	// Shader and buffer creation only goes through the device, which is free threaded
+	graph.AddStep("shaders", [this]() { CreateDeviceDependentResources(); }, { device });
 
-	m_view->Initialise();
+	// Running without a monitor to talk to is fine
+	graph.AddStep("telemetry", [this]() { m_telemetry.Open(TelemetryName); });
 
-	m_scene = new scene::Scene();
-	m_scene->Initialise();
+	const unsigned int assetPack = graph.AddStep("asset_pack", [this]()
+	{
+		m_assetPack = new assets::AssetPack();
+		if (m_assetPack->Mount(AssetPackPath))
+			m_assetStreamer = new assets::AssetStreamer(*m_assetPack, StreamingBudget, 2);
+		else
+			DEBUG_MESSAGE("Running without %s.\n", AssetPackPath);
+	});
 
-	m_input = new Input();
-	m_input->Initialise();
+	// Loads straight out of the pack, and waits for the view so nothing else is using the context
+	graph.AddStep("scene", [this]()
+	{
+		m_scene = new scene::Scene();
+		m_scene->Initialise();
+	}, { assetPack, view });
+
+	graph.AddStep("input", [this]()
+	{
+		m_input = new Input();
+		m_input->Initialise();
+	});
+
+	graph.Run(&m_startupTrace);
+
+	m_initialiseEnd = Seconds();
+	DEBUG_MESSAGE("Initialised in %.1f ms, %.1f ms of work.\n", (m_initialiseEnd - initialiseStart) * 1000.0,
+		graph.GetSerialTime() * 1000.0);
 }
 
 // Clear up and perform any closing actions
@@ -64,41 +153,291 @@ void Core::Shutdown()
 	m_scene = nullptr;
 	m_input->Shutdown();
 	delete m_input;
+
+	delete m_assetStreamer;
+	m_assetStreamer = nullptr;
+
+	// Everything using the pools has gone by now
+	DX::BufferManager::Get()->LogReport();
+	DX::BufferManager::Destroy();
+
+	m_resolutionScaler.LogReport();
+
+	// Last, everything above registered its GPU resources
+	m_upscaler.Release();
+	m_gpuTimer.Release();
+	m_clusteredLighting.Release();
+	m_spriteBatch.Release();
+	m_particleRenderer.Release();
+	m_debugText->Release();
+	DX::ResourceRegistry::Destroy();
+
+	m_assetPack->Unmount();
+	delete m_assetPack;
+	m_assetPack = nullptr;
+
+	// For the perf dashboards
+	m_perfCounters.WriteCsv(PerfCountersCsvPath);
+	m_perfCounters.WriteJson(PerfCountersJsonPath);
+
+	m_telemetry.Close();
 }
 
 // Each frame update
 void Core::Update()
 {
+	const double updateStart = Seconds();
+
+	// Close off the counts from the frame just gone
+	m_perfCounters.EndFrame();
+	m_telemetry.Publish(m_perfCounters);
+
+	if (m_recording != nullptr)
+		m_recording->BeginFrame(GetTimeStep());
+
+	DispatchInput();
+
 	// Update the scene
 	if (m_scene != nullptr)
 		m_scene->Update();
 
+	// After the scene, which moves the emitters
+	m_particles.Update(float(GetTimeStep()));
+	m_broadphase.Update();
+	m_sceneQuery.Build(m_broadphase);
+
 	if (m_input != nullptr)
 		m_input->Update();
+
+	m_framePhases.seconds[utils::FramePhases::Update] = Seconds() - updateStart;
+}
+
+double Core::GetTimeStep() const
+{
+	return m_fixedTimeStep > 0.0 ? m_fixedTimeStep : utils::Timers::GetFrameTime();
 }
 
 // Render the world
 void Core::Render()
 {
-	Clear();
+	const double renderStart = Seconds();
+	double cullTime = 0.0;
 
-	if (m_view != nullptr)
-		m_view->Refresh();
+	// Before a capture takes over the context, so the queries go to the immediate one
+	m_gpuTimer.Begin(m_deviceResources->GetD3DDeviceContext());
 
-	// Draw the scene
-	if (m_scene != nullptr)
-		m_scene->Render();
+	// Everything asking DeviceResources for the context this frame gets the capture instead
+	if (m_capturePath != nullptr)
+	{
+		m_commandCapture->StartCapture(m_deviceResources->GetD3DDeviceContext());
+		m_deviceResources->SetContextOverride(m_commandCapture);
+	}
+
+	// Finish any streamed loads, nearest the camera first
+	if (m_assetStreamer != nullptr)
+	{
+		const XMFLOAT3 cameraPosition = m_view->GetCameraPosition();
+		m_assetStreamer->SetCameraPosition(&cameraPosition.x);
+		m_assetStreamer->PumpUploads(StreamingUploadTime);
+	}
+
+	// The passes are declared afresh each frame; their targets come out of the graph's pool
+	m_frameGraph.Reset();
+
+	DX::FrameGraph::Views backBufferViews = {};
+	backBufferViews.renderTarget = m_deviceResources->GetRenderTargetView();
+	const DX::FrameGraph::Handle backBuffer = m_frameGraph.Import("back_buffer", backBufferViews);
+
+	DX::FrameGraph::Views depthViews = {};
+	depthViews.depthStencil = m_deviceResources->GetDepthStencilView();
+	const DX::FrameGraph::Handle depth = m_frameGraph.Import("depth", depthViews);
+
+	// The scene goes straight to the back buffer at full scale, otherwise into targets of the scaled size
+	const D3D11_VIEWPORT screenViewport = m_deviceResources->GetScreenViewport();
+	uint32_t renderWidth, renderHeight;
+	m_resolutionScaler.GetRenderSize(uint32_t(screenViewport.Width), uint32_t(screenViewport.Height), renderWidth, renderHeight);
+	const bool scaled = renderWidth != uint32_t(screenViewport.Width) || renderHeight != uint32_t(screenViewport.Height);
+
+	DX::FrameGraph::Handle sceneColor = backBuffer;
+	DX::FrameGraph::Handle sceneDepth = depth;
+	D3D11_VIEWPORT sceneViewport = screenViewport;
+	if (scaled)
+	{
+		sceneViewport.Width = float(renderWidth);
+		sceneViewport.Height = float(renderHeight);
+	}
+
+	m_frameGraph.AddPass("scene", [&, scaled](DX::FrameGraph::Builder& builder)
+	{
+		if (scaled)
+		{
+			const DX::FrameGraph::TextureDesc colorDesc = { renderWidth, renderHeight, DXGI_FORMAT_B8G8R8A8_UNORM,
+				D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE, 4 };
+			const DX::FrameGraph::TextureDesc depthDesc = { renderWidth, renderHeight, DXGI_FORMAT_D24_UNORM_S8_UINT, D3D11_BIND_DEPTH_STENCIL, 4 };
+			sceneColor = builder.Create("scene_color", colorDesc);
+			sceneDepth = builder.Create("scene_depth", depthDesc);
+		}
+		else
+		{
+			builder.Write(backBuffer);
+			builder.Write(depth);
+		}
+	}, [this, &cullTime, &sceneColor, &sceneDepth, sceneViewport](const DX::FrameGraph& graph)
+	{
+		Clear(graph.GetViews(sceneColor).renderTarget, graph.GetViews(sceneDepth).depthStencil, sceneViewport);
+
+		if (m_view != nullptr)
+			m_view->Refresh();
+
+		if (m_scene != nullptr)
+		{
+			const double cullStart = Seconds();
+			m_lodSelector.BeginFrame(*m_view, sceneViewport.Height);
+
+			XMFLOAT4X4 viewProjection;
+			XMStoreFloat4x4(&viewProjection, XMLoadFloat4x4(&m_view->GetViewMatrix()) * XMLoadFloat4x4(&m_view->GetProjectionMatrix()));
+			m_occlusionCuller.BeginFrame(&viewProjection.m[0][0]);
+
+			// Binning counts as culling, the upload as recording
+			if (m_clusteredLighting.IsCreated())
+			{
+				m_lightClusters.BeginFrame(&m_view->GetViewMatrix().m[0][0], &m_view->GetProjectionMatrix().m[0][0]);
+				m_lightClusters.Build();
+			}
+			cullTime = Seconds() - cullStart;
+
+			if (m_clusteredLighting.IsCreated())
+			{
+				ID3D11DeviceContext* const deviceContext = m_deviceResources->GetD3DDeviceContext();
+				m_clusteredLighting.Upload(deviceContext, m_lightClusters, sceneViewport);
+				m_clusteredLighting.Bind(deviceContext);
+			}
+
+			m_scene->Render();
+
+			// Over the scene's depth, with its view still bound
+			if (m_particleRenderer.IsCreated())
+				m_particleRenderer.Draw(m_deviceResources->GetD3DDeviceContext(), m_particles);
+		}
+	});
+
+	if (scaled)
+	{
+		m_frameGraph.AddPass("upscale", [=](DX::FrameGraph::Builder& builder)
+		{
+			builder.Read(sceneColor);
+			builder.Write(backBuffer);
+		}, [this, sceneColor, backBuffer, screenViewport](const DX::FrameGraph& graph)
+		{
+			m_upscaler.Draw(m_deviceResources->GetD3DDeviceContext(), graph.GetViews(sceneColor).shaderResource,
+				graph.GetViews(backBuffer).renderTarget, screenViewport);
+		});
+	}
+
+	// Sprites and UI at full resolution over the scene, whatever it was drawn at
+	m_frameGraph.AddPass("ui", [=](DX::FrameGraph::Builder& builder)
+	{
+		builder.Read(backBuffer);
+		builder.Write(backBuffer);
+	}, [this, backBuffer, screenViewport](const DX::FrameGraph& graph)
+	{
+		ID3D11DeviceContext* const deviceContext = m_deviceResources->GetD3DDeviceContext();
+		ID3D11RenderTargetView* const renderTarget = graph.GetViews(backBuffer).renderTarget;
+		deviceContext->OMSetRenderTargets(1, &renderTarget, nullptr);
+		deviceContext->RSSetViewports(1, &screenViewport);
+		m_spriteBatch.Flush(deviceContext, screenViewport.Width, screenViewport.Height);
+	});
+
+	// Stats go on top of everything else
+	m_frameGraph.AddPass("debug_hud", [=](DX::FrameGraph::Builder& builder)
+	{
+		builder.Read(backBuffer);
+		builder.Write(backBuffer);
+	}, [this](const DX::FrameGraph&) { DrawDebugHud(); });
+
+	m_frameGraph.Compile();
+	m_frameGraph.Run(m_deviceResources->GetD3DDevice());
+
+	if (m_commandCapture->IsCapturing())
+	{
+		m_deviceResources->SetContextOverride(nullptr);
+		m_commandCapture->FinishCapture(m_capturePath);
+		m_capturePath = nullptr;
+	}
+
+	const double submitStart = Seconds();
+	m_framePhases.seconds[utils::FramePhases::Cull] = cullTime;
+	m_framePhases.seconds[utils::FramePhases::Record] = submitStart - renderStart - cullTime;
+	m_gpuTimer.End(m_deviceResources->GetD3DDeviceContext());
 
 	// Show the new frame.
 	m_deviceResources->Present();
+	const double presentTime = Seconds() - submitStart;
+	m_inputLatency.OnPresented(input::Now());
+	DX::BufferManager::Get()->EndFrame();
+
+	if (!m_firstFrameShown)
+	{
+		const double shown = Seconds();
+		m_startupTrace.Add("first_frame", m_initialiseEnd, shown);
+		m_startupTrace.WriteJson(StartupTracePath, ProcessStart);
+		DEBUG_MESSAGE("First frame presented %.1f ms after start.\n", (shown - ProcessStart) * 1000.0);
+		m_frameGraph.LogReport();
+		m_firstFrameShown = true;
+	}
+
+	m_framePhases.seconds[utils::FramePhases::Submit] = Seconds() - submitStart;
+
+	// Present's wait is for vertical sync as often as for the GPU, so it is left out and the GPU timed on its own;
+	// the frame takes as long as the slower of the two
+	double cpuTime = -presentTime;
+	for (double seconds : m_framePhases.seconds)
+		cpuTime += seconds;
+	const double gpuTime = m_gpuTimer.GetSeconds();
+	m_resolutionScaler.SetRefreshInterval(m_deviceResources->GetRefreshInterval());
+	m_resolutionScaler.Update(cpuTime > gpuTime ? cpuTime : gpuTime);
+}
+
+void Core::DrawDebugHud()
+{
+	m_debugHud.EndFrame();
+	float y = m_debugHud.Print(*m_debugText, m_perfCounters);
+
+	const input::InputLatency::Stats latency = m_inputLatency.GetStats();
+	m_debugText->Print(8.0f, y, DX::DebugText::White, "input  p50 %5.2f ms  p99 %5.2f ms", latency.p50 * 1000.0, latency.p99 * 1000.0);
+	y += m_debugText->GetLineHeight();
+
+	const utils::FrameLimiter::Stats pacing = m_frameLimiter.GetStats();
+	m_debugText->Print(8.0f, y, pacing.missed > 0 ? DX::DebugText::Yellow : DX::DebugText::White, "pacing p99 %5.2f ms  missed %u",
+		pacing.p99Error * 1000.0, pacing.missed);
+	y += m_debugText->GetLineHeight();
+
+	const D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+	uint32_t sceneWidth, sceneHeight;
+	m_resolutionScaler.GetRenderSize(uint32_t(viewport.Width), uint32_t(viewport.Height), sceneWidth, sceneHeight);
+	m_debugText->Print(8.0f, y, m_resolutionScaler.GetScale() < 1.0f ? DX::DebugText::Yellow : DX::DebugText::White, "scale  %4.2f  %ux%u",
+		m_resolutionScaler.GetScale(), sceneWidth, sceneHeight);
+
+	m_debugText->Render(m_deviceResources->GetD3DDeviceContext(), viewport.Width, viewport.Height);
 }
 
-void Core::Clear()
+void Core::DispatchInput()
+{
+	input::InputEvent event;
+	while (m_inputEvents.Pop(event))
+	{
+		if (m_recording != nullptr)
+			m_recording->AddEvent(event);
+
+		m_inputLatency.OnConsumed(event);
+		Keyboard::ProcessMessage(event.type == input::InputEvent::KeyDown ? WM_KEYDOWN : WM_KEYUP, WPARAM(event.key), LPARAM(event.flags));
+	}
+}
+
+void Core::Clear(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil, const D3D11_VIEWPORT& viewport)
 {
 	// Clear the views
 	ID3D11DeviceContext1* const context = m_deviceResources->GetD3DDeviceContext();
-	ID3D11RenderTargetView* const renderTarget = m_deviceResources->GetRenderTargetView();
-	ID3D11DepthStencilView* const depthStencil = m_deviceResources->GetDepthStencilView();
 
 	context->ClearRenderTargetView(renderTarget, DirectX::Colors::CornflowerBlue);
 	context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
@@ -106,22 +445,79 @@ void Core::Clear()
 	context->OMSetRenderTargets(1, &renderTarget, depthStencil);
 
 	// Set the viewport.
-	auto viewport = m_deviceResources->GetScreenViewport();
 	context->RSSetViewports(1, &viewport);
 }
 
+void Core::OnWindowSizeChanged(int width, int height)
+{
+	// WM_SIZE arrives while the window is being created, before there is anything to resize
+	if (m_initialiseEnd == 0.0)
+		return;
+
+	if (m_deviceResources->WindowSizeChanged(width, height))
+		CreateWindowSizeDependentResources();
+}
+
+void Core::SimulateDeviceLost()
+{
+	DEBUG_MESSAGE("Throwing the device away.\n");
+	m_deviceResources->HandleDeviceLost();
+}
+
 void Core::OnDeviceLost()
 {
+	m_deviceLostTime = Seconds();
+
+	// The descriptions and CPU copies stay, only the objects go
+	m_frameGraph.ReleaseTextures();
+	m_gpuTimer.Release();
+	DX::BufferManager::Get()->OnDeviceLost();
+	DX::ResourceRegistry::Get()->ReleaseAll();
 }
 
 void Core::OnDeviceRestored()
 {
+	// DeviceResources has already remade the swap chain and its targets
+	const RECT size = m_deviceResources->GetOutputSize();
+	DX::ResourceRegistry::Get()->SetDevice(m_deviceResources->GetD3DDevice(), uint32_t(size.right - size.left), uint32_t(size.bottom - size.top));
+	DX::BufferManager::Get()->OnDeviceRestored(m_deviceResources->GetD3DDevice());
+	m_gpuTimer.Create(m_deviceResources->GetD3DDevice());
+
+	const DX::ResourceRegistry::RecreateStats stats = DX::ResourceRegistry::Get()->RecreateAll();
+	DEBUG_MESSAGE("Device recovered in %.1f ms, %u resources recreated in %.1f ms (%.1f ms of work).\n",
+		(Seconds() - m_deviceLostTime) * 1000.0, stats.resources, stats.wallSeconds * 1000.0, stats.serialSeconds * 1000.0);
 }
 
 void Core::CreateDeviceDependentResources()
 {
+	m_debugText->Create(m_deviceResources->GetD3DDevice());
+
+	// Without it the scene stays at full resolution
+	if (!m_upscaler.Create(m_deviceResources->GetD3DDevice()))
+		m_resolutionScaler.SetFixedScale(1.0f);
+
+	// Without it the scene is drawn unlit
+	m_clusteredLighting.Create(m_deviceResources->GetD3DDevice(), m_lightClusters.GetMaxLights(), uint32_t(m_lightClusters.GetClusters().size()),
+		m_lightClusters.GetMaxIndices());
+
+	// Without it the resolution scaler goes by CPU time alone
+	m_gpuTimer.Create(m_deviceResources->GetD3DDevice());
+
+	// Without it sprites are batched and dropped
+	m_spriteBatch.Create(m_deviceResources->GetD3DDevice());
+
+	// Without it particles are simulated but not drawn
+	m_particleRenderer.Create(m_deviceResources->GetD3DDevice(), MaxSceneParticles);
 }
 
 void Core::CreateWindowSizeDependentResources()
 {
+	// Everything the graph pooled was sized for the old window
+	m_frameGraph.ReleaseTextures();
+
+	const RECT size = m_deviceResources->GetOutputSize();
+	const DX::ResourceRegistry::RecreateStats stats = DX::ResourceRegistry::Get()->Resize(uint32_t(size.right - size.left),
+		uint32_t(size.bottom - size.top));
+	if (stats.resources > 0)
+		DEBUG_MESSAGE("Resized %u resources in %.1f ms.\n", stats.resources, stats.wallSeconds * 1000.0);
 }
\ No newline at end of file
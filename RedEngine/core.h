@@ -1,10 +1,31 @@
 #pragma once
 
 #include "device_resources.h"
+#include "lod.h"
+#include "occlusion_culler.h"
+#include "light_clusters.h"
+#include "clustered_lighting.h"
+#include "particle_system.h"
+#include "particle_renderer.h"
+#include "broadphase.h"
+#include "scene_query.h"
+#include "input_events.h"
+#include "frame_limiter.h"
+#include "debug_text.h"
+#include "perf_counters.h"
+#include "telemetry.h"
+#include "benchmark_report.h"
+#include "init_graph.h"
+#include "frame_graph.h"
+#include "resolution_scaler.h"
+#include "upscaler.h"
+#include "gpu_timer.h"
+#include "sprite_batch.h"
 
 namespace DX
 {
 	class View;
+	class CommandCapture;
 }
 
 namespace scene
@@ -12,12 +33,24 @@ namespace scene
 	class Scene;
 }
 
+namespace assets
+{
+	class AssetPack;
+	class AssetStreamer;
+}
+
+namespace utils
+{
+	class Replay;
+}
+
 class Input;
 
 class Core final : public DX::IDeviceNotify
 {
 public:
-	Core() noexcept(false);
+	// Headless runs on a WARP device with no window, for replays and benchmarks
+	explicit Core(bool headless = false) noexcept(false);
 	~Core();
 
 	static Core* Get()
@@ -39,6 +72,12 @@ public:
 	virtual void			OnDeviceLost() override;
 	virtual void			OnDeviceRestored() override;
 
+	// From WM_SIZE; recreates the swap chain targets and only the window sized registered resources
+	void					OnWindowSizeChanged(int width, int height);
+
+	// Goes through the whole device lost path on a healthy device, to time the recovery
+	void					SimulateDeviceLost();
+
 	scene::Scene* GetScene() const
 	{
 		return m_scene;
@@ -49,8 +88,128 @@ public:
 		return m_view;
 	}
 
+	const assets::AssetPack* GetAssetPack() const
+	{
+		return m_assetPack;
+	}
+
+	DX::LodSelector& GetLodSelector()
+	{
+		return m_lodSelector;
+	}
+
+	// Ready for occluders once Render has started the frame
+	scene::OcclusionCuller& GetOcclusionCuller()
+	{
+		return m_occlusionCuller;
+	}
+
+	// The scene hands over its lights with SetLights; each frame Render bins them into clusters for the lit shader
+	scene::LightClusters& GetLightClusters()
+	{
+		return m_lightClusters;
+	}
+
+	// Not created below feature level 10_0, in which case nothing is lit
+	const DX::ClusteredLighting& GetClusteredLighting() const
+	{
+		return m_clusteredLighting;
+	}
+
+	// Add emitters here; Update steps the particles each tick and the scene pass draws them
+	scene::ParticleSystem& GetParticles()
+	{
+		return m_particles;
+	}
+
+	// Bodies keep their boxes current here; Update finds the overlapping pairs each tick, after the scene has moved
+	scene::Broadphase& GetBroadphase()
+	{
+		return m_broadphase;
+	}
+
+	// Picking, line of sight and proximity against the broadphase's bodies as Update left them this tick
+	scene::SceneQuery& GetSceneQuery()
+	{
+		return m_sceneQuery;
+	}
+
+	// The OS event source pushes here, Update drains it at the start of each tick
+	input::InputEventQueue& GetInputEvents()
+	{
+		return m_inputEvents;
+	}
+
+	const input::InputLatency& GetInputLatency() const
+	{
+		return m_inputLatency;
+	}
+
+	utils::FrameLimiter& GetFrameLimiter()
+	{
+		return m_frameLimiter;
+	}
+
+	const utils::PerfCounters& GetPerfCounters() const
+	{
+		return m_perfCounters;
+	}
+
+	// Picks the scene's render resolution from the frame times; aim it with SetTargetFrameTime
+	utils::ResolutionScaler& GetResolutionScaler()
+	{
+		return m_resolutionScaler;
+	}
+
+	// Replays step time by a fixed amount rather than by the wall clock; 0 goes back to the frame timer
+	void SetFixedTimeStep(double seconds)
+	{
+		m_fixedTimeStep = seconds;
+	}
+
+	// Seconds this frame steps the simulation by
+	double					GetTimeStep() const;
+
+	// Every frame's time step and consumed input go to recording until it is set back to null
+	void SetRecording(utils::Replay* recording)
+	{
+		m_recording = recording;
+	}
+
+	// Writes every device context call of the next Render to path, which has to stay valid until then
+	void CaptureNextFrame(const char* path)
+	{
+		m_capturePath = path;
+	}
+
+	// Timings of the last Update and Render
+	const utils::FramePhases& GetFramePhases() const
+	{
+		return m_framePhases;
+	}
+
+	// Render thread only. Draw sprites with an atlas added once; they go on screen over the scene this frame
+	DX::SpriteBatch& GetSpriteBatch()
+	{
+		return m_spriteBatch;
+	}
+
+	// Print from any thread, it shows on the next frame
+	DX::DebugText* GetDebugText() const
+	{
+		return m_debugText;
+	}
+
+	// Null when there is no asset pack to stream from
+	assets::AssetStreamer* GetAssetStreamer() const
+	{
+		return m_assetStreamer;
+	}
+
 private:
-	void					Clear(); // Clear the screen
+	void					Clear(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil, const D3D11_VIEWPORT& viewport); // Clear and bind the scene's targets
+	void					DispatchInput(); // Hand queued events to the keyboard state
+	void					DrawDebugHud();
 
 	void					CreateDeviceDependentResources();
 	void					CreateWindowSizeDependentResources();
@@ -63,4 +222,42 @@ private:
 	scene::Scene* m_scene; // An object that contains all the game world entities
 
 	Input* m_input;
+	input::InputEventQueue m_inputEvents; // Filled by WndProc, timestamped as they arrive
+	input::InputLatency m_inputLatency; // Event arrival to the Present that showed its effect
+
+	utils::FrameLimiter m_frameLimiter; // Paces the main loop
+
+	DX::FrameGraph m_frameGraph; // This frame's passes and their transient targets
+	utils::ResolutionScaler m_resolutionScaler; // Scene render size, from how long frames are taking
+	DX::GpuTimer m_gpuTimer; // The GPU's part of each frame, for m_resolutionScaler
+	DX::Upscaler m_upscaler; // Scaled scene to the back buffer
+	DX::SpriteBatch m_spriteBatch; // Sprites and UI over the scene
+	DX::DebugText* m_debugText; // On-screen text, drawn last
+	DX::DebugHud m_debugHud; // Frame, draw and allocation stats
+	utils::PerfCounters m_perfCounters; // Every PerfCounter, per frame
+	utils::TelemetryPublisher m_telemetry; // The same again, live in shared memory for telemetry_monitor
+
+	DX::LodSelector m_lodSelector; // Per-object detail levels for this frame
+	scene::OcclusionCuller m_occlusionCuller; // Hides objects behind big ones before they are submitted
+	scene::LightClusters m_lightClusters; // Which lights reach each part of the view
+	DX::ClusteredLighting m_clusteredLighting; // The same on the GPU for the lit pixel shader
+	scene::ParticleSystem m_particles; // Effects, simulated on the job system
+	DX::ParticleRenderer m_particleRenderer; // The same as instanced quads
+	scene::Broadphase m_broadphase; // Collision pairs, found on the job system
+	scene::SceneQuery m_sceneQuery; // Rebuilt over m_broadphase each tick
+
+	assets::AssetPack* m_assetPack; // Memory-mapped game data
+	assets::AssetStreamer* m_assetStreamer; // Background loading out of m_assetPack
+
+	double m_fixedTimeStep; // Zero to follow the frame timer
+	utils::Replay* m_recording; // Not owned, null unless recording
+	utils::FramePhases m_framePhases;
+
+	DX::CommandCapture* m_commandCapture; // Stands in for the device context while capturing
+	const char* m_capturePath; // Not owned, null unless the next frame is to be captured
+
+	utils::StartupTrace m_startupTrace; // Initialise's steps through to the first Present
+	double m_initialiseEnd;
+	bool m_firstFrameShown;
+	double m_deviceLostTime; // When the last recovery started
 };
\ No newline at end of file
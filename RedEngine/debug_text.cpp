@@ -0,0 +1,421 @@
+#include "red_engine.h"
+#include "debug_text.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+
+// Compiled from the .hlsl files into $(IntDir) by the project
+#include "DebugTextVertexShader.h"
+#include "DebugTextPixelShader.h"
+
+namespace DX
+{
+
+	namespace
+	{
+		// The atlas holds printable ASCII in a 16 x 6 grid
+		const uint32_t c_FirstGlyph = 32;
+		const uint32_t c_GlyphCount = 95;
+		const uint32_t c_AtlasColumns = 16;
+		const uint32_t c_AtlasRows = (c_GlyphCount + c_AtlasColumns - 1) / c_AtlasColumns;
+
+		const int c_FontHeight = 16;
+		const wchar_t* const c_FontName = L"Consolas";
+
+		// Triangle strip corners of a glyph quad
+		const float c_Corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+		utils::PerfCounter s_draws("render.draws");
+		utils::PerfCounter s_constantBufferBytes("render.constant_buffer_bytes");
+
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+	}
+
+	DebugText::DebugText() :
+		m_buffers(new FrameBuffer[2]),
+		m_writeIndex(0),
+		m_cellWidth(0),
+		m_cellHeight(0),
+		m_atlasWidth(0),
+		m_atlasHeight(0),
+		m_atlas(nullptr),
+		m_atlasView(nullptr),
+		m_cornerBuffer(nullptr),
+		m_instanceBuffer(nullptr),
+		m_constantBuffer(nullptr),
+		m_inputLayout(nullptr),
+		m_vertexShader(nullptr),
+		m_pixelShader(nullptr),
+		m_sampler(nullptr),
+		m_blendState(nullptr),
+		m_depthState(nullptr),
+		m_rasterizerState(nullptr)
+	{
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			m_buffers[i].count = 0;
+			m_buffers[i].writers = 0;
+		}
+	}
+
+	DebugText::~DebugText()
+	{
+		Release();
+		delete[] m_buffers;
+	}
+
+	bool DebugText::Create(ID3D11Device* device)
+	{
+		ASSERT(m_atlas == nullptr, "Debug text has already been created.\n");
+
+		// Instancing needs 9_3 or better
+		if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+		{
+			DEBUG_MESSAGE("No debug text below feature level 9_3.\n");
+			return false;
+		}
+
+		if (!BakeAtlas())
+			return false;
+
+		// Everything goes through the registry, so it all comes back by itself after device loss
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		m_resources.push_back(registry->RegisterVertexShader(&m_vertexShader, g_DebugTextVertexShader, sizeof(g_DebugTextVertexShader)));
+		m_resources.push_back(registry->RegisterPixelShader(&m_pixelShader, g_DebugTextPixelShader, sizeof(g_DebugTextPixelShader)));
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "POSITION", 1, DXGI_FORMAT_R32G32_FLOAT, 1, offsetof(GlyphInstance, x), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, offsetof(GlyphInstance, u), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, offsetof(GlyphInstance, color), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		m_resources.push_back(registry->RegisterInputLayout(&m_inputLayout, layout, _countof(layout), g_DebugTextVertexShader,
+			sizeof(g_DebugTextVertexShader)));
+
+		CD3D11_BUFFER_DESC cornerDesc(sizeof(c_Corners), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		m_resources.push_back(registry->RegisterBuffer(&m_cornerBuffer, cornerDesc, c_Corners));
+
+		CD3D11_BUFFER_DESC instanceDesc(MaxGlyphs * sizeof(GlyphInstance), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_instanceBuffer, instanceDesc));
+
+		CD3D11_BUFFER_DESC constantDesc(sizeof(Constants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_constantBuffer, constantDesc));
+
+		CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
+		m_resources.push_back(registry->RegisterSamplerState(&m_sampler, samplerDesc));
+
+		CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		m_resources.push_back(registry->RegisterBlendState(&m_blendState, blendDesc));
+
+		CD3D11_DEPTH_STENCIL_DESC depthDesc(D3D11_DEFAULT);
+		depthDesc.DepthEnable = FALSE;
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		m_resources.push_back(registry->RegisterDepthStencilState(&m_depthState, depthDesc));
+
+		CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+		rasterizerDesc.CullMode = D3D11_CULL_NONE;
+		m_resources.push_back(registry->RegisterRasterizerState(&m_rasterizerState, rasterizerDesc));
+
+		for (ResourceRegistry::Handle handle : m_resources)
+		{
+			if (handle == ResourceRegistry::InvalidHandle)
+			{
+				Release();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Renders each glyph with GDI into a DIB, then keeps the coverage as alpha on white
+	bool DebugText::BakeAtlas()
+	{
+		HDC const dc = CreateCompatibleDC(nullptr);
+		HFONT const font = CreateFontW(-c_FontHeight, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS,
+			CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, FIXED_PITCH | FF_MODERN, c_FontName);
+		HGDIOBJ const oldFont = SelectObject(dc, font);
+
+		TEXTMETRICW metrics = {};
+		GetTextMetricsW(dc, &metrics);
+		m_cellWidth = uint32_t(metrics.tmAveCharWidth);
+		m_cellHeight = uint32_t(metrics.tmHeight);
+		m_atlasWidth = m_cellWidth * c_AtlasColumns;
+		m_atlasHeight = m_cellHeight * c_AtlasRows;
+
+		BITMAPINFO bitmapInfo = {};
+		bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		bitmapInfo.bmiHeader.biWidth = LONG(m_atlasWidth);
+		bitmapInfo.bmiHeader.biHeight = -LONG(m_atlasHeight); // Top down
+		bitmapInfo.bmiHeader.biPlanes = 1;
+		bitmapInfo.bmiHeader.biBitCount = 32;
+		bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+		uint32_t* pixels = nullptr;
+		HBITMAP const bitmap = CreateDIBSection(dc, &bitmapInfo, DIB_RGB_COLORS, reinterpret_cast<void**>(&pixels), nullptr, 0);
+		if (bitmap == nullptr)
+		{
+			SelectObject(dc, oldFont);
+			DeleteObject(font);
+			DeleteDC(dc);
+			DEBUG_MESSAGE("Unable to create the debug text atlas bitmap.\n");
+			return false;
+		}
+
+		HGDIOBJ const oldBitmap = SelectObject(dc, bitmap);
+		memset(pixels, 0, m_atlasWidth * m_atlasHeight * sizeof(uint32_t));
+		SetTextColor(dc, RGB(255, 255, 255));
+		SetBkMode(dc, TRANSPARENT);
+
+		for (uint32_t glyph = 0; glyph < c_GlyphCount; ++glyph)
+		{
+			const int x = int((glyph % c_AtlasColumns) * m_cellWidth);
+			const int y = int((glyph / c_AtlasColumns) * m_cellHeight);
+			const char character = char(c_FirstGlyph + glyph);
+			TextOutA(dc, x, y, &character, 1);
+		}
+		GdiFlush();
+
+		// GDI leaves alpha alone, so take coverage from green
+		std::vector<uint32_t> texels(m_atlasWidth * m_atlasHeight);
+		for (size_t i = 0; i < texels.size(); ++i)
+			texels[i] = ((pixels[i] >> 8) & 0xff) << 24 | 0x00ffffff;
+
+		SelectObject(dc, oldBitmap);
+		SelectObject(dc, oldFont);
+		DeleteObject(bitmap);
+		DeleteObject(font);
+		DeleteDC(dc);
+
+		// The registry keeps the texels, so device loss doesn't mean baking again
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		CD3D11_TEXTURE2D_DESC atlasDesc(DXGI_FORMAT_B8G8R8A8_UNORM, m_atlasWidth, m_atlasHeight, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+		const ResourceRegistry::Handle atlas = registry->RegisterTexture2D(&m_atlas, atlasDesc, texels.data(), m_atlasWidth * sizeof(uint32_t));
+		if (atlas == ResourceRegistry::InvalidHandle)
+			return false;
+		m_resources.push_back(atlas);
+
+		const ResourceRegistry::Handle atlasView = registry->RegisterShaderResourceView(&m_atlasView, atlas);
+		if (atlasView == ResourceRegistry::InvalidHandle)
+		{
+			Release();
+			return false;
+		}
+		m_resources.push_back(atlasView);
+
+		return true;
+	}
+
+	void DebugText::Release()
+	{
+		// Newest first, so the atlas view goes before the atlas
+		while (!m_resources.empty())
+		{
+			ResourceRegistry::Get()->Unregister(m_resources.back());
+			m_resources.pop_back();
+		}
+	}
+
+	void DebugText::Print(float x, float y, uint32_t color, const char* format, ...)
+	{
+		char text[512];
+		va_list args;
+		va_start(args, format);
+		const int length = vsnprintf(text, sizeof(text), format, args);
+		va_end(args);
+
+		if (length <= 0)
+			return;
+
+		const uint32_t textLength = std::min(uint32_t(length), uint32_t(sizeof(text) - 1));
+		uint32_t glyphCount = 0;
+		for (uint32_t i = 0; i < textLength; ++i)
+			glyphCount += text[i] != '\n' && text[i] != ' ';
+
+		// Join whichever buffer is filling. If Render retires it between our load and joining, leave and try again.
+		FrameBuffer* buffer;
+		for (;;)
+		{
+			const uint32_t index = m_writeIndex.load();
+			buffer = &m_buffers[index];
+			buffer->writers.fetch_add(1);
+			if (m_writeIndex.load() == index)
+				break;
+			buffer->writers.fetch_sub(1);
+		}
+
+		const uint32_t first = buffer->count.fetch_add(glyphCount, std::memory_order_relaxed);
+		const uint32_t available = first < MaxGlyphs ? std::min(glyphCount, MaxGlyphs - first) : 0;
+
+		const float atlasCellU = 1.0f / float(c_AtlasColumns);
+		const float atlasCellV = 1.0f / float(c_AtlasRows);
+
+		float penX = x;
+		float penY = y;
+		uint32_t written = 0;
+		for (uint32_t i = 0; i < textLength && written < available; ++i)
+		{
+			const uint8_t character = uint8_t(text[i]);
+			if (character == '\n')
+			{
+				penX = x;
+				penY += float(m_cellHeight);
+				continue;
+			}
+
+			if (character != ' ')
+			{
+				// Anything outside printable ASCII shows as '?'
+				const uint32_t glyph = (character >= c_FirstGlyph && character < c_FirstGlyph + c_GlyphCount) ? character - c_FirstGlyph : '?' - c_FirstGlyph;
+
+				GlyphInstance& instance = buffer->glyphs[first + written++];
+				instance.x = penX;
+				instance.y = penY;
+				instance.u = float(glyph % c_AtlasColumns) * atlasCellU;
+				instance.v = float(glyph / c_AtlasColumns) * atlasCellV;
+				instance.color = color;
+			}
+
+			penX += float(m_cellWidth);
+		}
+
+		buffer->writers.fetch_sub(1, std::memory_order_release);
+	}
+
+	void DebugText::Render(ID3D11DeviceContext* deviceContext, float screenWidth, float screenHeight)
+	{
+		// Point new text at the other buffer, then wait out anyone still writing into this one
+		const uint32_t index = m_writeIndex.load();
+		m_writeIndex.store(index ^ 1);
+
+		FrameBuffer& buffer = m_buffers[index];
+		while (buffer.writers.load() != 0)
+			std::this_thread::yield();
+
+		const uint32_t count = std::min(buffer.count.load(std::memory_order_acquire), uint32_t(MaxGlyphs));
+		buffer.count.store(0, std::memory_order_relaxed);
+
+		if (count == 0 || m_atlasView == nullptr)
+			return;
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = deviceContext->Map(m_instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+		ASSERT_HANDLE(hr);
+		memcpy(mapped.pData, buffer.glyphs, count * sizeof(GlyphInstance));
+		deviceContext->Unmap(m_instanceBuffer, 0);
+
+		Constants constants = {};
+		constants.screenScale[0] = 2.0f / screenWidth;
+		constants.screenScale[1] = 2.0f / screenHeight;
+		constants.screenScale[2] = float(m_cellWidth);
+		constants.screenScale[3] = float(m_cellHeight);
+		constants.atlasScale[0] = 1.0f / float(c_AtlasColumns);
+		constants.atlasScale[1] = 1.0f / float(c_AtlasRows);
+
+		hr = deviceContext->Map(m_constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+		ASSERT_HANDLE(hr);
+		memcpy(mapped.pData, &constants, sizeof(constants));
+		deviceContext->Unmap(m_constantBuffer, 0);
+		s_constantBufferBytes.Add(sizeof(constants));
+
+		ID3D11Buffer* const vertexBuffers[] = { m_cornerBuffer, m_instanceBuffer };
+		const UINT strides[] = { sizeof(c_Corners[0]), sizeof(GlyphInstance) };
+		const UINT offsets[] = { 0, 0 };
+		deviceContext->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		deviceContext->IASetInputLayout(m_inputLayout);
+		deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+		deviceContext->VSSetShader(m_vertexShader, nullptr, 0);
+		deviceContext->VSSetConstantBuffers(0, 1, &m_constantBuffer);
+		deviceContext->PSSetShader(m_pixelShader, nullptr, 0);
+		deviceContext->PSSetShaderResources(0, 1, &m_atlasView);
+		deviceContext->PSSetSamplers(0, 1, &m_sampler);
+
+		deviceContext->OMSetBlendState(m_blendState, nullptr, 0xffffffff);
+		deviceContext->OMSetDepthStencilState(m_depthState, 0);
+		deviceContext->RSSetState(m_rasterizerState);
+
+		deviceContext->DrawInstanced(4, count, 0, 0);
+		s_draws.Add();
+
+		// Leave the defaults behind for whoever draws next frame
+		deviceContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+		deviceContext->OMSetDepthStencilState(nullptr, 0);
+		deviceContext->RSSetState(nullptr);
+	}
+
+	DebugHud::DebugHud(uint32_t history) :
+		m_frameTimes(history > 0 ? history : 1, 0.0f),
+		m_next(0),
+		m_count(0),
+		m_lastFrame(0.0)
+	{
+	}
+
+	void DebugHud::EndFrame()
+	{
+		const double now = Seconds();
+		if (m_lastFrame != 0.0)
+		{
+			m_frameTimes[m_next] = float((now - m_lastFrame) * 1000.0);
+			m_next = (m_next + 1) % uint32_t(m_frameTimes.size());
+			m_count = std::min(m_count + 1, uint32_t(m_frameTimes.size()));
+		}
+		m_lastFrame = now;
+	}
+
+	float DebugHud::Print(DebugText& text, const utils::PerfCounters& counters) const
+	{
+		const float x = 8.0f;
+		float y = 8.0f;
+
+		if (m_count > 0)
+		{
+			// Sorting a few hundred floats once a frame is nothing next to the frame itself
+			float sorted[1024];
+			const uint32_t count = std::min(m_count, uint32_t(_countof(sorted)));
+			for (uint32_t i = 0; i < count; ++i)
+				sorted[i] = m_frameTimes[(m_next + m_frameTimes.size() - count + i) % m_frameTimes.size()];
+			std::sort(sorted, sorted + count);
+
+			const float p50 = sorted[count / 2];
+			const float p99 = sorted[std::min(count - 1, count * 99 / 100)];
+			const float max = sorted[count - 1];
+
+			text.Print(x, y, p99 > 1000.0f / 55.0f ? DebugText::Red : DebugText::White,
+				"frame  %5.2f ms (%3.0f fps)  p50 %5.2f  p99 %5.2f  max %5.2f", m_frameTimes[(m_next + m_frameTimes.size() - 1) % m_frameTimes.size()],
+				1000.0f / p50, p50, p99, max);
+			y += text.GetLineHeight();
+		}
+
+		text.Print(x, y, DebugText::White, "draws  %5lld  triangles %lld", static_cast<long long>(counters.GetValue("render.draws")),
+			static_cast<long long>(counters.GetValue("render.triangles")));
+		y += text.GetLineHeight();
+
+		const int64_t allocations = counters.GetValue("memory.allocations");
+		text.Print(x, y, allocations > 0 ? DebugText::Yellow : DebugText::White, "allocs %5lld  %.1f KB", static_cast<long long>(allocations),
+			double(counters.GetValue("memory.allocated_bytes")) / 1024.0);
+		y += text.GetLineHeight();
+
+		text.Print(x, y, DebugText::White, "jobs   %5lld  culled %lld", static_cast<long long>(counters.GetValue("jobs.submitted")),
+			static_cast<long long>(counters.GetValue("cull.occluded")));
+		y += text.GetLineHeight();
+
+		return y;
+	}
+
+} // namespace DX
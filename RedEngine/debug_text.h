@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+	class PerfCounters;
+}
+
+namespace DX
+{
+
+	// On-screen debug text. Print may be called from any thread at any time; everything printed since the last
+	// Render is drawn by the next one as a single instanced draw against a glyph atlas baked from a system font.
+	class DebugText
+	{
+	public:
+		// Packed R8G8B8A8
+		static const uint32_t			White = 0xffffffff;
+		static const uint32_t			Yellow = 0xff00ffff;
+		static const uint32_t			Red = 0xff4040ff;
+		static const uint32_t			Green = 0xff40ff40;
+
+		static const uint32_t			MaxGlyphs = 16384; // Per frame, anything past this is dropped
+
+		DebugText();
+		~DebugText();
+
+		bool							Create(ID3D11Device* device);
+		void							Release();
+
+		// x and y are in pixels from the top left of the screen. Newlines start a new line under x.
+		void							Print(float x, float y, uint32_t color, const char* format, ...);
+
+		// Draws everything printed so far and starts collecting the next frame
+		void							Render(ID3D11DeviceContext* deviceContext, float screenWidth, float screenHeight);
+
+		float							GetLineHeight() const
+		{
+			return float(m_cellHeight);
+		}
+
+		float							GetCharacterWidth() const
+		{
+			return float(m_cellWidth);
+		}
+
+	private:
+		struct GlyphInstance
+		{
+			float						x, y; // Pixels
+			float						u, v; // Top left of the glyph's atlas cell
+			uint32_t					color;
+		};
+
+		struct Constants
+		{
+			float						screenScale[4]; // 2 / screen size, then the cell size in pixels
+			float						atlasScale[4]; // Cell size in atlas texels, normalised
+		};
+
+		// Writers bump writers while they fill their reservation, so Render knows when a buffer it has
+		// retired is safe to read
+		struct FrameBuffer
+		{
+			GlyphInstance				glyphs[MaxGlyphs];
+			std::atomic<uint32_t>		count;
+			std::atomic<uint32_t>		writers;
+		};
+
+		bool							BakeAtlas();
+
+		FrameBuffer*					m_buffers; // Two, one filling while the other is drawn
+		std::atomic<uint32_t>			m_writeIndex;
+
+		uint32_t						m_cellWidth;
+		uint32_t						m_cellHeight;
+		uint32_t						m_atlasWidth;
+		uint32_t						m_atlasHeight;
+
+		ID3D11Texture2D*				m_atlas;
+		ID3D11ShaderResourceView*		m_atlasView;
+		ID3D11Buffer*					m_cornerBuffer;
+		ID3D11Buffer*					m_instanceBuffer;
+		ID3D11Buffer*					m_constantBuffer;
+		ID3D11InputLayout*				m_inputLayout;
+		ID3D11VertexShader*				m_vertexShader;
+		ID3D11PixelShader*				m_pixelShader;
+		ID3D11SamplerState*				m_sampler;
+		ID3D11BlendState*				m_blendState;
+		ID3D11DepthStencilState*		m_depthState;
+		ID3D11RasterizerState*			m_rasterizerState;
+		std::vector<uint32_t>			m_resources; // ResourceRegistry handles, in registration order
+	};
+
+	// Frame time percentiles and the last frame's draw, triangle and allocation counters, printed through DebugText
+	class DebugHud
+	{
+	public:
+		explicit DebugHud(uint32_t history = 240);
+
+		// Once per frame, times the frame since the last call
+		void							EndFrame();
+
+		// Prints the HUD at the top left, returning the y below it for anything else to follow
+		float							Print(DebugText& text, const utils::PerfCounters& counters) const;
+
+	private:
+		std::vector<float>				m_frameTimes; // Milliseconds, a ring of the last history frames
+		uint32_t						m_next;
+		uint32_t						m_count;
+		double							m_lastFrame;
+	};
+
+} // namespace DX
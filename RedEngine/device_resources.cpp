@@ -56,9 +56,11 @@ DeviceResources::DeviceResources(
     m_window(nullptr),
     m_d3dFeatureLevel(D3D_FEATURE_LEVEL_9_1),
     m_outputSize{ 0, 0, 1, 1 },
+    m_refreshInterval(0.0),
     m_colorSpace(DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709),
     m_options(flags | c_FlipPresent),
-    m_deviceNotify(nullptr)
+    m_deviceNotify(nullptr),
+    m_contextOverride(nullptr)
 {
 }
 
@@ -144,14 +146,31 @@ void DeviceResources::CreateDeviceResources()
     ASSERT(featLevelCount != 0, "minFeatureLevel too high.\n");
 
     ComPtr<IDXGIAdapter1> adapter;
-    GetHardwareAdapter(adapter.GetAddressOf());
+    if (!(m_options & c_Headless))
+        GetHardwareAdapter(adapter.GetAddressOf());
 
     // Create the Direct3D 11 API device object and a corresponding context.
     ComPtr<ID3D11Device> device;
     ComPtr<ID3D11DeviceContext> context;
 
     HRESULT hr = E_FAIL;
-    if (adapter)
+    if (m_options & c_Headless)
+    {
+        // Replays want the same device whatever machine they run on, and nothing to put on screen
+        hr = D3D11CreateDevice(
+            nullptr,
+            D3D_DRIVER_TYPE_WARP,
+            nullptr,
+            creationFlags,
+            s_featureLevels,
+            featLevelCount,
+            D3D11_SDK_VERSION,
+            device.GetAddressOf(),
+            &m_d3dFeatureLevel,
+            context.GetAddressOf()
+        );
+    }
+    else if (adapter)
     {
         hr = D3D11CreateDevice(
             adapter.Get(),
@@ -232,7 +251,7 @@ void DeviceResources::CreateWindowSizeDependentResources()
 {
     HRESULT hr = 0;
 
-    if (!m_window)
+    if (!m_window && !(m_options & c_Headless))
     {
         ASSERT(FALSE, "Call SetWindow with a valid Win32 window handle.\n");
         return;
@@ -252,7 +271,26 @@ void DeviceResources::CreateWindowSizeDependentResources()
     UINT backBufferHeight = std::max<UINT>(static_cast<UINT>(m_outputSize.bottom - m_outputSize.top), 1u);
     DXGI_FORMAT backBufferFormat = (m_options & (c_FlipPresent | c_AllowTearing | c_EnableHDR)) ? NoSRGB(m_backBufferFormat) : m_backBufferFormat;
 
-    if (m_swapChain)
+    if (m_options & c_Headless)
+    {
+        // An offscreen target the same shape as the back buffer would have been
+        CD3D11_TEXTURE2D_DESC renderTargetDesc(
+            backBufferFormat,
+            backBufferWidth,
+            backBufferHeight,
+            1,
+            1,
+            D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE
+        );
+
+        hr = m_d3dDevice->CreateTexture2D(
+            &renderTargetDesc,
+            nullptr,
+            m_renderTarget.ReleaseAndGetAddressOf()
+        );
+        ASSERT(SUCCEEDED(hr), "Can't create headless render target.\n");
+    }
+    else if (m_swapChain)
     {
         // If the swap chain already exists, resize it.
         hr = m_swapChain->ResizeBuffers(
@@ -313,12 +351,16 @@ void DeviceResources::CreateWindowSizeDependentResources()
         ASSERT(SUCCEEDED(hr), "Unable to make window assocciation.\n");
     }
 
-    // Handle color space settings for HDR
-    UpdateColorSpace();
+    if (m_swapChain)
+    {
+        // Handle color space settings for HDR
+        UpdateColorSpace();
+        UpdateRefreshInterval();
 
-    // Create a render target view of the swap chain back buffer.
-    hr = m_swapChain->GetBuffer(0, IID_PPV_ARGS(m_renderTarget.ReleaseAndGetAddressOf()));
-    ASSERT(SUCCEEDED(hr), "Can't get swap chain buffer.\n");
+        // Create a render target view of the swap chain back buffer.
+        hr = m_swapChain->GetBuffer(0, IID_PPV_ARGS(m_renderTarget.ReleaseAndGetAddressOf()));
+        ASSERT(SUCCEEDED(hr), "Can't get swap chain buffer.\n");
+    }
 
     CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(D3D11_RTV_DIMENSION_TEXTURE2D, m_backBufferFormat);
     hr = m_d3dDevice->CreateRenderTargetView(
@@ -386,7 +428,8 @@ bool DeviceResources::WindowSizeChanged(int width, int height)
     if (newRc == m_outputSize)
     {
         // Handle color space settings for HDR
-        UpdateColorSpace();
+        if (m_swapChain)
+            UpdateColorSpace();
 
         return false;
     }
@@ -437,6 +480,16 @@ void DeviceResources::HandleDeviceLost()
 // Present the contents of the swap chain to the screen.
 void DeviceResources::Present()
 {
+    if (m_options & c_Headless)
+    {
+        // Nothing to show, but the frame's commands still have to be handed to the driver
+        m_d3dContext->DiscardView(m_d3dRenderTargetView.Get());
+        if (m_d3dDepthStencilView)
+            m_d3dContext->DiscardView(m_d3dDepthStencilView.Get());
+        m_d3dContext->Flush();
+        return;
+    }
+
     HRESULT hr;
     if (m_options & c_AllowTearing)
     {
@@ -643,4 +696,24 @@ void DeviceResources::UpdateColorSpace()
             ASSERT(SUCCEEDED(hr), "Can't set color space.\n");
         }
     }
+}
+
+// Finds how often the output the window is on refreshes, which Present(1, 0) holds each frame to.
+void DeviceResources::UpdateRefreshInterval()
+{
+    m_refreshInterval = 0.0;
+    if (!m_swapChain || (m_options & c_AllowTearing))
+        return;
+
+    ComPtr<IDXGIOutput> output;
+    if (FAILED(m_swapChain->GetContainingOutput(output.GetAddressOf())))
+        return;
+
+    DXGI_OUTPUT_DESC desc;
+    DEVMODEW mode = {};
+    mode.dmSize = sizeof(mode);
+
+    // 0 and 1 stand for the hardware's default rate, which isn't known
+    if (SUCCEEDED(output->GetDesc(&desc)) && EnumDisplaySettingsW(desc.DeviceName, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1)
+        m_refreshInterval = 1.0 / double(mode.dmDisplayFrequency);
 }
\ No newline at end of file
@@ -19,6 +19,7 @@ namespace DX
         static const unsigned int c_FlipPresent = 0x1;
         static const unsigned int c_AllowTearing = 0x2;
         static const unsigned int c_EnableHDR = 0x4;
+        static const unsigned int c_Headless = 0x8; // WARP device and an offscreen target, no window or swap chain
 
         DeviceResources(DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM,
             DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT,
@@ -28,7 +29,7 @@ namespace DX
 
         void CreateDeviceResources();
         void CreateWindowSizeDependentResources();
-        void SetWindow(HWND window, int width, int height);
+        void SetWindow(HWND window, int width, int height); // window may be null when headless
         bool WindowSizeChanged(int width, int height);
         void HandleDeviceLost();
         void RegisterDeviceNotify(IDeviceNotify* deviceNotify) { m_deviceNotify = deviceNotify; }
@@ -39,7 +40,11 @@ namespace DX
 
         // Direct3D Accessors.
         ID3D11Device1* GetD3DDevice() const { return m_d3dDevice.Get(); }
-        ID3D11DeviceContext1* GetD3DDeviceContext() const { return m_d3dContext.Get(); }
+        ID3D11DeviceContext1* GetD3DDeviceContext() const { return m_contextOverride != nullptr ? m_contextOverride : m_d3dContext.Get(); }
+
+        // Hands out context in place of the immediate context until set back to null, for command capture
+        void SetContextOverride(ID3D11DeviceContext1* context) { m_contextOverride = context; }
+
         IDXGISwapChain1* GetSwapChain() const { return m_swapChain.Get(); }
         D3D_FEATURE_LEVEL       GetDeviceFeatureLevel() const { return m_d3dFeatureLevel; }
         ID3D11Texture2D* GetRenderTarget() const { return m_renderTarget.Get(); }
@@ -53,6 +58,9 @@ namespace DX
         DXGI_COLOR_SPACE_TYPE   GetColorSpace() const { return m_colorSpace; }
         unsigned int            GetDeviceOptions() const { return m_options; }
 
+        // Seconds between refreshes of the output Present waits on, 0 when it doesn't wait for vertical sync
+        double                  GetRefreshInterval() const { return m_refreshInterval; }
+
         // Performance events
         void PIXBeginEvent(_In_z_ const wchar_t* name)
         {
@@ -73,6 +81,7 @@ namespace DX
         void CreateFactory();
         void GetHardwareAdapter(IDXGIAdapter1** ppAdapter);
         void UpdateColorSpace();
+        void UpdateRefreshInterval();
 
         // Direct3D objects.
         Microsoft::WRL::ComPtr<IDXGIFactory2>               m_dxgiFactory;
@@ -98,6 +107,7 @@ namespace DX
         HWND                                            m_window;
         D3D_FEATURE_LEVEL                               m_d3dFeatureLevel;
         RECT                                            m_outputSize;
+        double                                          m_refreshInterval;
 
         // HDR Support
         DXGI_COLOR_SPACE_TYPE                           m_colorSpace;
@@ -107,5 +117,8 @@ namespace DX
 
         // The IDeviceNotify can be held directly as it owns the DeviceResources.
         IDeviceNotify* m_deviceNotify;
+
+        // Not owned, null unless something is wrapping the immediate context
+        ID3D11DeviceContext1* m_contextOverride;
     };
 }
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "red_engine.h"
+#include "frame_graph.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_culledPasses("render.culled_passes");
+		utils::PerfCounter s_transientBytes("render.transient_bytes", utils::PerfCounter::Gauge);
+
+		template <typename T>
+		void SafeRelease(T*& object)
+		{
+			if (object != nullptr)
+			{
+				object->Release();
+				object = nullptr;
+			}
+		}
+
+		uint64_t GetBytes(const FrameGraph::TextureDesc& desc)
+		{
+			return uint64_t(desc.width) * desc.height * desc.bytesPerPixel;
+		}
+	}
+
+	FrameGraph::Handle FrameGraph::Builder::Create(const char* name, const TextureDesc& desc)
+	{
+		Resource resource = {};
+		resource.name = name;
+		resource.desc = desc;
+		resource.imported = false;
+		resource.physical = InvalidHandle;
+		m_graph.m_resources.push_back(resource);
+
+		const Handle handle = Handle(m_graph.m_resources.size() - 1);
+		Write(handle);
+		return handle;
+	}
+
+	void FrameGraph::Builder::Read(Handle resource)
+	{
+		ASSERT(resource < m_graph.m_resources.size(), "Pass %s reads a resource that doesn't exist.\n", m_graph.m_passes[m_pass].name);
+		m_graph.m_passes[m_pass].reads.push_back(resource);
+	}
+
+	void FrameGraph::Builder::Write(Handle resource)
+	{
+		ASSERT(resource < m_graph.m_resources.size(), "Pass %s writes a resource that doesn't exist.\n", m_graph.m_passes[m_pass].name);
+		m_graph.m_passes[m_pass].writes.push_back(resource);
+		m_graph.m_resources[resource].writers.push_back(m_pass);
+	}
+
+	void FrameGraph::Builder::SetSideEffects()
+	{
+		m_graph.m_passes[m_pass].sideEffects = true;
+	}
+
+	FrameGraph::FrameGraph() :
+		m_stats(),
+		m_frame(0),
+		m_compiled(false)
+	{
+	}
+
+	FrameGraph::~FrameGraph()
+	{
+		ReleaseTextures();
+	}
+
+	void FrameGraph::Reset()
+	{
+		m_resources.clear();
+		m_passes.clear();
+		m_physical.clear();
+		m_stats = Stats();
+		m_compiled = false;
+		++m_frame;
+	}
+
+	FrameGraph::Handle FrameGraph::Import(const char* name, const Views& views)
+	{
+		Resource resource = {};
+		resource.name = name;
+		resource.imported = true;
+		resource.views = views;
+		resource.physical = InvalidHandle;
+		m_resources.push_back(resource);
+		return Handle(m_resources.size() - 1);
+	}
+
+	void FrameGraph::AddPass(const char* name, const Setup& setup, Execute execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = std::move(execute);
+		pass.outputs = 0;
+		pass.sideEffects = false;
+		pass.culled = false;
+		m_passes.push_back(std::move(pass));
+
+		Builder builder(*this, uint32_t(m_passes.size() - 1));
+		setup(builder);
+	}
+
+	void FrameGraph::Compile()
+	{
+		// Count the readers of everything and the writes of every pass; imports count as read from outside
+		for (Resource& resource : m_resources)
+			resource.readers = resource.imported ? 1 : 0;
+		for (Pass& pass : m_passes)
+		{
+			pass.outputs = uint32_t(pass.writes.size());
+			for (Handle read : pass.reads)
+				++m_resources[read].readers;
+		}
+
+		// Anything nobody reads takes its writers with it, which can leave what they read unread in turn
+		std::vector<Handle> unread;
+		for (Handle i = 0; i < m_resources.size(); ++i)
+		{
+			if (m_resources[i].readers == 0)
+				unread.push_back(i);
+		}
+
+		while (!unread.empty())
+		{
+			const Handle resource = unread.back();
+			unread.pop_back();
+
+			for (uint32_t writer : m_resources[resource].writers)
+			{
+				Pass& pass = m_passes[writer];
+				if (pass.culled || --pass.outputs > 0 || pass.sideEffects)
+					continue;
+
+				pass.culled = true;
+				++m_stats.culledPasses;
+				for (Handle read : pass.reads)
+				{
+					if (--m_resources[read].readers == 0)
+						unread.push_back(read);
+				}
+			}
+		}
+
+		// Lifetimes over the surviving passes
+		for (Resource& resource : m_resources)
+		{
+			resource.firstPass = InvalidHandle;
+			resource.lastPass = 0;
+		}
+		for (uint32_t i = 0; i < m_passes.size(); ++i)
+		{
+			const Pass& pass = m_passes[i];
+			if (pass.culled)
+				continue;
+
+			for (const std::vector<Handle>* list : { &pass.reads, &pass.writes })
+			{
+				for (Handle handle : *list)
+				{
+					Resource& resource = m_resources[handle];
+					resource.firstPass = std::min(resource.firstPass, i);
+					resource.lastPass = std::max(resource.lastPass, i);
+				}
+			}
+		}
+
+		// Transients in order of first use, each into the first matching physical texture that's free by then
+		std::vector<Handle> transients;
+		for (Handle i = 0; i < m_resources.size(); ++i)
+		{
+			if (!m_resources[i].imported && m_resources[i].firstPass != InvalidHandle)
+				transients.push_back(i);
+		}
+		std::stable_sort(transients.begin(), transients.end(),
+			[this](Handle a, Handle b) { return m_resources[a].firstPass < m_resources[b].firstPass; });
+
+		for (Handle handle : transients)
+		{
+			Resource& resource = m_resources[handle];
+
+			uint32_t physical = 0;
+			while (physical < m_physical.size() &&
+				!(m_physical[physical].desc == resource.desc && m_physical[physical].lastPass < resource.firstPass))
+				++physical;
+
+			if (physical == m_physical.size())
+			{
+				Physical created;
+				created.desc = resource.desc;
+				created.pooled = InvalidHandle;
+				m_physical.push_back(created);
+				m_stats.aliasedBytes += GetBytes(resource.desc);
+			}
+
+			m_physical[physical].lastPass = resource.lastPass;
+			resource.physical = physical;
+			m_stats.unaliasedBytes += GetBytes(resource.desc);
+		}
+
+		// Sweep the passes for the most bytes live at once
+		for (uint32_t i = 0; i < m_passes.size(); ++i)
+		{
+			uint64_t live = 0;
+			for (Handle handle : transients)
+			{
+				if (m_resources[handle].firstPass <= i && m_resources[handle].lastPass >= i)
+					live += GetBytes(m_resources[handle].desc);
+			}
+			m_stats.peakLiveBytes = std::max(m_stats.peakLiveBytes, live);
+		}
+
+		m_stats.passes = uint32_t(m_passes.size());
+		m_stats.transients = uint32_t(transients.size());
+		m_stats.physicalTextures = uint32_t(m_physical.size());
+		m_compiled = true;
+
+		s_culledPasses.Add(m_stats.culledPasses);
+		s_transientBytes.Set(m_stats.aliasedBytes);
+	}
+
+	void FrameGraph::Run(ID3D11Device* device)
+	{
+		ASSERT(m_compiled, "FrameGraph::Run called before Compile.\n");
+
+		for (PooledTexture& texture : m_pool)
+			texture.claimed = false;
+
+		// Last frame's textures first, so a steady graph creates nothing
+		for (Physical& physical : m_physical)
+		{
+			uint32_t pooled = 0;
+			while (pooled < m_pool.size() && (m_pool[pooled].claimed || !(m_pool[pooled].desc == physical.desc)))
+				++pooled;
+
+			if (pooled == m_pool.size())
+			{
+				PooledTexture texture = {};
+				texture.desc = physical.desc;
+				if (device != nullptr && !CreateTexture(device, texture))
+					DEBUG_MESSAGE("Unable to create a %ux%u frame graph texture.\n", physical.desc.width, physical.desc.height);
+				m_pool.push_back(texture);
+			}
+
+			m_pool[pooled].claimed = true;
+			m_pool[pooled].lastUsedFrame = m_frame;
+			physical.pooled = pooled;
+		}
+
+		for (const Pass& pass : m_passes)
+		{
+			if (!pass.culled && pass.execute)
+				pass.execute(*this);
+		}
+
+		// Let go of anything the graph has stopped asking for
+		for (size_t i = 0; i < m_pool.size();)
+		{
+			if (m_frame - m_pool[i].lastUsedFrame > PoolFrames)
+			{
+				ReleaseViews(m_pool[i].views);
+				m_pool[i] = m_pool.back();
+				m_pool.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	const FrameGraph::Views& FrameGraph::GetViews(Handle resource) const
+	{
+		const Resource& entry = m_resources[resource];
+		if (entry.imported)
+			return entry.views;
+
+		ASSERT(entry.physical != InvalidHandle, "%s isn't used by any pass that runs.\n", entry.name);
+		return m_pool[m_physical[entry.physical].pooled].views;
+	}
+
+	void FrameGraph::LogReport() const
+	{
+		DEBUG_MESSAGE("Frame graph: %u passes, %u culled, %u transients in %u textures.\n", m_stats.passes, m_stats.culledPasses,
+			m_stats.transients, m_stats.physicalTextures);
+		DEBUG_MESSAGE("Frame graph transient memory: %.2f MB unaliased, %.2f MB aliased, %.2f MB peak live.\n",
+			double(m_stats.unaliasedBytes) / (1024.0 * 1024.0), double(m_stats.aliasedBytes) / (1024.0 * 1024.0),
+			double(m_stats.peakLiveBytes) / (1024.0 * 1024.0));
+
+		for (const Pass& pass : m_passes)
+		{
+			if (pass.culled)
+				DEBUG_MESSAGE("  culled %s\n", pass.name);
+		}
+		for (const Resource& resource : m_resources)
+		{
+			if (!resource.imported && resource.physical != InvalidHandle)
+				DEBUG_MESSAGE("  %-24s passes %u-%u texture %u\n", resource.name, resource.firstPass, resource.lastPass, resource.physical);
+		}
+	}
+
+	void FrameGraph::ReleaseTextures()
+	{
+		for (PooledTexture& texture : m_pool)
+			ReleaseViews(texture.views);
+		m_pool.clear();
+	}
+
+	bool FrameGraph::CreateTexture(ID3D11Device* device, PooledTexture& texture)
+	{
+#if defined(_WIN32)
+		const TextureDesc& desc = texture.desc;
+		const CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT(desc.format), desc.width, desc.height, 1, 1, desc.bindFlags);
+
+		Views& views = texture.views;
+		if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &views.texture)))
+			return false;
+
+		bool ok = true;
+		if ((desc.bindFlags & D3D11_BIND_RENDER_TARGET) != 0)
+			ok = ok && SUCCEEDED(device->CreateRenderTargetView(views.texture, nullptr, &views.renderTarget));
+		if ((desc.bindFlags & D3D11_BIND_SHADER_RESOURCE) != 0)
+			ok = ok && SUCCEEDED(device->CreateShaderResourceView(views.texture, nullptr, &views.shaderResource));
+		if ((desc.bindFlags & D3D11_BIND_DEPTH_STENCIL) != 0)
+			ok = ok && SUCCEEDED(device->CreateDepthStencilView(views.texture, nullptr, &views.depthStencil));
+
+		if (!ok)
+			ReleaseViews(views);
+		return ok;
+#else
+		(void)device;
+		(void)texture;
+		return false;
+#endif
+	}
+
+	void FrameGraph::ReleaseViews(Views& views)
+	{
+#if defined(_WIN32)
+		SafeRelease(views.renderTarget);
+		SafeRelease(views.shaderResource);
+		SafeRelease(views.depthStencil);
+		SafeRelease(views.texture);
+#else
+		views = Views();
+#endif
+	}
+
+} // namespace DX
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct ID3D11Device;
+struct ID3D11Texture2D;
+struct ID3D11RenderTargetView;
+struct ID3D11ShaderResourceView;
+struct ID3D11DepthStencilView;
+
+namespace DX
+{
+
+	// Render passes declared each frame with the textures they read and write. Compile drops passes whose results
+	// nobody reads, then gives transient textures with the same description and non-overlapping lifetimes the same
+	// physical texture. D3D11 can't place resources in shared memory, so that is as fine as the aliasing gets.
+	class FrameGraph
+	{
+	public:
+		typedef uint32_t Handle;
+		static const Handle				InvalidHandle = 0xffffffff;
+
+		struct TextureDesc
+		{
+			uint32_t					width;
+			uint32_t					height;
+			uint32_t					format; // DXGI_FORMAT
+			uint32_t					bindFlags; // D3D11_BIND_*, which decide the views made for it
+			uint32_t					bytesPerPixel; // Only for the memory report
+
+			bool						operator==(const TextureDesc& other) const
+			{
+				return width == other.width && height == other.height && format == other.format && bindFlags == other.bindFlags;
+			}
+		};
+
+		struct Views
+		{
+			ID3D11Texture2D*			texture;
+			ID3D11RenderTargetView*		renderTarget;
+			ID3D11ShaderResourceView*	shaderResource;
+			ID3D11DepthStencilView*		depthStencil;
+		};
+
+		struct Stats
+		{
+			uint32_t					passes;
+			uint32_t					culledPasses;
+			uint32_t					transients; // Used by a pass that survived culling
+			uint32_t					physicalTextures;
+			uint64_t					unaliasedBytes; // Every transient its own texture
+			uint64_t					aliasedBytes; // What the physical textures take
+			uint64_t					peakLiveBytes; // Most transient bytes live at once, the floor for any aliasing
+		};
+
+		// Handed to a pass's setup to declare what it touches
+		class Builder
+		{
+		public:
+			// A new transient texture, written by this pass
+			Handle						Create(const char* name, const TextureDesc& desc);
+
+			void						Read(Handle resource);
+			void						Write(Handle resource);
+
+			// Never culled, for passes with effects outside the graph
+			void						SetSideEffects();
+
+		private:
+			friend class FrameGraph;
+
+			Builder(FrameGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {}
+
+			FrameGraph&					m_graph;
+			uint32_t					m_pass;
+		};
+
+		typedef std::function<void(Builder&)> Setup;
+		typedef std::function<void(const FrameGraph&)> Execute;
+
+		FrameGraph();
+		~FrameGraph();
+
+		// Starts the next frame's declarations, keeping the physical textures for reuse
+		void							Reset();
+
+		// Something the graph doesn't own, such as the back buffer. Passes writing one are never culled.
+		Handle							Import(const char* name, const Views& views);
+
+		// Setup runs straight away; execute is kept until Run
+		void							AddPass(const char* name, const Setup& setup, Execute execute);
+
+		void							Compile();
+
+		// Creates any physical textures the pool is missing, then executes the surviving passes in order.
+		// Without a device (headless tools) the views are all null and only the passes run.
+		void							Run(ID3D11Device* device);
+
+		// Valid during Run
+		const Views&					GetViews(Handle resource) const;
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+		void							LogReport() const;
+
+		// All pooled textures, for device loss and resizes
+		void							ReleaseTextures();
+
+	private:
+		struct Resource
+		{
+			const char*					name; // Not owned, a literal
+			TextureDesc					desc;
+			bool						imported;
+			Views						views; // Imported ones only, transients look theirs up through physical
+			std::vector<uint32_t>		writers;
+			uint32_t					readers; // Passes still reading it while culling
+			uint32_t					firstPass;
+			uint32_t					lastPass;
+			uint32_t					physical; // Index into m_physical, InvalidHandle if unused
+		};
+
+		struct Pass
+		{
+			const char*					name;
+			Execute						execute;
+			std::vector<Handle>			reads;
+			std::vector<Handle>			writes;
+			uint32_t					outputs; // Writes still read by someone while culling
+			bool						sideEffects;
+			bool						culled;
+		};
+
+		struct Physical
+		{
+			TextureDesc					desc;
+			uint32_t					lastPass; // Free for any transient first used after this
+			uint32_t					pooled; // Index into m_pool once Run has found or made it
+		};
+
+		struct PooledTexture
+		{
+			TextureDesc					desc;
+			Views						views;
+			uint32_t					lastUsedFrame;
+			bool						claimed; // By this frame's Run
+		};
+
+		static const uint32_t			PoolFrames = 8; // Pooled textures unused for this long are released
+
+		bool							CreateTexture(ID3D11Device* device, PooledTexture& texture);
+		static void						ReleaseViews(Views& views);
+
+		std::vector<Resource>			m_resources;
+		std::vector<Pass>				m_passes;
+		std::vector<Physical>			m_physical;
+		std::vector<PooledTexture>		m_pool;
+		Stats							m_stats;
+		uint32_t						m_frame;
+		bool							m_compiled;
+	};
+
+} // namespace DX
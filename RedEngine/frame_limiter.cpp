@@ -0,0 +1,162 @@
+#include "red_engine.h"
+#include "frame_limiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+namespace utils
+{
+
+	namespace
+	{
+		// Bounds on how early the coarse sleep stops. The floor keeps a little spin for scheduler jitter, the
+		// ceiling stops one bad wake from turning the limiter back into a busy loop.
+		const double c_MinSpinMargin = 0.0002;
+		const double c_MaxSpinMargin = 0.004;
+
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		void Pause()
+		{
+#if defined(_M_X64) || defined(__x86_64__)
+			_mm_pause();
+#else
+			std::this_thread::yield();
+#endif
+		}
+	}
+
+	FrameLimiter::FrameLimiter(uint32_t history) :
+		m_targetPeriod(0.0),
+		m_latencyBudget(0.0),
+		m_deadline(0.0),
+		m_frameStart(0.0),
+		m_work(0.0),
+		m_spinMargin(0.001),
+		m_lastError(0.0),
+		m_errors(history > 0 ? history : 1, 0.0),
+		m_next(0),
+		m_frames(0),
+		m_missed(0)
+	{
+#if defined(_WIN32)
+		// The default 15.6 ms tick is coarser than a frame
+		timeBeginPeriod(1);
+#endif
+	}
+
+	FrameLimiter::~FrameLimiter()
+	{
+#if defined(_WIN32)
+		timeEndPeriod(1);
+#endif
+	}
+
+	void FrameLimiter::SetTargetFrameRate(double framesPerSecond)
+	{
+		m_targetPeriod = framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0;
+	}
+
+	void FrameLimiter::SetLatencyBudget(double seconds)
+	{
+		m_latencyBudget = seconds > 0.0 ? seconds : 0.0;
+	}
+
+	double FrameLimiter::GetPeriod() const
+	{
+		if (m_latencyBudget <= 0.0)
+			return m_targetPeriod;
+
+		// Input arriving just after a frame starts waits a whole period and then the next frame's work
+		return std::max(m_latencyBudget - m_work, m_work);
+	}
+
+	void FrameLimiter::BeginFrame()
+	{
+		const double period = GetPeriod();
+		double now = Seconds();
+
+		if (period <= 0.0 || m_deadline == 0.0)
+		{
+			m_deadline = now;
+		}
+		else if (now >= m_deadline)
+		{
+			++m_missed;
+		}
+		else
+		{
+			const double sleep = m_deadline - now - m_spinMargin;
+			if (sleep > 0.0)
+			{
+				std::this_thread::sleep_for(std::chrono::duration<double>(sleep));
+
+				// Jump straight up to a bigger oversleep, ease back down from a smaller one
+				const double oversleep = Seconds() - now - sleep;
+				m_spinMargin = oversleep > m_spinMargin ? oversleep * 1.25 : m_spinMargin * 0.95 + oversleep * 0.05;
+				m_spinMargin = std::min(std::max(m_spinMargin, c_MinSpinMargin), c_MaxSpinMargin);
+			}
+
+			while (Seconds() < m_deadline)
+				Pause();
+
+			now = Seconds();
+		}
+
+		m_lastError = now - m_deadline;
+
+		m_errors[m_next] = m_lastError;
+		m_next = (m_next + 1) % uint32_t(m_errors.size());
+		++m_frames;
+
+		// After a long stall start afresh rather than rushing frames out to catch up
+		m_frameStart = now;
+		m_deadline = m_lastError > period ? now + period : m_deadline + period;
+	}
+
+	void FrameLimiter::EndFrame()
+	{
+		const double work = Seconds() - m_frameStart;
+		m_work = work > m_work ? work : m_work * 0.95 + work * 0.05;
+	}
+
+	FrameLimiter::Stats FrameLimiter::GetStats() const
+	{
+		Stats stats = {};
+		stats.frames = m_frames;
+		stats.missed = m_missed;
+		stats.period = GetPeriod();
+		stats.work = m_work;
+		stats.spinMargin = m_spinMargin;
+
+		const uint32_t count = std::min(m_frames, uint32_t(m_errors.size()));
+		if (count == 0)
+			return stats;
+
+		std::vector<double> sorted(m_errors.begin(), m_errors.begin() + count);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (double error : sorted)
+			total += error;
+
+		stats.averageError = total / double(count);
+		stats.p99Error = sorted[std::min(count - 1, count * 99 / 100)];
+		stats.maxError = sorted.back();
+		return stats;
+	}
+
+} // namespace utils
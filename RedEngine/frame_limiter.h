@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+	// Paces the main loop without burning a core. Each frame waits with an OS sleep that stops short of the
+	// deadline by however much the OS has been oversleeping lately, then spins the last fraction of a millisecond.
+	class FrameLimiter
+	{
+	public:
+		struct Stats
+		{
+			uint32_t					frames;
+			uint32_t					missed; // Frames that started after their deadline
+			double						period; // Seconds between frames currently being targeted
+			double						work; // Smoothed time from BeginFrame to EndFrame
+			double						averageError; // How late frames start, over the recent history
+			double						p99Error;
+			double						maxError;
+			double						spinMargin; // How early the sleep currently stops
+		};
+
+		explicit FrameLimiter(uint32_t history = 512);
+		~FrameLimiter();
+
+		// 0 runs unlimited
+		void							SetTargetFrameRate(double framesPerSecond);
+
+		// Longest time input may wait to be shown, 0 turns it off. Overrides the frame rate: the period stretches
+		// to whatever keeps waiting plus the measured frame work inside the budget, so slow frames run less often
+		// rather than queueing up behind each other.
+		void							SetLatencyBudget(double seconds);
+
+		// Waits for this frame's slot. Call before pumping messages, so input is as fresh as possible.
+		void							BeginFrame();
+
+		// Marks the end of the frame's work, used to size the period under a latency budget
+		void							EndFrame();
+
+		// Seconds this frame started after its deadline
+		double							GetLastError() const
+		{
+			return m_lastError;
+		}
+
+		Stats							GetStats() const;
+
+	private:
+		double							GetPeriod() const;
+
+		double							m_targetPeriod;
+		double							m_latencyBudget;
+
+		double							m_deadline; // When the next frame should start, 0 before the first
+		double							m_frameStart;
+		double							m_work;
+		double							m_spinMargin;
+
+		double							m_lastError;
+		std::vector<double>				m_errors; // A ring of the last history frames
+		uint32_t						m_next;
+		uint32_t						m_frames;
+		uint32_t						m_missed;
+	};
+
+} // namespace utils
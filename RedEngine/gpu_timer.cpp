@@ -0,0 +1,101 @@
+#include "red_engine.h"
+#include "gpu_timer.h"
+
+namespace DX
+{
+
+	GpuTimer::GpuTimer() :
+		m_frames{},
+		m_begun(0),
+		m_read(0),
+		m_seconds(0.0)
+	{
+	}
+
+	GpuTimer::~GpuTimer()
+	{
+		Release();
+	}
+
+	bool GpuTimer::Create(ID3D11Device* device)
+	{
+		ASSERT(!IsCreated(), "The GPU timer has already been created.\n");
+
+		const D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		const D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		for (Frame& frame : m_frames)
+		{
+			if (FAILED(device->CreateQuery(&disjointDesc, &frame.disjoint)) || FAILED(device->CreateQuery(&timestampDesc, &frame.begin)) ||
+				FAILED(device->CreateQuery(&timestampDesc, &frame.end)))
+			{
+				DEBUG_MESSAGE("No GPU timestamps, frames are timed on the CPU alone.\n");
+				Release();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void GpuTimer::Release()
+	{
+		for (Frame& frame : m_frames)
+		{
+			ID3D11Query** const queries[] = { &frame.disjoint, &frame.begin, &frame.end };
+			for (ID3D11Query** query : queries)
+			{
+				if (*query != nullptr)
+					(*query)->Release();
+				*query = nullptr;
+			}
+		}
+
+		// What was in flight went with the device
+		m_begun = 0;
+		m_read = 0;
+		m_seconds = 0.0;
+	}
+
+	void GpuTimer::Begin(ID3D11DeviceContext* deviceContext)
+	{
+		if (!IsCreated())
+			return;
+
+		// Oldest first, and only what the GPU has already finished
+		while (m_read < m_begun)
+		{
+			const Frame& frame = m_frames[m_read % Latency];
+			D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+			UINT64 begin, end;
+			if (deviceContext->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+				deviceContext->GetData(frame.begin, &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+				deviceContext->GetData(frame.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+				break;
+
+			// A clock change in between, such as a power state switch, makes the pair meaningless
+			if (!disjoint.Disjoint && disjoint.Frequency > 0 && end >= begin)
+				m_seconds = double(end - begin) / double(disjoint.Frequency);
+			++m_read;
+		}
+
+		// Rather than wait, a frame goes untimed when the GPU is that far behind
+		if (m_begun - m_read == Latency)
+			return;
+
+		const Frame& frame = m_frames[m_begun % Latency];
+		deviceContext->Begin(frame.disjoint);
+		deviceContext->End(frame.begin);
+	}
+
+	void GpuTimer::End(ID3D11DeviceContext* deviceContext)
+	{
+		if (!IsCreated() || m_begun - m_read == Latency)
+			return;
+
+		const Frame& frame = m_frames[m_begun % Latency];
+		deviceContext->End(frame.end);
+		deviceContext->End(frame.disjoint);
+		++m_begun;
+	}
+
+} // namespace DX
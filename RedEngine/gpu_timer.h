@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+namespace DX
+{
+
+	// Times the GPU's part of a frame with timestamp queries. The results are read a few frames later, once the
+	// GPU has got to them, so nothing waits; until then the last time read stands. Present's wait for vertical
+	// sync is on the CPU and never lands between the two timestamps.
+	class GpuTimer
+	{
+	public:
+		GpuTimer();
+		~GpuTimer();
+
+		bool							Create(ID3D11Device* device);
+		void							Release();
+
+		bool							IsCreated() const
+		{
+			return m_frames[0].disjoint != nullptr;
+		}
+
+		// Around the frame's commands, on the immediate context
+		void							Begin(ID3D11DeviceContext* deviceContext);
+		void							End(ID3D11DeviceContext* deviceContext);
+
+		// Of the newest frame read back, 0 before the first
+		double							GetSeconds() const
+		{
+			return m_seconds;
+		}
+
+	private:
+		static const uint32_t			Latency = 4; // Frames in flight before a result is waited for
+
+		struct Frame
+		{
+			ID3D11Query*				disjoint;
+			ID3D11Query*				begin;
+			ID3D11Query*				end;
+		};
+
+		Frame							m_frames[Latency];
+		uint32_t						m_begun; // Frames begun and read back, counting up
+		uint32_t						m_read;
+		double							m_seconds;
+	};
+
+} // namespace DX
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Name hashing shared by the runtime and the offline tools, so it must not pull in any engine headers.
+namespace utils
+{
+
+	static const uint64_t HashSeed = 0xcbf29ce484222325ull;
+	static const uint64_t HashPrime = 0x100000001b3ull;
+
+	// 64-bit FNV-1a. constexpr so literal names can be hashed at compile time.
+	constexpr uint64_t HashName(const char* name, uint64_t hash = HashSeed)
+	{
+		return *name == '\0' ? hash : HashName(name + 1, (hash ^ uint64_t(uint8_t(*name))) * HashPrime);
+	}
+
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashSeed)
+	{
+		const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * HashPrime;
+		return hash;
+	}
+
+} // namespace utils
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <emmintrin.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace containers
+{
+
+	// Spreads every bit of an integer, enum or pointer key over the whole hash
+	template <typename T>
+	struct Hash
+	{
+		static_assert(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+			"Give HashMap a hasher for keys that aren't integers, enums or pointers.");
+
+		uint64_t operator()(T key) const
+		{
+			uint64_t value;
+			if constexpr (std::is_pointer<T>::value)
+				value = uint64_t(reinterpret_cast<uintptr_t>(key));
+			else
+				value = uint64_t(key);
+
+			value ^= value >> 33;
+			value *= 0xff51afd7ed558ccdull;
+			value ^= value >> 33;
+			value *= 0xc4ceb9fe1a85ec53ull;
+			value ^= value >> 33;
+			return value;
+		}
+	};
+
+	// Open addressing hash map, laid out as Swiss tables are. A byte of control per slot holds seven bits of the key's
+	// hash when the slot is full, and the slots are probed sixteen at a time: one SSE2 compare of a group's control
+	// bytes finds the few slots worth comparing keys in, and a group with an empty slot ends the search. Keys and
+	// values live in place in one array, so a lookup is normally one control load and one key compare.
+	// Pointers from find and insert are good until the next insert, erase, reserve or clear.
+	template <typename Key, typename Value, typename Hasher = Hash<Key>>
+	class HashMap
+	{
+	public:
+		HashMap() :
+			m_groups(nullptr),
+			m_slots(nullptr),
+			m_groupCount(0),
+			m_size(0),
+			m_tombstones(0),
+			m_growthLeft(0)
+		{
+		}
+
+		~HashMap()
+		{
+			clear();
+			Free();
+		}
+
+		HashMap(const HashMap&) = delete;
+		HashMap& operator=(const HashMap&) = delete;
+
+		inline Value* find(const Key& key)
+		{
+			const size_t slot = FindSlot(key, Hasher()(key));
+			return slot != NoSlot ? &m_slots[slot].value : nullptr;
+		}
+
+		inline const Value* find(const Key& key) const
+		{
+			const size_t slot = FindSlot(key, Hasher()(key));
+			return slot != NoSlot ? &m_slots[slot].value : nullptr;
+		}
+
+		inline bool contains(const Key& key) const
+		{
+			return find(key) != nullptr;
+		}
+
+		// Leaves the value alone if key is already there. The bool is whether it was added.
+		std::pair<Value*, bool> insert(const Key& key, Value value)
+		{
+			const uint64_t hash = Hasher()(key);
+			const size_t found = FindSlot(key, hash);
+			if (found != NoSlot)
+				return std::make_pair(&m_slots[found].value, false);
+
+			if (m_growthLeft == 0)
+				Grow();
+
+			const size_t slot = FindFree(hash);
+			int8_t& control = m_groups[slot / GroupSize].control[slot % GroupSize];
+			if (control == Empty)
+				--m_growthLeft;
+			else
+				--m_tombstones;
+			control = int8_t(hash & 0x7f);
+
+			new (&m_slots[slot]) Slot{ key, std::move(value) };
+			++m_size;
+			return std::make_pair(&m_slots[slot].value, true);
+		}
+
+		inline Value& operator[](const Key& key)
+		{
+			return *insert(key, Value()).first;
+		}
+
+		bool erase(const Key& key)
+		{
+			const size_t slot = FindSlot(key, Hasher()(key));
+			if (slot == NoSlot)
+				return false;
+
+			m_slots[slot].~Slot();
+			--m_size;
+
+			// Searches stop at a group with an empty slot, so one more changes nothing for them. In a full group
+			// the slot must stay marked, or searches for keys that probed past it would stop short.
+			Group& group = m_groups[slot / GroupSize];
+			if (EmptyMask(group) != 0)
+			{
+				group.control[slot % GroupSize] = Empty;
+				++m_growthLeft;
+			}
+			else
+			{
+				group.control[slot % GroupSize] = Deleted;
+				++m_tombstones;
+			}
+			return true;
+		}
+
+		// Keeps the capacity
+		void clear()
+		{
+			for (size_t group = 0; group < m_groupCount; ++group)
+			{
+				for (uint32_t full = FullMask(m_groups[group]); full != 0; full &= full - 1)
+					m_slots[group * GroupSize + LowestBit(full)].~Slot();
+				for (int8_t& control : m_groups[group].control)
+					control = Empty;
+			}
+			m_size = 0;
+			m_tombstones = 0;
+			m_growthLeft = MaxLoad(m_groupCount);
+		}
+
+		// Room for count entries without growing
+		void reserve(size_t count)
+		{
+			size_t groupCount = m_groupCount != 0 ? m_groupCount : 1;
+			while (MaxLoad(groupCount) < count)
+				groupCount *= 2;
+			if (groupCount != m_groupCount)
+				Rehash(groupCount);
+		}
+
+		// function(const Key&, Value&) for every entry, in no particular order
+		template <typename Function>
+		void for_each(Function function)
+		{
+			for (size_t group = 0; group < m_groupCount; ++group)
+			{
+				for (uint32_t full = FullMask(m_groups[group]); full != 0; full &= full - 1)
+				{
+					Slot& slot = m_slots[group * GroupSize + LowestBit(full)];
+					function(static_cast<const Key&>(slot.key), slot.value);
+				}
+			}
+		}
+
+		inline size_t size() const
+		{
+			return m_size;
+		}
+
+		inline bool empty() const
+		{
+			return m_size == 0;
+		}
+
+		inline size_t capacity() const
+		{
+			return m_groupCount * GroupSize;
+		}
+
+	private:
+		static const size_t				GroupSize = 16;
+		static const size_t				NoSlot = ~size_t(0);
+
+		// Full slots hold the low seven bits of the hash, so only empty and deleted have the top bit set
+		static const int8_t				Empty = -128;
+		static const int8_t				Deleted = -2;
+
+		struct alignas(16) Group
+		{
+			int8_t						control[GroupSize];
+		};
+
+		struct Slot
+		{
+			Key							key;
+			Value						value;
+		};
+
+		static uint32_t LowestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(__builtin_ctz(value));
+#endif
+		}
+
+		static uint32_t MatchMask(const Group& group, int8_t control)
+		{
+			const __m128i controls = _mm_load_si128(reinterpret_cast<const __m128i*>(group.control));
+			return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8(control))));
+		}
+
+		static uint32_t EmptyMask(const Group& group)
+		{
+			return MatchMask(group, Empty);
+		}
+
+		// Empty or deleted
+		static uint32_t FreeMask(const Group& group)
+		{
+			return uint32_t(_mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(group.control))));
+		}
+
+		static uint32_t FullMask(const Group& group)
+		{
+			return ~FreeMask(group) & 0xffff;
+		}
+
+		// Seven in eight slots full at most, so there is always an empty slot to end a search
+		static size_t MaxLoad(size_t groupCount)
+		{
+			return groupCount * GroupSize - groupCount * GroupSize / 8;
+		}
+
+		// Groups in triangular steps from the one the hash picks, which visits every group when there are a power of two
+		size_t FindSlot(const Key& key, uint64_t hash) const
+		{
+			if (m_groupCount == 0)
+				return NoSlot;
+
+			const int8_t control = int8_t(hash & 0x7f);
+			size_t group = size_t(hash >> 7) & (m_groupCount - 1);
+			for (size_t step = 1;; ++step)
+			{
+				for (uint32_t matches = MatchMask(m_groups[group], control); matches != 0; matches &= matches - 1)
+				{
+					const size_t slot = group * GroupSize + LowestBit(matches);
+					if (m_slots[slot].key == key)
+						return slot;
+				}
+
+				if (EmptyMask(m_groups[group]) != 0)
+					return NoSlot;
+
+				group = (group + step) & (m_groupCount - 1);
+			}
+		}
+
+		size_t FindFree(uint64_t hash) const
+		{
+			size_t group = size_t(hash >> 7) & (m_groupCount - 1);
+			for (size_t step = 1;; ++step)
+			{
+				const uint32_t free = FreeMask(m_groups[group]);
+				if (free != 0)
+					return group * GroupSize + LowestBit(free);
+
+				group = (group + step) & (m_groupCount - 1);
+			}
+		}
+
+		// Doubles, unless clearing out the deleted slots makes room enough
+		void Grow()
+		{
+			if (m_groupCount == 0)
+				Rehash(1);
+			else if (m_size <= MaxLoad(m_groupCount) / 2)
+				Rehash(m_groupCount);
+			else
+				Rehash(m_groupCount * 2);
+		}
+
+		void Rehash(size_t groupCount)
+		{
+			Group* const oldGroups = m_groups;
+			Slot* const oldSlots = m_slots;
+			const size_t oldGroupCount = m_groupCount;
+
+			m_groups = new Group[groupCount];
+			for (size_t group = 0; group < groupCount; ++group)
+			{
+				for (int8_t& control : m_groups[group].control)
+					control = Empty;
+			}
+			m_slots = static_cast<Slot*>(::operator new(groupCount * GroupSize * sizeof(Slot), std::align_val_t(alignof(Slot))));
+			m_groupCount = groupCount;
+
+			for (size_t group = 0; group < oldGroupCount; ++group)
+			{
+				for (uint32_t full = FullMask(oldGroups[group]); full != 0; full &= full - 1)
+				{
+					Slot& slot = oldSlots[group * GroupSize + LowestBit(full)];
+					const size_t to = FindFree(Hasher()(slot.key));
+					m_groups[to / GroupSize].control[to % GroupSize] = oldGroups[group].control[LowestBit(full)];
+					new (&m_slots[to]) Slot(std::move(slot));
+					slot.~Slot();
+				}
+			}
+
+			delete[] oldGroups;
+			::operator delete(oldSlots, std::align_val_t(alignof(Slot)));
+
+			m_tombstones = 0;
+			m_growthLeft = MaxLoad(m_groupCount) - m_size;
+		}
+
+		void Free()
+		{
+			delete[] m_groups;
+			::operator delete(m_slots, std::align_val_t(alignof(Slot)));
+			m_groups = nullptr;
+			m_slots = nullptr;
+			m_groupCount = 0;
+		}
+
+		Group*							m_groups;
+		Slot*							m_slots; // GroupSize to a group, constructed only where the control byte is full
+		size_t							m_groupCount; // A power of two
+		size_t							m_size;
+		size_t							m_tombstones; // Deleted slots, free for inserts but not an end to searches
+		size_t							m_growthLeft; // Inserts into empty slots before the table must grow
+	};
+
+}
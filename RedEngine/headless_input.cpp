@@ -0,0 +1,115 @@
+#include "red_engine.h"
+#include "headless_input.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace input
+{
+
+	HeadlessInputSource::HeadlessInputSource(InputEventQueue& queue) :
+		m_queue(queue),
+		m_stop(false),
+		m_finished(false)
+	{
+	}
+
+	HeadlessInputSource::~HeadlessInputSource()
+	{
+		Stop();
+	}
+
+	void HeadlessInputSource::Add(double seconds, InputEvent::Type type, uint32_t key)
+	{
+		ASSERT(!m_thread.joinable(), "Can't add input events while the script is playing.\n");
+		m_script.push_back(ScriptedEvent{ seconds, type, key });
+	}
+
+	bool HeadlessInputSource::Load(const char* path)
+	{
+		FILE* const file = fopen(path, "r");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to open input script %s.\n", path);
+			return false;
+		}
+
+		char line[256];
+		unsigned int lineNumber = 0;
+		bool ok = true;
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			++lineNumber;
+
+			double milliseconds;
+			char action[16];
+			unsigned int key;
+			const int fields = sscanf(line, " %lf %15s %u", &milliseconds, action, &key);
+
+			if (fields <= 0 || line[strspn(line, " \t")] == '#')
+				continue;
+
+			if (fields != 3 || (strcmp(action, "down") != 0 && strcmp(action, "up") != 0))
+			{
+				DEBUG_MESSAGE("%s(%u): expected \"<milliseconds> down|up <key>\".\n", path, lineNumber);
+				ok = false;
+				break;
+			}
+
+			Add(milliseconds * 0.001, strcmp(action, "down") == 0 ? InputEvent::KeyDown : InputEvent::KeyUp, key);
+		}
+
+		fclose(file);
+		return ok;
+	}
+
+	void HeadlessInputSource::Start()
+	{
+		ASSERT(!m_thread.joinable(), "Input script is already playing.\n");
+
+		std::stable_sort(m_script.begin(), m_script.end(),
+			[](const ScriptedEvent& a, const ScriptedEvent& b) { return a.seconds < b.seconds; });
+
+		m_stop.store(false);
+		m_finished.store(false);
+		m_thread = std::thread(&HeadlessInputSource::ProducerMain, this);
+	}
+
+	void HeadlessInputSource::Stop()
+	{
+		if (!m_thread.joinable())
+			return;
+
+		m_stop.store(true);
+		m_thread.join();
+	}
+
+	void HeadlessInputSource::ProducerMain()
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (const ScriptedEvent& scripted : m_script)
+		{
+			const std::chrono::steady_clock::time_point due = start +
+				std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(scripted.seconds));
+
+			// Short sleeps so Stop doesn't wait on a long gap in the script
+			while (!m_stop.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < due)
+				std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - std::chrono::steady_clock::now(), std::chrono::milliseconds(10)));
+
+			if (m_stop.load(std::memory_order_relaxed))
+				break;
+
+			InputEvent event = {};
+			event.timestamp = Now();
+			event.type = scripted.type;
+			event.key = scripted.key;
+			m_queue.Push(event);
+		}
+
+		m_finished.store(true, std::memory_order_release);
+	}
+
+} // namespace input
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "input_events.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace input
+{
+
+	// Stands in for the window's message pump where there isn't one. Plays a script of key events from its own
+	// thread at the times they were scripted for, so the queue sees the same producer/consumer split as the game.
+	class HeadlessInputSource
+	{
+	public:
+		explicit HeadlessInputSource(InputEventQueue& queue);
+		~HeadlessInputSource();
+
+		// Adds an event seconds after Start. Events may be added in any order, but not once started.
+		void							Add(double seconds, InputEvent::Type type, uint32_t key);
+
+		// Text script, one event per line: "<milliseconds> down|up <key>". Blank lines and # comments are skipped.
+		bool							Load(const char* path);
+
+		void							Start();
+		void							Stop();
+
+		bool							IsFinished() const
+		{
+			return m_finished.load(std::memory_order_acquire);
+		}
+
+		uint32_t						GetEventCount() const
+		{
+			return uint32_t(m_script.size());
+		}
+
+	private:
+		struct ScriptedEvent
+		{
+			double						seconds;
+			InputEvent::Type			type;
+			uint32_t					key;
+		};
+
+		void							ProducerMain();
+
+		InputEventQueue&				m_queue;
+		std::vector<ScriptedEvent>		m_script;
+		std::thread						m_thread;
+		std::atomic<bool>				m_stop;
+		std::atomic<bool>				m_finished;
+	};
+
+} // namespace input
@@ -0,0 +1,171 @@
+#include "red_engine.h"
+#include "init_graph.h"
+#include "job_system.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace utils
+{
+
+	namespace
+	{
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+	}
+
+	StartupTrace::StartupTrace()
+	{
+	}
+
+	void StartupTrace::Add(const char* name, double start, double end)
+	{
+		const std::thread::id id = std::this_thread::get_id();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		unsigned int thread = 0;
+		while (thread < m_threads.size() && m_threads[thread] != id)
+			++thread;
+		if (thread == m_threads.size())
+			m_threads.push_back(id);
+
+		m_spans.push_back(Span{ name, start, end, thread });
+	}
+
+	bool StartupTrace::WriteJson(const char* path, double origin) const
+	{
+		FILE* const file = fopen(path, "w");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write startup trace %s.\n", path);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Complete events in microseconds, the trace event format's unit
+		fprintf(file, "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [\n");
+		for (size_t i = 0; i < m_spans.size(); ++i)
+		{
+			const Span& span = m_spans[i];
+			fprintf(file, "\t\t{ \"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.1f, \"dur\": %.1f }%s\n",
+				span.name, span.thread, (span.start - origin) * 1e6, (span.end - span.start) * 1e6,
+				i + 1 < m_spans.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+
+		fclose(file);
+		return true;
+	}
+
+	InitGraph::InitGraph() :
+		m_trace(nullptr),
+		m_pending(0)
+	{
+	}
+
+	unsigned int InitGraph::AddStep(const char* name, Step step, std::initializer_list<unsigned int> dependencies, uint32_t flags)
+	{
+		const unsigned int index = unsigned(m_nodes.size());
+
+		Node node;
+		node.name = name;
+		node.step = std::move(step);
+		node.flags = flags;
+		node.dependencyCount = unsigned(dependencies.size());
+		node.waitingOn = 0;
+		node.time = 0.0;
+		m_nodes.push_back(std::move(node));
+
+		for (unsigned int dependency : dependencies)
+		{
+			ASSERT(dependency < index, "Init step %s depends on a step that hasn't been added.\n", name);
+			m_nodes[dependency].dependants.push_back(index);
+		}
+
+		return index;
+	}
+
+	void InitGraph::Run(StartupTrace* trace)
+	{
+		m_trace = trace;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_pending = unsigned(m_nodes.size());
+		for (Node& node : m_nodes)
+			node.waitingOn = node.dependencyCount;
+
+		for (unsigned int i = 0; i < m_nodes.size(); ++i)
+		{
+			if (m_nodes[i].dependencyCount == 0)
+				Release(i);
+		}
+
+		while (m_pending > 0)
+		{
+			if (m_mainReady.empty())
+			{
+				m_wake.wait(lock);
+				continue;
+			}
+
+			const unsigned int node = m_mainReady.back();
+			m_mainReady.pop_back();
+
+			lock.unlock();
+			Execute(node);
+			lock.lock();
+		}
+	}
+
+	double InitGraph::GetSerialTime() const
+	{
+		double total = 0.0;
+		for (const Node& node : m_nodes)
+			total += node.time;
+		return total;
+	}
+
+	void InitGraph::Release(unsigned int node)
+	{
+		JobSystem* const jobSystem = JobSystem::Get();
+		if ((m_nodes[node].flags & c_MainThread) != 0 || jobSystem == nullptr)
+		{
+			m_mainReady.push_back(node);
+			m_wake.notify_one();
+		}
+		else
+		{
+			jobSystem->Submit([this, node]() { Execute(node); });
+		}
+	}
+
+	void InitGraph::Execute(unsigned int node)
+	{
+		Node& current = m_nodes[node];
+
+		const double start = Seconds();
+		current.step();
+		const double end = Seconds();
+
+		current.time = end - start;
+		if (m_trace != nullptr)
+			m_trace->Add(current.name, start, end);
+
+		// Run waits on this lock, so nothing here outlives the graph
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (unsigned int dependant : current.dependants)
+		{
+			if (--m_nodes[dependant].waitingOn == 0)
+				Release(dependant);
+		}
+
+		if (--m_pending == 0)
+			m_wake.notify_one();
+	}
+
+} // namespace utils
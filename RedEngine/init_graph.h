@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+	// Named spans on whichever threads ran them, written out for chrome://tracing or Perfetto
+	class StartupTrace
+	{
+	public:
+		StartupTrace();
+
+		// Times are in seconds on the steady clock; the calling thread is the one the span is put on
+		void							Add(const char* name, double start, double end);
+
+		// Everything relative to origin, which is normally process start
+		bool							WriteJson(const char* path, double origin) const;
+
+	private:
+		struct Span
+		{
+			const char*					name; // Not owned, step names are literals
+			double						start;
+			double						end;
+			unsigned int				thread;
+		};
+
+		mutable std::mutex				m_mutex;
+		std::vector<Span>				m_spans;
+		std::vector<std::thread::id>	m_threads; // Index is the tid in the trace, in order of first span
+	};
+
+	// Startup work as steps with dependencies. Steps whose dependencies are done run at once, on the job system
+	// unless they have to be on the calling thread (anything using the immediate context or the window).
+	class InitGraph
+	{
+	public:
+		typedef std::function<void()> Step;
+
+		static const uint32_t			c_MainThread = 0x1;
+
+		InitGraph();
+
+		// Dependencies are indices returned by earlier AddSteps, so the graph can't have cycles
+		unsigned int					AddStep(const char* name, Step step, std::initializer_list<unsigned int> dependencies = {},
+											uint32_t flags = 0);
+
+		// Blocks until every step has run, running the main thread ones itself
+		void							Run(StartupTrace* trace = nullptr);
+
+		// What Run would have taken with the steps one after another, to compare against its wall time
+		double							GetSerialTime() const;
+
+	private:
+		struct Node
+		{
+			const char*					name;
+			Step						step;
+			uint32_t					flags;
+			std::vector<unsigned int>	dependants;
+			unsigned int				dependencyCount;
+			unsigned int				waitingOn; // Dependencies not yet done, under m_mutex
+			double						time;
+		};
+
+		void							Release(unsigned int node); // Call with m_mutex held
+		void							Execute(unsigned int node);
+
+		std::vector<Node>				m_nodes;
+		StartupTrace*					m_trace;
+
+		std::mutex						m_mutex;
+		std::condition_variable			m_wake; // The calling thread waits here for main thread steps or the end
+		std::vector<unsigned int>		m_mainReady;
+		unsigned int					m_pending;
+	};
+
+} // namespace utils
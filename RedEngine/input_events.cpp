@@ -0,0 +1,82 @@
+#include "red_engine.h"
+#include "input_events.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace input
+{
+
+	uint64_t Now()
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	InputEventQueue::InputEventQueue(uint32_t capacity) :
+		m_events(capacity),
+		m_dropped(0)
+	{
+	}
+
+	bool InputEventQueue::Push(const InputEvent& event)
+	{
+		if (!m_events.push(event))
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	bool InputEventQueue::Pop(InputEvent& event)
+	{
+		return m_events.pop(event);
+	}
+
+	InputLatency::InputLatency(uint32_t history) :
+		m_oldestPending(0),
+		m_samples(history > 0 ? history : 1, 0),
+		m_next(0),
+		m_count(0)
+	{
+	}
+
+	void InputLatency::OnConsumed(const InputEvent& event)
+	{
+		if (m_oldestPending == 0 || event.timestamp < m_oldestPending)
+			m_oldestPending = event.timestamp;
+	}
+
+	void InputLatency::OnPresented(uint64_t presentTime)
+	{
+		if (m_oldestPending == 0)
+			return;
+
+		m_samples[m_next] = presentTime > m_oldestPending ? presentTime - m_oldestPending : 0;
+		m_next = (m_next + 1) % uint32_t(m_samples.size());
+		m_count = std::min(m_count + 1, uint32_t(m_samples.size()));
+		m_oldestPending = 0;
+	}
+
+	InputLatency::Stats InputLatency::GetStats() const
+	{
+		Stats stats = {};
+		if (m_count == 0)
+			return stats;
+
+		std::vector<uint64_t> sorted(m_samples.begin(), m_samples.begin() + m_count);
+		std::sort(sorted.begin(), sorted.end());
+
+		uint64_t total = 0;
+		for (uint64_t sample : sorted)
+			total += sample;
+
+		stats.samples = m_count;
+		stats.average = double(total) / double(m_count) * 1e-9;
+		stats.p50 = double(sorted[m_count / 2]) * 1e-9;
+		stats.p99 = double(sorted[std::min(m_count - 1, m_count * 99 / 100)]) * 1e-9;
+		stats.max = double(sorted.back()) * 1e-9;
+		return stats;
+	}
+
+} // namespace input
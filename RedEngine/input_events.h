@@ -0,0 +1,89 @@
+#pragma once
+
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace input
+{
+
+	// Nanoseconds on the steady clock, the time base for everything in here
+	uint64_t Now();
+
+	struct InputEvent
+	{
+		enum Type : uint32_t
+		{
+			KeyDown,
+			KeyUp,
+		};
+
+		uint64_t						timestamp; // When the OS delivered it, from Now()
+		Type							type;
+		uint32_t						key; // Virtual key code
+		uint32_t						flags; // Platform bits passed through untouched, the lParam on Windows
+		uint32_t						reserved;
+	};
+
+	// Single producer, single consumer ring (a containers::SpscQueue). The OS event source pushes, the update tick
+	// pops. Neither side blocks; a full ring drops the new event and counts it.
+	class InputEventQueue
+	{
+	public:
+		// capacity is rounded up to a power of two
+		explicit InputEventQueue(uint32_t capacity = 1024);
+
+		// Producer side only
+		bool							Push(const InputEvent& event);
+
+		// Consumer side only
+		bool							Pop(InputEvent& event);
+
+		uint32_t						GetDropped() const
+		{
+			return m_dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		InputEventQueue(const InputEventQueue&) = delete;
+		InputEventQueue& operator=(const InputEventQueue&) = delete;
+
+		containers::SpscQueue<InputEvent> m_events;
+
+		alignas(64) std::atomic<uint32_t> m_dropped;
+	};
+
+	// How long input takes to reach the screen: the oldest event consumed in a frame against when that frame presents
+	class InputLatency
+	{
+	public:
+		struct Stats
+		{
+			uint32_t					samples;
+			double						average; // Seconds
+			double						p50;
+			double						p99;
+			double						max;
+		};
+
+		explicit InputLatency(uint32_t history = 256);
+
+		// Called for every event as the update tick consumes it
+		void							OnConsumed(const InputEvent& event);
+
+		// Called straight after Present, closes off the frame that consumed the events
+		void							OnPresented(uint64_t presentTime);
+
+		// Over the most recent frames that had input
+		Stats							GetStats() const;
+
+	private:
+		uint64_t						m_oldestPending; // Zero when nothing is waiting to be presented
+		std::vector<uint64_t>			m_samples; // Nanoseconds, a ring of the last history frames
+		uint32_t						m_next;
+		uint32_t						m_count;
+	};
+
+} // namespace input
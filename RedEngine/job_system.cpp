@@ -0,0 +1,151 @@
+#include "red_engine.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+namespace utils
+{
+
+	namespace
+	{
+		PerfCounter s_jobsSubmitted("jobs.submitted");
+	}
+
+	JobSystem* JobSystem::g_jobSystem = nullptr;
+
+	void JobSystem::Create(unsigned int workerCount)
+	{
+		ASSERT(g_jobSystem == nullptr, "The job system already exists.\n");
+
+		if (workerCount == 0)
+		{
+			const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		g_jobSystem = new JobSystem(workerCount);
+	}
+
+	void JobSystem::Destroy()
+	{
+		delete g_jobSystem;
+		g_jobSystem = nullptr;
+	}
+
+	JobSystem::JobSystem(unsigned int workerCount) :
+		m_queue(QueueCapacity),
+		m_sleepers(0),
+		m_quit(false)
+	{
+		m_workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; ++i)
+			m_workers.emplace_back(&JobSystem::WorkerMain, this);
+	}
+
+	JobSystem::~JobSystem()
+	{
+		// Under the lock, so no worker is between checking m_quit and going to sleep
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_quit.store(true);
+		}
+		m_wake.notify_all();
+
+		for (std::thread& worker : m_workers)
+			worker.join();
+
+		ASSERT(m_queue.empty(), "Job system destroyed with %u jobs still queued.\n", unsigned(m_queue.size()));
+	}
+
+	void JobSystem::Submit(Job job, JobCounter* counter)
+	{
+		s_jobsSubmitted.Add();
+
+		if (counter != nullptr)
+			counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		// A full queue means the workers are well behind, so help them rather than wait
+		Entry entry{ std::move(job), counter };
+		while (!m_queue.push(std::move(entry)))
+		{
+			if (!RunOne())
+				std::this_thread::yield();
+		}
+		WakeWorker();
+	}
+
+	void JobSystem::WakeWorker()
+	{
+		// Pairs with the fence in WorkerMain: either this sees the sleeper, or the sleeper sees the job
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_sleepers.load(std::memory_order_relaxed) == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+
+	void JobSystem::Wait(JobCounter& counter)
+	{
+		while (!counter.IsDone())
+		{
+			// Help out rather than block, the jobs we're waiting on may still be queued
+			if (!RunOne())
+				std::this_thread::yield();
+		}
+	}
+
+	void JobSystem::ParallelFor(unsigned int count, unsigned int batchSize, const RangeJob& job)
+	{
+		if (count == 0)
+			return;
+
+		if (batchSize == 0)
+			batchSize = 1;
+
+		JobCounter counter;
+
+		// The calling thread takes the first batch itself
+		for (unsigned int begin = batchSize; begin < count; begin += batchSize)
+		{
+			const unsigned int end = begin + batchSize < count ? begin + batchSize : count;
+			Submit([&job, begin, end]() { job(begin, end); }, &counter);
+		}
+
+		job(0, batchSize < count ? batchSize : count);
+		Wait(counter);
+	}
+
+	bool JobSystem::RunOne()
+	{
+		Entry entry;
+		if (!m_queue.pop(entry))
+			return false;
+
+		entry.job();
+
+		if (entry.counter != nullptr)
+			entry.counter->m_pending.fetch_sub(1, std::memory_order_release);
+
+		return true;
+	}
+
+	void JobSystem::WorkerMain()
+	{
+		for (;;)
+		{
+			if (RunOne())
+				continue;
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_sleepers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_wake.wait(lock, [this]() { return m_quit.load() || !m_queue.empty(); });
+			m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+			// Only once everything queued has run
+			if (m_quit.load() && m_queue.empty())
+				return;
+		}
+	}
+
+} // namespace utils
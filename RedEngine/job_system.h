@@ -0,0 +1,91 @@
+#pragma once
+
+#include "mpmc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+	// Tracks a group of jobs so the submitter can wait for all of them
+	class JobCounter
+	{
+	public:
+		JobCounter() : m_pending(0) {}
+
+		bool							IsDone() const
+		{
+			return m_pending.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<unsigned int>		m_pending;
+	};
+
+	// A fixed pool of worker threads pulling from a shared lock-free queue. Workers with nothing to do sleep on a
+	// condition variable, which submitters only touch when someone is asleep.
+	class JobSystem
+	{
+	public:
+		typedef std::function<void()> Job;
+		typedef std::function<void(unsigned int begin, unsigned int end)> RangeJob;
+
+		// workerCount of 0 uses one worker per hardware thread, less one for the main thread
+		static void						Create(unsigned int workerCount = 0);
+		static void						Destroy();
+
+		static JobSystem*				Get()
+		{
+			return g_jobSystem;
+		}
+
+		void							Submit(Job job, JobCounter* counter = nullptr);
+
+		// Runs other jobs on the calling thread until the counter drains
+		void							Wait(JobCounter& counter);
+
+		// Splits [0, count) into batches of batchSize and blocks until all have run
+		void							ParallelFor(unsigned int count, unsigned int batchSize, const RangeJob& job);
+
+		unsigned int					GetWorkerCount() const
+		{
+			return unsigned(m_workers.size());
+		}
+
+	private:
+		JobSystem(unsigned int workerCount);
+		~JobSystem();
+
+		bool							RunOne(); // Runs a queued job if there is one
+		void							WorkerMain();
+		void							WakeWorker(); // After a push, if any are asleep
+
+		// Jobs waiting at once before Submit starts running them itself
+		static const size_t				QueueCapacity = 4096;
+
+		struct Entry
+		{
+			Job							job;
+			JobCounter*					counter;
+		};
+
+		static JobSystem*				g_jobSystem;
+
+		std::vector<std::thread>		m_workers;
+
+		containers::MpmcQueue<Entry>	m_queue;
+
+		std::mutex						m_sleepMutex; // Only for sleeping and waking
+		std::condition_variable			m_wake;
+		std::atomic<unsigned int>		m_sleepers;
+		std::atomic<bool>				m_quit;
+	};
+
+} // namespace utils
@@ -0,0 +1,406 @@
+#include "red_engine.h"
+#include "light_clusters.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace scene
+{
+
+	namespace
+	{
+		// Lights per transform job, in blocks of four
+		const unsigned int c_TransformBatch = 256;
+
+		utils::PerfCounter s_lights("light.lights");
+		utils::PerfCounter s_indices("light.cluster_indices");
+		utils::PerfCounter s_dropped("light.dropped");
+		utils::PerfCounter s_unbinned("light.unbinned");
+
+		// Lanes of a block past the last light sit infinitely far behind the camera with no radius
+		const float c_DeadZ = -FLT_MAX;
+
+		// Index of the lowest set bit, value must not be 0
+		uint32_t LowestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(__builtin_ctz(value));
+#endif
+		}
+
+		// Mask of the four lights in block whose spheres touch box
+		__m128 SpheresTouchBox(const float* block, const LightClusters::Box& box)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 x = _mm_loadu_ps(block);
+			const __m128 y = _mm_loadu_ps(block + 4);
+			const __m128 z = _mm_loadu_ps(block + 8);
+			const __m128 r = _mm_loadu_ps(block + 12);
+
+			// Distance from the centre to the nearest point of the box along each axis, 0 inside it
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min[0]), x), _mm_sub_ps(x, _mm_set1_ps(box.max[0]))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min[1]), y), _mm_sub_ps(y, _mm_set1_ps(box.max[1]))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min[2]), z), _mm_sub_ps(z, _mm_set1_ps(box.max[2]))), zero);
+			const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			return _mm_cmple_ps(distanceSquared, _mm_mul_ps(r, r));
+		}
+
+		// Appends one lane of block to blocks, which holds count lights so far
+		void AppendLane(const float* block, uint32_t lane, uint16_t light, std::vector<float>& blocks, std::vector<uint16_t>& blockLights,
+			uint32_t& count)
+		{
+			if ((count & 3) == 0)
+			{
+				blocks.resize(blocks.size() + 16);
+				blockLights.resize(blockLights.size() + 4);
+			}
+
+			float* const to = &blocks[size_t(count >> 2) * 16 + (count & 3)];
+			to[0] = block[lane];
+			to[4] = block[lane + 4];
+			to[8] = block[lane + 8];
+			to[12] = block[lane + 12];
+			blockLights[count] = light;
+			++count;
+		}
+
+		// And every lane set in mask
+		void AppendLanes(const float* block, const uint16_t* lights, int mask, std::vector<float>& blocks, std::vector<uint16_t>& blockLights,
+			uint32_t& count)
+		{
+			while (mask != 0)
+			{
+				const uint32_t lane = LowestBit(uint32_t(mask));
+				mask &= mask - 1;
+				AppendLane(block, lane, lights[lane], blocks, blockLights, count);
+			}
+		}
+
+		// Fills the rest of the last block with lights that touch nothing
+		void PadBlocks(std::vector<float>& blocks, std::vector<uint16_t>& blockLights, uint32_t count)
+		{
+			for (uint32_t lane = count & 3; lane != 0 && lane < 4; ++lane)
+			{
+				float* const to = &blocks[size_t(count >> 2) * 16 + lane];
+				to[0] = 0.0f;
+				to[4] = 0.0f;
+				to[8] = c_DeadZ;
+				to[12] = 0.0f;
+				blockLights[(count & ~3u) + lane] = 0;
+			}
+		}
+	}
+
+	LightClusters::LightClusters(uint32_t maxLights, uint32_t tilesX, uint32_t tilesY, uint32_t slices, float firstSliceDepth,
+		uint32_t maxIndices) :
+		m_maxLights(maxLights),
+		m_tilesX(tilesX),
+		m_tilesY(tilesY),
+		m_slices(slices),
+		m_firstSliceDepth(firstSliceDepth),
+		m_maxIndices(maxIndices),
+		m_view{},
+		m_projection{},
+		m_nearZ(0.0f),
+		m_farZ(0.0f),
+		m_sliceScale(0.0f),
+		m_sliceBias(0.0f),
+		m_unbinnedLights(0),
+		m_scratch(slices),
+		m_clusters(size_t(tilesX) * tilesY * slices),
+		m_stats{}
+	{
+		ASSERT(tilesX > 0 && tilesY > 0 && slices > 0, "A %ux%ux%u cluster grid has nothing in it.\n", tilesX, tilesY, slices);
+		ASSERT(maxLights <= MaxLights, "%u lights is more than the 16 bit light indices can reach.\n", maxLights);
+	}
+
+	void LightClusters::SetLights(const Light* lights, uint32_t count)
+	{
+		const uint32_t kept = std::min(count, m_maxLights);
+		m_lights.assign(lights, lights + kept);
+		m_unbinnedLights = count - kept;
+	}
+
+	void LightClusters::BeginFrame(const float view[16], const float projection[16])
+	{
+		memcpy(m_view, view, sizeof(m_view));
+		if (memcmp(m_projection, projection, sizeof(m_projection)) == 0)
+			return;
+
+		memcpy(m_projection, projection, sizeof(m_projection));
+		BuildBounds();
+	}
+
+	void LightClusters::BuildBounds()
+	{
+		// Perspective only: w is view z
+		ASSERT(m_projection[11] == 1.0f && m_projection[15] == 0.0f, "Light clusters need a left-handed perspective projection.\n");
+
+		m_nearZ = -m_projection[14] / m_projection[10];
+		m_farZ = m_projection[14] / (1.0f - m_projection[10]);
+
+		m_sliceDepths.resize(m_slices + 1);
+		m_sliceDepths[0] = m_nearZ;
+		m_sliceDepths[m_slices] = m_farZ;
+		if (m_slices > 1)
+		{
+			const float first = std::min(std::max(m_firstSliceDepth, m_nearZ), m_farZ);
+			for (uint32_t slice = 1; slice < m_slices; ++slice)
+				m_sliceDepths[slice] = first * powf(m_farZ / first, float(slice - 1) / float(m_slices - 1));
+
+			// Slice 1 starts at the first slice depth, anything nearer comes out below 1 and lands in slice 0
+			m_sliceScale = float(m_slices - 1) / logf(m_farZ / first);
+			m_sliceBias = 1.0f - logf(first) * m_sliceScale;
+		}
+
+		// ndc = (view * p[0] + viewZ * p[8]) / viewZ, so view = viewZ * (ndc - p[8]) / p[0], likewise for y
+		m_bounds.resize(m_clusters.size());
+		m_rowBounds.resize(size_t(m_slices) * m_tilesY);
+		m_sliceBounds.resize(m_slices);
+		for (uint32_t slice = 0; slice < m_slices; ++slice)
+		{
+			const float depths[2] = { m_sliceDepths[slice], m_sliceDepths[slice + 1] };
+			Box& sliceBox = m_sliceBounds[slice];
+			sliceBox = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+			for (uint32_t y = 0; y < m_tilesY; ++y)
+			{
+				const float ndcY[2] = { 1.0f - 2.0f * float(y) / float(m_tilesY), 1.0f - 2.0f * float(y + 1) / float(m_tilesY) };
+
+				Box& row = m_rowBounds[slice * m_tilesY + y];
+				row = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+				for (uint32_t x = 0; x < m_tilesX; ++x)
+				{
+					const float ndcX[2] = { -1.0f + 2.0f * float(x) / float(m_tilesX), -1.0f + 2.0f * float(x + 1) / float(m_tilesX) };
+
+					Box& box = m_bounds[GetClusterIndex(x, y, slice)];
+					box = { { FLT_MAX, FLT_MAX, depths[0] }, { -FLT_MAX, -FLT_MAX, depths[1] } };
+					for (int corner = 0; corner < 8; ++corner)
+					{
+						const float z = depths[(corner >> 2) & 1];
+						const float px = z * (ndcX[corner & 1] - m_projection[8]) / m_projection[0];
+						const float py = z * (ndcY[(corner >> 1) & 1] - m_projection[9]) / m_projection[5];
+						box.min[0] = std::min(box.min[0], px);
+						box.max[0] = std::max(box.max[0], px);
+						box.min[1] = std::min(box.min[1], py);
+						box.max[1] = std::max(box.max[1], py);
+					}
+
+					for (int k = 0; k < 3; ++k)
+					{
+						row.min[k] = std::min(row.min[k], box.min[k]);
+						row.max[k] = std::max(row.max[k], box.max[k]);
+					}
+				}
+
+				for (int k = 0; k < 3; ++k)
+				{
+					sliceBox.min[k] = std::min(sliceBox.min[k], row.min[k]);
+					sliceBox.max[k] = std::max(sliceBox.max[k], row.max[k]);
+				}
+			}
+		}
+	}
+
+	void LightClusters::Build()
+	{
+		ASSERT(!m_bounds.empty(), "Building light clusters before BeginFrame.\n");
+
+		const uint32_t lightCount = uint32_t(m_lights.size());
+		const uint32_t blockCount = (lightCount + 3) / 4;
+		m_viewLights.resize(size_t(blockCount) * 16);
+		m_gpuLights.resize(lightCount);
+
+		// Into view space four at a time, and the shader's copy while they are to hand
+		auto transform = [this, lightCount](unsigned int begin, unsigned int end)
+			{
+				const float* const v = m_view;
+				for (unsigned int block = begin; block < end; ++block)
+				{
+					float px[4] = {}, py[4] = {}, pz[4] = {}, radius[4] = {};
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						const uint32_t index = block * 4 + lane;
+						if (index < lightCount)
+						{
+							const Light& light = m_lights[index];
+							px[lane] = light.position[0];
+							py[lane] = light.position[1];
+							pz[lane] = light.position[2];
+							radius[lane] = light.radius;
+						}
+					}
+
+					const __m128 x = _mm_loadu_ps(px), y = _mm_loadu_ps(py), z = _mm_loadu_ps(pz);
+					float* const to = &m_viewLights[size_t(block) * 16];
+					for (int k = 0; k < 3; ++k)
+					{
+						const __m128 row = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(v[0 * 4 + k])), _mm_mul_ps(y, _mm_set1_ps(v[1 * 4 + k]))),
+							_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(v[2 * 4 + k])), _mm_set1_ps(v[3 * 4 + k])));
+						_mm_storeu_ps(to + k * 4, row);
+					}
+					_mm_storeu_ps(to + 12, _mm_loadu_ps(radius));
+
+					for (uint32_t lane = 0; lane < 4; ++lane)
+					{
+						const uint32_t index = block * 4 + lane;
+						if (index >= lightCount)
+						{
+							to[8 + lane] = c_DeadZ;
+							to[12 + lane] = 0.0f;
+							continue;
+						}
+
+						const Light& light = m_lights[index];
+						GpuLight& gpu = m_gpuLights[index];
+						gpu.positionRadius[0] = to[lane];
+						gpu.positionRadius[1] = to[4 + lane];
+						gpu.positionRadius[2] = to[8 + lane];
+						gpu.positionRadius[3] = light.radius;
+						gpu.colorInverseRadiusSquared[0] = light.color[0] * light.intensity;
+						gpu.colorInverseRadiusSquared[1] = light.color[1] * light.intensity;
+						gpu.colorInverseRadiusSquared[2] = light.color[2] * light.intensity;
+						gpu.colorInverseRadiusSquared[3] = light.radius > 0.0f ? 1.0f / (light.radius * light.radius) : 0.0f;
+					}
+				}
+			};
+
+		// Each slice only writes its own clusters and scratch
+		auto bin = [this](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int slice = begin; slice < end; ++slice)
+					BinSlice(slice);
+			};
+
+		if (utils::JobSystem::Get() != nullptr)
+		{
+			utils::JobSystem::Get()->ParallelFor(blockCount, c_TransformBatch, transform);
+			utils::JobSystem::Get()->ParallelFor(m_slices, 1, bin);
+		}
+		else
+		{
+			transform(0, blockCount);
+			bin(0, m_slices);
+		}
+
+		// One list for the upload, the slices in order. Past maxIndices the clusters keep what fits.
+		m_stats = {};
+		m_stats.lights = lightCount;
+		m_stats.unbinned = m_unbinnedLights;
+
+		uint32_t total = 0;
+		for (const SliceScratch& scratch : m_scratch)
+			total += uint32_t(scratch.indices.size());
+		m_indices.resize(std::min(total, m_maxIndices));
+
+		const uint32_t clustersPerSlice = m_tilesX * m_tilesY;
+		uint32_t base = 0;
+		for (uint32_t slice = 0; slice < m_slices; ++slice)
+		{
+			const std::vector<uint16_t>& indices = m_scratch[slice].indices;
+			const uint32_t room = m_maxIndices - std::min(base, m_maxIndices);
+			const uint32_t kept = std::min(uint32_t(indices.size()), room);
+			if (kept > 0)
+				memcpy(&m_indices[base], indices.data(), kept * sizeof(uint16_t));
+
+			Cluster* const clusters = &m_clusters[size_t(slice) * clustersPerSlice];
+			for (uint32_t i = 0; i < clustersPerSlice; ++i)
+			{
+				Cluster& cluster = clusters[i];
+				const uint32_t fits = cluster.offset < kept ? std::min(cluster.count, kept - cluster.offset) : 0;
+				m_stats.dropped += cluster.count - fits;
+				cluster.offset += base;
+				cluster.count = fits;
+
+				m_stats.occupiedClusters += fits > 0;
+				m_stats.maxPerCluster = std::max(m_stats.maxPerCluster, fits);
+			}
+
+			base += uint32_t(indices.size());
+		}
+		m_stats.indices = uint32_t(m_indices.size());
+
+		s_lights.Add(lightCount);
+		s_indices.Add(m_stats.indices);
+		s_dropped.Add(m_stats.dropped);
+		s_unbinned.Add(m_stats.unbinned);
+	}
+
+	void LightClusters::BinSlice(uint32_t slice)
+	{
+		SliceScratch& scratch = m_scratch[slice];
+		scratch.candidates.clear();
+		scratch.candidateLights.clear();
+		scratch.indices.clear();
+
+		// Lights reaching into the slice at all
+		const Box& sliceBox = m_sliceBounds[slice];
+		const uint32_t blockCount = uint32_t(m_viewLights.size() / 16);
+		uint32_t candidateCount = 0;
+		for (uint32_t block = 0; block < blockCount; ++block)
+		{
+			const float* const lights = &m_viewLights[size_t(block) * 16];
+			const int mask = _mm_movemask_ps(SpheresTouchBox(lights, sliceBox));
+			if (mask == 0)
+				continue;
+
+			const uint16_t indices[4] = { uint16_t(block * 4), uint16_t(block * 4 + 1), uint16_t(block * 4 + 2), uint16_t(block * 4 + 3) };
+			AppendLanes(lights, indices, mask, scratch.candidates, scratch.candidateLights, candidateCount);
+		}
+		PadBlocks(scratch.candidates, scratch.candidateLights, candidateCount);
+
+		Cluster* const clusters = &m_clusters[size_t(slice) * m_tilesX * m_tilesY];
+		const uint32_t candidateBlocks = (candidateCount + 3) / 4;
+		for (uint32_t y = 0; y < m_tilesY; ++y)
+		{
+			// Then those touching the row, so each cluster only looks at lights that can reach it
+			scratch.rowCandidates.clear();
+			scratch.rowCandidateLights.clear();
+			uint32_t rowCount = 0;
+			const Box& row = m_rowBounds[slice * m_tilesY + y];
+			for (uint32_t block = 0; block < candidateBlocks; ++block)
+			{
+				const float* const lights = &scratch.candidates[size_t(block) * 16];
+				const int mask = _mm_movemask_ps(SpheresTouchBox(lights, row));
+				if (mask != 0)
+					AppendLanes(lights, &scratch.candidateLights[block * 4], mask, scratch.rowCandidates, scratch.rowCandidateLights, rowCount);
+			}
+			PadBlocks(scratch.rowCandidates, scratch.rowCandidateLights, rowCount);
+
+			const uint32_t rowBlocks = (rowCount + 3) / 4;
+			for (uint32_t x = 0; x < m_tilesX; ++x)
+			{
+				Cluster& cluster = clusters[y * m_tilesX + x];
+				cluster.offset = uint32_t(scratch.indices.size());
+
+				const Box& box = m_bounds[GetClusterIndex(x, y, slice)];
+				for (uint32_t block = 0; block < rowBlocks; ++block)
+				{
+					int mask = _mm_movemask_ps(SpheresTouchBox(&scratch.rowCandidates[size_t(block) * 16], box));
+					while (mask != 0)
+					{
+						const uint32_t lane = LowestBit(uint32_t(mask));
+						mask &= mask - 1;
+						scratch.indices.push_back(scratch.rowCandidateLights[block * 4 + lane]);
+					}
+				}
+
+				cluster.count = uint32_t(scratch.indices.size()) - cluster.offset;
+			}
+		}
+	}
+
+} // namespace scene
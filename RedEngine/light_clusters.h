@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+
+	// Clustered light culling. The view frustum is split into a grid of screen tiles by depth slices, and each
+	// frame every point light is binned into the clusters its sphere touches, so a pixel only loops over the lights
+	// in its own cluster. Slice 0 runs from the near plane to the first slice depth, the rest are spaced
+	// exponentially out to the far plane. Binning tests four lights at a time with SSE, one job per slice.
+	// Matrices are row-major with row vectors (p' = p * M), the same convention as DirectXMath.
+	class LightClusters
+	{
+	public:
+		// World space
+		struct Light
+		{
+			float						position[3];
+			float						radius;
+			float						color[3];
+			float						intensity;
+		};
+
+		// What the shader reads: view space position and radius, then colour times intensity and 1 / radius^2
+		struct GpuLight
+		{
+			float						positionRadius[4];
+			float						colorInverseRadiusSquared[4];
+		};
+
+		struct Cluster
+		{
+			uint32_t					offset; // Into GetLightIndices
+			uint32_t					count;
+		};
+
+		struct Box
+		{
+			float						min[3];
+			float						max[3];
+		};
+
+		struct Stats
+		{
+			uint32_t					lights;
+			uint32_t					indices;
+			uint32_t					occupiedClusters;
+			uint32_t					maxPerCluster;
+			uint32_t					dropped; // Over maxIndices, left out of their clusters
+			uint32_t					unbinned; // Lights set past maxLights, left out of every cluster
+		};
+
+		// Indices are 16 bit to halve the upload
+		static const uint32_t			MaxLights = 0xffff;
+
+		// maxLights is what the GPU light buffer holds, so no index reaches past it
+		explicit LightClusters(uint32_t maxLights = MaxLights, uint32_t tilesX = 16, uint32_t tilesY = 9, uint32_t slices = 24,
+			float firstSliceDepth = 0.5f, uint32_t maxIndices = 512 * 1024);
+
+		// Copied, and kept until the next call; Build bins whatever was set last. Lights past maxLights are left out.
+		void							SetLights(const Light* lights, uint32_t count);
+
+		// The cluster bounds are rebuilt only when the projection changes
+		void							BeginFrame(const float view[16], const float projection[16]);
+
+		// Transforms the lights to view space and bins them across the job system
+		void							Build();
+
+		uint32_t						GetMaxLights() const
+		{
+			return m_maxLights;
+		}
+
+		uint32_t						GetMaxIndices() const
+		{
+			return m_maxIndices;
+		}
+
+		uint32_t						GetTilesX() const
+		{
+			return m_tilesX;
+		}
+
+		uint32_t						GetTilesY() const
+		{
+			return m_tilesY;
+		}
+
+		uint32_t						GetSlices() const
+		{
+			return m_slices;
+		}
+
+		// Tile x across, tile y down the screen, slice away from the camera
+		uint32_t						GetClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const
+		{
+			return (slice * m_tilesY + y) * m_tilesX + x;
+		}
+
+		// The shader's slice is floor(log(viewZ) * scale + bias), clamped at 0
+		void							GetSliceScaleBias(float& scale, float& bias) const
+		{
+			scale = m_sliceScale;
+			bias = m_sliceBias;
+		}
+
+		const std::vector<Cluster>&		GetClusters() const
+		{
+			return m_clusters;
+		}
+
+		// View space, conservative
+		const std::vector<Box>&			GetClusterBounds() const
+		{
+			return m_bounds;
+		}
+
+		const std::vector<uint16_t>&	GetLightIndices() const
+		{
+			return m_indices;
+		}
+
+		// One per light set, in the same order
+		const std::vector<GpuLight>&	GetGpuLights() const
+		{
+			return m_gpuLights;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		// Each slice's job works in its own, so nothing is shared while binning
+		struct SliceScratch
+		{
+			std::vector<float>			candidates; // x, y, z, radius in blocks of four lights
+			std::vector<uint16_t>		candidateLights;
+			std::vector<float>			rowCandidates;
+			std::vector<uint16_t>		rowCandidateLights;
+			std::vector<uint16_t>		indices;
+		};
+
+		void							BuildBounds();
+		void							BinSlice(uint32_t slice);
+
+		uint32_t						m_maxLights;
+		uint32_t						m_tilesX;
+		uint32_t						m_tilesY;
+		uint32_t						m_slices;
+		float							m_firstSliceDepth;
+		uint32_t						m_maxIndices;
+
+		float							m_view[16];
+		float							m_projection[16];
+		float							m_nearZ;
+		float							m_farZ;
+		float							m_sliceScale;
+		float							m_sliceBias;
+
+		std::vector<Light>				m_lights;
+		uint32_t						m_unbinnedLights; // Set past m_maxLights
+		std::vector<float>				m_viewLights; // x, y, z, radius in blocks of four, padded with lights that touch nothing
+		std::vector<GpuLight>			m_gpuLights;
+
+		std::vector<float>				m_sliceDepths; // slices + 1 boundaries
+		std::vector<Box>				m_bounds;
+		std::vector<Box>				m_rowBounds; // Each row of tiles in each slice
+		std::vector<Box>				m_sliceBounds;
+		std::vector<SliceScratch>		m_scratch;
+
+		std::vector<Cluster>			m_clusters;
+		std::vector<uint16_t>			m_indices;
+
+		Stats							m_stats;
+	};
+
+} // namespace scene
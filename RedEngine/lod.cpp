@@ -0,0 +1,73 @@
+#include "red_engine.h"
+#include "lod.h"
+#include "view.h"
+
+using namespace DirectX;
+
+namespace DX
+{
+
+	LodSelector::LodSelector() :
+		m_cameraPosition{},
+		m_projectionScale(1.0f),
+		m_pixelThreshold(1.0f),
+		m_hysteresis(0.25f),
+		m_stats{}
+	{
+	}
+
+	void LodSelector::BeginFrame(const View& view, float viewportHeight)
+	{
+		const XMFLOAT3 cameraPosition = view.GetCameraPosition();
+		m_cameraPosition[0] = cameraPosition.x;
+		m_cameraPosition[1] = cameraPosition.y;
+		m_cameraPosition[2] = cameraPosition.z;
+
+		// _22 is cot(fovY / 2), so this converts a world space length at distance d into pixels when divided by d
+		m_projectionScale = view.GetProjectionMatrix()._22 * viewportHeight * 0.5f;
+
+		m_stats = {};
+	}
+
+	uint32_t LodSelector::Select(const assets::MeshLod* lods, uint32_t lodCount, const float center[3], float radius, uint32_t previousLod)
+	{
+		ASSERT(lodCount > 0 && lodCount <= assets::MeshMaxLods, "Invalid LOD count %u.\n", lodCount);
+
+		const float dx = center[0] - m_cameraPosition[0];
+		const float dy = center[1] - m_cameraPosition[1];
+		const float dz = center[2] - m_cameraPosition[2];
+
+		// Measure from the nearest point of the bounds, inside them always use the full mesh
+		const float distance = sqrtf(dx * dx + dy * dy + dz * dz) - radius;
+
+		uint32_t lod = 0;
+		if (distance > 0.0f)
+		{
+			// Errors grow with each level, so find the coarsest level under the threshold, and the coarsest under
+			// the tighter switching threshold. Anything between the two keeps whatever it had last frame.
+			const float pixelsPerUnit = m_projectionScale / distance;
+			const float switchThreshold = m_pixelThreshold * (1.0f - m_hysteresis);
+
+			uint32_t allowed = 0;
+			uint32_t settled = 0;
+			for (uint32_t i = 1; i < lodCount; ++i)
+			{
+				const float projectedError = lods[i].error * pixelsPerUnit;
+				if (projectedError <= m_pixelThreshold)
+					allowed = i;
+				if (projectedError <= switchThreshold)
+					settled = i;
+			}
+
+			lod = previousLod < settled ? settled : (previousLod > allowed ? allowed : previousLod);
+		}
+
+		++m_stats.objects;
+		m_stats.trianglesFull += lods[0].indexCount / 3;
+		m_stats.trianglesDrawn += lods[lod].indexCount / 3;
+		++m_stats.lodHistogram[lod];
+
+		return lod;
+	}
+
+} // namespace DX
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mesh_format.h"
+
+namespace DX
+{
+
+	class View;
+
+	// Picks a level of detail per object from how large its simplification error would be on screen
+	class LodSelector
+	{
+	public:
+		struct Stats
+		{
+			uint32_t					objects;
+			uint64_t					trianglesFull; // What drawing everything at LOD 0 would have cost
+			uint64_t					trianglesDrawn;
+			uint32_t					lodHistogram[assets::MeshMaxLods];
+		};
+
+		LodSelector();
+
+		// Largest error, in pixels, a level may show before a finer one is used
+		void							SetPixelThreshold(float pixels)
+		{
+			m_pixelThreshold = pixels;
+		}
+
+		// Fraction below the threshold a coarser level must reach before we switch to it, to stop popping back and forth
+		void							SetHysteresis(float fraction)
+		{
+			m_hysteresis = fraction;
+		}
+
+		// Caches the camera and projection for this frame's selections and resets the stats
+		void							BeginFrame(const View& view, float viewportHeight);
+
+		// center is the object's bounding sphere centre in world space. previousLod is what it used last frame.
+		uint32_t						Select(const assets::MeshLod* lods, uint32_t lodCount, const float center[3], float radius, uint32_t previousLod);
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		float							m_cameraPosition[3];
+		float							m_projectionScale; // Pixels per world unit at distance 1
+		float							m_pixelThreshold;
+		float							m_hysteresis;
+
+		Stats							m_stats;
+	};
+
+} // namespace DX
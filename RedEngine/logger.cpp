@@ -0,0 +1,257 @@
+#include "red_engine.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+
+namespace utils
+{
+
+	// Which logger's buffer this thread has, and flags it for freeing when the thread exits
+	struct Logger::ThreadSlot
+	{
+		uint32_t						generation = 0;
+		ThreadBuffer*					buffer = nullptr;
+
+		~ThreadSlot()
+		{
+			// A buffer from a logger that has since been destroyed is already gone
+			if (buffer != nullptr && Get() != nullptr && generation == g_generation.load())
+				buffer->abandoned.store(true, std::memory_order_release);
+		}
+	};
+
+	std::atomic<Logger*> Logger::g_logger(nullptr);
+	std::atomic<uint32_t> Logger::g_generation(0);
+	thread_local Logger::ThreadSlot Logger::t_slot;
+
+	uint64_t LogTimestamp()
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void Logger::Create(const char* path, uint32_t bufferBytes, bool echo)
+	{
+		ASSERT(Get() == nullptr, "The logger already exists.\n");
+		g_logger.store(new Logger(path, bufferBytes, echo), std::memory_order_release);
+	}
+
+	void Logger::Destroy()
+	{
+		// Anything logged from here on is written straight away
+		Logger* const logger = g_logger.exchange(nullptr);
+		delete logger;
+	}
+
+	Logger::Logger(const char* path, uint32_t bufferBytes, bool echo) :
+		m_file(nullptr),
+		m_echo(echo || path == nullptr),
+		m_bufferBytes(64),
+		m_generation(++g_generation),
+		m_startTime(LogTimestamp()),
+		m_nextThreadIndex(0),
+		m_quit(false),
+		m_passes(0),
+		m_dropped(0)
+	{
+		while (m_bufferBytes < bufferBytes)
+			m_bufferBytes <<= 1;
+
+		if (path != nullptr)
+		{
+			m_file = fopen(path, "w");
+			if (m_file == nullptr)
+			{
+				char text[MaxLineLength];
+				Printf(text, sizeof(text), "Unable to open log file %s.\n", path);
+				WriteNow(text);
+			}
+		}
+
+		m_thread = std::thread(&Logger::ThreadMain, this);
+	}
+
+	Logger::~Logger()
+	{
+		m_quit.store(true);
+		m_thread.join();
+
+		for (ThreadBuffer* buffer : m_buffers)
+		{
+			delete[] buffer->data;
+			delete buffer;
+		}
+
+		if (m_file != nullptr)
+			fclose(m_file);
+	}
+
+	void Logger::Flush()
+	{
+		// The pass running now may have missed our records, the one after it can't have
+		const uint64_t target = m_passes.load() + 2;
+		while (m_passes.load() < target)
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	int Logger::Printf(char* output, size_t size, const char* format, ...)
+	{
+		va_list args;
+		va_start(args, format);
+		const int length = vsnprintf(output, size, format, args);
+		va_end(args);
+		return length;
+	}
+
+	void Logger::WriteNow(const char* text)
+	{
+#if defined(_WIN32)
+		OutputDebugStringA(text);
+#else
+		fputs(text, stderr);
+#endif
+	}
+
+	Logger::ThreadBuffer* Logger::GetThreadBuffer()
+	{
+		if (t_slot.generation == m_generation)
+			return t_slot.buffer;
+
+		ThreadBuffer* const buffer = new ThreadBuffer();
+		buffer->data = new uint8_t[m_bufferBytes];
+		buffer->capacity = m_bufferBytes;
+		buffer->abandoned = false;
+		buffer->head = 0;
+		buffer->tail = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(m_buffersMutex);
+			buffer->threadIndex = m_nextThreadIndex++;
+			m_buffers.push_back(buffer);
+		}
+
+		t_slot.generation = m_generation;
+		t_slot.buffer = buffer;
+		return buffer;
+	}
+
+	uint8_t* Logger::Reserve(ThreadBuffer& buffer, uint32_t size)
+	{
+		uint64_t head = buffer.head.load(std::memory_order_relaxed);
+		const uint64_t tail = buffer.tail.load(std::memory_order_acquire);
+
+		// Records never wrap, so one that won't fit before the end leaves filler and starts again at the front
+		const uint32_t position = uint32_t(head & (buffer.capacity - 1));
+		const uint32_t contiguous = buffer.capacity - position;
+		const uint32_t needed = size <= contiguous ? size : contiguous + size;
+
+		if (size > buffer.capacity / 2 || head - tail + needed > buffer.capacity)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		if (size > contiguous)
+		{
+			RecordHeader* const filler = reinterpret_cast<RecordHeader*>(buffer.data + position);
+			filler->size = contiguous;
+			filler->padding = 1;
+			head += contiguous;
+			buffer.head.store(head, std::memory_order_release);
+		}
+
+		return buffer.data + (head & (buffer.capacity - 1));
+	}
+
+	void Logger::Commit(ThreadBuffer& buffer, uint32_t size)
+	{
+		buffer.head.store(buffer.head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+	}
+
+	void Logger::ThreadMain()
+	{
+		while (!m_quit.load())
+		{
+			if (Drain() == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		Drain();
+	}
+
+	size_t Logger::Drain()
+	{
+		std::vector<ThreadBuffer*> buffers;
+		{
+			std::lock_guard<std::mutex> lock(m_buffersMutex);
+			buffers = m_buffers;
+		}
+
+		m_lines.clear();
+		m_text.clear();
+
+		for (ThreadBuffer* buffer : buffers)
+		{
+			// Read before head, so a thread that has gone has nothing left we could miss
+			const bool abandoned = buffer->abandoned.load(std::memory_order_acquire);
+
+			uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+			const uint64_t head = buffer->head.load(std::memory_order_acquire);
+			while (tail < head)
+			{
+				const uint8_t* const record = buffer->data + (tail & (buffer->capacity - 1));
+				const RecordHeader* const header = reinterpret_cast<const RecordHeader*>(record);
+
+				if (header->padding == 0)
+				{
+					const size_t offset = m_text.size();
+					m_text.resize(offset + MaxLineLength);
+					const int length = header->formatter(&m_text[offset], MaxLineLength, header->format, record + sizeof(RecordHeader));
+					m_text.resize(offset + std::min(size_t(std::max(length, 0)), MaxLineLength - 1) + 1);
+					m_text.back() = 0;
+
+					m_lines.push_back(Line{ header->timestamp, buffer->threadIndex, uint32_t(offset) });
+				}
+
+				tail += header->size;
+			}
+			buffer->tail.store(tail, std::memory_order_release);
+
+			if (abandoned)
+			{
+				std::lock_guard<std::mutex> lock(m_buffersMutex);
+				m_buffers.erase(std::find(m_buffers.begin(), m_buffers.end(), buffer));
+				delete[] buffer->data;
+				delete buffer;
+			}
+		}
+
+		// Each thread's lines are in order already, this interleaves them
+		std::stable_sort(m_lines.begin(), m_lines.end(), [](const Line& a, const Line& b) { return a.timestamp < b.timestamp; });
+
+		char prefixed[MaxLineLength + 32];
+		for (const Line& line : m_lines)
+		{
+			const double seconds = double(line.timestamp - std::min(line.timestamp, m_startTime)) * 1e-9;
+			const int length = snprintf(prefixed, sizeof(prefixed), "[%11.6f] [%2u] %s", seconds, line.threadIndex, &m_text[line.offset]);
+			Write(prefixed, std::min(size_t(std::max(length, 0)), sizeof(prefixed) - 1));
+		}
+
+		if (m_file != nullptr && !m_lines.empty())
+			fflush(m_file);
+
+		m_passes.fetch_add(1);
+		return m_lines.size();
+	}
+
+	void Logger::Write(const char* text, size_t length)
+	{
+		if (m_file != nullptr)
+			fwrite(text, 1, length, m_file);
+
+		if (m_echo || m_file == nullptr)
+			WriteNow(text);
+	}
+
+} // namespace utils
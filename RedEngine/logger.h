@@ -0,0 +1,250 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace utils
+{
+
+	// Asynchronous logging. Log copies a timestamp, the format pointer and the raw arguments into the calling
+	// thread's own ring and returns; a background thread does the formatting and the writing. Strings are copied,
+	// so the format must be a literal (or otherwise outlive the logger) but string arguments need not be.
+	// Before Create, and after Destroy, Log formats and writes synchronously.
+	class Logger
+	{
+	public:
+		// path may be null to log to the debugger/stderr only. bufferBytes is per thread. echo also sends file
+		// output to the debugger/stderr.
+		static void						Create(const char* path = nullptr, uint32_t bufferBytes = 64 * 1024, bool echo = true);
+		static void						Destroy();
+
+		static Logger*					Get()
+		{
+			return g_logger.load(std::memory_order_acquire);
+		}
+
+		template<typename... Args>
+		static void						Log(const char* format, const Args&... args);
+
+		// Blocks until everything logged before the call has been written
+		void							Flush();
+
+		// Messages thrown away because their thread's ring was full
+		uint64_t						GetDropped() const
+		{
+			return m_dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		typedef int (*FormatFunction)(char* output, size_t size, const char* format, const uint8_t* arguments);
+
+		// Every record starts 8-byte aligned with this header, followed by its encoded arguments
+		struct RecordHeader
+		{
+			uint32_t					size; // Whole record, a multiple of 8
+			uint32_t					padding; // Non-zero for filler at the end of the ring
+			uint64_t					timestamp;
+			const char*					format;
+			FormatFunction				formatter;
+		};
+
+		// One per logging thread: the thread pushes, the logger thread pops
+		struct ThreadBuffer
+		{
+			uint8_t*					data;
+			uint32_t					capacity;
+			uint32_t					threadIndex;
+			std::atomic<bool>			abandoned; // Its thread has exited, free it once drained
+
+			alignas(64) std::atomic<uint64_t> head;
+			alignas(64) std::atomic<uint64_t> tail;
+		};
+
+		struct ThreadSlot;
+
+		struct Line
+		{
+			uint64_t					timestamp;
+			uint32_t					threadIndex;
+			uint32_t					offset; // Into the formatting scratch
+		};
+
+		// Arguments are stored by value, except strings (below)
+		template<typename T>
+		struct Encoding
+		{
+			static_assert(std::is_arithmetic<T>::value || std::is_pointer<T>::value || std::is_enum<T>::value,
+				"Only numbers, enums, pointers and strings can be logged.");
+
+			typedef T					Stored;
+
+			static size_t				Size(const T&)
+			{
+				return (sizeof(T) + 7) & ~size_t(7);
+			}
+
+			static void					Write(uint8_t*& cursor, const T& value)
+			{
+				memcpy(cursor, &value, sizeof(T));
+				cursor += Size(value);
+			}
+
+			static T					Read(const uint8_t*& cursor)
+			{
+				T value;
+				memcpy(&value, cursor, sizeof(T));
+				cursor += (sizeof(T) + 7) & ~size_t(7);
+				return value;
+			}
+		};
+
+		// Narrow or wide, copied with a length in front and handed back pointing into the record
+		template<typename Char>
+		struct StringEncoding
+		{
+			typedef const Char*			Stored;
+
+			static size_t				Size(const Char* value)
+			{
+				return (sizeof(uint32_t) + (Length(value) + 1) * sizeof(Char) + 7) & ~size_t(7);
+			}
+
+			static void					Write(uint8_t*& cursor, const Char* value)
+			{
+				const uint32_t length = Length(value);
+				const Char terminator = 0;
+				memcpy(cursor, &length, sizeof(length));
+				if (length > 0)
+					memcpy(cursor + sizeof(length), value, length * sizeof(Char));
+				memcpy(cursor + sizeof(length) + length * sizeof(Char), &terminator, sizeof(Char));
+				cursor += (sizeof(uint32_t) + (length + 1) * sizeof(Char) + 7) & ~size_t(7);
+			}
+
+			static const Char*			Read(const uint8_t*& cursor)
+			{
+				uint32_t length;
+				memcpy(&length, cursor, sizeof(length));
+				const Char* const value = reinterpret_cast<const Char*>(cursor + sizeof(length));
+				cursor += (sizeof(uint32_t) + (length + 1) * sizeof(Char) + 7) & ~size_t(7);
+				return value;
+			}
+
+			static uint32_t				Length(const Char* value)
+			{
+				uint32_t length = 0;
+				if (value != nullptr)
+				{
+					while (length < MaxStringLength && value[length] != 0)
+						++length;
+				}
+				return length;
+			}
+		};
+
+		template<typename T, typename Decayed = typename std::decay<T>::type>
+		struct EncodingFor : std::conditional<
+			std::is_same<Decayed, const char*>::value || std::is_same<Decayed, char*>::value, StringEncoding<char>,
+			typename std::conditional<std::is_same<Decayed, const wchar_t*>::value || std::is_same<Decayed, wchar_t*>::value,
+			StringEncoding<wchar_t>, Encoding<Decayed>>::type> {};
+
+		static const size_t				MaxStringLength = 256;
+		static const size_t				MaxLineLength = 1024;
+
+		static std::atomic<Logger*>		g_logger;
+		static std::atomic<uint32_t>	g_generation;
+		static thread_local ThreadSlot	t_slot;
+
+		Logger(const char* path, uint32_t bufferBytes, bool echo);
+		~Logger();
+
+		template<typename... Args>
+		static int						FormatRecord(char* output, size_t size, const char* format, const uint8_t* arguments)
+		{
+			// Braced initialisation reads the arguments in order
+			const uint8_t* cursor = arguments;
+			const std::tuple<typename EncodingFor<Args>::type::Stored...> values{ EncodingFor<Args>::type::Read(cursor)... };
+			(void)cursor;
+			return std::apply([output, size, format](auto... unpacked) { return Printf(output, size, format, unpacked...); }, values);
+		}
+
+		static int						Printf(char* output, size_t size, const char* format, ...);
+		static void						WriteNow(const char* text);
+
+		ThreadBuffer*					GetThreadBuffer(); // Registers the calling thread on first use
+		uint8_t*						Reserve(ThreadBuffer& buffer, uint32_t size);
+		static void						Commit(ThreadBuffer& buffer, uint32_t size);
+
+		void							ThreadMain();
+		size_t							Drain(); // Formats and writes everything queued, returns how many lines
+		void							Write(const char* text, size_t length);
+
+		FILE*							m_file;
+		bool							m_echo;
+		uint32_t						m_bufferBytes;
+		uint32_t						m_generation; // Tells threads a buffer from an earlier logger is stale
+		uint64_t						m_startTime;
+
+		std::mutex						m_buffersMutex; // Only taken to register threads and by the logger thread
+		std::vector<ThreadBuffer*>		m_buffers;
+		uint32_t						m_nextThreadIndex;
+
+		std::vector<Line>				m_lines;
+		std::vector<char>				m_text;
+
+		std::thread						m_thread;
+		std::atomic<bool>				m_quit;
+		std::atomic<uint64_t>			m_passes; // Completed drains, for Flush
+		std::atomic<uint64_t>			m_dropped;
+	};
+
+	uint64_t LogTimestamp();
+
+	template<typename... Args>
+	void Logger::Log(const char* format, const Args&... args)
+	{
+		Logger* const logger = Get();
+		if (logger == nullptr)
+		{
+			char text[MaxLineLength];
+			Printf(text, sizeof(text), format, typename EncodingFor<Args>::type::Stored(args)...);
+			WriteNow(text);
+			return;
+		}
+
+		ThreadBuffer* const buffer = logger->GetThreadBuffer();
+		if (buffer == nullptr)
+			return;
+
+		size_t size = sizeof(RecordHeader);
+		((size += EncodingFor<Args>::type::Size(args)), ...);
+
+		uint8_t* const record = logger->Reserve(*buffer, uint32_t(size));
+		if (record == nullptr)
+			return;
+
+		RecordHeader* const header = reinterpret_cast<RecordHeader*>(record);
+		header->size = uint32_t(size);
+		header->padding = 0;
+		header->timestamp = LogTimestamp();
+		header->format = format;
+		header->formatter = &FormatRecord<Args...>;
+
+		uint8_t* cursor = record + sizeof(RecordHeader);
+		(EncodingFor<Args>::type::Write(cursor, args), ...);
+		(void)cursor;
+
+		Commit(*buffer, uint32_t(size));
+	}
+
+} // namespace utils
+
+#if !defined(DEBUG_MESSAGE)
+#define DEBUG_MESSAGE(...) utils::Logger::Log(__VA_ARGS__)
+#endif
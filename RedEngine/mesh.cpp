@@ -0,0 +1,175 @@
+#include "red_engine.h"
+#include "mesh.h"
+#include "asset_pack.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_draws("render.draws");
+		utils::PerfCounter s_triangles("render.triangles");
+		utils::PerfCounter s_allocations("memory.allocations");
+		utils::PerfCounter s_allocatedBytes("memory.allocated_bytes");
+	}
+
+	Mesh::Mesh() :
+		m_vertexBuffer(nullptr),
+		m_indexBuffer(nullptr),
+		m_vertexBufferHandle(ResourceRegistry::InvalidHandle),
+		m_indexBufferHandle(ResourceRegistry::InvalidHandle),
+		m_vertexAllocation(),
+		m_indexAllocation(),
+		m_vertexCount(0),
+		m_indexCount(0),
+		m_lods{},
+		m_lodCount(0),
+		m_boundsCenter{},
+		m_boundsRadius(0.0f)
+	{
+		m_vertexAllocation.node = utils::OffsetAllocator::InvalidNode;
+		m_indexAllocation.node = utils::OffsetAllocator::InvalidNode;
+	}
+
+	Mesh::~Mesh()
+	{
+		Release();
+	}
+
+	bool Mesh::Create(const void* data, size_t size, bool persistentData)
+	{
+		ASSERT(m_vertexBufferHandle == ResourceRegistry::InvalidHandle && m_vertexAllocation.node == utils::OffsetAllocator::InvalidNode,
+			"Mesh has already been created.\n");
+
+		if (!assets::ValidateMesh(data, size))
+		{
+			DEBUG_MESSAGE("Mesh data is corrupt or out of date.\n");
+			return false;
+		}
+
+		const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+		const assets::MeshHeader* const header = reinterpret_cast<const assets::MeshHeader*>(bytes);
+
+		// The cooked sections are already in GPU layout, so upload straight from them rather than staging a copy
+		const uint32_t vertexBytes = header->vertexCount * sizeof(assets::MeshVertex);
+		const uint32_t indexBytes = header->indexCount * sizeof(uint32_t);
+
+		BufferManager* const buffers = BufferManager::Get();
+		bool pooled = false;
+		if (buffers != nullptr && buffers->Allocate(BufferManager::Vertex, vertexBytes, bytes + header->vertexOffset, m_vertexAllocation))
+		{
+			pooled = buffers->Allocate(BufferManager::Index, indexBytes, bytes + header->indexOffset, m_indexAllocation);
+			if (!pooled)
+			{
+				// All of it, as Draw takes the offset whichever buffers the mesh ends up in
+				buffers->Free(m_vertexAllocation);
+				m_vertexAllocation = BufferManager::Allocation();
+				m_vertexAllocation.node = utils::OffsetAllocator::InvalidNode;
+			}
+		}
+
+		// Too big for a pool, or no pools at all. The registry recreates them after device loss, from the pack mapping
+		// when it lasts, otherwise from a copy of its own.
+		if (!pooled)
+		{
+			ResourceRegistry* const registry = ResourceRegistry::Get();
+			const uint32_t flags = persistentData ? ResourceRegistry::c_BorrowedData : 0;
+
+			CD3D11_BUFFER_DESC vertexDesc(vertexBytes, D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+			m_vertexBufferHandle = registry->RegisterBuffer(&m_vertexBuffer, vertexDesc, bytes + header->vertexOffset, flags);
+
+			CD3D11_BUFFER_DESC indexDesc(indexBytes, D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+			m_indexBufferHandle = registry->RegisterBuffer(&m_indexBuffer, indexDesc, bytes + header->indexOffset, flags);
+		}
+
+		m_vertexCount = header->vertexCount;
+		m_indexCount = header->indexCount;
+
+		// The LOD table is tiny and read every frame, so keep a copy rather than touching the mapping
+		m_lodCount = header->lodCount;
+		memcpy(m_lods, bytes + header->lodOffset, m_lodCount * sizeof(assets::MeshLod));
+
+		float radiusSq = 0.0f;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const float extent = (header->boundsMax[k] - header->boundsMin[k]) * 0.5f;
+			m_boundsCenter[k] = header->boundsMin[k] + extent;
+			radiusSq += extent * extent;
+		}
+		m_boundsRadius = sqrtf(radiusSq);
+
+		return pooled || (m_vertexBuffer != nullptr && m_indexBuffer != nullptr);
+	}
+
+	bool Mesh::CreateFromPack(const assets::AssetPack& pack, uint64_t nameHash)
+	{
+		const assets::PackEntry* const entry = pack.Find(nameHash);
+		if (entry == nullptr)
+		{
+			DEBUG_MESSAGE("Mesh %016llx isn't in %s.\n", static_cast<unsigned long long>(nameHash), pack.GetPath());
+			return false;
+		}
+
+		// The pack stays mounted as long as Core, and with it the mapping
+		if ((entry->flags & assets::PackEntryCompressed) == 0)
+			return Create(pack.GetData(entry), size_t(entry->size), true);
+
+		// Compressed meshes need somewhere to land before they can be uploaded
+		uint8_t* const scratch = new uint8_t[size_t(entry->uncompressedSize)];
+		s_allocations.Add();
+		s_allocatedBytes.Add(int64_t(entry->uncompressedSize));
+		const bool ok = pack.Decompress(entry, scratch, size_t(entry->uncompressedSize)) &&
+			Create(scratch, size_t(entry->uncompressedSize));
+		delete[] scratch;
+
+		return ok;
+	}
+
+	void Mesh::Release()
+	{
+		if (m_vertexAllocation.node != utils::OffsetAllocator::InvalidNode)
+		{
+			// The pools outlive every mesh, and hold the ranges until the GPU is done with this frame
+			BufferManager::Get()->Free(m_vertexAllocation);
+			BufferManager::Get()->Free(m_indexAllocation);
+			m_vertexAllocation = BufferManager::Allocation();
+			m_vertexAllocation.node = utils::OffsetAllocator::InvalidNode;
+			m_indexAllocation = m_vertexAllocation;
+		}
+		else if (m_vertexBufferHandle != ResourceRegistry::InvalidHandle || m_indexBufferHandle != ResourceRegistry::InvalidHandle)
+		{
+			ResourceRegistry::Get()->Unregister(m_vertexBufferHandle);
+			ResourceRegistry::Get()->Unregister(m_indexBufferHandle);
+			m_vertexBufferHandle = ResourceRegistry::InvalidHandle;
+			m_indexBufferHandle = ResourceRegistry::InvalidHandle;
+		}
+
+		m_vertexCount = 0;
+		m_indexCount = 0;
+		m_lodCount = 0;
+	}
+
+	void Mesh::Draw(ID3D11DeviceContext* deviceContext, uint32_t lod) const
+	{
+		ASSERT(m_lodCount > 0, "Drawing a mesh that hasn't been created.\n");
+		ASSERT(lod < m_lodCount, "Mesh has no LOD %u.\n", lod);
+
+		// Pool buffers are read through the pool, as device loss replaces them. Offsets are 0 for dedicated
+		// buffers, as their allocations are zeroed.
+		const bool pooled = m_vertexAllocation.node != utils::OffsetAllocator::InvalidNode;
+		ID3D11Buffer* const vertexBuffer = pooled ? *m_vertexAllocation.buffer : m_vertexBuffer;
+		ID3D11Buffer* const indexBuffer = pooled ? *m_indexAllocation.buffer : m_indexBuffer;
+
+		const UINT stride = sizeof(assets::MeshVertex);
+		const UINT offset = m_vertexAllocation.offset;
+		deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, m_indexAllocation.offset);
+		deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		deviceContext->DrawIndexed(m_lods[lod].indexCount, m_lods[lod].indexOffset, 0);
+		s_draws.Add();
+		s_triangles.Add(m_lods[lod].indexCount / 3);
+	}
+
+} // namespace DX
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "mesh_format.h"
+#include "buffer_manager.h"
+
+namespace assets
+{
+	class AssetPack;
+}
+
+namespace DX
+{
+
+	// GPU buffers for a mesh cooked by tools/mesh_cooker, sub-allocated from the BufferManager's pools when it exists
+	class Mesh
+	{
+	public:
+		Mesh();
+		~Mesh();
+
+		// Buffer creation reads straight from data, which is normally a mapped asset pack entry. persistentData says it
+		// stays mapped as long as the mesh, so buffers recreated after device loss can be made from it without a copy.
+		// The buffers come from the BufferManager or the ResourceRegistry, on whatever device they hold.
+		bool							Create(const void* data, size_t size, bool persistentData = false);
+		bool							CreateFromPack(const assets::AssetPack& pack, uint64_t nameHash);
+		void							Release();
+
+		// lod 0 is the full mesh
+		void							Draw(ID3D11DeviceContext* deviceContext, uint32_t lod = 0) const;
+
+		uint32_t						GetVertexCount() const
+		{
+			return m_vertexCount;
+		}
+
+		uint32_t						GetIndexCount() const
+		{
+			return m_indexCount;
+		}
+
+		uint32_t						GetLodCount() const
+		{
+			return m_lodCount;
+		}
+
+		const assets::MeshLod*			GetLods() const
+		{
+			return m_lods;
+		}
+
+		// Bounding sphere in object space, for LOD selection and culling
+		const float*					GetBoundsCenter() const
+		{
+			return m_boundsCenter;
+		}
+
+		float							GetBoundsRadius() const
+		{
+			return m_boundsRadius;
+		}
+
+	private:
+		ID3D11Buffer*					m_vertexBuffer; // Dedicated buffers, only when the allocations are invalid
+		ID3D11Buffer*					m_indexBuffer;
+		uint32_t						m_vertexBufferHandle; // In the ResourceRegistry
+		uint32_t						m_indexBufferHandle;
+		BufferManager::Allocation		m_vertexAllocation;
+		BufferManager::Allocation		m_indexAllocation;
+
+		uint32_t						m_vertexCount;
+		uint32_t						m_indexCount;
+
+		assets::MeshLod					m_lods[assets::MeshMaxLods];
+		uint32_t						m_lodCount;
+
+		float							m_boundsCenter[3];
+		float							m_boundsRadius;
+	};
+
+} // namespace DX
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Binary layout of a cooked mesh as written by tools/mesh_cooker.
+// Everything is little endian and every section starts on a 16 byte boundary so the
+// runtime can point buffer creation straight at the file data.
+namespace assets
+{
+
+	static const uint32_t MeshMagic = 0x48534D52; // 'RMSH'
+	static const uint32_t MeshVersion = 2;
+	static const uint32_t MeshSectionAlignment = 16;
+
+	static const uint32_t MeshletMaxVertices = 64;
+	static const uint32_t MeshletMaxTriangles = 124;
+	static const uint32_t MeshMaxLods = 8;
+
+	// Matches VS_INPUT in VertexShader.hlsl
+	struct MeshVertex
+	{
+		float			position[3];
+		float			color[4];
+	};
+	static_assert(sizeof(MeshVertex) == 28, "MeshVertex must match the vertex shader input layout");
+
+	struct Meshlet
+	{
+		uint32_t		vertexOffset; // Into the meshlet vertex table
+		uint32_t		triangleOffset; // Into the meshlet triangle table, in triangles
+		uint32_t		vertexCount;
+		uint32_t		triangleCount;
+		float			center[3]; // Bounding sphere
+		float			radius;
+	};
+
+	// One level of detail. Every level indexes the same vertex buffer; level 0 is the full mesh.
+	struct MeshLod
+	{
+		uint32_t		indexOffset; // Into the index buffer, in indices
+		uint32_t		indexCount;
+		float			error; // Approximate object space deviation from level 0
+		uint32_t		reserved;
+	};
+
+	struct MeshHeader
+	{
+		uint32_t		magic;
+		uint32_t		version;
+		uint32_t		vertexCount;
+		uint32_t		indexCount;
+
+		uint32_t		meshletCount;
+		uint32_t		meshletVertexCount;
+		uint32_t		meshletTriangleCount;
+		uint32_t		flags;
+
+		float			boundsMin[3];
+		float			boundsMax[3];
+
+		// Byte offsets from the start of the header
+		uint32_t		vertexOffset;
+		uint32_t		indexOffset; // uint32_t indices
+		uint32_t		meshletOffset;
+		uint32_t		meshletVertexOffset; // uint32_t indices into the vertex buffer
+		uint32_t		meshletTriangleOffset; // 3 x uint8_t local indices per triangle
+		uint32_t		lodOffset; // MeshLod[lodCount]
+		uint32_t		lodCount;
+		uint32_t		totalSize;
+		uint32_t		reserved[2];
+	};
+	static_assert((sizeof(MeshHeader) % MeshSectionAlignment) == 0, "Mesh header must keep the sections aligned");
+
+	inline uint32_t AlignMeshOffset(uint32_t offset)
+	{
+		return (offset + MeshSectionAlignment - 1) & ~(MeshSectionAlignment - 1);
+	}
+
+	// Checks a block of memory holds a complete mesh of the current version
+	inline bool ValidateMesh(const void* data, size_t size)
+	{
+		if (data == nullptr || size < sizeof(MeshHeader))
+			return false;
+
+		const MeshHeader* const header = static_cast<const MeshHeader*>(data);
+		if (header->magic != MeshMagic || header->version != MeshVersion)
+			return false;
+
+		if (header->totalSize > size)
+			return false;
+
+		const uint64_t vertexEnd = uint64_t(header->vertexOffset) + uint64_t(header->vertexCount) * sizeof(MeshVertex);
+		const uint64_t indexEnd = uint64_t(header->indexOffset) + uint64_t(header->indexCount) * sizeof(uint32_t);
+		const uint64_t meshletEnd = uint64_t(header->meshletOffset) + uint64_t(header->meshletCount) * sizeof(Meshlet);
+		const uint64_t meshletVertexEnd = uint64_t(header->meshletVertexOffset) + uint64_t(header->meshletVertexCount) * sizeof(uint32_t);
+		const uint64_t meshletTriangleEnd = uint64_t(header->meshletTriangleOffset) + uint64_t(header->meshletTriangleCount) * 3;
+		const uint64_t lodEnd = uint64_t(header->lodOffset) + uint64_t(header->lodCount) * sizeof(MeshLod);
+
+		if (vertexEnd > header->totalSize || indexEnd > header->totalSize || meshletEnd > header->totalSize ||
+			meshletVertexEnd > header->totalSize || meshletTriangleEnd > header->totalSize || lodEnd > header->totalSize)
+			return false;
+
+		if (header->lodCount == 0 || header->lodCount > MeshMaxLods)
+			return false;
+
+		const MeshLod* const lods = reinterpret_cast<const MeshLod*>(static_cast<const uint8_t*>(data) + header->lodOffset);
+		for (uint32_t i = 0; i < header->lodCount; ++i)
+		{
+			if (uint64_t(lods[i].indexOffset) + lods[i].indexCount > header->indexCount)
+				return false;
+		}
+
+		return true;
+	}
+
+} // namespace assets
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace containers
+{
+
+	// Bounded lock-free ring for any number of producer and consumer threads. Every cell carries a sequence number
+	// saying which lap of the ring it is ready for: a producer claims the next position with a compare and swap on
+	// the write index once that cell is empty for its lap, fills it and bumps the sequence; consumers do the same on
+	// the read index. The batch forms claim a run of ready cells with one compare and swap, so a batch costs the
+	// shared indices one round trip rather than one per value. push fails when full and pop when empty; nothing waits.
+	// The two indices sit on cache lines of their own, apart from the cells and each other.
+	template <typename T>
+	class MpmcQueue
+	{
+	public:
+		// capacity is rounded up to a power of two
+		explicit MpmcQueue(size_t capacity) :
+			m_cells(nullptr),
+			m_mask(0),
+			m_enqueue(0),
+			m_dequeue(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			m_cells = new Cell[size];
+			for (size_t i = 0; i < size; ++i)
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			m_mask = size - 1;
+		}
+
+		~MpmcQueue()
+		{
+			delete[] m_cells;
+		}
+
+		MpmcQueue(const MpmcQueue&) = delete;
+		MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+		// value is only moved from if it goes in
+		bool push(T&& value)
+		{
+			size_t claimed = 1;
+			const size_t position = Claim(m_enqueue, 0, claimed);
+			if (position == NoPosition)
+				return false;
+
+			Cell& cell = m_cells[position & m_mask];
+			cell.value = std::move(value);
+			cell.sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool push(const T& value)
+		{
+			return push(&value, 1) == 1;
+		}
+
+		// Returns how many went in, from the front of values, one after another in the ring
+		size_t push(const T* values, size_t count)
+		{
+			size_t claimed = count;
+			const size_t position = Claim(m_enqueue, 0, claimed);
+			if (position == NoPosition)
+				return 0;
+
+			for (size_t i = 0; i < claimed; ++i)
+			{
+				Cell& cell = m_cells[(position + i) & m_mask];
+				cell.value = values[i];
+				cell.sequence.store(position + i + 1, std::memory_order_release);
+			}
+			return claimed;
+		}
+
+		bool pop(T& value)
+		{
+			return pop(&value, 1) == 1;
+		}
+
+		// Returns how many came out, into the front of values
+		size_t pop(T* values, size_t maxCount)
+		{
+			size_t claimed = maxCount;
+			const size_t position = Claim(m_dequeue, 1, claimed);
+			if (position == NoPosition)
+				return 0;
+
+			for (size_t i = 0; i < claimed; ++i)
+			{
+				Cell& cell = m_cells[(position + i) & m_mask];
+				values[i] = std::move(cell.value);
+				cell.sequence.store(position + i + m_mask + 1, std::memory_order_release);
+			}
+			return claimed;
+		}
+
+		size_t capacity() const
+		{
+			return m_mask + 1;
+		}
+
+		// Claimed rather than finished pushes and pops, so only a hint while other threads are at it
+		size_t size() const
+		{
+			const size_t dequeue = m_dequeue.load(std::memory_order_acquire);
+			const size_t enqueue = m_enqueue.load(std::memory_order_acquire);
+			return enqueue > dequeue ? enqueue - dequeue : 0;
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+	private:
+		static const size_t				NoPosition = ~size_t(0);
+
+		struct Cell
+		{
+			std::atomic<size_t>			sequence; // position when empty for that lap, position + 1 once full
+			T							value;
+		};
+
+		// Claims up to count cells in a row from index whose sequence is position + ready, which is 0 for empty
+		// cells a producer wants and 1 for full ones a consumer wants. Returns the first position and sets count
+		// to how many, or NoPosition if there were none.
+		size_t Claim(std::atomic<size_t>& index, size_t ready, size_t& count)
+		{
+			size_t position = index.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				// Only the thread that claims a position changes its cell, so what is seen ready here stays so
+				// until the compare and swap below settles who has it
+				size_t run = 0;
+				while (run < count && m_cells[(position + run) & m_mask].sequence.load(std::memory_order_acquire) == position + run + ready)
+					++run;
+
+				if (run == 0)
+				{
+					// Either the ring is full (or empty), or another thread has moved the index on since we read it
+					const size_t current = index.load(std::memory_order_relaxed);
+					if (current == position)
+						return NoPosition;
+					position = current;
+					continue;
+				}
+
+				if (index.compare_exchange_weak(position, position + run, std::memory_order_relaxed))
+				{
+					count = run;
+					return position;
+				}
+			}
+		}
+
+		Cell*							m_cells;
+		size_t							m_mask;
+
+		alignas(64) std::atomic<size_t> m_enqueue; // Next position to push
+		alignas(64) std::atomic<size_t> m_dequeue; // Next position to pop
+	};
+
+}
@@ -0,0 +1,421 @@
+#include "red_engine.h"
+#include "occlusion_culler.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace scene
+{
+
+	namespace
+	{
+		// Anything closer than this in clip space w is treated as crossing the near plane
+		const float c_NearW = 1e-4f;
+
+		// Rows each rasterisation job owns
+		const int c_BandHeight = 16;
+
+		// Boxes per visibility job
+		const unsigned int c_TestBatch = 64;
+
+		utils::PerfCounter s_tested("cull.tested");
+		utils::PerfCounter s_occluded("cull.occluded");
+
+		void Multiply(const float* a, const float* b, float* result)
+		{
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int column = 0; column < 4; ++column)
+				{
+					result[row * 4 + column] = a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column] +
+						a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+				}
+			}
+		}
+
+		void Transform(const float* p, const float* m, float* clip)
+		{
+			for (int column = 0; column < 4; ++column)
+				clip[column] = p[0] * m[0 * 4 + column] + p[1] * m[1 * 4 + column] + p[2] * m[2 * 4 + column] + m[3 * 4 + column];
+		}
+	}
+
+	OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) :
+		m_width(width),
+		m_height(height),
+		m_tilesX(width / TileWidth),
+		m_tilesY(height / TileHeight),
+		m_viewProjection{},
+		m_minOccluderScreenFraction(0.02f),
+		m_depth(size_t(width) * height, 1.0f),
+		m_tileMaxDepth(size_t(width / TileWidth) * (height / TileHeight), 1.0f),
+		m_stats{}
+	{
+		ASSERT(width % TileWidth == 0 && height % TileHeight == 0, "Occlusion buffer %ux%u must be a multiple of the tile size.\n", width, height);
+	}
+
+	void OcclusionCuller::BeginFrame(const float viewProjection[16])
+	{
+		memcpy(m_viewProjection, viewProjection, sizeof(m_viewProjection));
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+		std::fill(m_tileMaxDepth.begin(), m_tileMaxDepth.end(), 1.0f);
+		m_triangles.clear();
+		m_edgeTests.clear();
+		m_stats = {};
+	}
+
+	void OcclusionCuller::AddOccluder(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+		const float world[16], const Box& worldBounds)
+	{
+		// Small on screen means it hides little, and crossing the near plane means we can't trust it
+		int minX, minY, maxX, maxY;
+		float minDepth;
+		if (!ProjectBox(worldBounds, minX, minY, maxX, maxY, minDepth))
+			return;
+
+		const float coverage = float(maxX - minX + 1) * float(maxY - minY + 1) / float(m_width * m_height);
+		if (coverage < m_minOccluderScreenFraction)
+			return;
+
+		++m_stats.occluders;
+		m_stats.occluderTriangles += indexCount / 3;
+
+		float worldViewProjection[16];
+		Multiply(world, m_viewProjection, worldViewProjection);
+
+		const uint8_t* const vertexData = reinterpret_cast<const uint8_t*>(positions);
+		const float halfWidth = float(m_width) * 0.5f;
+		const float halfHeight = float(m_height) * 0.5f;
+
+		m_faces.clear();
+		m_faceIndices.clear();
+		m_edges.clear();
+		m_outline.clear();
+		float farDepth = 0.0f;
+
+		for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			ScreenTriangle triangle = {};
+			bool clipped = false;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				float clip[4];
+				Transform(reinterpret_cast<const float*>(vertexData + size_t(indices[i + k]) * stride), worldViewProjection, clip);
+
+				// Clipping would make new triangles, and dropping an occluder triangle is always safe
+				if (clip[3] < c_NearW)
+				{
+					clipped = true;
+					break;
+				}
+
+				const float invW = 1.0f / clip[3];
+				triangle.x[k] = (clip[0] * invW + 1.0f) * halfWidth;
+				triangle.y[k] = (1.0f - clip[1] * invW) * halfHeight;
+				triangle.z[k] = clip[2] * invW;
+			}
+
+			if (clipped)
+				continue;
+
+			// Clockwise in screen space (y down) is front facing
+			const float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+			if (area <= 0.0f)
+				continue;
+
+			// Off screen faces still count, their edges may be shared with ones that aren't
+			for (int k = 0; k < 3; ++k)
+			{
+				m_edges.push_back(uint64_t(indices[i + (k + 1) % 3]) << 32 | indices[i + (k + 2) % 3]);
+				farDepth = std::max(farDepth, triangle.z[k]);
+			}
+			m_faces.push_back(triangle);
+			m_faceIndices.push_back(i);
+		}
+
+		// An edge another front face runs the other way along is inside the occluder; the rest make up its outline.
+		// Meshes with split vertices only lose a little coverage along the splits.
+		std::sort(m_edges.begin(), m_edges.end());
+		for (size_t face = 0; face < m_faces.size(); ++face)
+		{
+			const ScreenTriangle& triangle = m_faces[face];
+			const uint32_t i = m_faceIndices[face];
+			for (int k = 0; k < 3; ++k)
+			{
+				const int from = (k + 1) % 3, to = (k + 2) % 3;
+				if (std::binary_search(m_edges.begin(), m_edges.end(), uint64_t(indices[i + to]) << 32 | indices[i + from]))
+					continue;
+
+				// Half a pixel either way moves the edge function by at most half of |A| + |B|
+				OutlineEdge edge;
+				edge.test.a = triangle.y[from] - triangle.y[to];
+				edge.test.b = triangle.x[to] - triangle.x[from];
+				edge.test.c = triangle.x[from] * triangle.y[to] - triangle.x[to] * triangle.y[from] - 0.5f * (std::fabs(edge.test.a) + std::fabs(edge.test.b));
+				edge.minX = std::min(triangle.x[from], triangle.x[to]);
+				edge.maxX = std::max(triangle.x[from], triangle.x[to]);
+				edge.minY = std::min(triangle.y[from], triangle.y[to]);
+				edge.maxY = std::max(triangle.y[from], triangle.y[to]);
+				m_outline.push_back(edge);
+			}
+		}
+
+		// A pixel centred in a face can only poke out of the occluder across outline edges within a pixel of the face
+		for (ScreenTriangle& triangle : m_faces)
+		{
+			triangle.minX = std::max(0, int(std::floor(std::min({ triangle.x[0], triangle.x[1], triangle.x[2] }))));
+			triangle.maxX = std::min(int(m_width) - 1, int(std::ceil(std::max({ triangle.x[0], triangle.x[1], triangle.x[2] }))));
+			triangle.minY = std::max(0, int(std::floor(std::min({ triangle.y[0], triangle.y[1], triangle.y[2] }))));
+			triangle.maxY = std::min(int(m_height) - 1, int(std::ceil(std::max({ triangle.y[0], triangle.y[1], triangle.y[2] }))));
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+				continue;
+
+			triangle.firstEdge = uint32_t(m_edgeTests.size());
+			for (const OutlineEdge& edge : m_outline)
+			{
+				if (edge.maxX >= float(triangle.minX - 1) && edge.minX <= float(triangle.maxX + 2) &&
+					edge.maxY >= float(triangle.minY - 1) && edge.minY <= float(triangle.maxY + 2))
+				{
+					m_edgeTests.push_back(edge.test);
+				}
+			}
+			triangle.edgeCount = uint32_t(m_edgeTests.size()) - triangle.firstEdge;
+			triangle.farDepth = farDepth;
+			m_triangles.push_back(triangle);
+		}
+	}
+
+	void OcclusionCuller::RenderOccluders()
+	{
+		m_stats.rasterisedTriangles = uint32_t(m_triangles.size());
+
+		// Bands of rows never overlap, so each job writes its own part of the buffer without locking
+		const unsigned int bandCount = (m_height + c_BandHeight - 1) / c_BandHeight;
+		auto rasterise = [this](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int band = begin; band < end; ++band)
+				{
+					const int bandMinY = int(band) * c_BandHeight;
+					RasteriseBand(bandMinY, std::min(bandMinY + c_BandHeight, int(m_height)) - 1);
+				}
+			};
+
+		if (utils::JobSystem::Get() != nullptr)
+			utils::JobSystem::Get()->ParallelFor(bandCount, 1, rasterise);
+		else
+			rasterise(0, bandCount);
+
+		// Farthest depth in each tile, a box nearer than that is hidden without looking at pixels
+		for (uint32_t tileY = 0; tileY < m_tilesY; ++tileY)
+		{
+			for (uint32_t tileX = 0; tileX < m_tilesX; ++tileX)
+			{
+				__m128 maxDepth = _mm_setzero_ps();
+				for (uint32_t y = 0; y < TileHeight; ++y)
+				{
+					const float* const row = &m_depth[size_t(tileY * TileHeight + y) * m_width + tileX * TileWidth];
+					maxDepth = _mm_max_ps(maxDepth, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+				}
+
+				maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+				maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+				m_tileMaxDepth[tileY * m_tilesX + tileX] = _mm_cvtss_f32(maxDepth);
+			}
+		}
+	}
+
+	void OcclusionCuller::RasteriseBand(int bandMinY, int bandMaxY)
+	{
+		const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (const ScreenTriangle& triangle : m_triangles)
+		{
+			const int minY = std::max(triangle.minY, bandMinY);
+			const int maxY = std::min(triangle.maxY, bandMaxY);
+			if (minY > maxY)
+				continue;
+
+			// Edge functions E(x, y) = A x + B y + C, positive inside
+			float a[3], b[3], c[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				const int i = (k + 1) % 3, j = (k + 2) % 3;
+				a[k] = triangle.y[i] - triangle.y[j];
+				b[k] = triangle.x[j] - triangle.x[i];
+				c[k] = triangle.x[i] * triangle.y[j] - triangle.x[j] * triangle.y[i];
+			}
+
+			// Edge k is opposite vertex k, so the normalised edge values are the barycentrics
+			const float invArea = 1.0f / (a[0] * triangle.x[0] + b[0] * triangle.y[0] + c[0]);
+			const __m128 z0 = _mm_set1_ps(triangle.z[0] * invArea);
+			const __m128 z1 = _mm_set1_ps(triangle.z[1] * invArea);
+			const __m128 z2 = _mm_set1_ps(triangle.z[2] * invArea);
+
+			// A pixel whose centre is this far inside an edge is inside it all over
+			const __m128 inset0 = _mm_set1_ps(0.5f * (std::fabs(a[0]) + std::fabs(b[0])));
+			const __m128 inset1 = _mm_set1_ps(0.5f * (std::fabs(a[1]) + std::fabs(b[1])));
+			const __m128 inset2 = _mm_set1_ps(0.5f * (std::fabs(a[2]) + std::fabs(b[2])));
+
+			// Wholly inside the triangle, the farthest the pixel reaches is the plane at one of its corners. Pixels across
+			// an edge into another face take the farthest depth of the whole occluder.
+			const float slopeX = (a[0] * triangle.z[0] + a[1] * triangle.z[1] + a[2] * triangle.z[2]) * invArea;
+			const float slopeY = (b[0] * triangle.z[0] + b[1] * triangle.z[1] + b[2] * triangle.z[2]) * invArea;
+			const __m128 cornerOffset = _mm_set1_ps(0.5f * (std::fabs(slopeX) + std::fabs(slopeY)));
+			const __m128 farDepth = _mm_set1_ps(triangle.farDepth);
+			const EdgeTest* const edges = m_edgeTests.data() + triangle.firstEdge;
+
+			const __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+			const int startX = triangle.minX & ~3;
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				const float centreY = float(y) + 0.5f;
+				const __m128 row0 = _mm_set1_ps(b[0] * centreY + c[0]);
+				const __m128 row1 = _mm_set1_ps(b[1] * centreY + c[1]);
+				const __m128 row2 = _mm_set1_ps(b[2] * centreY + c[2]);
+
+				float* const depthRow = &m_depth[size_t(y) * m_width];
+
+				for (int x = startX; x <= triangle.maxX; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), pixelOffsets);
+					const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+					const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+					const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+
+					// Centred in this triangle, and wholly inside the occluder's outline
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+					for (uint32_t edge = 0; edge < triangle.edgeCount && _mm_movemask_ps(inside) != 0; ++edge)
+					{
+						const __m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[edge].a), px), _mm_set1_ps(edges[edge].b * centreY + edges[edge].c));
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+					}
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+
+					const __m128 withinTriangle = _mm_and_ps(_mm_cmpge_ps(e0, inset0), _mm_and_ps(_mm_cmpge_ps(e1, inset1), _mm_cmpge_ps(e2, inset2)));
+					const __m128 plane = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, z0), _mm_add_ps(_mm_mul_ps(e1, z1), _mm_mul_ps(e2, z2))), cornerOffset);
+					const __m128 depth = _mm_or_ps(_mm_and_ps(withinTriangle, _mm_min_ps(plane, farDepth)), _mm_andnot_ps(withinTriangle, farDepth));
+					const __m128 current = _mm_loadu_ps(depthRow + x);
+					const __m128 nearest = _mm_min_ps(current, depth);
+					_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+				}
+			}
+		}
+	}
+
+	bool OcclusionCuller::ProjectBox(const Box& box, int& minX, int& minY, int& maxX, int& maxY, float& minDepth) const
+	{
+		float screenMinX = INFINITY, screenMinY = INFINITY;
+		float screenMaxX = -INFINITY, screenMaxY = -INFINITY;
+		minDepth = INFINITY;
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const float p[3] = {
+				(corner & 1) ? box.max[0] : box.min[0],
+				(corner & 2) ? box.max[1] : box.min[1],
+				(corner & 4) ? box.max[2] : box.min[2] };
+
+			float clip[4];
+			Transform(p, m_viewProjection, clip);
+			if (clip[3] < c_NearW)
+				return false;
+
+			const float invW = 1.0f / clip[3];
+			const float x = (clip[0] * invW + 1.0f) * float(m_width) * 0.5f;
+			const float y = (1.0f - clip[1] * invW) * float(m_height) * 0.5f;
+
+			screenMinX = std::min(screenMinX, x);
+			screenMaxX = std::max(screenMaxX, x);
+			screenMinY = std::min(screenMinY, y);
+			screenMaxY = std::max(screenMaxY, y);
+			minDepth = std::min(minDepth, clip[2] * invW);
+		}
+
+		minX = std::max(0, int(std::floor(screenMinX)));
+		minY = std::max(0, int(std::floor(screenMinY)));
+		maxX = std::min(int(m_width) - 1, int(std::floor(screenMaxX)));
+		maxY = std::min(int(m_height) - 1, int(std::floor(screenMaxY)));
+		return true;
+	}
+
+	bool OcclusionCuller::IsVisible(const Box& worldBox) const
+	{
+		int minX, minY, maxX, maxY;
+		float minDepth;
+		if (!ProjectBox(worldBox, minX, minY, maxX, maxY, minDepth))
+			return true; // Crosses the near plane
+
+		// Off screen is the frustum culler's call, not ours
+		if (minX > maxX || minY > maxY)
+			return true;
+
+		const __m128 boxDepth = _mm_set1_ps(minDepth);
+		const int tileMinX = minX / int(TileWidth), tileMaxX = maxX / int(TileWidth);
+		const int tileMinY = minY / int(TileHeight), tileMaxY = maxY / int(TileHeight);
+
+		for (int tileY = tileMinY; tileY <= tileMaxY; ++tileY)
+		{
+			for (int tileX = tileMinX; tileX <= tileMaxX; ++tileX)
+			{
+				// Everything in the tile is in front of the box
+				if (m_tileMaxDepth[tileY * m_tilesX + tileX] < minDepth)
+					continue;
+
+				// Otherwise look for any pixel of the box's rect in this tile that the box is in front of
+				const int x0 = std::max(minX, tileX * int(TileWidth));
+				const int x1 = std::min(maxX, tileX * int(TileWidth) + int(TileWidth) - 1);
+				const int y0 = std::max(minY, tileY * int(TileHeight));
+				const int y1 = std::min(maxY, tileY * int(TileHeight) + int(TileHeight) - 1);
+
+				for (int y = y0; y <= y1; ++y)
+				{
+					const float* const row = &m_depth[size_t(y) * m_width];
+					int x = x0;
+					for (; x + 3 <= x1; x += 4)
+					{
+						if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0)
+							return true;
+					}
+					for (; x <= x1; ++x)
+					{
+						if (row[x] >= minDepth)
+							return true;
+					}
+				}
+			}
+		}
+
+		return false;
+	}
+
+	void OcclusionCuller::TestVisibility(const Box* worldBoxes, uint32_t count, uint8_t* visible)
+	{
+		auto test = [this, worldBoxes, visible](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int i = begin; i < end; ++i)
+					visible[i] = IsVisible(worldBoxes[i]) ? 1 : 0;
+			};
+
+		if (utils::JobSystem::Get() != nullptr)
+			utils::JobSystem::Get()->ParallelFor(count, c_TestBatch, test);
+		else
+			test(0, count);
+
+		uint32_t culled = 0;
+		for (uint32_t i = 0; i < count; ++i)
+			culled += visible[i] == 0;
+
+		m_stats.tested += count;
+		m_stats.culled += culled;
+		s_tested.Add(count);
+		s_occluded.Add(culled);
+	}
+
+} // namespace scene
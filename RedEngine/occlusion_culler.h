@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+
+	// CPU occlusion culling against a small software depth buffer.
+	// Each frame: BeginFrame, AddOccluder for the big, close meshes, RenderOccluders, then test everything else.
+	// Matrices are row-major with row vectors (p' = p * M), the same convention as DirectXMath.
+	// Occluders only fill pixels their outline covers completely, with the farthest depth they reach in the pixel,
+	// so nothing is reported hidden that shows through a gap or past an edge narrower than a pixel.
+	class OcclusionCuller
+	{
+	public:
+		struct Box
+		{
+			float						min[3];
+			float						max[3];
+		};
+
+		struct Stats
+		{
+			uint32_t					occluders;
+			uint32_t					occluderTriangles;
+			uint32_t					rasterisedTriangles; // Survived near plane, backface and screen rejection
+			uint32_t					tested;
+			uint32_t					culled;
+		};
+
+		static const uint32_t			TileWidth = 8;
+		static const uint32_t			TileHeight = 8;
+
+		// The buffer must tile exactly; 256x128 is plenty for a 16:9 view
+		OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+
+		void							BeginFrame(const float viewProjection[16]);
+
+		// positions are xyz floats stride bytes apart. Occluders whose bounds cover less than the minimum screen
+		// fraction are skipped, they cost more to rasterise than they hide.
+		void							AddOccluder(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+											const float world[16], const Box& worldBounds);
+
+		// Rasterises everything added this frame across the job system and builds the tile max depths
+		void							RenderOccluders();
+
+		bool							IsVisible(const Box& worldBox) const;
+
+		// Tests a batch of boxes on the job system, visible[i] is 0 for occluded boxes
+		void							TestVisibility(const Box* worldBoxes, uint32_t count, uint8_t* visible);
+
+		void							SetMinOccluderScreenFraction(float fraction)
+		{
+			m_minOccluderScreenFraction = fraction;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+		// Depth per pixel, 0 nearest to 1 farthest. 1 means no occluder.
+		const float*					GetDepthBuffer() const
+		{
+			return m_depth.data();
+		}
+
+	private:
+		struct ScreenTriangle
+		{
+			float						x[3];
+			float						y[3];
+			float						z[3];
+			int							minX, minY, maxX, maxY;
+			uint32_t					firstEdge, edgeCount; // The occluder's outline edges near it, in m_edgeTests
+			float						farDepth; // Of the whole occluder
+		};
+
+		// Edge function A x + B y + C of an occluder outline edge, positive inside
+		struct EdgeTest
+		{
+			float						a, b, c;
+		};
+
+		struct OutlineEdge
+		{
+			EdgeTest					test; // C less half a pixel's worth, so only pixels wholly inside pass
+			float						minX, minY, maxX, maxY;
+		};
+
+		// Projects the box; returns false if it crosses the near plane. Rect is in pixels, inclusive.
+		bool							ProjectBox(const Box& box, int& minX, int& minY, int& maxX, int& maxY, float& minDepth) const;
+		void							RasteriseBand(int bandMinY, int bandMaxY);
+
+		uint32_t						m_width;
+		uint32_t						m_height;
+		uint32_t						m_tilesX;
+		uint32_t						m_tilesY;
+
+		float							m_viewProjection[16];
+		float							m_minOccluderScreenFraction;
+
+		std::vector<float>				m_depth;
+		std::vector<float>				m_tileMaxDepth;
+		std::vector<ScreenTriangle>		m_triangles;
+		std::vector<EdgeTest>			m_edgeTests;
+
+		// AddOccluder's working space: the occluder's front faces, their first indices, their edges as
+		// (from << 32 | to) vertex indices, and those of the edges no other front face shares
+		std::vector<ScreenTriangle>		m_faces;
+		std::vector<uint32_t>			m_faceIndices;
+		std::vector<uint64_t>			m_edges;
+		std::vector<OutlineEdge>		m_outline;
+
+		Stats							m_stats;
+	};
+
+} // namespace scene
@@ -0,0 +1,265 @@
+#include "red_engine.h"
+#include "offset_allocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace utils
+{
+
+	namespace
+	{
+		// Index of the highest set bit, value must not be 0
+		uint32_t HighestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse(&index, value);
+			return uint32_t(index);
+#else
+			return 31 - uint32_t(__builtin_clz(value));
+#endif
+		}
+
+		// Index of the lowest set bit, value must not be 0
+		uint32_t LowestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(__builtin_ctz(value));
+#endif
+		}
+	}
+
+	OffsetAllocator::OffsetAllocator(uint32_t size) :
+		m_firstLevelMask(0),
+		m_secondLevelMasks{},
+		m_size(size),
+		m_freeUnits(0),
+		m_freeBlocks(0),
+		m_allocations(0)
+	{
+		ASSERT(size > 0, "An offset allocator needs something to allocate.\n");
+
+		for (uint32_t& head : m_binHeads)
+			head = InvalidNode;
+
+		const uint32_t node = NewNode();
+		m_nodes[node].offset = 0;
+		m_nodes[node].size = size;
+		InsertFree(node);
+	}
+
+	OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32_t size)
+	{
+		Allocation allocation = { 0, InvalidNode };
+		if (size == 0 || size > m_freeUnits)
+			return allocation;
+
+		const uint32_t bin = FindFreeBin(GetSearchBin(size));
+		if (bin == InvalidNode)
+			return allocation;
+
+		const uint32_t node = m_binHeads[bin];
+		RemoveFree(node);
+
+		// Give the tail back
+		const uint32_t remainder = m_nodes[node].size - size;
+		if (remainder > 0)
+		{
+			const uint32_t tail = NewNode(); // Can move m_nodes, so no references across this
+			Node& block = m_nodes[node];
+			m_nodes[tail].offset = block.offset + size;
+			m_nodes[tail].size = remainder;
+			m_nodes[tail].previousPhysical = node;
+			m_nodes[tail].nextPhysical = block.nextPhysical;
+			if (block.nextPhysical != InvalidNode)
+				m_nodes[block.nextPhysical].previousPhysical = tail;
+			block.nextPhysical = tail;
+			block.size = size;
+			InsertFree(tail);
+		}
+
+		m_nodes[node].used = true;
+		++m_allocations;
+
+		allocation.offset = m_nodes[node].offset;
+		allocation.node = node;
+		return allocation;
+	}
+
+	void OffsetAllocator::Free(const Allocation& allocation)
+	{
+		uint32_t node = allocation.node;
+		ASSERT(node < m_nodes.size() && m_nodes[node].used, "Freeing an offset that isn't allocated.\n");
+
+		m_nodes[node].used = false;
+		--m_allocations;
+
+		// Swallow free neighbours on either side
+		const uint32_t previous = m_nodes[node].previousPhysical;
+		if (previous != InvalidNode && !m_nodes[previous].used)
+		{
+			RemoveFree(previous);
+			m_nodes[previous].size += m_nodes[node].size;
+			m_nodes[previous].nextPhysical = m_nodes[node].nextPhysical;
+			if (m_nodes[node].nextPhysical != InvalidNode)
+				m_nodes[m_nodes[node].nextPhysical].previousPhysical = previous;
+			m_spareNodes.push_back(node);
+			node = previous;
+		}
+
+		const uint32_t next = m_nodes[node].nextPhysical;
+		if (next != InvalidNode && !m_nodes[next].used)
+		{
+			RemoveFree(next);
+			m_nodes[node].size += m_nodes[next].size;
+			m_nodes[node].nextPhysical = m_nodes[next].nextPhysical;
+			if (m_nodes[next].nextPhysical != InvalidNode)
+				m_nodes[m_nodes[next].nextPhysical].previousPhysical = node;
+			m_spareNodes.push_back(next);
+		}
+
+		InsertFree(node);
+	}
+
+	OffsetAllocator::Stats OffsetAllocator::GetStats() const
+	{
+		Stats stats;
+		stats.size = m_size;
+		stats.usedUnits = m_size - m_freeUnits;
+		stats.freeUnits = m_freeUnits;
+		stats.freeBlocks = m_freeBlocks;
+		stats.allocations = m_allocations;
+		stats.largestFree = 0;
+
+		// Everything bigger is in the highest non-empty bin, but that bin's blocks vary in size
+		if (m_firstLevelMask != 0)
+		{
+			const uint32_t firstLevel = HighestBit(m_firstLevelMask);
+			const uint32_t secondLevel = HighestBit(m_secondLevelMasks[firstLevel]);
+			for (uint32_t node = m_binHeads[firstLevel * SecondLevelCount + secondLevel]; node != InvalidNode; node = m_nodes[node].nextFree)
+			{
+				if (m_nodes[node].size > stats.largestFree)
+					stats.largestFree = m_nodes[node].size;
+			}
+		}
+
+		return stats;
+	}
+
+	uint32_t OffsetAllocator::GetBin(uint32_t size)
+	{
+		// The first level is linear below SecondLevelCount, then each power of two is split SecondLevelCount ways
+		if (size < SecondLevelCount)
+			return size;
+
+		const uint32_t highest = HighestBit(size);
+		const uint32_t firstLevel = highest - SecondLevelBits + 1;
+		const uint32_t secondLevel = (size >> (highest - SecondLevelBits)) & (SecondLevelCount - 1);
+		return firstLevel * SecondLevelCount + secondLevel;
+	}
+
+	uint32_t OffsetAllocator::GetSearchBin(uint32_t size)
+	{
+		// Round up to the next bin boundary, so anything in the bin is big enough
+		if (size >= SecondLevelCount)
+		{
+			const uint32_t round = (1u << (HighestBit(size) - SecondLevelBits)) - 1;
+			if (size > 0xffffffff - round)
+				return BinCount;
+			size += round;
+		}
+		return GetBin(size);
+	}
+
+	uint32_t OffsetAllocator::FindFreeBin(uint32_t bin) const
+	{
+		if (bin >= BinCount)
+			return InvalidNode;
+
+		uint32_t firstLevel = bin / SecondLevelCount;
+		const uint32_t secondLevelMask = m_secondLevelMasks[firstLevel] & (0xffu << (bin % SecondLevelCount));
+		if (secondLevelMask != 0)
+			return firstLevel * SecondLevelCount + LowestBit(secondLevelMask);
+
+		// Nothing left in this size class, take the smallest larger one
+		const uint32_t firstLevelMask = firstLevel + 1 < FirstLevelCount ? m_firstLevelMask & (0xffffffffu << (firstLevel + 1)) : 0;
+		if (firstLevelMask == 0)
+			return InvalidNode;
+
+		firstLevel = LowestBit(firstLevelMask);
+		return firstLevel * SecondLevelCount + LowestBit(m_secondLevelMasks[firstLevel]);
+	}
+
+	uint32_t OffsetAllocator::NewNode()
+	{
+		uint32_t node;
+		if (!m_spareNodes.empty())
+		{
+			node = m_spareNodes.back();
+			m_spareNodes.pop_back();
+		}
+		else
+		{
+			node = uint32_t(m_nodes.size());
+			m_nodes.push_back(Node());
+		}
+
+		Node& entry = m_nodes[node];
+		entry.offset = 0;
+		entry.size = 0;
+		entry.previousPhysical = InvalidNode;
+		entry.nextPhysical = InvalidNode;
+		entry.previousFree = InvalidNode;
+		entry.nextFree = InvalidNode;
+		entry.used = false;
+		return node;
+	}
+
+	void OffsetAllocator::InsertFree(uint32_t node)
+	{
+		const uint32_t bin = GetBin(m_nodes[node].size);
+		const uint32_t head = m_binHeads[bin];
+
+		m_nodes[node].previousFree = InvalidNode;
+		m_nodes[node].nextFree = head;
+		if (head != InvalidNode)
+			m_nodes[head].previousFree = node;
+		m_binHeads[bin] = node;
+
+		m_firstLevelMask |= 1u << (bin / SecondLevelCount);
+		m_secondLevelMasks[bin / SecondLevelCount] |= uint8_t(1u << (bin % SecondLevelCount));
+
+		m_freeUnits += m_nodes[node].size;
+		++m_freeBlocks;
+	}
+
+	void OffsetAllocator::RemoveFree(uint32_t node)
+	{
+		const Node& entry = m_nodes[node];
+		const uint32_t bin = GetBin(entry.size);
+
+		if (entry.previousFree != InvalidNode)
+			m_nodes[entry.previousFree].nextFree = entry.nextFree;
+		else
+			m_binHeads[bin] = entry.nextFree;
+		if (entry.nextFree != InvalidNode)
+			m_nodes[entry.nextFree].previousFree = entry.previousFree;
+
+		if (m_binHeads[bin] == InvalidNode)
+		{
+			m_secondLevelMasks[bin / SecondLevelCount] &= uint8_t(~(1u << (bin % SecondLevelCount)));
+			if (m_secondLevelMasks[bin / SecondLevelCount] == 0)
+				m_firstLevelMask &= ~(1u << (bin / SecondLevelCount));
+		}
+
+		m_freeUnits -= entry.size;
+		--m_freeBlocks;
+	}
+
+} // namespace utils
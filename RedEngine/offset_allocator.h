@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+	// Two-level segregated fit over a range of units, handing out offsets rather than memory, so it can manage
+	// anything addressed by offset such as a GPU buffer. Allocate and Free are O(1): free blocks are binned by
+	// size with a bitmap per level, and freed blocks merge with free neighbours straight away.
+	class OffsetAllocator
+	{
+	public:
+		static const uint32_t			InvalidNode = 0xffffffff;
+
+		struct Allocation
+		{
+			uint32_t					offset;
+			uint32_t					node; // InvalidNode if the allocation failed
+		};
+
+		struct Stats
+		{
+			uint32_t					size;
+			uint32_t					usedUnits;
+			uint32_t					freeUnits;
+			uint32_t					largestFree;
+			uint32_t					freeBlocks;
+			uint32_t					allocations;
+
+			// 0 when all the free space is one block, towards 1 as it splinters
+			float						GetFragmentation() const
+			{
+				return freeUnits > 0 ? 1.0f - float(largestFree) / float(freeUnits) : 0.0f;
+			}
+		};
+
+		explicit OffsetAllocator(uint32_t size);
+
+		Allocation						Allocate(uint32_t size);
+		void							Free(const Allocation& allocation);
+
+		// Only the node is needed to free, so this fits the callers that keep just that
+		uint32_t						GetSize(uint32_t node) const
+		{
+			return m_nodes[node].size;
+		}
+
+		Stats							GetStats() const;
+
+	private:
+		static const uint32_t			SecondLevelBits = 3;
+		static const uint32_t			SecondLevelCount = 1 << SecondLevelBits;
+		static const uint32_t			FirstLevelCount = 32;
+		static const uint32_t			BinCount = FirstLevelCount * SecondLevelCount;
+
+		struct Node
+		{
+			uint32_t					offset;
+			uint32_t					size;
+			uint32_t					previousPhysical; // Neighbours in address order
+			uint32_t					nextPhysical;
+			uint32_t					previousFree; // Within the bin
+			uint32_t					nextFree;
+			bool						used;
+		};
+
+		static uint32_t					GetBin(uint32_t size); // The bin a block of size lives in
+		static uint32_t					GetSearchBin(uint32_t size); // The first bin whose every block holds size
+
+		uint32_t						FindFreeBin(uint32_t bin) const; // First non-empty bin from bin up
+		uint32_t						NewNode();
+		void							InsertFree(uint32_t node);
+		void							RemoveFree(uint32_t node);
+
+		std::vector<Node>				m_nodes;
+		std::vector<uint32_t>			m_spareNodes;
+		uint32_t						m_binHeads[BinCount];
+		uint32_t						m_firstLevelMask;
+		uint8_t							m_secondLevelMasks[FirstLevelCount];
+		uint32_t						m_size;
+		uint32_t						m_freeUnits;
+		uint32_t						m_freeBlocks;
+		uint32_t						m_allocations;
+	};
+
+} // namespace utils
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary layout of an asset pack as written by tools/asset_packer.
+// The table of contents is sorted by name hash, which keeps packs of the same files byte for byte the same; the runtime
+// indexes it in a hash map at mount. Every entry's data starts on an EntryAlignment boundary so it can be handed straight
+// to the GPU.
+namespace assets
+{
+
+	static const uint32_t PackMagic = 0x4B415052; // 'RPAK'
+	static const uint32_t PackVersion = 1;
+	static const uint32_t PackEntryAlignment = 64;
+
+	static const uint32_t PackEntryCompressed = 0x1; // Data is an LZ4 block of uncompressedSize bytes
+
+	struct PackHeader
+	{
+		uint32_t		magic;
+		uint32_t		version;
+		uint32_t		entryCount;
+		uint32_t		entryAlignment;
+		uint64_t		tocOffset; // PackEntry[entryCount]
+		uint64_t		totalSize;
+	};
+	static_assert(sizeof(PackHeader) == 32, "PackHeader layout changed");
+
+	struct PackEntry
+	{
+		uint64_t		nameHash; // utils::HashName of the entry's path
+		uint64_t		offset; // From the start of the pack
+		uint64_t		size; // Bytes stored in the pack
+		uint64_t		uncompressedSize;
+		uint32_t		flags;
+		uint32_t		reserved;
+	};
+	static_assert(sizeof(PackEntry) == 40, "PackEntry layout changed");
+
+} // namespace assets
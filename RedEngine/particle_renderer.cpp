@@ -0,0 +1,150 @@
+#include "red_engine.h"
+#include "particle_renderer.h"
+#include "particle_system.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+#include "ParticleVertexShader.h"
+#include "ParticlePixelShader.h"
+
+#include <cstddef>
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_draws("render.draws");
+		utils::PerfCounter s_uploadBytes("render.particle_upload_bytes");
+
+		// Triangle strip corners of a particle quad, -1 to 1 across
+		const float c_Corners[4][2] = { { -1.0f, 1.0f }, { 1.0f, 1.0f }, { -1.0f, -1.0f }, { 1.0f, -1.0f } };
+	}
+
+	ParticleRenderer::ParticleRenderer() :
+		m_cornerBuffer(nullptr),
+		m_instanceBuffer(nullptr),
+		m_inputLayout(nullptr),
+		m_vertexShader(nullptr),
+		m_pixelShader(nullptr),
+		m_blendState(nullptr),
+		m_depthState(nullptr),
+		m_rasterizerState(nullptr),
+		m_maxParticles(0)
+	{
+	}
+
+	ParticleRenderer::~ParticleRenderer()
+	{
+		Release();
+	}
+
+	bool ParticleRenderer::Create(ID3D11Device* device, uint32_t maxParticles)
+	{
+		ASSERT(!IsCreated(), "The particle renderer has already been created.\n");
+
+		// Instancing needs 9_3 or better
+		if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+		{
+			DEBUG_MESSAGE("No particles below feature level 9_3.\n");
+			return false;
+		}
+
+		m_maxParticles = maxParticles;
+
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		m_resources.push_back(registry->RegisterVertexShader(&m_vertexShader, g_ParticleVertexShader, sizeof(g_ParticleVertexShader)));
+		m_resources.push_back(registry->RegisterPixelShader(&m_pixelShader, g_ParticlePixelShader, sizeof(g_ParticlePixelShader)));
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			// Position and size together
+			{ "POSITION", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(scene::ParticleSystem::Instance, position),
+				D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, offsetof(scene::ParticleSystem::Instance, color), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		m_resources.push_back(registry->RegisterInputLayout(&m_inputLayout, layout, _countof(layout), g_ParticleVertexShader,
+			sizeof(g_ParticleVertexShader)));
+
+		CD3D11_BUFFER_DESC cornerDesc(sizeof(c_Corners), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		m_resources.push_back(registry->RegisterBuffer(&m_cornerBuffer, cornerDesc, c_Corners));
+
+		CD3D11_BUFFER_DESC instanceDesc(maxParticles * sizeof(scene::ParticleSystem::Instance), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC,
+			D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_instanceBuffer, instanceDesc));
+
+		CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+		m_resources.push_back(registry->RegisterBlendState(&m_blendState, blendDesc));
+
+		CD3D11_DEPTH_STENCIL_DESC depthDesc(D3D11_DEFAULT);
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		m_resources.push_back(registry->RegisterDepthStencilState(&m_depthState, depthDesc));
+
+		CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+		rasterizerDesc.CullMode = D3D11_CULL_NONE;
+		m_resources.push_back(registry->RegisterRasterizerState(&m_rasterizerState, rasterizerDesc));
+
+		for (ResourceRegistry::Handle handle : m_resources)
+		{
+			if (handle == ResourceRegistry::InvalidHandle)
+			{
+				Release();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void ParticleRenderer::Release()
+	{
+		while (!m_resources.empty())
+		{
+			if (m_resources.back() != ResourceRegistry::InvalidHandle)
+				ResourceRegistry::Get()->Unregister(m_resources.back());
+			m_resources.pop_back();
+		}
+	}
+
+	void ParticleRenderer::Draw(ID3D11DeviceContext* deviceContext, const scene::ParticleSystem& particles)
+	{
+		ASSERT(IsCreated(), "Drawing particles without the particle renderer.\n");
+
+		if (particles.GetCount() == 0)
+			return;
+
+		// Written by the system's jobs straight into the mapped buffer
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		const HRESULT hr = deviceContext->Map(m_instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+		ASSERT_HANDLE(hr);
+		const uint32_t count = particles.WriteInstances(static_cast<scene::ParticleSystem::Instance*>(mapped.pData), m_maxParticles);
+		deviceContext->Unmap(m_instanceBuffer, 0);
+		s_uploadBytes.Add(int64_t(count) * int64_t(sizeof(scene::ParticleSystem::Instance)));
+
+		ID3D11Buffer* const vertexBuffers[] = { m_cornerBuffer, m_instanceBuffer };
+		const UINT strides[] = { sizeof(c_Corners[0]), sizeof(scene::ParticleSystem::Instance) };
+		const UINT offsets[] = { 0, 0 };
+		deviceContext->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		deviceContext->IASetInputLayout(m_inputLayout);
+		deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+		deviceContext->VSSetShader(m_vertexShader, nullptr, 0);
+		deviceContext->PSSetShader(m_pixelShader, nullptr, 0);
+		deviceContext->OMSetBlendState(m_blendState, nullptr, 0xffffffff);
+		deviceContext->OMSetDepthStencilState(m_depthState, 0);
+		deviceContext->RSSetState(m_rasterizerState);
+
+		deviceContext->DrawInstanced(4, count, 0, 0);
+		s_draws.Add();
+
+		// Leave the defaults behind for whoever draws next
+		deviceContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+		deviceContext->OMSetDepthStencilState(nullptr, 0);
+		deviceContext->RSSetState(nullptr);
+	}
+
+} // namespace DX
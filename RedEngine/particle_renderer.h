@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+	class ParticleSystem;
+}
+
+namespace DX
+{
+
+	// Draws a ParticleSystem as camera-facing quads, one instance per particle, with an instanced billboard
+	// variant of VertexShader.hlsl that reads the view and projection the View binds at b0. The particles go into
+	// a dynamic instance buffer rewritten whole each frame straight from the system's streams. Additive, depth
+	// tested against the scene but not written, so the order they are drawn in doesn't matter.
+	class ParticleRenderer
+	{
+	public:
+		ParticleRenderer();
+		~ParticleRenderer();
+
+		// Particles past maxParticles are left out
+		bool							Create(ID3D11Device* device, uint32_t maxParticles);
+		void							Release();
+
+		bool							IsCreated() const
+		{
+			return !m_resources.empty();
+		}
+
+		// Into whatever target and depth are bound, with the view's constants at b0
+		void							Draw(ID3D11DeviceContext* deviceContext, const scene::ParticleSystem& particles);
+
+	private:
+		ID3D11Buffer*					m_cornerBuffer;
+		ID3D11Buffer*					m_instanceBuffer;
+		ID3D11InputLayout*				m_inputLayout;
+		ID3D11VertexShader*				m_vertexShader;
+		ID3D11PixelShader*				m_pixelShader;
+		ID3D11BlendState*				m_blendState;
+		ID3D11DepthStencilState*		m_depthState;
+		ID3D11RasterizerState*			m_rasterizerState;
+		std::vector<uint32_t>			m_resources; // ResourceRegistry handles
+
+		uint32_t						m_maxParticles;
+	};
+
+} // namespace DX
@@ -0,0 +1,385 @@
+#include "red_engine.h"
+#include "particle_system.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// MSVC takes AVX2 intrinsics anywhere; GCC and Clang only in functions built for it
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+namespace scene
+{
+
+	namespace
+	{
+		utils::PerfCounter s_alive("particles.alive", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_emitted("particles.emitted");
+		utils::PerfCounter s_killed("particles.killed");
+		utils::PerfCounter s_dropped("particles.dropped");
+
+		enum Stream
+		{
+			PositionX, PositionY, PositionZ,
+			VelocityX, VelocityY, VelocityZ,
+			Life,
+			Size,
+			Growth
+		};
+		const uint32_t c_StreamCount = Growth + 1;
+
+		// Chunk-relative pointers to each stream
+		struct ChunkData
+		{
+			float*						streams[c_StreamCount];
+			uint32_t*					colors;
+		};
+
+		struct StepConstants
+		{
+			float						deltaTime;
+			float						damping;
+			float						gravity[3];
+		};
+
+		// For each mask of living lanes, the lanes to gather to pack them to the front, in order
+		struct PackTable
+		{
+			uint32_t					lanes[256][8];
+
+			PackTable()
+			{
+				for (uint32_t mask = 0; mask < 256; ++mask)
+				{
+					uint32_t packed = 0;
+					for (uint32_t lane = 0; lane < 8; ++lane)
+					{
+						if ((mask & (1u << lane)) != 0)
+							lanes[mask][packed++] = lane;
+					}
+					while (packed < 8)
+						lanes[mask][packed++] = 0;
+				}
+			}
+		};
+
+		const PackTable s_packTable;
+
+		// Number of set bits in an 8-bit mask
+		uint32_t CountBits(uint32_t mask)
+		{
+			mask = mask - ((mask >> 1) & 0x55);
+			mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+			return (mask + (mask >> 4)) & 0x0f;
+		}
+
+		// Lanes at or past count are not particles
+		uint32_t TailMask(uint32_t first, uint32_t count, uint32_t width)
+		{
+			return count - first >= width ? (1u << width) - 1 : (1u << (count - first)) - 1;
+		}
+
+		uint32_t IntegrateSse2(const ChunkData& data, uint32_t count, const StepConstants& step)
+		{
+			const __m128 deltaTime = _mm_set1_ps(step.deltaTime);
+			const __m128 damping = _mm_set1_ps(step.damping);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 gravityStep[3] = { _mm_set1_ps(step.gravity[0] * step.deltaTime), _mm_set1_ps(step.gravity[1] * step.deltaTime),
+				_mm_set1_ps(step.gravity[2] * step.deltaTime) };
+
+			uint32_t alive = 0;
+			for (uint32_t i = 0; i < count; i += 4)
+			{
+				__m128 values[c_StreamCount];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					values[VelocityX + axis] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data.streams[VelocityX + axis] + i), damping), gravityStep[axis]);
+					values[PositionX + axis] = _mm_add_ps(_mm_loadu_ps(data.streams[PositionX + axis] + i), _mm_mul_ps(values[VelocityX + axis], deltaTime));
+				}
+				values[Life] = _mm_sub_ps(_mm_loadu_ps(data.streams[Life] + i), deltaTime);
+				values[Growth] = _mm_loadu_ps(data.streams[Growth] + i);
+				values[Size] = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(data.streams[Size] + i), _mm_mul_ps(values[Growth], deltaTime)), zero);
+
+				const uint32_t mask = uint32_t(_mm_movemask_ps(_mm_cmpgt_ps(values[Life], zero))) & TailMask(i, count, 4);
+
+				// No variable shuffle before AVX, so only whole blocks move as vectors; the rest go a lane at a time
+				if (mask == 0xf)
+				{
+					for (uint32_t stream = 0; stream < c_StreamCount; ++stream)
+						_mm_storeu_ps(data.streams[stream] + alive, values[stream]);
+					if (alive != i)
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(data.colors + alive), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.colors + i)));
+					alive += 4;
+					continue;
+				}
+
+				for (uint32_t stream = 0; stream < c_StreamCount; ++stream)
+					_mm_storeu_ps(data.streams[stream] + i, values[stream]);
+				for (uint32_t lane = 0; lane < 4; ++lane)
+				{
+					if ((mask & (1u << lane)) == 0)
+						continue;
+					for (float* stream : data.streams)
+						stream[alive] = stream[i + lane];
+					data.colors[alive] = data.colors[i + lane];
+					++alive;
+				}
+			}
+			return alive;
+		}
+
+		AVX2_FUNCTION uint32_t IntegrateAvx2(const ChunkData& data, uint32_t count, const StepConstants& step)
+		{
+			const __m256 deltaTime = _mm256_set1_ps(step.deltaTime);
+			const __m256 damping = _mm256_set1_ps(step.damping);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 gravityStep[3] = { _mm256_set1_ps(step.gravity[0] * step.deltaTime), _mm256_set1_ps(step.gravity[1] * step.deltaTime),
+				_mm256_set1_ps(step.gravity[2] * step.deltaTime) };
+
+			uint32_t alive = 0;
+			for (uint32_t i = 0; i < count; i += 8)
+			{
+				__m256 values[c_StreamCount];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					values[VelocityX + axis] = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(data.streams[VelocityX + axis] + i), damping), gravityStep[axis]);
+					values[PositionX + axis] = _mm256_add_ps(_mm256_loadu_ps(data.streams[PositionX + axis] + i), _mm256_mul_ps(values[VelocityX + axis], deltaTime));
+				}
+				values[Life] = _mm256_sub_ps(_mm256_loadu_ps(data.streams[Life] + i), deltaTime);
+				values[Growth] = _mm256_loadu_ps(data.streams[Growth] + i);
+				values[Size] = _mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(data.streams[Size] + i), _mm256_mul_ps(values[Growth], deltaTime)), zero);
+
+				const uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(values[Life], zero, _CMP_GT_OQ))) & TailMask(i, count, 8);
+
+				// Stored whole at the packed position; the lanes past the living are overwritten by what follows
+				const __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s_packTable.lanes[mask]));
+				for (uint32_t stream = 0; stream < c_StreamCount; ++stream)
+					_mm256_storeu_ps(data.streams[stream] + alive, _mm256_permutevar8x32_ps(values[stream], lanes));
+
+				const __m256i colors = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data.colors + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(data.colors + alive), _mm256_permutevar8x32_epi32(colors, lanes));
+
+				alive += CountBits(mask);
+			}
+			return alive;
+		}
+
+		// xorshift32, seeded per chunk and frame
+		uint32_t NextRandom(uint32_t& state)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// -1 to 1
+		float RandomSigned(uint32_t& state)
+		{
+			return float(NextRandom(state) >> 8) * (2.0f / 16777216.0f) - 1.0f;
+		}
+
+		// 0 to 1
+		float RandomUnit(uint32_t& state)
+		{
+			return float(NextRandom(state) >> 8) * (1.0f / 16777216.0f);
+		}
+	}
+
+	ParticleSystem::ParticleSystem(uint32_t capacity) :
+		m_chunkCount((capacity + ChunkSize - 1) / ChunkSize),
+		m_gravity{ 0.0f, -9.8f, 0.0f },
+		m_drag(0.0f),
+		m_avx2(HasAvx2()),
+		m_frame(0),
+		m_stats{}
+	{
+		static_assert(c_StreamCount == StreamCount, "The header's stream count is out of date");
+
+		for (std::vector<float>& stream : m_streams)
+			stream.resize(size_t(m_chunkCount) * ChunkSize);
+		m_colors.resize(size_t(m_chunkCount) * ChunkSize);
+		m_chunkCounts.resize(m_chunkCount);
+		m_chunkOffsets.resize(m_chunkCount + 1);
+		m_chunkKilled.resize(m_chunkCount);
+	}
+
+	uint32_t ParticleSystem::AddEmitter(const Emitter& emitter)
+	{
+		m_emitters.push_back(emitter);
+		m_emitterCarry.push_back(0.0f);
+		return uint32_t(m_emitters.size() - 1);
+	}
+
+	bool ParticleSystem::EnableAvx2(bool enable)
+	{
+		m_avx2 = enable && HasAvx2();
+		return m_avx2;
+	}
+
+	bool ParticleSystem::HasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// The OS has to save the YMM registers as well as the CPU having them
+		__cpuid(info, 1);
+		const bool osSaves = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osSaves || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	void ParticleSystem::Update(float deltaTime)
+	{
+		m_stats.emitted = 0;
+		m_stats.killed = 0;
+		m_stats.dropped = 0;
+
+		// Emission is planned against the room each chunk had before this frame's deaths, filling chunks in order
+		m_spawns.clear();
+		uint32_t chunk = 0;
+		uint32_t room = m_chunkCount > 0 ? ChunkSize - m_chunkCounts[0] : 0;
+		for (uint32_t emitter = 0; emitter < m_emitters.size(); ++emitter)
+		{
+			m_emitterCarry[emitter] += m_emitters[emitter].rate * deltaTime;
+			uint32_t count = uint32_t(m_emitterCarry[emitter]);
+			m_emitterCarry[emitter] -= float(count);
+
+			while (count > 0 && chunk < m_chunkCount)
+			{
+				if (room == 0)
+				{
+					if (++chunk < m_chunkCount)
+						room = ChunkSize - m_chunkCounts[chunk];
+					continue;
+				}
+
+				const uint32_t taken = std::min(count, room);
+				m_spawns.push_back({ chunk, emitter, taken });
+				room -= taken;
+				count -= taken;
+				m_stats.emitted += taken;
+			}
+			m_stats.dropped += count;
+		}
+
+		const float damping = std::max(1.0f - m_drag * deltaTime, 0.0f);
+		auto update = [this, deltaTime, damping](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int i = begin; i < end; ++i)
+					UpdateChunk(i, deltaTime, damping);
+			};
+		if (utils::JobSystem::Get() != nullptr)
+			utils::JobSystem::Get()->ParallelFor(m_chunkCount, 1, update);
+		else
+			update(0, m_chunkCount);
+
+		m_stats.alive = 0;
+		for (uint32_t i = 0; i < m_chunkCount; ++i)
+		{
+			m_chunkOffsets[i] = m_stats.alive;
+			m_stats.alive += m_chunkCounts[i];
+			m_stats.killed += m_chunkKilled[i];
+		}
+		m_chunkOffsets[m_chunkCount] = m_stats.alive;
+		++m_frame;
+
+		s_alive.Set(m_stats.alive);
+		s_emitted.Add(m_stats.emitted);
+		s_killed.Add(m_stats.killed);
+		s_dropped.Add(m_stats.dropped);
+	}
+
+	void ParticleSystem::UpdateChunk(uint32_t chunk, float deltaTime, float damping)
+	{
+		const size_t base = size_t(chunk) * ChunkSize;
+		ChunkData data;
+		for (uint32_t stream = 0; stream < StreamCount; ++stream)
+			data.streams[stream] = m_streams[stream].data() + base;
+		data.colors = m_colors.data() + base;
+
+		const StepConstants constants = { deltaTime, damping, { m_gravity[0], m_gravity[1], m_gravity[2] } };
+		const uint32_t before = m_chunkCounts[chunk];
+		uint32_t count = before;
+		if (count > 0)
+			count = m_avx2 ? IntegrateAvx2(data, count, constants) : IntegrateSse2(data, count, constants);
+		m_chunkKilled[chunk] = before - count;
+
+		const auto first = std::lower_bound(m_spawns.begin(), m_spawns.end(), chunk, [](const Spawn& spawn, uint32_t value) { return spawn.chunk < value; });
+		for (auto spawn = first; spawn != m_spawns.end() && spawn->chunk == chunk; ++spawn)
+			Emit(chunk, *spawn, count);
+
+		m_chunkCounts[chunk] = count;
+	}
+
+	void ParticleSystem::Emit(uint32_t chunk, const Spawn& spawn, uint32_t& count)
+	{
+		const Emitter& emitter = m_emitters[spawn.emitter];
+		uint32_t random = (m_frame * 0x9e3779b1u) ^ (chunk * 0x85ebca77u) ^ (spawn.emitter * 0xc2b2ae3du);
+		random = random != 0 ? random : 1;
+
+		const size_t base = size_t(chunk) * ChunkSize;
+		for (uint32_t i = 0; i < spawn.count; ++i)
+		{
+			const size_t particle = base + count++;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				m_streams[PositionX + axis][particle] = emitter.position[axis] + RandomSigned(random) * emitter.positionJitter;
+				m_streams[VelocityX + axis][particle] = emitter.velocity[axis] + RandomSigned(random) * emitter.velocityJitter;
+			}
+			m_streams[Life][particle] = emitter.minLife + RandomUnit(random) * (emitter.maxLife - emitter.minLife);
+			m_streams[Size][particle] = emitter.size;
+			m_streams[Growth][particle] = emitter.growth;
+			m_colors[particle] = emitter.color;
+		}
+	}
+
+	uint32_t ParticleSystem::WriteInstances(Instance* instances, uint32_t maxCount) const
+	{
+		auto write = [this, instances, maxCount](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int chunk = begin; chunk < end; ++chunk)
+				{
+					const uint32_t offset = m_chunkOffsets[chunk];
+					const uint32_t count = std::min(m_chunkCounts[chunk], maxCount - std::min(offset, maxCount));
+					const size_t base = size_t(chunk) * ChunkSize;
+					Instance* const to = instances + offset;
+					for (uint32_t i = 0; i < count; ++i)
+					{
+						to[i].position[0] = m_streams[PositionX][base + i];
+						to[i].position[1] = m_streams[PositionY][base + i];
+						to[i].position[2] = m_streams[PositionZ][base + i];
+						to[i].size = m_streams[Size][base + i];
+						to[i].color = m_colors[base + i];
+					}
+				}
+			};
+		if (utils::JobSystem::Get() != nullptr)
+			utils::JobSystem::Get()->ParallelFor(m_chunkCount, 1, write);
+		else
+			write(0, m_chunkCount);
+
+		return std::min(m_stats.alive, maxCount);
+	}
+
+} // namespace scene
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+
+	// CPU particles for large effects. Particles live in fixed chunks of ChunkSize, each stored as one array per
+	// field, and every chunk is one job a frame: integrate, drop the dead by packing the living down to the front
+	// of the chunk, then emit into the room left at the end. Eight particles at a time with AVX2 where the CPU has it,
+	// four with SSE2 where it doesn't, with the same results either way. Emission draws from a random sequence per
+	// chunk and frame, so a run is the same however many workers there are.
+	class ParticleSystem
+	{
+	public:
+		struct Emitter
+		{
+			float						position[3];
+			float						positionJitter; // Half the side of the cube particles start in
+			float						velocity[3];
+			float						velocityJitter; // Likewise for the starting velocity
+			float						minLife, maxLife; // Seconds
+			float						size; // World units across at birth
+			float						growth; // Size change per second
+			uint32_t					color; // Packed R8G8B8A8
+			float						rate; // Particles per second
+		};
+
+		// What ParticleVertexShader reads per instance
+		struct Instance
+		{
+			float						position[3];
+			float						size;
+			uint32_t					color;
+		};
+
+		struct Stats
+		{
+			uint32_t					alive;
+			uint32_t					emitted;
+			uint32_t					killed;
+			uint32_t					dropped; // Emitted with no room left
+		};
+
+		static const uint32_t			ChunkSize = 16 * 1024;
+
+		// capacity is rounded up to whole chunks
+		explicit ParticleSystem(uint32_t capacity);
+
+		uint32_t						AddEmitter(const Emitter& emitter);
+
+		Emitter&						GetEmitter(uint32_t emitter)
+		{
+			return m_emitters[emitter];
+		}
+
+		void							SetGravity(float x, float y, float z)
+		{
+			m_gravity[0] = x;
+			m_gravity[1] = y;
+			m_gravity[2] = z;
+		}
+
+		// Fraction of the velocity lost per second
+		void							SetDrag(float drag)
+		{
+			m_drag = drag;
+		}
+
+		// AVX2 is used when the CPU has it unless turned off here. Returns whether it is in use.
+		bool							EnableAvx2(bool enable);
+
+		// Steps every particle by deltaTime and emits, across the job system
+		void							Update(float deltaTime);
+
+		// Every living particle, chunk by chunk, across the job system. Returns how many were written, at most maxCount.
+		uint32_t						WriteInstances(Instance* instances, uint32_t maxCount) const;
+
+		uint32_t						GetCapacity() const
+		{
+			return m_chunkCount * ChunkSize;
+		}
+
+		uint32_t						GetCount() const
+		{
+			return m_stats.alive;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+		static bool						HasAvx2();
+
+	private:
+		// Positions, velocities, seconds of life left, size and growth
+		static const uint32_t			StreamCount = 9;
+
+		// Emitter's particles for a chunk this frame
+		struct Spawn
+		{
+			uint32_t					chunk;
+			uint32_t					emitter;
+			uint32_t					count;
+		};
+
+		void							UpdateChunk(uint32_t chunk, float deltaTime, float damping);
+		void							Emit(uint32_t chunk, const Spawn& spawn, uint32_t& count);
+
+		uint32_t						m_chunkCount;
+		std::vector<float>				m_streams[StreamCount]; // Chunk after chunk, ChunkSize apart
+		std::vector<uint32_t>			m_colors;
+		std::vector<uint32_t>			m_chunkCounts;
+		std::vector<uint32_t>			m_chunkOffsets; // Of each chunk's first particle among the living, and the total
+		std::vector<uint32_t>			m_chunkKilled; // This frame's, per chunk
+
+		std::vector<Emitter>			m_emitters;
+		std::vector<float>				m_emitterCarry; // Fractions of a particle owed to each emitter
+		std::vector<Spawn>				m_spawns; // This frame's, in chunk order
+
+		float							m_gravity[3];
+		float							m_drag;
+		bool							m_avx2;
+		uint32_t						m_frame;
+		Stats							m_stats;
+	};
+
+} // namespace scene
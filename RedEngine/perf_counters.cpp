@@ -0,0 +1,261 @@
+#include "red_engine.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace utils
+{
+
+	namespace
+	{
+		const uint32_t c_MaxThreads = 256;
+
+		// Only its own thread writes a block, so updates are a relaxed load and store rather than a locked add
+		struct ThreadBlock
+		{
+			std::atomic<int64_t>		values[PerfCounter::MaxCounters];
+		};
+
+		// All constant initialised, so counters can be used from other statics' constructors
+		std::mutex g_registryMutex;
+		const char* g_names[PerfCounter::MaxCounters];
+		PerfCounter::Kind g_kinds[PerfCounter::MaxCounters];
+		std::atomic<uint32_t> g_counterCount(0);
+
+		ThreadBlock* g_blocks[c_MaxThreads];
+		std::atomic<uint32_t> g_blockCount(0);
+		ThreadBlock g_sharedBlock; // For threads past c_MaxThreads, updated with locked adds
+
+		std::atomic<int64_t> g_gauges[PerfCounter::MaxCounters];
+
+		thread_local ThreadBlock* t_block = nullptr;
+
+		// Blocks outlive their threads, counts already made still belong in the totals
+		ThreadBlock* GetThreadBlock()
+		{
+			if (t_block != nullptr)
+				return t_block;
+
+			std::lock_guard<std::mutex> lock(g_registryMutex);
+			const uint32_t index = g_blockCount.load(std::memory_order_relaxed);
+			if (index == c_MaxThreads)
+				return nullptr;
+
+			ThreadBlock* const block = new ThreadBlock();
+			for (std::atomic<int64_t>& value : block->values)
+				value.store(0, std::memory_order_relaxed);
+
+			g_blocks[index] = block;
+			g_blockCount.store(index + 1, std::memory_order_release);
+			t_block = block;
+			return block;
+		}
+	}
+
+	uint32_t PerfCounter::GetId()
+	{
+		const int32_t id = m_id.load(std::memory_order_acquire);
+		if (id >= 0)
+			return uint32_t(id);
+
+		std::lock_guard<std::mutex> lock(g_registryMutex);
+
+		const uint32_t count = g_counterCount.load(std::memory_order_relaxed);
+		uint32_t found = 0;
+		while (found < count && strcmp(g_names[found], m_name) != 0)
+			++found;
+
+		if (found == count)
+		{
+			ASSERT(count < MaxCounters, "Too many perf counters registering %s.\n", m_name);
+			g_names[count] = m_name;
+			g_kinds[count] = m_kind;
+			g_counterCount.store(count + 1, std::memory_order_release);
+		}
+		else
+		{
+			ASSERT(g_kinds[found] == m_kind, "Perf counter %s is registered as both a counter and a gauge.\n", m_name);
+		}
+
+		m_id.store(int32_t(found), std::memory_order_release);
+		return found;
+	}
+
+	void PerfCounter::Add(int64_t amount)
+	{
+		const uint32_t id = GetId();
+
+		ThreadBlock* const block = GetThreadBlock();
+		if (block != nullptr)
+		{
+			std::atomic<int64_t>& value = block->values[id];
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+		else
+		{
+			g_sharedBlock.values[id].fetch_add(amount, std::memory_order_relaxed);
+		}
+	}
+
+	void PerfCounter::Set(int64_t value)
+	{
+		g_gauges[GetId()].store(value, std::memory_order_relaxed);
+	}
+
+	uint32_t PerfCounter::GetCount()
+	{
+		return g_counterCount.load(std::memory_order_acquire);
+	}
+
+	const char* PerfCounter::GetName(uint32_t id)
+	{
+		return g_names[id];
+	}
+
+	PerfCounter::Kind PerfCounter::GetKind(uint32_t id)
+	{
+		return g_kinds[id];
+	}
+
+	int64_t PerfCounter::ReadTotal(uint32_t id)
+	{
+		if (g_kinds[id] == Gauge)
+			return g_gauges[id].load(std::memory_order_relaxed);
+
+		int64_t total = g_sharedBlock.values[id].load(std::memory_order_relaxed);
+		const uint32_t blockCount = g_blockCount.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < blockCount; ++i)
+			total += g_blocks[i]->values[id].load(std::memory_order_relaxed);
+		return total;
+	}
+
+	PerfCounters::PerfCounters(uint32_t history) :
+		m_previousTotals(PerfCounter::MaxCounters, 0),
+		m_history(size_t(std::max(history, 1u)) * PerfCounter::MaxCounters, 0),
+		m_historySize(std::max(history, 1u)),
+		m_next(0),
+		m_frames(0)
+	{
+	}
+
+	void PerfCounters::EndFrame()
+	{
+		// Totals only ever grow, so the frame's count is the difference from last time and nothing is reset
+		// underneath the threads still adding to them
+		int64_t* const row = &m_history[size_t(m_next) * PerfCounter::MaxCounters];
+		const uint32_t count = PerfCounter::GetCount();
+		for (uint32_t id = 0; id < count; ++id)
+		{
+			const int64_t total = PerfCounter::ReadTotal(id);
+			if (PerfCounter::GetKind(id) == PerfCounter::Gauge)
+			{
+				row[id] = total;
+			}
+			else
+			{
+				row[id] = total - m_previousTotals[id];
+				m_previousTotals[id] = total;
+			}
+		}
+
+		m_next = (m_next + 1) % m_historySize;
+		++m_frames;
+	}
+
+	int64_t PerfCounters::GetValue(const char* name) const
+	{
+		if (m_frames == 0)
+			return 0;
+
+		const uint32_t count = PerfCounter::GetCount();
+		for (uint32_t id = 0; id < count; ++id)
+		{
+			if (strcmp(PerfCounter::GetName(id), name) == 0)
+				return GetFrame(GetFrameCount() - 1)[id];
+		}
+		return 0;
+	}
+
+	int64_t PerfCounters::GetLastValue(uint32_t id) const
+	{
+		if (m_frames == 0 || id >= PerfCounter::MaxCounters)
+			return 0;
+
+		return GetFrame(GetFrameCount() - 1)[id];
+	}
+
+	uint32_t PerfCounters::GetFrameCount() const
+	{
+		return uint32_t(std::min<uint64_t>(m_frames, m_historySize));
+	}
+
+	const int64_t* PerfCounters::GetFrame(uint32_t age) const
+	{
+		const uint32_t oldest = m_frames < m_historySize ? 0 : m_next;
+		return &m_history[size_t((oldest + age) % m_historySize) * PerfCounter::MaxCounters];
+	}
+
+	bool PerfCounters::WriteCsv(const char* path) const
+	{
+		FILE* const file = fopen(path, "w");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write perf counters to %s.\n", path);
+			return false;
+		}
+
+		const uint32_t count = PerfCounter::GetCount();
+		const uint32_t frames = GetFrameCount();
+		const uint64_t firstFrame = m_frames - frames;
+
+		fprintf(file, "frame");
+		for (uint32_t id = 0; id < count; ++id)
+			fprintf(file, ",%s", PerfCounter::GetName(id));
+		fprintf(file, "\n");
+
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			const int64_t* const row = GetFrame(frame);
+			fprintf(file, "%llu", static_cast<unsigned long long>(firstFrame + frame));
+			for (uint32_t id = 0; id < count; ++id)
+				fprintf(file, ",%lld", static_cast<long long>(row[id]));
+			fprintf(file, "\n");
+		}
+
+		fclose(file);
+		return true;
+	}
+
+	bool PerfCounters::WriteJson(const char* path) const
+	{
+		FILE* const file = fopen(path, "w");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write perf counters to %s.\n", path);
+			return false;
+		}
+
+		const uint32_t count = PerfCounter::GetCount();
+		const uint32_t frames = GetFrameCount();
+
+		// Names are code identifiers like "render.draws", nothing in them needs escaping
+		fprintf(file, "{\n  \"firstFrame\": %llu,\n  \"frames\": %u,\n  \"counters\": [\n",
+			static_cast<unsigned long long>(m_frames - frames), frames);
+		for (uint32_t id = 0; id < count; ++id)
+		{
+			fprintf(file, "    { \"name\": \"%s\", \"kind\": \"%s\", \"values\": [", PerfCounter::GetName(id),
+				PerfCounter::GetKind(id) == PerfCounter::Gauge ? "gauge" : "counter");
+			for (uint32_t frame = 0; frame < frames; ++frame)
+				fprintf(file, frame == 0 ? "%lld" : ", %lld", static_cast<long long>(GetFrame(frame)[id]));
+			fprintf(file, "] }%s\n", id + 1 < count ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+
+		fclose(file);
+		return true;
+	}
+
+} // namespace utils
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+	// A named metric. Declare them as statics next to the code they measure:
+	//     static utils::PerfCounter s_draws("render.draws");
+	//     s_draws.Add();
+	// Counters with the same name share a value. Counters are summed per frame, each thread adding to its own
+	// slot with relaxed atomics so nothing is shared on the hot path. Gauges hold the last value set.
+	class PerfCounter
+	{
+	public:
+		enum Kind : uint32_t
+		{
+			Counter,
+			Gauge,
+		};
+
+		static const uint32_t			MaxCounters = 128;
+
+		constexpr PerfCounter(const char* name, Kind kind = Counter) :
+			m_name(name),
+			m_kind(kind),
+			m_id(-1)
+		{
+		}
+
+		void							Add(int64_t amount = 1);
+		void							Set(int64_t value);
+
+		// Registered so far, ids are 0 to count - 1
+		static uint32_t					GetCount();
+		static const char*				GetName(uint32_t id);
+		static Kind						GetKind(uint32_t id);
+
+	private:
+		friend class PerfCounters;
+
+		uint32_t						GetId(); // Registers the name on first use
+
+		// Sum over every thread that has touched the counter, or the gauge's value
+		static int64_t					ReadTotal(uint32_t id);
+
+		const char*						m_name;
+		Kind							m_kind;
+		std::atomic<int32_t>			m_id;
+	};
+
+	// Per-frame values of every counter with a rolling history, for the HUD and for dumping at shutdown
+	class PerfCounters
+	{
+	public:
+		explicit PerfCounters(uint32_t history = 600);
+
+		// Turns the running totals into this frame's values. Once a frame, from one thread.
+		void							EndFrame();
+
+		// Last completed frame, 0 for a name that has never been used
+		int64_t							GetValue(const char* name) const;
+		int64_t							GetLastValue(uint32_t id) const;
+
+		// Oldest frame first, one column per counter
+		bool							WriteCsv(const char* path) const;
+		bool							WriteJson(const char* path) const;
+
+	private:
+		uint32_t						GetFrameCount() const;
+		const int64_t*					GetFrame(uint32_t age) const; // 0 is the oldest kept
+
+		std::vector<int64_t>			m_previousTotals;
+		std::vector<int64_t>			m_history; // history rows of MaxCounters
+		uint32_t						m_historySize;
+		uint32_t						m_next;
+		uint64_t						m_frames;
+	};
+
+} // namespace utils
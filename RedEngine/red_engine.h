@@ -1 +1,4 @@
 #pragma once
+
+// DEBUG_MESSAGE goes through the asynchronous logger
+#include "logger.h"
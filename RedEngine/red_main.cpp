@@ -5,14 +5,47 @@
 #include "red_engine.h"
 #include "core.h"
 #include "list.h"
+#include "job_system.h"
+#include "replay.h"
+#include "benchmark_report.h"
+
+#include <shellapi.h>
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
 LPCWSTR g_szAppName = L"Red Engine";
-static const float MinFrameTime = 1.0f / 75.0f - 0.0001f;
+static const double TargetFrameRate = 75.0;
+static const char* const LogPath = "red_engine.log";
+static const char* const DefaultReportPath = "benchmark.json";
+static const int ReplayWidth = 1280, ReplayHeight = 720;
+static const uint32_t CaptureFrame = 120; // Late enough for streaming and the caches to have settled
+
+// Command line:
+//     -record <file>                 play normally, saving the input and time steps to file on exit
+//     -replay <file>                 play file back headlessly as fast as it will go and report the timings
+//         [-frames <n>]              frames to run, looping the recording, defaults to its length
+//         [-dt <seconds>]            fixed time step, defaults to 1 / TargetFrameRate, 0 uses the recorded steps
+//         [-report <file>]           where the JSON goes, defaults to DefaultReportPath
+//     -capture <file>                write frame CaptureFrame's device context calls to file, for tools/command_replay
+//     -devicelost <frame>            throw the device away before frame and log how long recovery takes
+//     -renderscale <scale>           pin the scene's render scale, 0 for dynamic; replays default to 1 so runs compare
+struct Options
+{
+	char recordPath[MAX_PATH];
+	char replayPath[MAX_PATH];
+	char reportPath[MAX_PATH];
+	char capturePath[MAX_PATH];
+	uint32_t frames;
+	double timeStep;
+	uint32_t deviceLostFrame; // 0 for never
+	float renderScale; // Negative for the default
+};
 
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
+static bool ParseCommandLine(Options& options);
+static int RunReplay(const Options& options);
+static int Teardown(int result, bool uninitialiseCom);
 
 // Entry point
 int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
@@ -21,13 +54,28 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 	UNREFERENCED_PARAMETER(lpCmdLine);
 
 	memory::Heap::Create();
+	utils::Logger::Create(LogPath);
+	utils::JobSystem::Create();
 
 	if (!XMVerifyCPUSupport())
-		return 1;
+	{
+		DEBUG_MESSAGE("This CPU lacks the instructions DirectXMath was built for.\n");
+		return Teardown(1, false);
+	}
 
 	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED);
 	if (FAILED(hr))
-		return 1;
+	{
+		DEBUG_MESSAGE("CoInitializeEx failed: 0x%08X\n", unsigned(hr));
+		return Teardown(1, false);
+	}
+
+	Options options;
+	if (!ParseCommandLine(options))
+		return Teardown(1, true);
+
+	if (options.replayPath[0] != 0)
+		return Teardown(RunReplay(options), true);
 
 	DEBUG_MESSAGE("Creating core object.\n");
 	Core* const core = new Core();
@@ -49,7 +97,11 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 		wcEx.lpszClassName = L"DirectXTKSimpleSampleWindowClass";
 		wcEx.hIconSm = LoadIconW(wcEx.hInstance, L"IDI_ICON");
 		if (!RegisterClassExW(&wcEx))
-			return 1;
+		{
+			DEBUG_MESSAGE("RegisterClassExW failed: %u\n", unsigned(GetLastError()));
+			delete core;
+			return Teardown(1, true);
+		}
 
 		// Create window
 		int width = 1280, height = 720;
@@ -63,7 +115,11 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 			nullptr);
 
 		if (!hWnd)
-			return 1;
+		{
+			DEBUG_MESSAGE("CreateWindowExW failed: %u\n", unsigned(GetLastError()));
+			delete core;
+			return Teardown(1, true);
+		}
 
 		ShowWindow(hWnd, nCmdShow);
 
@@ -76,34 +132,174 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
 	utils::Timers::InitialiseTimers();
 
+	utils::FrameLimiter& frameLimiter = core->GetFrameLimiter();
+	frameLimiter.SetTargetFrameRate(TargetFrameRate);
+
+	utils::ResolutionScaler& resolutionScaler = core->GetResolutionScaler();
+	resolutionScaler.SetTargetFrameTime(1.0 / TargetFrameRate);
+	if (options.renderScale >= 0.0f)
+		resolutionScaler.SetFixedScale(options.renderScale);
+
+	utils::Replay recording;
+	if (options.recordPath[0] != 0)
+		core->SetRecording(&recording);
+
 	// Main message loop
 	MSG msg = {};
+	uint32_t frame = 0;
 	while (WM_QUIT != msg.message)
 	{
-		if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+		// Sleep off the rest of the frame before taking messages, so the input the frame sees is as late as it can be
+		frameLimiter.BeginFrame();
+
+		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
 		{
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
+
+			if (msg.message == WM_QUIT)
+				break;
 		}
-		else
-		{
-			utils::Timers::UpdateFrameTimer();
-			const float frameTime = utils::Timers::GetFrameTime();
-			if (frameTime > MinFrameTime)
-				core->Update();
-			core->Render();
-		}
+
+		if (msg.message == WM_QUIT)
+			break;
+
+		if (options.capturePath[0] != 0 && frame == CaptureFrame)
+			core->CaptureNextFrame(options.capturePath);
+		if (options.deviceLostFrame != 0 && frame == options.deviceLostFrame)
+			core->SimulateDeviceLost();
+
+		utils::Timers::UpdateFrameTimer();
+		core->Update();
+		core->Render();
+		++frame;
+
+		frameLimiter.EndFrame();
+	}
+
+	if (options.recordPath[0] != 0)
+	{
+		core->SetRecording(nullptr);
+		if (recording.Save(options.recordPath))
+			DEBUG_MESSAGE("Recorded %u frames and %u input events to %s.\n", recording.GetFrameCount(), recording.GetEventCount(), options.recordPath);
 	}
 
 	core->Shutdown();
 
 	delete core;
 
-	CoUninitialize();
+	return Teardown((int)msg.wParam, true);
+}
+
+// Every way out of wWinMain comes through here. Destroying the logger writes out what is still queued, so the
+// reason for an early exit reaches the log file.
+static int Teardown(int result, bool uninitialiseCom)
+{
+	if (uninitialiseCom)
+		CoUninitialize();
 
+	utils::JobSystem::Destroy();
+	utils::Logger::Destroy();
 	memory::Heap::Destroy();
 
-	return (int)msg.wParam;
+	return result;
+}
+
+static bool ParseCommandLine(Options& options)
+{
+	options.recordPath[0] = 0;
+	options.replayPath[0] = 0;
+	strcpy_s(options.reportPath, DefaultReportPath);
+	options.capturePath[0] = 0;
+	options.frames = 0;
+	options.timeStep = 1.0 / TargetFrameRate;
+	options.deviceLostFrame = 0;
+	options.renderScale = -1.0f;
+
+	int argc = 0;
+	LPWSTR* const argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	if (argv == nullptr)
+		return false;
+
+	// argv[0] is the program
+	bool ok = true;
+	for (int i = 1; i < argc && ok; ++i)
+	{
+		char* path = nullptr;
+		if (wcscmp(argv[i], L"-record") == 0)
+			path = options.recordPath;
+		else if (wcscmp(argv[i], L"-replay") == 0)
+			path = options.replayPath;
+		else if (wcscmp(argv[i], L"-report") == 0)
+			path = options.reportPath;
+		else if (wcscmp(argv[i], L"-capture") == 0)
+			path = options.capturePath;
+
+		if (path != nullptr && i + 1 < argc)
+			ok = WideCharToMultiByte(CP_UTF8, 0, argv[++i], -1, path, MAX_PATH, nullptr, nullptr) > 0;
+		else if (wcscmp(argv[i], L"-frames") == 0 && i + 1 < argc)
+			options.frames = uint32_t(_wtoi(argv[++i]));
+		else if (wcscmp(argv[i], L"-dt") == 0 && i + 1 < argc)
+			options.timeStep = _wtof(argv[++i]);
+		else if (wcscmp(argv[i], L"-devicelost") == 0 && i + 1 < argc)
+			options.deviceLostFrame = uint32_t(_wtoi(argv[++i]));
+		else if (wcscmp(argv[i], L"-renderscale") == 0 && i + 1 < argc)
+			options.renderScale = float(_wtof(argv[++i]));
+		else
+		{
+			DEBUG_MESSAGE("Unknown or incomplete argument %ls.\n", argv[i]);
+			ok = false;
+		}
+	}
+
+	LocalFree(argv);
+	return ok;
+}
+
+// The same workload every time: no window, no frame limiter, input and time steps from the recording
+static int RunReplay(const Options& options)
+{
+	utils::Replay replay;
+	if (!replay.Load(options.replayPath) || replay.GetFrameCount() == 0)
+		return 1;
+
+	const uint32_t frames = options.frames > 0 ? options.frames : replay.GetFrameCount();
+	DEBUG_MESSAGE("Replaying %s for %u frames.\n", options.replayPath, frames);
+
+	Core* const core = new Core(true);
+	core->Initialise(nullptr, ReplayWidth, ReplayHeight);
+
+	utils::ResolutionScaler& resolutionScaler = core->GetResolutionScaler();
+	resolutionScaler.SetTargetFrameTime(1.0 / TargetFrameRate);
+	resolutionScaler.SetFixedScale(options.renderScale >= 0.0f ? options.renderScale : 1.0f);
+
+	utils::Timers::InitialiseTimers();
+
+	utils::BenchmarkReport report(frames);
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		const uint32_t recorded = frame % replay.GetFrameCount();
+		core->SetFixedTimeStep(options.timeStep > 0.0 ? options.timeStep : replay.GetTimeStep(recorded));
+		replay.Play(recorded, core->GetInputEvents());
+
+		if (options.capturePath[0] != 0 && frame == CaptureFrame)
+			core->CaptureNextFrame(options.capturePath);
+		if (options.deviceLostFrame != 0 && frame == options.deviceLostFrame)
+			core->SimulateDeviceLost();
+
+		core->Update();
+		core->Render();
+
+		report.AddFrame(core->GetFramePhases());
+	}
+
+	core->Shutdown();
+	delete core;
+
+	const utils::BenchmarkReport::Summary frame = report.Summarise(utils::FramePhases::Count);
+	DEBUG_MESSAGE("Frame mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms.\n", frame.mean, frame.p50, frame.p99, frame.max);
+
+	return report.WriteJson(options.reportPath, options.replayPath, options.timeStep) ? 0 : 1;
 }
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -126,11 +322,25 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		PostQuitMessage(0);
 		break;
 
+	case WM_SIZE:
+		if (wParam != SIZE_MINIMIZED && Core::Get() != nullptr)
+			Core::Get()->OnWindowSizeChanged(int(LOWORD(lParam)), int(HIWORD(lParam)));
+		break;
+
 	case WM_KEYDOWN:
 	case WM_KEYUP:
 	case WM_SYSKEYUP:
-		Keyboard::ProcessMessage(message, wParam, lParam);
+	{
+		// Queued with the time it arrived, the update tick applies it
+		input::InputEvent event = {};
+		event.timestamp = input::Now();
+		event.type = message == WM_KEYDOWN ? input::InputEvent::KeyDown : input::InputEvent::KeyUp;
+		event.key = uint32_t(wParam);
+		event.flags = uint32_t(lParam);
+		if (Core::Get() != nullptr)
+			Core::Get()->GetInputEvents().Push(event);
 		break;
+	}
 
 	default:
 		break;
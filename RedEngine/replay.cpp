@@ -0,0 +1,156 @@
+#include "red_engine.h"
+#include "replay.h"
+
+#include <cstdio>
+
+namespace utils
+{
+
+	namespace
+	{
+		const uint32_t c_ReplayMagic = 0x4C505252; // 'RRPL'
+		const uint32_t c_ReplayVersion = 1;
+
+		// File layout: the header, then frameCount FileFrames, then eventCount input::InputEvents
+		struct FileHeader
+		{
+			uint32_t		magic;
+			uint32_t		version;
+			uint32_t		frameCount;
+			uint32_t		eventCount;
+		};
+		static_assert(sizeof(FileHeader) == 16, "FileHeader layout changed");
+
+		struct FileFrame
+		{
+			double			timeStep;
+			uint32_t		eventCount;
+			uint32_t		reserved;
+		};
+		static_assert(sizeof(FileFrame) == 16, "FileFrame layout changed");
+		static_assert(sizeof(input::InputEvent) == 24, "InputEvent layout changed, bump c_ReplayVersion");
+	}
+
+	void Replay::BeginFrame(double timeStep)
+	{
+		Frame frame;
+		frame.timeStep = timeStep;
+		frame.firstEvent = uint32_t(m_events.size());
+		frame.eventCount = 0;
+		m_frames.push_back(frame);
+	}
+
+	void Replay::AddEvent(const input::InputEvent& event)
+	{
+		ASSERT(!m_frames.empty(), "Recording an input event before the first frame.\n");
+
+		m_events.push_back(event);
+		++m_frames.back().eventCount;
+	}
+
+	bool Replay::Save(const char* path) const
+	{
+		FILE* const file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to write replay %s.\n", path);
+			return false;
+		}
+
+		const FileHeader header = { c_ReplayMagic, c_ReplayVersion, GetFrameCount(), GetEventCount() };
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+		for (const Frame& frame : m_frames)
+		{
+			const FileFrame fileFrame = { frame.timeStep, frame.eventCount, 0 };
+			ok = ok && fwrite(&fileFrame, sizeof(fileFrame), 1, file) == 1;
+		}
+
+		if (!m_events.empty())
+			ok = ok && fwrite(m_events.data(), sizeof(input::InputEvent), m_events.size(), file) == m_events.size();
+
+		fclose(file);
+
+		if (!ok)
+			DEBUG_MESSAGE("Failed writing replay %s.\n", path);
+		return ok;
+	}
+
+	bool Replay::Load(const char* path)
+	{
+		m_frames.clear();
+		m_events.clear();
+
+		FILE* const file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to open replay %s.\n", path);
+			return false;
+		}
+
+		FileHeader header = {};
+		bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == c_ReplayMagic && header.version == c_ReplayVersion;
+
+		uint32_t eventTotal = 0;
+		if (ok)
+		{
+			m_frames.resize(header.frameCount);
+			for (Frame& frame : m_frames)
+			{
+				FileFrame fileFrame;
+				if (fread(&fileFrame, sizeof(fileFrame), 1, file) != 1)
+				{
+					ok = false;
+					break;
+				}
+
+				frame.timeStep = fileFrame.timeStep;
+				frame.firstEvent = eventTotal;
+				frame.eventCount = fileFrame.eventCount;
+				eventTotal += fileFrame.eventCount;
+			}
+		}
+
+		ok = ok && eventTotal == header.eventCount;
+		if (ok && eventTotal > 0)
+		{
+			m_events.resize(eventTotal);
+			ok = fread(m_events.data(), sizeof(input::InputEvent), eventTotal, file) == eventTotal;
+		}
+
+		fclose(file);
+
+		if (!ok)
+		{
+			DEBUG_MESSAGE("Replay %s is damaged or from another version.\n", path);
+			m_frames.clear();
+			m_events.clear();
+		}
+		return ok;
+	}
+
+	double Replay::GetTimeStep(uint32_t frame) const
+	{
+		ASSERT(frame < GetFrameCount(), "Replay frame %u out of range.\n", frame);
+		return m_frames[frame].timeStep;
+	}
+
+	uint32_t Replay::Play(uint32_t frame, input::InputEventQueue& queue) const
+	{
+		ASSERT(frame < GetFrameCount(), "Replay frame %u out of range.\n", frame);
+
+		const uint64_t now = input::Now();
+		const Frame& recorded = m_frames[frame];
+
+		uint32_t pushed = 0;
+		for (uint32_t i = 0; i < recorded.eventCount; ++i)
+		{
+			input::InputEvent event = m_events[recorded.firstEvent + i];
+			event.timestamp = now;
+			if (queue.Push(event))
+				++pushed;
+		}
+		return pushed;
+	}
+
+} // namespace utils
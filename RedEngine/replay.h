@@ -0,0 +1,51 @@
+#pragma once
+
+#include "input_events.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace utils
+{
+
+	// The input and timestep streams of a run, so it can be played again frame for frame. Recording takes each
+	// frame's time step and every event the update tick consumed; playback hands the same events back to the queue
+	// at the start of the same frame, restamped with the current time so latency still measures this run.
+	class Replay
+	{
+	public:
+		// Recording: a frame at a time, the events going to the last frame begun
+		void							BeginFrame(double timeStep);
+		void							AddEvent(const input::InputEvent& event);
+
+		bool							Save(const char* path) const;
+		bool							Load(const char* path);
+
+		uint32_t						GetFrameCount() const
+		{
+			return uint32_t(m_frames.size());
+		}
+
+		uint32_t						GetEventCount() const
+		{
+			return uint32_t(m_events.size());
+		}
+
+		double							GetTimeStep(uint32_t frame) const;
+
+		// Playback: pushes the frame's events, returns how many the queue took
+		uint32_t						Play(uint32_t frame, input::InputEventQueue& queue) const;
+
+	private:
+		struct Frame
+		{
+			double						timeStep; // Seconds
+			uint32_t					firstEvent;
+			uint32_t					eventCount;
+		};
+
+		std::vector<Frame>				m_frames;
+		std::vector<input::InputEvent>	m_events;
+	};
+
+} // namespace utils
@@ -0,0 +1,162 @@
+#include "red_engine.h"
+#include "resolution_scaler.h"
+#include "perf_counters.h"
+
+#include <cmath>
+
+namespace utils
+{
+
+	namespace
+	{
+		utils::PerfCounter s_renderScale("render.scale_percent", utils::PerfCounter::Gauge);
+
+		float Clamp(float value, float low, float high)
+		{
+			return value < low ? low : (value > high ? high : value);
+		}
+	}
+
+	ResolutionScaler::Settings ResolutionScaler::GetDefaultSettings(double targetFrameTime)
+	{
+		Settings settings;
+		settings.targetFrameTime = targetFrameTime;
+		settings.headroom = 0.1f;
+		settings.minScale = 0.5f;
+		settings.maxScale = 1.0f;
+		settings.proportional = 0.5f;
+		settings.integral = 0.05f;
+		settings.derivative = 0.1f;
+		settings.increaseRate = 0.5f;
+		settings.deadband = 0.05f;
+		settings.step = 1.0f / 32.0f;
+		settings.settleFrames = 3;
+		settings.smoothing = 0.3f;
+		return settings;
+	}
+
+	ResolutionScaler::ResolutionScaler(const Settings& settings) :
+		m_settings(settings),
+		m_stats{},
+		m_scale(settings.maxScale),
+		m_fixedScale(0.0f),
+		m_refreshInterval(0.0),
+		m_filteredTime(0.0),
+		m_integral(0.0),
+		m_lastError(0.0),
+		m_settle(0)
+	{
+		ASSERT(settings.minScale > 0.0f && settings.minScale <= settings.maxScale, "Render scale bounds are the wrong way round.\n");
+		ASSERT(settings.targetFrameTime > 0.0, "A resolution scaler needs a frame time to aim for.\n");
+
+		m_stats.lowestScale = m_scale;
+	}
+
+	float ResolutionScaler::Update(double frameSeconds)
+	{
+		// Under vertical sync a frame is late only when it misses its refresh
+		const double budget = m_settings.targetFrameTime > m_refreshInterval ? m_settings.targetFrameTime : m_refreshInterval;
+
+		++m_stats.frames;
+		m_stats.overBudget += frameSeconds > budget;
+		m_stats.scaleSum += m_scale;
+
+		// One slow frame is noise, a run of them is load
+		m_filteredTime = m_filteredTime > 0.0 ? m_filteredTime + (frameSeconds - m_filteredTime) * m_settings.smoothing : frameSeconds;
+
+		// Positive with time to spare. A frame that makes its refresh is on time however close it comes, and
+		// aiming faster than the display shows frames would only give up pixels for nothing
+		const double headroomPoint = m_settings.targetFrameTime * (1.0 - m_settings.headroom);
+		const double setPoint = headroomPoint > m_refreshInterval ? headroomPoint : m_refreshInterval;
+		const double error = (setPoint - m_filteredTime) / setPoint;
+		const double derivative = error - m_lastError;
+		m_lastError = error;
+
+		if (m_fixedScale > 0.0f)
+			return m_scale;
+
+		if (m_settle > 0)
+		{
+			--m_settle;
+			return m_scale;
+		}
+
+		// Near enough is left alone, and the integral doesn't creep while it is
+		if (std::fabs(error) < m_settings.deadband)
+			return m_scale;
+
+		// What built up going one way mustn't carry it past the level once the error turns round
+		const double rate = error > 0.0 ? m_settings.increaseRate : 1.0;
+		const double integral = (m_integral * error < 0.0 ? 0.0 : m_integral) + error;
+		const double output = rate * (m_settings.proportional * error + m_settings.integral * integral + m_settings.derivative * derivative);
+
+		// The output is a relative change in area, which is what the frame time follows
+		const double area = double(m_scale) * double(m_scale) * (1.0 + output);
+		const float wanted = area > 0.0 ? float(std::sqrt(area)) : m_settings.minScale;
+		const float bounded = Clamp(wanted, m_settings.minScale, m_settings.maxScale);
+
+		// Only integrate while the scale can still move that way, or it winds up against the bounds
+		if (bounded == wanted)
+			m_integral = integral;
+
+		// Toward the current scale, so a change needs a whole step of push
+		const float steps = (bounded - m_scale) / m_settings.step;
+		const float quantised = Clamp(m_scale + float(int(steps)) * m_settings.step, m_settings.minScale, m_settings.maxScale);
+		if (quantised != m_scale)
+		{
+			m_scale = quantised;
+			m_settle = m_settings.settleFrames;
+			++m_stats.changes;
+			if (m_scale < m_stats.lowestScale)
+				m_stats.lowestScale = m_scale;
+			s_renderScale.Set(int64_t(m_scale * 100.0f + 0.5f));
+		}
+
+		return m_scale;
+	}
+
+	void ResolutionScaler::SetFixedScale(float scale)
+	{
+		m_fixedScale = scale;
+		if (scale > 0.0f)
+			m_scale = Clamp(scale, m_settings.minScale, m_settings.maxScale);
+		else
+			m_integral = 0.0;
+
+		s_renderScale.Set(int64_t(m_scale * 100.0f + 0.5f));
+	}
+
+	void ResolutionScaler::SetTargetFrameTime(double seconds)
+	{
+		ASSERT(seconds > 0.0, "A resolution scaler needs a frame time to aim for.\n");
+		m_settings.targetFrameTime = seconds;
+		m_integral = 0.0;
+	}
+
+	void ResolutionScaler::SetRefreshInterval(double seconds)
+	{
+		ASSERT(seconds >= 0.0, "A refresh interval can't be negative.\n");
+		if (seconds != m_refreshInterval)
+			m_integral = 0.0;
+		m_refreshInterval = seconds;
+	}
+
+	void ResolutionScaler::GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+	{
+		width = uint32_t(float(outputWidth) * m_scale + 0.5f);
+		height = uint32_t(float(outputHeight) * m_scale + 0.5f);
+		width = width > 0 ? width : 1;
+		height = height > 0 ? height : 1;
+	}
+
+	void ResolutionScaler::LogReport() const
+	{
+		if (m_stats.frames == 0)
+			return;
+
+		DEBUG_MESSAGE("Render scale: mean %.2f, lowest %.2f, %u changes over %u frames, %.1f%% of frames over %.2f ms.\n",
+			m_stats.scaleSum / double(m_stats.frames), m_stats.lowestScale, m_stats.changes, m_stats.frames,
+			100.0 * double(m_stats.overBudget) / double(m_stats.frames), m_settings.targetFrameTime * 1000.0);
+	}
+
+} // namespace utils
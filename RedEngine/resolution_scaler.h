@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+namespace utils
+{
+
+	// Picks the scene's render scale each frame from how long frames are taking, so heavy scenes drop pixels
+	// rather than frames. A PID controller on the relative frame time error drives the rendered area, which is
+	// what the cost follows; the scale is its square root. Errors inside the deadband leave the scale alone, and
+	// changes are quantised and spaced out so the frame graph isn't reallocating targets every frame.
+	// Pure arithmetic on the times it is given, so tools/resolution_sim drives it with synthetic loads.
+	class ResolutionScaler
+	{
+	public:
+		struct Settings
+		{
+			double						targetFrameTime; // Seconds
+			float						headroom; // Fraction of the target aimed under, so ordinary noise stays inside it
+			float						minScale; // Of the output width and height
+			float						maxScale;
+			float						proportional; // Gains, on the error as a fraction of the target
+			float						integral;
+			float						derivative;
+			float						increaseRate; // Scales the gains when going up, so recovery is slower than backing off
+			float						deadband; // Relative error inside which nothing changes
+			float						step; // The scale moves in these
+			uint32_t					settleFrames; // Frames after a change before the next one; the new size takes a frame or two to show
+			float						smoothing; // Weight of the newest frame in the filtered frame time
+		};
+
+		struct Stats
+		{
+			uint32_t					frames;
+			uint32_t					overBudget; // Frames slower than the target
+			uint32_t					changes;
+			double						scaleSum; // For the mean
+			float						lowestScale;
+		};
+
+		static Settings					GetDefaultSettings(double targetFrameTime);
+
+		explicit ResolutionScaler(const Settings& settings);
+
+		// Once per frame with the frame's time, excluding any frame limiter sleep. Returns the scale for the next.
+		float							Update(double frameSeconds);
+
+		// Pins the scale, for comparisons; 0 goes back to the controller
+		void							SetFixedScale(float scale);
+
+		void							SetTargetFrameTime(double seconds);
+
+		// Under vertical sync no frame shows sooner than this, so the controller doesn't aim below it; 0 when unsynced
+		void							SetRefreshInterval(double seconds);
+
+		float							GetScale() const
+		{
+			return m_scale;
+		}
+
+		// The render target size for the current scale, never 0
+		void							GetRenderSize(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+
+		const Settings&					GetSettings() const
+		{
+			return m_settings;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+		void							LogReport() const;
+
+	private:
+		Settings						m_settings;
+		Stats							m_stats;
+		float							m_scale;
+		float							m_fixedScale; // 0 unless pinned
+		double							m_refreshInterval; // Seconds, 0 unless Present waits for vertical sync
+		double							m_filteredTime; // 0 until the first frame
+		double							m_integral;
+		double							m_lastError;
+		uint32_t						m_settle; // Frames left before the next change
+	};
+
+} // namespace utils
@@ -0,0 +1,577 @@
+#include "red_engine.h"
+#include "resource_registry.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <chrono>
+#include <string>
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_registryResources("registry.resources", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_registryRetainedBytes("registry.retained_bytes", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_registryRecreations("registry.recreations");
+
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		uint32_t Scaled(uint32_t size, float scale)
+		{
+			const uint32_t scaled = uint32_t(float(size) * scale);
+			return scaled > 0 ? scaled : 1;
+		}
+	}
+
+	enum ResourceRegistry::Type : uint32_t
+	{
+		Buffer,
+		Texture2D,
+		VertexShader,
+		PixelShader,
+		InputLayout,
+		SamplerState,
+		BlendState,
+		DepthStencilState,
+		RasterizerState,
+		ShaderResourceView, // Views last, they're made after what they view
+		RenderTargetView,
+		DepthStencilView,
+		Free,
+	};
+
+	struct ResourceRegistry::Entry
+	{
+		Type						type;
+		uint32_t					flags;
+		void**						target; // The owner's pointer, of the type the Register call took
+		ID3D11DeviceChild*			object; // The reference the registry holds
+		Handle						resource; // What a view views
+		float						scale; // Window sized textures, of the output size
+		bool						hasViewDesc;
+
+		union
+		{
+			D3D11_BUFFER_DESC					buffer;
+			D3D11_TEXTURE2D_DESC				texture;
+			D3D11_SAMPLER_DESC					sampler;
+			D3D11_BLEND_DESC					blend;
+			D3D11_DEPTH_STENCIL_DESC			depthStencil;
+			D3D11_RASTERIZER_DESC				rasterizer;
+			D3D11_SHADER_RESOURCE_VIEW_DESC		shaderResourceView;
+			D3D11_RENDER_TARGET_VIEW_DESC		renderTargetView;
+			D3D11_DEPTH_STENCIL_VIEW_DESC		depthStencilView;
+		}							desc;
+
+		uint32_t					pitch;
+		std::vector<uint8_t>		data; // Initial data, or shader bytecode
+		const void*					borrowed; // Initial data the owner keeps alive, instead of data
+		std::vector<D3D11_INPUT_ELEMENT_DESC>	elements;
+		std::vector<std::string>	semantics; // The elements' names, as the caller's may not last
+	};
+
+	ResourceRegistry* ResourceRegistry::g_resourceRegistry = nullptr;
+
+	void ResourceRegistry::Create()
+	{
+		ASSERT(g_resourceRegistry == nullptr, "The resource registry already exists.\n");
+		g_resourceRegistry = new ResourceRegistry();
+	}
+
+	void ResourceRegistry::Destroy()
+	{
+		delete g_resourceRegistry;
+		g_resourceRegistry = nullptr;
+	}
+
+	ResourceRegistry::ResourceRegistry() :
+		m_device(nullptr),
+		m_outputWidth(1),
+		m_outputHeight(1)
+	{
+	}
+
+	ResourceRegistry::~ResourceRegistry()
+	{
+		uint32_t live = 0;
+		for (Entry& entry : m_entries)
+		{
+			if (entry.type == Free)
+				continue;
+			ReleaseObject(entry);
+			++live;
+		}
+
+		if (live > 0)
+			DEBUG_MESSAGE("%u GPU resources still registered at shutdown.\n", live);
+	}
+
+	void ResourceRegistry::SetDevice(ID3D11Device* device, uint32_t outputWidth, uint32_t outputHeight)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_device = device;
+		m_outputWidth = outputWidth;
+		m_outputHeight = outputHeight;
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterBuffer(ID3D11Buffer** target, const D3D11_BUFFER_DESC& desc, const void* initialData,
+		uint32_t flags)
+	{
+		Entry entry = {};
+		entry.type = Buffer;
+		entry.flags = flags;
+		entry.desc.buffer = desc;
+		if ((flags & c_BorrowedData) != 0)
+			entry.borrowed = initialData;
+		else if (initialData != nullptr)
+			entry.data.assign(static_cast<const uint8_t*>(initialData), static_cast<const uint8_t*>(initialData) + desc.ByteWidth);
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterTexture2D(ID3D11Texture2D** target, const D3D11_TEXTURE2D_DESC& desc, const void* initialData,
+		uint32_t pitch)
+	{
+		ASSERT(initialData == nullptr || (desc.MipLevels == 1 && desc.ArraySize == 1), "Registered textures keep mip 0 of one slice only.\n");
+
+		Entry entry = {};
+		entry.type = Texture2D;
+		entry.desc.texture = desc;
+		entry.pitch = pitch;
+		if (initialData != nullptr)
+			entry.data.assign(static_cast<const uint8_t*>(initialData), static_cast<const uint8_t*>(initialData) + size_t(pitch) * desc.Height);
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterWindowSizedTexture2D(ID3D11Texture2D** target, const D3D11_TEXTURE2D_DESC& desc, float scale)
+	{
+		Entry entry = {};
+		entry.type = Texture2D;
+		entry.flags = c_WindowSized;
+		entry.scale = scale;
+		entry.desc.texture = desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterShaderResourceView(ID3D11ShaderResourceView** target, Handle resource,
+		const D3D11_SHADER_RESOURCE_VIEW_DESC* desc)
+	{
+		Entry entry = {};
+		entry.type = ShaderResourceView;
+		entry.resource = resource;
+		entry.hasViewDesc = desc != nullptr;
+		if (desc != nullptr)
+			entry.desc.shaderResourceView = *desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterRenderTargetView(ID3D11RenderTargetView** target, Handle resource,
+		const D3D11_RENDER_TARGET_VIEW_DESC* desc)
+	{
+		Entry entry = {};
+		entry.type = RenderTargetView;
+		entry.resource = resource;
+		entry.hasViewDesc = desc != nullptr;
+		if (desc != nullptr)
+			entry.desc.renderTargetView = *desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterDepthStencilView(ID3D11DepthStencilView** target, Handle resource,
+		const D3D11_DEPTH_STENCIL_VIEW_DESC* desc)
+	{
+		Entry entry = {};
+		entry.type = DepthStencilView;
+		entry.resource = resource;
+		entry.hasViewDesc = desc != nullptr;
+		if (desc != nullptr)
+			entry.desc.depthStencilView = *desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterVertexShader(ID3D11VertexShader** target, const void* bytecode, size_t size)
+	{
+		Entry entry = {};
+		entry.type = VertexShader;
+		entry.data.assign(static_cast<const uint8_t*>(bytecode), static_cast<const uint8_t*>(bytecode) + size);
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterPixelShader(ID3D11PixelShader** target, const void* bytecode, size_t size)
+	{
+		Entry entry = {};
+		entry.type = PixelShader;
+		entry.data.assign(static_cast<const uint8_t*>(bytecode), static_cast<const uint8_t*>(bytecode) + size);
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterInputLayout(ID3D11InputLayout** target, const D3D11_INPUT_ELEMENT_DESC* elements,
+		uint32_t count, const void* bytecode, size_t size)
+	{
+		Entry entry = {};
+		entry.type = InputLayout;
+		entry.data.assign(static_cast<const uint8_t*>(bytecode), static_cast<const uint8_t*>(bytecode) + size);
+		entry.elements.assign(elements, elements + count);
+		for (uint32_t element = 0; element < count; ++element)
+			entry.semantics.push_back(elements[element].SemanticName);
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterSamplerState(ID3D11SamplerState** target, const D3D11_SAMPLER_DESC& desc)
+	{
+		Entry entry = {};
+		entry.type = SamplerState;
+		entry.desc.sampler = desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterBlendState(ID3D11BlendState** target, const D3D11_BLEND_DESC& desc)
+	{
+		Entry entry = {};
+		entry.type = BlendState;
+		entry.desc.blend = desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterDepthStencilState(ID3D11DepthStencilState** target, const D3D11_DEPTH_STENCIL_DESC& desc)
+	{
+		Entry entry = {};
+		entry.type = DepthStencilState;
+		entry.desc.depthStencil = desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::RegisterRasterizerState(ID3D11RasterizerState** target, const D3D11_RASTERIZER_DESC& desc)
+	{
+		Entry entry = {};
+		entry.type = RasterizerState;
+		entry.desc.rasterizer = desc;
+		return Add(entry, reinterpret_cast<void**>(target));
+	}
+
+	void ResourceRegistry::Unregister(Handle handle)
+	{
+		if (handle == InvalidHandle)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ASSERT(handle < m_entries.size() && m_entries[handle].type != Free, "Unregistering a resource that isn't registered.\n");
+
+		Entry& entry = m_entries[handle];
+		ReleaseObject(entry);
+
+		s_registryResources.Add(-1);
+		s_registryRetainedBytes.Add(-int64_t(entry.data.size()));
+
+		entry = Entry();
+		entry.type = Free;
+		m_freeEntries.push_back(handle);
+	}
+
+	void ResourceRegistry::UpdateData(Handle handle, uint32_t offset, const void* data, uint32_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ASSERT(handle < m_entries.size() && m_entries[handle].type == Buffer, "Only buffers keep updated data.\n");
+		ASSERT((m_entries[handle].flags & c_BorrowedData) == 0, "Updating a buffer whose data is borrowed.\n");
+
+		// Buffers registered without data only start keeping it once something is written
+		Entry& entry = m_entries[handle];
+		if (entry.data.empty())
+		{
+			entry.data.resize(entry.desc.buffer.ByteWidth);
+			s_registryRetainedBytes.Add(int64_t(entry.data.size()));
+		}
+
+		ASSERT(offset + size <= entry.data.size(), "Update past the end of a registered buffer.\n");
+		memcpy(entry.data.data() + offset, data, size);
+	}
+
+	void ResourceRegistry::ReleaseAll()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Entry& entry : m_entries)
+		{
+			if (entry.type != Free)
+				ReleaseObject(entry);
+		}
+		m_device = nullptr;
+	}
+
+	ResourceRegistry::RecreateStats ResourceRegistry::RecreateAll()
+	{
+		return Recreate(false);
+	}
+
+	ResourceRegistry::RecreateStats ResourceRegistry::Resize(uint32_t outputWidth, uint32_t outputHeight)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (outputWidth == m_outputWidth && outputHeight == m_outputHeight)
+				return RecreateStats{ 0, 0.0, 0.0 };
+
+			m_outputWidth = outputWidth;
+			m_outputHeight = outputHeight;
+			if (m_device == nullptr)
+				return RecreateStats{ 0, 0.0, 0.0 }; // Picked up by RecreateAll when the device comes back
+
+			for (Entry& entry : m_entries)
+			{
+				if (entry.type != Free && IsWindowSized(entry))
+					ReleaseObject(entry);
+			}
+		}
+
+		return Recreate(true);
+	}
+
+	uint32_t ResourceRegistry::GetCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return uint32_t(m_entries.size() - m_freeEntries.size());
+	}
+
+	ResourceRegistry::Handle ResourceRegistry::Add(Entry& entry, void** target)
+	{
+		entry.target = target;
+		*target = nullptr;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// Shader resource views can also be of buffers (structured light lists); the other views are of textures only
+		ASSERT(entry.type < ShaderResourceView || (entry.resource < m_entries.size() && (m_entries[entry.resource].type == Texture2D ||
+			(entry.type == ShaderResourceView && m_entries[entry.resource].type == Buffer))),
+			"A registered view needs a registered texture, or a buffer for a shader resource view.\n");
+
+		Handle handle;
+		if (!m_freeEntries.empty())
+		{
+			handle = m_freeEntries.back();
+			m_freeEntries.pop_back();
+			m_entries[handle] = std::move(entry);
+		}
+		else
+		{
+			handle = Handle(m_entries.size());
+			m_entries.push_back(std::move(entry));
+		}
+
+		Entry& added = m_entries[handle];
+		s_registryResources.Add();
+		s_registryRetainedBytes.Add(int64_t(added.data.size()));
+
+		if (m_device != nullptr && !CreateObject(added))
+		{
+			DEBUG_MESSAGE("Unable to create a registered GPU resource of type %u.\n", uint32_t(added.type));
+			added.type = Free;
+			m_freeEntries.push_back(handle);
+			s_registryResources.Add(-1);
+			s_registryRetainedBytes.Add(-int64_t(added.data.size()));
+			return InvalidHandle;
+		}
+
+		return handle;
+	}
+
+	bool ResourceRegistry::CreateObject(Entry& entry)
+	{
+		ID3D11Device* const device = m_device;
+		HRESULT hr = E_FAIL;
+
+		switch (entry.type)
+		{
+			case Buffer:
+			{
+				const void* const bytes = entry.borrowed != nullptr ? entry.borrowed : entry.data.data();
+				const D3D11_SUBRESOURCE_DATA initialData = { bytes, 0, 0 };
+				ID3D11Buffer* buffer = nullptr;
+				hr = device->CreateBuffer(&entry.desc.buffer, entry.borrowed == nullptr && entry.data.empty() ? nullptr : &initialData, &buffer);
+				entry.object = buffer;
+				break;
+			}
+
+			case Texture2D:
+			{
+				D3D11_TEXTURE2D_DESC desc = entry.desc.texture;
+				if (entry.flags & c_WindowSized)
+				{
+					desc.Width = Scaled(m_outputWidth, entry.scale);
+					desc.Height = Scaled(m_outputHeight, entry.scale);
+				}
+
+				const D3D11_SUBRESOURCE_DATA initialData = { entry.data.data(), entry.pitch, 0 };
+				ID3D11Texture2D* texture = nullptr;
+				hr = device->CreateTexture2D(&desc, entry.data.empty() ? nullptr : &initialData, &texture);
+				entry.object = texture;
+				break;
+			}
+
+			case VertexShader:
+			{
+				ID3D11VertexShader* shader = nullptr;
+				hr = device->CreateVertexShader(entry.data.data(), entry.data.size(), nullptr, &shader);
+				entry.object = shader;
+				break;
+			}
+
+			case PixelShader:
+			{
+				ID3D11PixelShader* shader = nullptr;
+				hr = device->CreatePixelShader(entry.data.data(), entry.data.size(), nullptr, &shader);
+				entry.object = shader;
+				break;
+			}
+
+			case InputLayout:
+			{
+				for (size_t element = 0; element < entry.elements.size(); ++element)
+					entry.elements[element].SemanticName = entry.semantics[element].c_str();
+
+				ID3D11InputLayout* layout = nullptr;
+				hr = device->CreateInputLayout(entry.elements.data(), UINT(entry.elements.size()), entry.data.data(), entry.data.size(), &layout);
+				entry.object = layout;
+				break;
+			}
+
+			case SamplerState:
+			{
+				ID3D11SamplerState* state = nullptr;
+				hr = device->CreateSamplerState(&entry.desc.sampler, &state);
+				entry.object = state;
+				break;
+			}
+
+			case BlendState:
+			{
+				ID3D11BlendState* state = nullptr;
+				hr = device->CreateBlendState(&entry.desc.blend, &state);
+				entry.object = state;
+				break;
+			}
+
+			case DepthStencilState:
+			{
+				ID3D11DepthStencilState* state = nullptr;
+				hr = device->CreateDepthStencilState(&entry.desc.depthStencil, &state);
+				entry.object = state;
+				break;
+			}
+
+			case RasterizerState:
+			{
+				ID3D11RasterizerState* state = nullptr;
+				hr = device->CreateRasterizerState(&entry.desc.rasterizer, &state);
+				entry.object = state;
+				break;
+			}
+
+			case ShaderResourceView:
+			{
+				// Typed buffers are read through views too
+				const Entry& viewed = m_entries[entry.resource];
+				ID3D11Resource* const resource = viewed.type == Buffer ? static_cast<ID3D11Resource*>(static_cast<ID3D11Buffer*>(viewed.object)) :
+					static_cast<ID3D11Texture2D*>(viewed.object);
+				ID3D11ShaderResourceView* view = nullptr;
+				hr = device->CreateShaderResourceView(resource, entry.hasViewDesc ? &entry.desc.shaderResourceView : nullptr, &view);
+				entry.object = view;
+				break;
+			}
+
+			case RenderTargetView:
+			{
+				ID3D11Resource* const resource = static_cast<ID3D11Texture2D*>(m_entries[entry.resource].object);
+				ID3D11RenderTargetView* view = nullptr;
+				hr = device->CreateRenderTargetView(resource, entry.hasViewDesc ? &entry.desc.renderTargetView : nullptr, &view);
+				entry.object = view;
+				break;
+			}
+
+			case DepthStencilView:
+			{
+				ID3D11Resource* const resource = static_cast<ID3D11Texture2D*>(m_entries[entry.resource].object);
+				ID3D11DepthStencilView* view = nullptr;
+				hr = device->CreateDepthStencilView(resource, entry.hasViewDesc ? &entry.desc.depthStencilView : nullptr, &view);
+				entry.object = view;
+				break;
+			}
+
+			case Free:
+				break;
+		}
+
+		if (FAILED(hr))
+		{
+			entry.object = nullptr;
+			return false;
+		}
+
+		// Every case created the owner's own type, so this is the pointer the owner expects
+		*entry.target = entry.object;
+		s_registryRecreations.Add();
+		return true;
+	}
+
+	void ResourceRegistry::ReleaseObject(Entry& entry)
+	{
+		if (entry.object != nullptr)
+		{
+			entry.object->Release();
+			entry.object = nullptr;
+		}
+		*entry.target = nullptr;
+	}
+
+	// Holds m_mutex across the job system's wait, so jobs it may run meanwhile mustn't register anything. Only startup
+	// jobs do, and device loss and resizes happen on the main thread after startup.
+	ResourceRegistry::RecreateStats ResourceRegistry::Recreate(bool windowSizedOnly)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ASSERT(m_device != nullptr, "Recreating resources without a device.\n");
+
+		RecreateStats stats = { 0, 0.0, 0.0 };
+		const double start = Seconds();
+
+		// Views need what they view, so resources go first; each phase is free threaded device calls on separate entries
+		std::vector<Handle> phases[2];
+		for (Handle handle = 0; handle < m_entries.size(); ++handle)
+		{
+			const Entry& entry = m_entries[handle];
+			if (entry.type == Free || entry.object != nullptr || (windowSizedOnly && !IsWindowSized(entry)))
+				continue;
+			phases[entry.type >= ShaderResourceView ? 1 : 0].push_back(handle);
+		}
+
+		std::vector<double> times(m_entries.size(), 0.0);
+		std::atomic<uint32_t> failures(0);
+		for (const std::vector<Handle>& phase : phases)
+		{
+			utils::JobSystem::Get()->ParallelFor(unsigned(phase.size()), 4, [&](unsigned int begin, unsigned int end)
+			{
+				for (unsigned int index = begin; index < end; ++index)
+				{
+					const double createStart = Seconds();
+					if (!CreateObject(m_entries[phase[index]]))
+						failures.fetch_add(1, std::memory_order_relaxed);
+					times[phase[index]] = Seconds() - createStart;
+				}
+			});
+			stats.resources += uint32_t(phase.size());
+		}
+
+		stats.wallSeconds = Seconds() - start;
+		for (double time : times)
+			stats.serialSeconds += time;
+
+		if (failures.load() > 0)
+			DEBUG_MESSAGE("%u of %u registered GPU resources failed to recreate.\n", failures.load(), stats.resources);
+		return stats;
+	}
+
+	bool ResourceRegistry::IsWindowSized(const Entry& entry) const
+	{
+		const Entry& resource = entry.type >= ShaderResourceView ? m_entries[entry.resource] : entry;
+		return (resource.flags & c_WindowSized) != 0;
+	}
+
+} // namespace DX
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct ID3D11Device;
+struct ID3D11Buffer;
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11InputLayout;
+struct ID3D11SamplerState;
+struct ID3D11BlendState;
+struct ID3D11DepthStencilState;
+struct ID3D11RasterizerState;
+struct D3D11_BUFFER_DESC;
+struct D3D11_TEXTURE2D_DESC;
+struct D3D11_SHADER_RESOURCE_VIEW_DESC;
+struct D3D11_RENDER_TARGET_VIEW_DESC;
+struct D3D11_DEPTH_STENCIL_VIEW_DESC;
+struct D3D11_INPUT_ELEMENT_DESC;
+struct D3D11_SAMPLER_DESC;
+struct D3D11_BLEND_DESC;
+struct D3D11_DEPTH_STENCIL_DESC;
+struct D3D11_RASTERIZER_DESC;
+
+namespace DX
+{
+
+	// Every long-lived GPU object created from a description kept on the CPU, along with its initial data, so the
+	// lot can be recreated after device loss without going back to disk or the code that first made it. Owners keep
+	// a raw pointer member as before and register its address; the registry holds the reference and writes the new
+	// object there on every recreation. Creation goes through the device only, so recreation runs on the job system.
+	class ResourceRegistry
+	{
+	public:
+		typedef uint32_t Handle;
+		static const Handle				InvalidHandle = 0xffffffff;
+
+		// Recreated on resize as well, sized as a fraction of the output
+		static const uint32_t			c_WindowSized = 0x1;
+
+		// The initial data outlives the registration, as a mapped asset pack does, so it is pointed at instead of copied
+		static const uint32_t			c_BorrowedData = 0x2;
+
+		struct RecreateStats
+		{
+			uint32_t					resources;
+			double						wallSeconds;
+			double						serialSeconds; // Sum of the creation times, what it would have taken in a row
+		};
+
+		static void						Create();
+		static void						Destroy();
+
+		static ResourceRegistry*		Get()
+		{
+			return g_resourceRegistry;
+		}
+
+		// The device future registrations and Recreate create on; null while it is lost
+		void							SetDevice(ID3D11Device* device, uint32_t outputWidth, uint32_t outputHeight);
+
+		// Each copies its description and data and creates the object straight away if there is a device.
+		// pitch is the row pitch of initialData; textures keep mip 0 only. Buffers registered with c_BorrowedData
+		// keep only a pointer to initialData, and can't be updated.
+		Handle							RegisterBuffer(ID3D11Buffer** target, const D3D11_BUFFER_DESC& desc, const void* initialData = nullptr,
+											uint32_t flags = 0);
+		Handle							RegisterTexture2D(ID3D11Texture2D** target, const D3D11_TEXTURE2D_DESC& desc, const void* initialData = nullptr,
+											uint32_t pitch = 0);
+		Handle							RegisterWindowSizedTexture2D(ID3D11Texture2D** target, const D3D11_TEXTURE2D_DESC& desc, float scale = 1.0f);
+		Handle							RegisterShaderResourceView(ID3D11ShaderResourceView** target, Handle resource,
+											const D3D11_SHADER_RESOURCE_VIEW_DESC* desc = nullptr);
+		Handle							RegisterRenderTargetView(ID3D11RenderTargetView** target, Handle resource,
+											const D3D11_RENDER_TARGET_VIEW_DESC* desc = nullptr);
+		Handle							RegisterDepthStencilView(ID3D11DepthStencilView** target, Handle resource,
+											const D3D11_DEPTH_STENCIL_VIEW_DESC* desc = nullptr);
+		Handle							RegisterVertexShader(ID3D11VertexShader** target, const void* bytecode, size_t size);
+		Handle							RegisterPixelShader(ID3D11PixelShader** target, const void* bytecode, size_t size);
+		Handle							RegisterInputLayout(ID3D11InputLayout** target, const D3D11_INPUT_ELEMENT_DESC* elements, uint32_t count,
+											const void* bytecode, size_t size);
+		Handle							RegisterSamplerState(ID3D11SamplerState** target, const D3D11_SAMPLER_DESC& desc);
+		Handle							RegisterBlendState(ID3D11BlendState** target, const D3D11_BLEND_DESC& desc);
+		Handle							RegisterDepthStencilState(ID3D11DepthStencilState** target, const D3D11_DEPTH_STENCIL_DESC& desc);
+		Handle							RegisterRasterizerState(ID3D11RasterizerState** target, const D3D11_RASTERIZER_DESC& desc);
+
+		// Releases the object and nulls the owner's pointer. Views go before the resources they view.
+		void							Unregister(Handle handle);
+
+		// Keeps the retained copy of a default usage buffer in step with an UpdateSubresource on it
+		void							UpdateData(Handle handle, uint32_t offset, const void* data, uint32_t size);
+
+		// Device lost: every object goes, the descriptions and data stay
+		void							ReleaseAll();
+
+		// Device restored: everything again, on the job system
+		RecreateStats					RecreateAll();
+
+		// Only the window sized textures and their views
+		RecreateStats					Resize(uint32_t outputWidth, uint32_t outputHeight);
+
+		uint32_t						GetCount() const;
+
+	private:
+		enum Type : uint32_t;
+		struct Entry; // Holds D3D descriptions, so it lives with the code that creates from them
+
+		ResourceRegistry();
+		~ResourceRegistry();
+
+		Handle							Add(Entry& entry, void** target); // Takes the entry's vectors, creates if it can
+		bool							CreateObject(Entry& entry); // Writes only to entry, so entries can be created in parallel
+		void							ReleaseObject(Entry& entry);
+		RecreateStats					Recreate(bool windowSizedOnly);
+		bool							IsWindowSized(const Entry& entry) const;
+
+		static ResourceRegistry*		g_resourceRegistry;
+
+		mutable std::mutex				m_mutex; // Registration happens on the startup jobs as well as the main thread
+		std::vector<Entry>				m_entries;
+		std::vector<Handle>				m_freeEntries;
+		ID3D11Device*					m_device; // Not owned
+		uint32_t						m_outputWidth;
+		uint32_t						m_outputHeight;
+	};
+
+} // namespace DX
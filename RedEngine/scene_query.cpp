@@ -0,0 +1,471 @@
+#include "red_engine.h"
+#include "scene_query.h"
+#include "job_system.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace scene
+{
+
+	namespace
+	{
+		// Queries per job; overlaps are gathered a batch at a time
+		const unsigned int c_RayBatch = 64;
+		const unsigned int c_OverlapBatch = 64;
+
+		// Nodes waiting in a traversal. Each split takes a bit of the thirty in a Morton code, or halves bodies that
+		// share a code, so the tree is at most about twenty five deep, and each level leaves at most three siblings waiting.
+		const uint32_t c_StackSize = 128;
+
+		// Cells along each axis of the grid Morton codes are taken on, ten bits each
+		const uint32_t c_MortonCells = 1024;
+
+		// Smaller direction components are taken as this, which keeps the slab distances finite
+		const float c_MinDirection = 1e-20f;
+
+		utils::PerfCounter s_bodies("query.bodies", utils::PerfCounter::Gauge);
+		utils::PerfCounter s_rays("query.rays");
+		utils::PerfCounter s_shapes("query.shapes");
+
+		// Index of the lowest set bit, value must not be 0
+		uint32_t LowestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(__builtin_ctz(value));
+#endif
+		}
+
+		// Index of the highest set bit, value must not be 0
+		uint32_t HighestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse(&index, value);
+			return uint32_t(index);
+#else
+			return uint32_t(31 - __builtin_clz(value));
+#endif
+		}
+
+		// Ten bits to every third of thirty, so three axes interleave
+		uint32_t SpreadBits(uint32_t value)
+		{
+			value = (value | (value << 16)) & 0x030000ff;
+			value = (value | (value << 8)) & 0x0300f00f;
+			value = (value | (value << 4)) & 0x030c30c3;
+			value = (value | (value << 2)) & 0x09249249;
+			return value;
+		}
+
+		// Stable LSD radix sort on the top 32 bits, a byte at a time, skipping bytes every key shares
+		void SortKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+		{
+			scratch.resize(keys.size());
+			for (uint32_t shift = 32; shift < 64; shift += 8)
+			{
+				uint32_t counts[256] = {};
+				for (uint64_t key : keys)
+					++counts[(key >> shift) & 0xff];
+				if (counts[(keys[0] >> shift) & 0xff] == keys.size())
+					continue;
+
+				uint32_t offset = 0;
+				for (uint32_t& count : counts)
+				{
+					const uint32_t bucket = count;
+					count = offset;
+					offset += bucket;
+				}
+
+				for (uint64_t key : keys)
+					scratch[counts[(key >> shift) & 0xff]++] = key;
+				keys.swap(scratch);
+			}
+		}
+
+		void ParallelFor(unsigned int count, unsigned int batchSize, const utils::JobSystem::RangeJob& job)
+		{
+			if (utils::JobSystem::Get() != nullptr)
+				utils::JobSystem::Get()->ParallelFor(count, batchSize, job);
+			else
+				job(0, count);
+		}
+
+		// Mask of the four boxes in bounds that the sphere touches
+		uint32_t OverlapMask(const float (&bounds)[6][4], const SceneQuery::Sphere& sphere)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 x = _mm_set1_ps(sphere.centre[0]);
+			const __m128 y = _mm_set1_ps(sphere.centre[1]);
+			const __m128 z = _mm_set1_ps(sphere.centre[2]);
+			const __m128 r = _mm_set1_ps(sphere.radius);
+
+			// Distance from the centre to the nearest point of each box along each axis, 0 inside it
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(bounds[0]), x), _mm_sub_ps(x, _mm_load_ps(bounds[3]))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(bounds[1]), y), _mm_sub_ps(y, _mm_load_ps(bounds[4]))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(bounds[2]), z), _mm_sub_ps(z, _mm_load_ps(bounds[5]))), zero);
+			const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			return uint32_t(_mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(r, r))));
+		}
+
+		// Mask of the four boxes in bounds that the box touches
+		uint32_t OverlapMask(const float (&bounds)[6][4], const SceneQuery::Box& box)
+		{
+			__m128 touching = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const __m128 below = _mm_cmple_ps(_mm_load_ps(bounds[axis]), _mm_set1_ps(box.max[axis]));
+				const __m128 above = _mm_cmpge_ps(_mm_load_ps(bounds[3 + axis]), _mm_set1_ps(box.min[axis]));
+				touching = _mm_and_ps(touching, _mm_and_ps(below, above));
+			}
+			return uint32_t(_mm_movemask_ps(touching));
+		}
+	}
+
+	SceneQuery::SceneQuery() :
+		m_stats{}
+	{
+	}
+
+	void SceneQuery::Build(const Broadphase& broadphase)
+	{
+		m_nodes.clear();
+		m_buildKeys.clear();
+		m_stats = {};
+
+		float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const uint32_t bodyLimit = broadphase.GetBodyLimit();
+		for (uint32_t body = 0; body < bodyLimit; ++body)
+		{
+			if (!broadphase.IsAlive(body))
+				continue;
+
+			const Box& box = broadphase.GetBox(body);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float centre = (box.min[axis] + box.max[axis]) * 0.5f;
+				low[axis] = std::min(low[axis], centre);
+				high[axis] = std::max(high[axis], centre);
+			}
+			m_buildKeys.push_back(body);
+		}
+
+		m_stats.bodies = uint32_t(m_buildKeys.size());
+		s_bodies.Set(m_stats.bodies);
+		if (m_buildKeys.empty())
+			return;
+
+		float scale[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			scale[axis] = high[axis] > low[axis] ? float(c_MortonCells - 1) / (high[axis] - low[axis]) : 0.0f;
+
+		for (uint64_t& key : m_buildKeys)
+		{
+			const Box& box = broadphase.GetBox(uint32_t(key));
+			uint32_t code = 0;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float centre = (box.min[axis] + box.max[axis]) * 0.5f;
+				const uint32_t cell = std::min(uint32_t((centre - low[axis]) * scale[axis]), c_MortonCells - 1);
+				code |= SpreadBits(cell) << axis;
+			}
+			key |= uint64_t(code) << 32;
+		}
+		SortKeys(m_buildKeys, m_sortScratch);
+
+		m_buildBoxes.resize(m_buildKeys.size());
+		for (size_t i = 0; i < m_buildKeys.size(); ++i)
+			m_buildBoxes[i] = broadphase.GetBox(uint32_t(m_buildKeys[i]));
+
+		// A node per three bodies or so, four to a node less the ones holding nodes
+		m_nodes.reserve(m_buildKeys.size() / 2 + 1);
+		BuildNode(0, uint32_t(m_buildKeys.size()), 1);
+		m_stats.nodes = uint32_t(m_nodes.size());
+	}
+
+	uint32_t SceneQuery::BuildNode(uint32_t begin, uint32_t end, uint32_t depth)
+	{
+		m_stats.depth = std::max(m_stats.depth, depth);
+
+		const uint32_t index = uint32_t(m_nodes.size());
+		m_nodes.emplace_back();
+
+		// Four bodies to a node at the bottom, otherwise halves of halves
+		uint32_t parts[5];
+		uint32_t partCount;
+		if (end - begin <= 4)
+		{
+			partCount = end - begin;
+			for (uint32_t k = 0; k <= partCount; ++k)
+				parts[k] = begin + k;
+		}
+		else
+		{
+			const uint32_t middle = Split(begin, end);
+			parts[0] = begin;
+			parts[1] = middle - begin > 1 ? Split(begin, middle) : middle;
+			parts[2] = middle;
+			parts[3] = end - middle > 1 ? Split(middle, end) : end;
+			parts[4] = end;
+
+			// A half of one body has nothing to split, so drop the empty quarter
+			partCount = 0;
+			for (uint32_t k = 1; k <= 4; ++k)
+			{
+				if (parts[k] != parts[partCount])
+					parts[++partCount] = parts[k];
+			}
+		}
+
+		Node node = {};
+		node.count = partCount;
+		for (uint32_t k = 0; k < partCount; ++k)
+		{
+			if (parts[k + 1] - parts[k] == 1)
+			{
+				const uint32_t body = uint32_t(m_buildKeys[parts[k]]);
+				const Box& box = m_buildBoxes[parts[k]];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					node.bounds[axis][k] = box.min[axis];
+					node.bounds[3 + axis][k] = box.max[axis];
+				}
+				node.child[k] = body | LeafBit;
+				continue;
+			}
+
+			const uint32_t child = BuildNode(parts[k], parts[k + 1], depth + 1);
+			const Node& built = m_nodes[child];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				node.bounds[axis][k] = *std::min_element(built.bounds[axis], built.bounds[axis] + built.count);
+				node.bounds[3 + axis][k] = *std::max_element(built.bounds[3 + axis], built.bounds[3 + axis] + built.count);
+			}
+			node.child[k] = child;
+		}
+
+		m_nodes[index] = node;
+		return index;
+	}
+
+	uint32_t SceneQuery::Split(uint32_t begin, uint32_t end) const
+	{
+		const uint32_t first = uint32_t(m_buildKeys[begin] >> 32);
+		const uint32_t last = uint32_t(m_buildKeys[end - 1] >> 32);
+		if (first == last)
+			return begin + (end - begin) / 2;
+
+		// The keys are sorted, so the ones with the bit clear come first
+		const uint32_t bit = HighestBit(first ^ last);
+		uint32_t low = begin + 1;
+		uint32_t high = end - 1;
+		while (low < high)
+		{
+			const uint32_t middle = low + (high - low) / 2;
+			if (((m_buildKeys[middle] >> 32) >> bit & 1) != 0)
+				high = middle;
+			else
+				low = middle + 1;
+		}
+		return low;
+	}
+
+	SceneQuery::RayHit SceneQuery::CastRay(const Ray& ray, bool anyHit) const
+	{
+		RayHit hit = { NoBody, ray.maxDistance };
+		if (m_nodes.empty())
+			return hit;
+
+		__m128 origin[3];
+		__m128 inverse[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float direction = ray.direction[axis];
+			if (std::fabs(direction) < c_MinDirection)
+				direction = direction < 0.0f ? -c_MinDirection : c_MinDirection;
+			origin[axis] = _mm_set1_ps(ray.origin[axis]);
+			inverse[axis] = _mm_set1_ps(1.0f / direction);
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		struct Entry
+		{
+			uint32_t node;
+			float distance;
+		};
+
+		Entry stack[c_StackSize];
+		stack[0] = { 0, 0.0f };
+		uint32_t top = 1;
+		while (top > 0)
+		{
+			const Entry entry = stack[--top];
+			if (entry.distance > hit.distance)
+				continue;
+
+			// Where the ray enters and leaves each child's box, as the latest entry and earliest exit of the slabs
+			const Node& node = m_nodes[entry.node];
+			__m128 enter = zero;
+			__m128 leave = _mm_set1_ps(hit.distance);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const __m128 toMin = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[axis]), origin[axis]), inverse[axis]);
+				const __m128 toMax = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[3 + axis]), origin[axis]), inverse[axis]);
+				enter = _mm_max_ps(enter, _mm_min_ps(toMin, toMax));
+				leave = _mm_min_ps(leave, _mm_max_ps(toMin, toMax));
+			}
+
+			uint32_t mask = uint32_t(_mm_movemask_ps(_mm_cmple_ps(enter, leave))) & ((1u << node.count) - 1);
+			alignas(16) float distances[4];
+			_mm_store_ps(distances, enter);
+
+			Entry inner[4];
+			uint32_t innerCount = 0;
+			while (mask != 0)
+			{
+				const uint32_t k = LowestBit(mask);
+				mask &= mask - 1;
+
+				const uint32_t child = node.child[k];
+				if ((child & LeafBit) == 0)
+				{
+					inner[innerCount++] = { child, distances[k] };
+					continue;
+				}
+
+				const uint32_t body = child & ~LeafBit;
+				if (distances[k] < hit.distance || (distances[k] == hit.distance && body < hit.body))
+				{
+					hit.body = body;
+					hit.distance = distances[k];
+					if (anyHit)
+						return hit;
+				}
+			}
+
+			// Nearest on top, so the closest hit is found early and prunes the rest
+			for (uint32_t i = 1; i < innerCount; ++i)
+			{
+				const Entry moving = inner[i];
+				uint32_t to = i;
+				for (; to > 0 && inner[to - 1].distance < moving.distance; --to)
+					inner[to] = inner[to - 1];
+				inner[to] = moving;
+			}
+
+			ASSERT(top + innerCount <= c_StackSize, "Scene query tree is deeper than its traversal stack.\n");
+			for (uint32_t i = 0; i < innerCount; ++i)
+				stack[top++] = inner[i];
+		}
+
+		return hit;
+	}
+
+	void SceneQuery::Raycast(const Ray* rays, uint32_t count, RayHit* hits) const
+	{
+		ParallelFor(count, c_RayBatch, [this, rays, hits](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+				hits[i] = CastRay(rays[i], false);
+		});
+		s_rays.Add(count);
+	}
+
+	void SceneQuery::Occluded(const Ray* rays, uint32_t count, uint8_t* occluded) const
+	{
+		ParallelFor(count, c_RayBatch, [this, rays, occluded](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i)
+				occluded[i] = CastRay(rays[i], true).body != NoBody ? 1 : 0;
+		});
+		s_rays.Add(count);
+	}
+
+	template <typename Shape>
+	void SceneQuery::Overlap(const Shape* shapes, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies)
+	{
+		const uint32_t batchCount = (count + c_OverlapBatch - 1) / c_OverlapBatch;
+		if (m_batchBodies.size() < batchCount)
+			m_batchBodies.resize(batchCount);
+
+		// Counts first, at offsets[i + 1], then summed into offsets once every batch is done
+		offsets.resize(size_t(count) + 1);
+		ParallelFor(count, c_OverlapBatch, [this, shapes, &offsets](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int first = begin; first < end; first += c_OverlapBatch)
+			{
+				std::vector<uint32_t>& found = m_batchBodies[first / c_OverlapBatch];
+				found.clear();
+
+				const unsigned int last = std::min(first + c_OverlapBatch, end);
+				for (unsigned int i = first; i < last; ++i)
+				{
+					const size_t before = found.size();
+					if (!m_nodes.empty())
+					{
+						uint32_t stack[c_StackSize];
+						stack[0] = 0;
+						uint32_t top = 1;
+						while (top > 0)
+						{
+							const Node& node = m_nodes[stack[--top]];
+							uint32_t mask = OverlapMask(node.bounds, shapes[i]) & ((1u << node.count) - 1);
+							while (mask != 0)
+							{
+								const uint32_t child = node.child[LowestBit(mask)];
+								mask &= mask - 1;
+								if ((child & LeafBit) != 0)
+									found.push_back(child & ~LeafBit);
+								else
+								{
+									ASSERT(top < c_StackSize, "Scene query tree is deeper than its traversal stack.\n");
+									stack[top++] = child;
+								}
+							}
+						}
+					}
+					std::sort(found.begin() + before, found.end());
+					offsets[i + 1] = uint32_t(found.size() - before);
+				}
+			}
+		});
+
+		offsets[0] = 0;
+		for (uint32_t i = 0; i < count; ++i)
+			offsets[i + 1] += offsets[i];
+
+		bodies.resize(offsets[count]);
+		for (uint32_t batch = 0; batch < batchCount; ++batch)
+		{
+			const std::vector<uint32_t>& found = m_batchBodies[batch];
+			if (!found.empty())
+				memcpy(&bodies[offsets[batch * c_OverlapBatch]], found.data(), found.size() * sizeof(uint32_t));
+		}
+		s_shapes.Add(count);
+	}
+
+	void SceneQuery::OverlapSpheres(const Sphere* spheres, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies)
+	{
+		Overlap(spheres, count, offsets, bodies);
+	}
+
+	void SceneQuery::OverlapBoxes(const Box* boxes, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies)
+	{
+		Overlap(boxes, count, offsets, bodies);
+	}
+
+} // namespace scene
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "broadphase.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace scene
+{
+
+	// Ray and shape queries against the broadphase's bodies, for picking, line of sight and proximity. Build puts
+	// the live bodies in a tree four wide, each node holding the boxes of its four children as SSE lanes, so one test
+	// covers a node's children at once and a child that is a single body is its own final test. Queries come in
+	// batches spread over the job system. The tree is a snapshot: rebuild it after the bodies move.
+	// Build and the queries belong to one thread at a time; queries don't change anything but their own results.
+	class SceneQuery
+	{
+	public:
+		typedef Broadphase::Box Box;
+
+		// Hits are at origin + direction * distance, up to maxDistance
+		struct Ray
+		{
+			float						origin[3];
+			float						direction[3];
+			float						maxDistance;
+		};
+
+		struct RayHit
+		{
+			uint32_t					body; // NoBody if nothing is hit
+			float						distance; // 0 from inside a box
+		};
+
+		struct Sphere
+		{
+			float						centre[3];
+			float						radius;
+		};
+
+		struct Stats
+		{
+			uint32_t					bodies;
+			uint32_t					nodes;
+			uint32_t					depth;
+		};
+
+		static const uint32_t			NoBody = 0xffffffff;
+
+		SceneQuery();
+
+		// Replaces the tree with one over the bodies alive in the broadphase now. Bodies are put in Morton order of
+		// their centres and split where the highest bit that differs in the range changes, which halves space rather than
+		// the count, twice per level down to fours.
+		void							Build(const Broadphase& broadphase);
+
+		// The nearest body along each ray; ties go to the lower id
+		void							Raycast(const Ray* rays, uint32_t count, RayHit* hits) const;
+
+		// Whether anything is along each ray, stopping at the first body found, for line of sight
+		void							Occluded(const Ray* rays, uint32_t count, uint8_t* occluded) const;
+
+		// Every body touching each shape. Those of shape i are bodies[offsets[i]] up to bodies[offsets[i + 1]], in id order.
+		void							OverlapSpheres(const Sphere* spheres, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies);
+		void							OverlapBoxes(const Box* boxes, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies);
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		// Child slots past count are unused
+		struct alignas(16) Node
+		{
+			float						bounds[6][4]; // Min x, y, z then max x, y, z, a lane per child
+			uint32_t					child[4]; // A node index, or a body with LeafBit set
+			uint32_t					count;
+		};
+
+		static const uint32_t			LeafBit = 0x80000000;
+
+		uint32_t						BuildNode(uint32_t begin, uint32_t end, uint32_t depth);
+		uint32_t						Split(uint32_t begin, uint32_t end) const; // Where the highest differing code bit changes
+		RayHit							CastRay(const Ray& ray, bool anyHit) const;
+
+		template <typename Shape>
+		void							Overlap(const Shape* shapes, uint32_t count, std::vector<uint32_t>& offsets, std::vector<uint32_t>& bodies);
+
+		std::vector<Node>				m_nodes; // The root first
+		std::vector<uint64_t>			m_buildKeys; // Morton code of each body's centre, then the body
+		std::vector<uint64_t>			m_sortScratch;
+		std::vector<Box>				m_buildBoxes; // In key order, gathered once rather than fetched body by body while building
+
+		std::vector<std::vector<uint32_t>> m_batchBodies; // Overlaps found by each job batch, in query order
+		Stats							m_stats;
+	};
+
+} // namespace scene
@@ -0,0 +1,382 @@
+#include "red_engine.h"
+#include "sprite_batch.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+// Compiled from the .hlsl files into $(IntDir) by the project
+#include "SpriteVertexShader.h"
+#include "SpritePixelShader.h"
+#endif
+
+namespace DX
+{
+
+	namespace
+	{
+		// Triangle strip corners of a sprite quad
+		const float c_Corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+		const uint32_t c_IndexMask = 0xffffffff;
+
+		utils::PerfCounter s_draws("render.draws");
+		utils::PerfCounter s_sprites("render.sprites");
+		utils::PerfCounter s_constantBufferBytes("render.constant_buffer_bytes");
+
+		uint32_t LayerOf(uint64_t key)
+		{
+			return uint32_t(key >> 48);
+		}
+
+		uint32_t AtlasOf(uint64_t key)
+		{
+			return uint32_t(key >> 32) & 0xffff;
+		}
+
+		// Stable LSD radix sort on the top 32 bits, a byte at a time, skipping bytes every key shares
+		void SortKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch)
+		{
+			scratch.resize(keys.size());
+			for (uint32_t shift = 32; shift < 64; shift += 8)
+			{
+				uint32_t counts[256] = {};
+				for (uint64_t key : keys)
+					++counts[(key >> shift) & 0xff];
+				if (counts[(keys[0] >> shift) & 0xff] == keys.size())
+					continue;
+
+				uint32_t offset = 0;
+				for (uint32_t& count : counts)
+				{
+					const uint32_t bucket = count;
+					count = offset;
+					offset += bucket;
+				}
+
+				for (uint64_t key : keys)
+					scratch[counts[(key >> shift) & 0xff]++] = key;
+				keys.swap(scratch);
+			}
+		}
+	}
+
+	SpriteBatch::SpriteBatch() :
+		m_ringCursor(RingSprites),
+		m_stats{},
+		m_cornerBuffer(nullptr),
+		m_instanceBuffer(nullptr),
+		m_constantBuffer(nullptr),
+		m_inputLayout(nullptr),
+		m_vertexShader(nullptr),
+		m_pixelShader(nullptr),
+		m_sampler(nullptr),
+		m_blendState(nullptr),
+		m_depthState(nullptr),
+		m_rasterizerState(nullptr)
+	{
+	}
+
+	SpriteBatch::~SpriteBatch()
+	{
+		Release();
+	}
+
+	bool SpriteBatch::Create(ID3D11Device* device)
+	{
+		ASSERT(!IsCreated(), "The sprite batch has already been created.\n");
+
+#if defined(_WIN32)
+		// Instancing needs 9_3 or better
+		if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+		{
+			DEBUG_MESSAGE("No sprites below feature level 9_3.\n");
+			return false;
+		}
+
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		m_resources.push_back(registry->RegisterVertexShader(&m_vertexShader, g_SpriteVertexShader, sizeof(g_SpriteVertexShader)));
+		m_resources.push_back(registry->RegisterPixelShader(&m_pixelShader, g_SpritePixelShader, sizeof(g_SpritePixelShader)));
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "POSITION", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Sprite, x), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(Sprite, u0), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, offsetof(Sprite, color), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		m_resources.push_back(registry->RegisterInputLayout(&m_inputLayout, layout, _countof(layout), g_SpriteVertexShader,
+			sizeof(g_SpriteVertexShader)));
+
+		CD3D11_BUFFER_DESC cornerDesc(sizeof(c_Corners), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		m_resources.push_back(registry->RegisterBuffer(&m_cornerBuffer, cornerDesc, c_Corners));
+
+		CD3D11_BUFFER_DESC instanceDesc(RingSprites * sizeof(Sprite), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_instanceBuffer, instanceDesc));
+
+		CD3D11_BUFFER_DESC constantDesc(sizeof(Constants), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+		m_resources.push_back(registry->RegisterBuffer(&m_constantBuffer, constantDesc));
+
+		CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+		m_resources.push_back(registry->RegisterSamplerState(&m_sampler, samplerDesc));
+
+		CD3D11_BLEND_DESC blendDesc(D3D11_DEFAULT);
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		m_resources.push_back(registry->RegisterBlendState(&m_blendState, blendDesc));
+
+		CD3D11_DEPTH_STENCIL_DESC depthDesc(D3D11_DEFAULT);
+		depthDesc.DepthEnable = FALSE;
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		m_resources.push_back(registry->RegisterDepthStencilState(&m_depthState, depthDesc));
+
+		CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+		rasterizerDesc.CullMode = D3D11_CULL_NONE;
+		m_resources.push_back(registry->RegisterRasterizerState(&m_rasterizerState, rasterizerDesc));
+
+		for (ResourceRegistry::Handle handle : m_resources)
+		{
+			if (handle == ResourceRegistry::InvalidHandle)
+			{
+				Release();
+				return false;
+			}
+		}
+
+		// The first flush starts the ring with a DISCARD
+		m_ringCursor = RingSprites;
+		return true;
+#else
+		(void)device;
+		return false;
+#endif
+	}
+
+	void SpriteBatch::Release()
+	{
+		while (!m_resources.empty())
+		{
+#if defined(_WIN32)
+			if (m_resources.back() != ResourceRegistry::InvalidHandle)
+				ResourceRegistry::Get()->Unregister(m_resources.back());
+#endif
+			m_resources.pop_back();
+		}
+	}
+
+	uint32_t SpriteBatch::AddAtlas(ID3D11ShaderResourceView* const* view)
+	{
+		ASSERT(m_atlases.size() < MaxAtlases, "More than %u sprite atlases.\n", MaxAtlases);
+		m_atlases.push_back(view);
+		return uint32_t(m_atlases.size() - 1);
+	}
+
+	void SpriteBatch::Draw(uint32_t atlas, uint32_t layer, const Sprite& sprite)
+	{
+		ASSERT(atlas < m_atlases.size(), "Sprite atlas %u hasn't been added.\n", atlas);
+		ASSERT(layer <= MaxLayers, "Sprite layer %u is past %u.\n", layer, MaxLayers);
+
+		m_keys.push_back(uint64_t(layer) << 48 | uint64_t(atlas) << 32 | uint64_t(m_sprites.size()));
+		m_sprites.push_back(sprite);
+	}
+
+	void SpriteBatch::Sort()
+	{
+		SortKeys(m_keys, m_sortScratch);
+
+		m_order.resize(m_keys.size());
+		m_batches.clear();
+
+		// Appends the run of keys [begin, end), all one atlas, to the draw order, joining the last batch if it can
+		uint32_t written = 0;
+		auto emit = [this, &written](uint32_t begin, uint32_t end)
+			{
+				const uint32_t atlas = AtlasOf(m_keys[begin]);
+				if (m_batches.empty() || m_batches.back().atlas != atlas)
+					m_batches.push_back({ atlas, written, 0 });
+				m_batches.back().count += end - begin;
+
+				for (uint32_t i = begin; i < end; ++i)
+					m_order[written++] = uint32_t(m_keys[i] & c_IndexMask);
+			};
+
+		// Each layer starts with the atlas the one before it finished on, if it has it, so that draw carries on
+		const uint32_t count = uint32_t(m_keys.size());
+		for (uint32_t layerBegin = 0; layerBegin < count;)
+		{
+			const uint32_t layer = LayerOf(m_keys[layerBegin]);
+			uint32_t layerEnd = layerBegin;
+			while (layerEnd < count && LayerOf(m_keys[layerEnd]) == layer)
+				++layerEnd;
+			++m_stats.layers;
+
+			const uint32_t lastAtlas = m_batches.empty() ? MaxAtlases + 1 : m_batches.back().atlas;
+			uint32_t carryBegin = layerEnd, carryEnd = layerEnd;
+			for (uint32_t i = layerBegin; i < layerEnd; ++i)
+			{
+				if (AtlasOf(m_keys[i]) == lastAtlas)
+				{
+					carryBegin = i;
+					for (carryEnd = i; carryEnd < layerEnd && AtlasOf(m_keys[carryEnd]) == lastAtlas; ++carryEnd)
+						;
+					break;
+				}
+			}
+
+			if (carryBegin < carryEnd)
+				emit(carryBegin, carryEnd);
+
+			for (uint32_t runBegin = layerBegin; runBegin < layerEnd;)
+			{
+				if (runBegin == carryBegin)
+				{
+					runBegin = carryEnd;
+					continue;
+				}
+
+				const uint32_t atlas = AtlasOf(m_keys[runBegin]);
+				uint32_t runEnd = runBegin + 1;
+				while (runEnd < layerEnd && AtlasOf(m_keys[runEnd]) == atlas)
+					++runEnd;
+				emit(runBegin, runEnd);
+				runBegin = runEnd;
+			}
+
+			layerBegin = layerEnd;
+		}
+	}
+
+	void SpriteBatch::Flush(ID3D11DeviceContext* deviceContext, float screenWidth, float screenHeight)
+	{
+		m_stats = {};
+		m_stats.sprites = uint32_t(m_sprites.size());
+		if (m_sprites.empty())
+		{
+			m_order.clear();
+			m_batches.clear();
+			return;
+		}
+
+		Sort();
+		m_stats.batches = uint32_t(m_batches.size());
+		s_sprites.Add(m_stats.sprites);
+
+		const bool draw = deviceContext != nullptr && IsCreated();
+#if defined(_WIN32)
+		if (draw)
+		{
+			Constants constants = {};
+			constants.screenScale[0] = 2.0f / screenWidth;
+			constants.screenScale[1] = 2.0f / screenHeight;
+
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			const HRESULT hr = deviceContext->Map(m_constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+			ASSERT_HANDLE(hr);
+			memcpy(mapped.pData, &constants, sizeof(constants));
+			deviceContext->Unmap(m_constantBuffer, 0);
+			s_constantBufferBytes.Add(sizeof(constants));
+
+			ID3D11Buffer* const vertexBuffers[] = { m_cornerBuffer, m_instanceBuffer };
+			const UINT strides[] = { sizeof(c_Corners[0]), sizeof(Sprite) };
+			const UINT offsets[] = { 0, 0 };
+			deviceContext->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+			deviceContext->IASetInputLayout(m_inputLayout);
+			deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+			deviceContext->VSSetShader(m_vertexShader, nullptr, 0);
+			deviceContext->VSSetConstantBuffers(0, 1, &m_constantBuffer);
+			deviceContext->PSSetShader(m_pixelShader, nullptr, 0);
+			deviceContext->PSSetSamplers(0, 1, &m_sampler);
+
+			deviceContext->OMSetBlendState(m_blendState, nullptr, 0xffffffff);
+			deviceContext->OMSetDepthStencilState(m_depthState, 0);
+			deviceContext->RSSetState(m_rasterizerState);
+		}
+#else
+		(void)screenWidth;
+		(void)screenHeight;
+#endif
+
+		if (!draw && m_cpuRing.empty())
+			m_cpuRing.resize(RingSprites);
+
+		// Appended behind what earlier flushes wrote, which the GPU may still be reading, until the ring runs out
+		const uint32_t count = m_stats.sprites;
+		uint32_t done = 0;
+		size_t batch = 0;
+		while (done < count)
+		{
+			const uint32_t chunk = std::min(count - done, uint32_t(RingSprites));
+			const bool wrap = m_ringCursor + chunk > RingSprites;
+			if (wrap)
+			{
+				m_ringCursor = 0;
+				++m_stats.wraps;
+			}
+
+			Sprite* ring = m_cpuRing.data();
+#if defined(_WIN32)
+			if (draw)
+			{
+				D3D11_MAPPED_SUBRESOURCE mapped;
+				const HRESULT hr = deviceContext->Map(m_instanceBuffer, 0, wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped);
+				ASSERT_HANDLE(hr);
+				ring = static_cast<Sprite*>(mapped.pData);
+			}
+#endif
+
+			Sprite* const to = ring + m_ringCursor;
+			for (uint32_t i = 0; i < chunk; ++i)
+				to[i] = m_sprites[m_order[done + i]];
+
+#if defined(_WIN32)
+			if (draw)
+				deviceContext->Unmap(m_instanceBuffer, 0);
+#endif
+
+			// The batches in this chunk, the last perhaps only partly
+			while (batch < m_batches.size())
+			{
+				const Batch& current = m_batches[batch];
+#if defined(_WIN32)
+				if (draw)
+				{
+					const uint32_t begin = std::max(current.first, done);
+					const uint32_t end = std::min(current.first + current.count, done + chunk);
+					ASSERT(m_atlases[current.atlas] != nullptr, "Sprite atlas %u has no view.\n", current.atlas);
+					deviceContext->PSSetShaderResources(0, 1, m_atlases[current.atlas]);
+					deviceContext->DrawInstanced(4, end - begin, 0, m_ringCursor + begin - done);
+					s_draws.Add();
+				}
+#endif
+				++m_stats.draws;
+
+				if (current.first + current.count > done + chunk)
+					break;
+				++batch;
+			}
+
+			m_ringCursor += chunk;
+			done += chunk;
+		}
+
+#if defined(_WIN32)
+		if (draw)
+		{
+			// Leave the defaults behind for whoever draws next
+			deviceContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+			deviceContext->OMSetDepthStencilState(nullptr, 0);
+			deviceContext->RSSetState(nullptr);
+		}
+#endif
+
+		m_sprites.clear();
+		m_keys.clear();
+	}
+
+} // namespace DX
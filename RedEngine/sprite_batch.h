@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11SamplerState;
+struct ID3D11BlendState;
+struct ID3D11DepthStencilState;
+struct ID3D11RasterizerState;
+struct ID3D11ShaderResourceView;
+
+namespace DX
+{
+
+	// Screen space sprites and UI in as few draws as the atlases allow. Draw only appends; Flush sorts by layer and
+	// by atlas within each layer, writes the sprites in that order into a dynamic instance ring, mapped NO_OVERWRITE
+	// behind the previous flush and DISCARD when it wraps, and issues one instanced draw per run of one atlas.
+	// Later layers draw over earlier ones. Within a layer each atlas's sprites keep the order they were drawn in,
+	// but there is no order between atlases, so overlapping sprites from different atlases want different layers.
+	// Render thread only. Without a device (headless tools) the ring is CPU memory and nothing is drawn.
+	class SpriteBatch
+	{
+	public:
+		// Also the instance layout
+		struct Sprite
+		{
+			float						x, y; // Top left, pixels from the top left of the screen
+			float						width, height; // Pixels
+			float						u0, v0, u1, v1; // The atlas rectangle
+			uint32_t					color; // Packed R8G8B8A8, multiplies the atlas
+		};
+
+		// A draw, over this flush's sprites in draw order
+		struct Batch
+		{
+			uint32_t					atlas;
+			uint32_t					first;
+			uint32_t					count;
+		};
+
+		struct Stats
+		{
+			uint32_t					sprites;
+			uint32_t					batches;
+			uint32_t					draws; // More than batches when one straddles the ring's wrap
+			uint32_t					layers;
+			uint32_t					wraps;
+		};
+
+		static const uint32_t			MaxAtlases = 0xffff;
+		static const uint32_t			MaxLayers = 0xffff;
+		static const uint32_t			RingSprites = 128 * 1024; // 4.5 MB
+
+		SpriteBatch();
+		~SpriteBatch();
+
+		bool							Create(ID3D11Device* device);
+		void							Release();
+
+		bool							IsCreated() const
+		{
+			return !m_resources.empty();
+		}
+
+		// view is the owner's pointer, read at each flush so it follows the ResourceRegistry through device loss
+		uint32_t						AddAtlas(ID3D11ShaderResourceView* const* view);
+
+		void							Draw(uint32_t atlas, uint32_t layer, const Sprite& sprite);
+
+		// Sorts, uploads and draws everything since the last flush into whatever target is bound.
+		// deviceContext may be null to only batch.
+		void							Flush(ID3D11DeviceContext* deviceContext, float screenWidth, float screenHeight);
+
+		// The last flush's draws, and the sprites in draw order as indices in the order they were drawn
+		const std::vector<Batch>&		GetBatches() const
+		{
+			return m_batches;
+		}
+
+		const std::vector<uint32_t>&	GetDrawOrder() const
+		{
+			return m_order;
+		}
+
+		const Stats&					GetStats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		struct Constants
+		{
+			float						screenScale[4]; // 2 / screen size
+		};
+
+		void							Sort(); // Fills m_order and m_batches from m_sprites and m_keys
+
+		std::vector<Sprite>				m_sprites; // As drawn
+		std::vector<uint64_t>			m_keys; // Layer, atlas, then the sprite's index, which keeps the sort stable
+		std::vector<uint64_t>			m_sortScratch;
+		std::vector<uint32_t>			m_order;
+		std::vector<Batch>				m_batches;
+		std::vector<Sprite>				m_cpuRing; // Stands in for the instance buffer without a device
+		uint32_t						m_ringCursor; // Sprites into the ring written by earlier flushes
+
+		std::vector<ID3D11ShaderResourceView* const*> m_atlases;
+		Stats							m_stats;
+
+		ID3D11Buffer*					m_cornerBuffer;
+		ID3D11Buffer*					m_instanceBuffer;
+		ID3D11Buffer*					m_constantBuffer;
+		ID3D11InputLayout*				m_inputLayout;
+		ID3D11VertexShader*				m_vertexShader;
+		ID3D11PixelShader*				m_pixelShader;
+		ID3D11SamplerState*				m_sampler;
+		ID3D11BlendState*				m_blendState;
+		ID3D11DepthStencilState*		m_depthState;
+		ID3D11RasterizerState*			m_rasterizerState;
+		std::vector<uint32_t>			m_resources; // ResourceRegistry handles, in registration order
+	};
+
+} // namespace DX
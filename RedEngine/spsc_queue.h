@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace containers
+{
+
+	// Bounded lock-free ring for one producer thread and one consumer thread. Neither side ever waits; push fails
+	// when the ring is full and pop when it is empty. Each index lives on its own cache line with that side's copy
+	// of the other index, so the two threads only share a line when one has to refresh its view of the other.
+	// The batch forms move as many as fit and publish them with a single store.
+	template <typename T>
+	class SpscQueue
+	{
+	public:
+		// capacity is rounded up to a power of two
+		explicit SpscQueue(size_t capacity) :
+			m_mask(0),
+			m_head(0),
+			m_cachedTail(0),
+			m_tail(0),
+			m_cachedHead(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			m_values.resize(size);
+			m_mask = size - 1;
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		// Producer side only
+		bool push(const T& value)
+		{
+			return push(&value, 1) == 1;
+		}
+
+		// Producer side only. Returns how many went in, from the front of values.
+		size_t push(const T* values, size_t count)
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+
+			// Indices run freely and wrap, the difference is the fill level
+			size_t room = m_values.size() - (head - m_cachedTail);
+			if (room < count)
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				room = m_values.size() - (head - m_cachedTail);
+			}
+
+			const size_t pushed = count < room ? count : room;
+			for (size_t i = 0; i < pushed; ++i)
+				m_values[(head + i) & m_mask] = values[i];
+
+			if (pushed != 0)
+				m_head.store(head + pushed, std::memory_order_release);
+			return pushed;
+		}
+
+		// Consumer side only
+		bool pop(T& value)
+		{
+			return pop(&value, 1) == 1;
+		}
+
+		// Consumer side only. Returns how many came out, into the front of values.
+		size_t pop(T* values, size_t maxCount)
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+			size_t waiting = m_cachedHead - tail;
+			if (waiting < maxCount)
+			{
+				m_cachedHead = m_head.load(std::memory_order_acquire);
+				waiting = m_cachedHead - tail;
+			}
+
+			const size_t popped = maxCount < waiting ? maxCount : waiting;
+			for (size_t i = 0; i < popped; ++i)
+				values[i] = std::move(m_values[(tail + i) & m_mask]);
+
+			if (popped != 0)
+				m_tail.store(tail + popped, std::memory_order_release);
+			return popped;
+		}
+
+		size_t capacity() const
+		{
+			return m_values.size();
+		}
+
+		// Exact from either side for what that side can see, a moment stale from anywhere else
+		size_t size() const
+		{
+			// The tail first, so the head read after it can't be behind it
+			const size_t tail = m_tail.load(std::memory_order_acquire);
+			return m_head.load(std::memory_order_acquire) - tail;
+		}
+
+	private:
+		std::vector<T>					m_values;
+		size_t							m_mask;
+
+		alignas(64) std::atomic<size_t> m_head; // Next slot to write
+		size_t							m_cachedTail;
+
+		alignas(64) std::atomic<size_t> m_tail; // Next slot to read
+		size_t							m_cachedHead;
+	};
+
+}
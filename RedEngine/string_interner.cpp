@@ -0,0 +1,103 @@
+#include "red_engine.h"
+#include "string_interner.h"
+#include "hash_map.h"
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace containers
+{
+
+	namespace
+	{
+		// Names are copied into blocks of this much, longer ones get a block to themselves
+		const size_t c_BlockSize = 64 * 1024;
+
+		struct Names
+		{
+			std::mutex					mutex;
+			HashMap<uint64_t, const char*> byId;
+			std::vector<char*>			blocks;
+			char*						block = nullptr; // Being filled
+			size_t						blockUsed = c_BlockSize;
+
+			~Names()
+			{
+				for (char* block : blocks)
+					delete[] block;
+			}
+
+			const char* Copy(const char* name, size_t length)
+			{
+				char* copy;
+				if (length + 1 > c_BlockSize)
+				{
+					copy = new char[length + 1];
+					blocks.push_back(copy);
+				}
+				else
+				{
+					if (blockUsed + length + 1 > c_BlockSize)
+					{
+						block = new char[c_BlockSize];
+						blocks.push_back(block);
+						blockUsed = 0;
+					}
+					copy = block + blockUsed;
+					blockUsed += length + 1;
+				}
+
+				memcpy(copy, name, length);
+				copy[length] = '\0';
+				return copy;
+			}
+		};
+
+		// Made on first use, so ids can be interned from other statics' constructors
+		Names& GetNames()
+		{
+			static Names names;
+			return names;
+		}
+	}
+
+	StringId StringInterner::Intern(const char* name)
+	{
+		return Intern(name, strlen(name));
+	}
+
+	StringId StringInterner::Intern(const char* name, size_t length)
+	{
+		const StringId id(utils::HashBytes(name, length));
+
+		Names& names = GetNames();
+		std::lock_guard<std::mutex> lock(names.mutex);
+		const char* const* found = names.byId.find(id.Get());
+		if (found != nullptr)
+		{
+			ASSERT(strlen(*found) == length && memcmp(*found, name, length) == 0, "\"%s\" and \"%.*s\" have the same hash, %016llx.\n",
+				*found, int(length), name, (unsigned long long)id.Get());
+			return id;
+		}
+
+		names.byId.insert(id.Get(), names.Copy(name, length));
+		return id;
+	}
+
+	const char* StringInterner::Find(StringId id)
+	{
+		Names& names = GetNames();
+		std::lock_guard<std::mutex> lock(names.mutex);
+		const char* const* found = names.byId.find(id.Get());
+		return found != nullptr ? *found : nullptr;
+	}
+
+	size_t StringInterner::GetCount()
+	{
+		Names& names = GetNames();
+		std::lock_guard<std::mutex> lock(names.mutex);
+		return names.byId.size();
+	}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "hash.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace containers
+{
+
+	// A name by its 64-bit FNV-1a hash, the same one the asset packer files names under. Made from a literal in a
+	// constant expression it costs nothing at run time: constexpr StringId c_Stone("textures/stone"), or "textures/stone"_id.
+	class StringId
+	{
+	public:
+		constexpr StringId() :
+			m_hash(0)
+		{
+		}
+
+		constexpr explicit StringId(uint64_t hash) :
+			m_hash(hash)
+		{
+		}
+
+		constexpr explicit StringId(const char* name) :
+			m_hash(utils::HashName(name))
+		{
+		}
+
+		constexpr uint64_t Get() const
+		{
+			return m_hash;
+		}
+
+		// Folded to 32 bits for tables that want it smaller; collides far sooner, so the full hash is the identity
+		constexpr uint32_t GetShort() const
+		{
+			return uint32_t(m_hash ^ (m_hash >> 32));
+		}
+
+		constexpr bool IsValid() const
+		{
+			return m_hash != 0;
+		}
+
+		constexpr bool operator==(StringId other) const
+		{
+			return m_hash == other.m_hash;
+		}
+
+		constexpr bool operator!=(StringId other) const
+		{
+			return m_hash != other.m_hash;
+		}
+
+		constexpr bool operator<(StringId other) const
+		{
+			return m_hash < other.m_hash;
+		}
+
+	private:
+		uint64_t						m_hash;
+	};
+
+	// using containers::operator""_id; to write "name"_id
+	constexpr StringId operator""_id(const char* name, size_t)
+	{
+		return StringId(name);
+	}
+
+	// Keeps one copy of every name given to it for the life of the process, so an id can be turned back into its
+	// name for logs and tools, and two names with one hash are caught when the second is interned rather than as the
+	// wrong asset later. Any thread; lookups and interning take a lock, so keep them out of inner loops and hold ids.
+	class StringInterner
+	{
+	public:
+		static StringId					Intern(const char* name);
+		static StringId					Intern(const char* name, size_t length); // name needn't be terminated
+
+		// The interned name, or null if nothing has interned it; a literal's id is only known here once interned
+		static const char*				Find(StringId id);
+
+		static size_t					GetCount();
+	};
+
+}
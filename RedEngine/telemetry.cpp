@@ -0,0 +1,285 @@
+#include "red_engine.h"
+#include "telemetry.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils
+{
+
+	namespace
+	{
+		double Seconds()
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// "Local\name" on Windows, "/name" for shm_open
+		void MakeSegmentName(const char* name, char* output, size_t size)
+		{
+#if defined(_WIN32)
+			snprintf(output, size, "Local\\%s", name);
+#else
+			snprintf(output, size, "/%s", name);
+#endif
+		}
+	}
+
+	TelemetryPublisher::TelemetryPublisher() :
+		m_segment(nullptr),
+		m_sequence(0),
+		m_namedCounters(0),
+		m_openTime(0.0),
+		m_lastPublish(0.0),
+#if defined(_WIN32)
+		m_mapping(nullptr)
+#else
+		m_name(nullptr)
+#endif
+	{
+	}
+
+	TelemetryPublisher::~TelemetryPublisher()
+	{
+		Close();
+	}
+
+	bool TelemetryPublisher::Open(const char* name)
+	{
+		ASSERT(!IsOpen(), "Telemetry is already being published.\n");
+
+		char segmentName[256];
+		MakeSegmentName(name, segmentName, sizeof(segmentName));
+
+		void* data = nullptr;
+#if defined(_WIN32)
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, DWORD(sizeof(TelemetrySegment)), segmentName);
+		if (m_mapping != nullptr)
+			data = MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, sizeof(TelemetrySegment));
+#else
+		// A segment left behind by a crashed run is simply reused
+		const int file = shm_open(segmentName, O_CREAT | O_RDWR, 0644);
+		if (file >= 0)
+		{
+			if (ftruncate(file, off_t(sizeof(TelemetrySegment))) == 0)
+			{
+				data = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+				if (data == MAP_FAILED)
+					data = nullptr;
+			}
+			close(file);
+		}
+#endif
+
+		if (data == nullptr)
+		{
+			DEBUG_MESSAGE("Unable to create telemetry segment %s.\n", segmentName);
+			Close();
+			return false;
+		}
+
+		m_segment = static_cast<TelemetrySegment*>(data);
+		memset(&m_segment->payload, 0, sizeof(m_segment->payload));
+		m_segment->sequence.store(0, std::memory_order_relaxed);
+
+		TelemetryHeader& header = m_segment->header;
+		header.maxCounters = TelemetryMaxCounters;
+		header.frameHistory = TelemetryFrameHistory;
+#if defined(_WIN32)
+		header.processId = GetCurrentProcessId();
+#else
+		header.processId = uint64_t(getpid());
+		m_name = new char[strlen(segmentName) + 1];
+		strcpy(m_name, segmentName);
+#endif
+		header.totalSize = sizeof(TelemetrySegment);
+		header.version = TelemetryVersion;
+
+		// Readers check the magic first, so it goes in last
+		std::atomic_thread_fence(std::memory_order_release);
+		header.magic = TelemetryMagic;
+
+		m_sequence = 0;
+		m_namedCounters = 0;
+		m_openTime = Seconds();
+		m_lastPublish = m_openTime;
+		return true;
+	}
+
+	void TelemetryPublisher::Close()
+	{
+		if (m_segment != nullptr)
+		{
+			// Tells a monitor still attached that the engine has gone
+			m_segment->header.magic = 0;
+#if defined(_WIN32)
+			UnmapViewOfFile(m_segment);
+#else
+			munmap(m_segment, sizeof(TelemetrySegment));
+#endif
+			m_segment = nullptr;
+		}
+
+#if defined(_WIN32)
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+#else
+		if (m_name != nullptr)
+		{
+			shm_unlink(m_name);
+			delete[] m_name;
+			m_name = nullptr;
+		}
+#endif
+	}
+
+	void TelemetryPublisher::Publish(const PerfCounters& counters)
+	{
+		if (m_segment == nullptr)
+			return;
+
+		const double now = Seconds();
+		const float frameTime = float((now - m_lastPublish) * 1000.0);
+		m_lastPublish = now;
+
+		// Odd while writing. The release fence keeps the payload writes from moving above the odd store.
+		m_segment->sequence.store(++m_sequence, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		TelemetryPayload& payload = m_segment->payload;
+		++payload.frame;
+		payload.uptime = now - m_openTime;
+		payload.frameTimes[payload.nextFrameTime] = frameTime;
+		payload.nextFrameTime = (payload.nextFrameTime + 1) % TelemetryFrameHistory;
+
+		const uint32_t count = std::min(PerfCounter::GetCount(), TelemetryMaxCounters);
+		for (; m_namedCounters < count; ++m_namedCounters)
+		{
+			TelemetryCounter& counter = payload.counters[m_namedCounters];
+			strncpy(counter.name, PerfCounter::GetName(m_namedCounters), TelemetryNameLength - 1);
+			counter.name[TelemetryNameLength - 1] = 0;
+			counter.kind = uint32_t(PerfCounter::GetKind(m_namedCounters));
+		}
+
+		for (uint32_t id = 0; id < count; ++id)
+			payload.counters[id].value = counters.GetLastValue(id);
+		payload.counterCount = count;
+
+		m_segment->sequence.store(++m_sequence, std::memory_order_release);
+	}
+
+	TelemetryReader::TelemetryReader() :
+		m_segment(nullptr)
+#if defined(_WIN32)
+		, m_mapping(nullptr)
+#endif
+	{
+	}
+
+	TelemetryReader::~TelemetryReader()
+	{
+		Close();
+	}
+
+	bool TelemetryReader::Open(const char* name)
+	{
+		ASSERT(!IsOpen(), "Telemetry reader is already open.\n");
+
+		char segmentName[256];
+		MakeSegmentName(name, segmentName, sizeof(segmentName));
+
+		const void* data = nullptr;
+#if defined(_WIN32)
+		m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, segmentName);
+		if (m_mapping != nullptr)
+			data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(TelemetrySegment));
+#else
+		const int file = shm_open(segmentName, O_RDONLY, 0);
+		if (file >= 0)
+		{
+			struct stat status;
+			if (fstat(file, &status) == 0 && size_t(status.st_size) >= sizeof(TelemetrySegment))
+			{
+				data = mmap(nullptr, sizeof(TelemetrySegment), PROT_READ, MAP_SHARED, file, 0);
+				if (data == MAP_FAILED)
+					data = nullptr;
+			}
+			close(file);
+		}
+#endif
+
+		if (data == nullptr)
+		{
+			Close();
+			return false;
+		}
+
+		m_segment = static_cast<const TelemetrySegment*>(data);
+
+		const TelemetryHeader& header = m_segment->header;
+		const bool valid = header.magic == TelemetryMagic;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (!valid || header.version != TelemetryVersion || header.totalSize != sizeof(TelemetrySegment))
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void TelemetryReader::Close()
+	{
+		if (m_segment != nullptr)
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(m_segment);
+#else
+			munmap(const_cast<TelemetrySegment*>(m_segment), sizeof(TelemetrySegment));
+#endif
+			m_segment = nullptr;
+		}
+
+#if defined(_WIN32)
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+#endif
+	}
+
+	bool TelemetryReader::Read(TelemetryPayload& payload, uint32_t attempts) const
+	{
+		ASSERT(IsOpen(), "Reading telemetry that isn't open.\n");
+
+		for (uint32_t attempt = 0; attempt < attempts; ++attempt)
+		{
+			const uint64_t before = m_segment->sequence.load(std::memory_order_acquire);
+			if ((before & 1) != 0)
+				continue;
+
+			memcpy(&payload, &m_segment->payload, sizeof(payload));
+
+			// Keeps the copy from moving below the second sequence load
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_segment->sequence.load(std::memory_order_relaxed) == before)
+				return true;
+		}
+
+		return false;
+	}
+
+} // namespace utils
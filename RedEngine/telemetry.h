@@ -0,0 +1,76 @@
+#pragma once
+
+#include "telemetry_format.h"
+
+namespace utils
+{
+	class PerfCounters;
+
+	// Publishes frame times and every perf counter into a named shared-memory segment once a frame, so a monitor
+	// in another process can watch a running engine. Publishing is a copy into the mapping; it never blocks on
+	// readers, and a reader that catches it mid-write just tries again.
+	class TelemetryPublisher
+	{
+	public:
+		TelemetryPublisher();
+		~TelemetryPublisher();
+
+		// Creates (or takes over) the segment. name is a plain identifier, the platform prefix is added here.
+		bool							Open(const char* name);
+		void							Close();
+
+		bool							IsOpen() const
+		{
+			return m_segment != nullptr;
+		}
+
+		// Once a frame, after PerfCounters::EndFrame. Times the frame since the last call.
+		void							Publish(const PerfCounters& counters);
+
+	private:
+		TelemetrySegment*				m_segment;
+		uint64_t						m_sequence;
+		uint32_t						m_namedCounters; // Names already copied in, they never change once registered
+		double							m_openTime;
+		double							m_lastPublish;
+
+#if defined(_WIN32)
+		HANDLE							m_mapping;
+#else
+		char*							m_name; // To unlink on Close
+#endif
+	};
+
+	// The monitor's side: maps the segment read-only and takes consistent copies of it
+	class TelemetryReader
+	{
+	public:
+		TelemetryReader();
+		~TelemetryReader();
+
+		// Fails if the engine hasn't created the segment yet, or it is from a different version
+		bool							Open(const char* name);
+		void							Close();
+
+		bool							IsOpen() const
+		{
+			return m_segment != nullptr;
+		}
+
+		const TelemetryHeader&			GetHeader() const
+		{
+			return m_segment->header;
+		}
+
+		// False if every attempt raced a write, which only happens if the engine is publishing very fast
+		bool							Read(TelemetryPayload& payload, uint32_t attempts = 64) const;
+
+	private:
+		const TelemetrySegment*			m_segment;
+
+#if defined(_WIN32)
+		HANDLE							m_mapping;
+#endif
+	};
+
+} // namespace utils
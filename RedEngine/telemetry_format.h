@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared-memory segment the engine publishes its live stats into, read by tools/telemetry_monitor.
+// The header is written once when the segment is created. Everything in TelemetryPayload is guarded by the
+// sequence: the engine makes it odd before writing and even again after, and a reader keeps its copy only if it
+// saw the same even sequence before and after copying.
+namespace utils
+{
+
+	static const uint32_t TelemetryMagic = 0x4C455452; // 'RTEL'
+	static const uint32_t TelemetryVersion = 1;
+	static const uint32_t TelemetryMaxCounters = 128;
+	static const uint32_t TelemetryNameLength = 48;
+	static const uint32_t TelemetryFrameHistory = 256;
+
+	struct TelemetryHeader
+	{
+		uint32_t		magic;
+		uint32_t		version;
+		uint32_t		maxCounters;
+		uint32_t		frameHistory;
+		uint64_t		processId;
+		uint64_t		totalSize;
+	};
+	static_assert(sizeof(TelemetryHeader) == 32, "TelemetryHeader layout changed");
+
+	struct TelemetryCounter
+	{
+		char			name[TelemetryNameLength]; // Null terminated, truncated if need be
+		uint32_t		kind; // utils::PerfCounter::Kind
+		uint32_t		reserved;
+		int64_t			value; // Last completed frame
+	};
+	static_assert(sizeof(TelemetryCounter) == 64, "TelemetryCounter layout changed");
+
+	struct TelemetryPayload
+	{
+		uint64_t		frame; // Frames published so far
+		double			uptime; // Seconds since the segment was opened
+		uint32_t		counterCount;
+		uint32_t		nextFrameTime; // Where the next frame time goes in frameTimes
+		float			frameTimes[TelemetryFrameHistory]; // Milliseconds, a ring
+		TelemetryCounter counters[TelemetryMaxCounters];
+	};
+
+	struct TelemetrySegment
+	{
+		TelemetryHeader	header;
+		alignas(64) std::atomic<uint64_t> sequence;
+		alignas(64) TelemetryPayload payload;
+	};
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "The sequence has to work across processes");
+
+} // namespace utils
@@ -0,0 +1,116 @@
+#include "red_engine.h"
+#include "upscaler.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
+
+#include "UpscaleVertexShader.h"
+#include "UpscalePixelShader.h"
+
+namespace DX
+{
+
+	namespace
+	{
+		utils::PerfCounter s_draws("render.draws");
+
+		// Clip space, clockwise; the two corners off screen keep the diagonal seam out of the picture
+		const float c_Triangle[3][2] = { { -1.0f, -1.0f }, { -1.0f, 3.0f }, { 3.0f, -1.0f } };
+	}
+
+	Upscaler::Upscaler() :
+		m_vertexBuffer(nullptr),
+		m_inputLayout(nullptr),
+		m_vertexShader(nullptr),
+		m_pixelShader(nullptr),
+		m_sampler(nullptr)
+	{
+	}
+
+	Upscaler::~Upscaler()
+	{
+		Release();
+	}
+
+	bool Upscaler::Create(ID3D11Device* device)
+	{
+		ASSERT(!IsCreated(), "The upscaler has already been created.\n");
+
+		// The shaders are built for 9_3
+		if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+		{
+			DEBUG_MESSAGE("No dynamic resolution below feature level 9_3.\n");
+			return false;
+		}
+
+		ResourceRegistry* const registry = ResourceRegistry::Get();
+		m_resources.push_back(registry->RegisterVertexShader(&m_vertexShader, g_UpscaleVertexShader, sizeof(g_UpscaleVertexShader)));
+		m_resources.push_back(registry->RegisterPixelShader(&m_pixelShader, g_UpscalePixelShader, sizeof(g_UpscalePixelShader)));
+
+		const D3D11_INPUT_ELEMENT_DESC layout[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		m_resources.push_back(registry->RegisterInputLayout(&m_inputLayout, layout, _countof(layout), g_UpscaleVertexShader,
+			sizeof(g_UpscaleVertexShader)));
+
+		CD3D11_BUFFER_DESC vertexDesc(sizeof(c_Triangle), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		m_resources.push_back(registry->RegisterBuffer(&m_vertexBuffer, vertexDesc, c_Triangle));
+
+		CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+		m_resources.push_back(registry->RegisterSamplerState(&m_sampler, samplerDesc));
+
+		for (ResourceRegistry::Handle handle : m_resources)
+		{
+			if (handle == ResourceRegistry::InvalidHandle)
+			{
+				Release();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void Upscaler::Release()
+	{
+		while (!m_resources.empty())
+		{
+			ResourceRegistry::Get()->Unregister(m_resources.back());
+			m_resources.pop_back();
+		}
+	}
+
+	void Upscaler::Draw(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* source, ID3D11RenderTargetView* target,
+		const D3D11_VIEWPORT& viewport)
+	{
+		ASSERT(IsCreated(), "Upscaling without the upscaler.\n");
+
+		deviceContext->OMSetRenderTargets(1, &target, nullptr);
+		deviceContext->RSSetViewports(1, &viewport);
+
+		const UINT stride = sizeof(c_Triangle[0]);
+		const UINT offset = 0;
+		deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+		deviceContext->IASetInputLayout(m_inputLayout);
+		deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		deviceContext->VSSetShader(m_vertexShader, nullptr, 0);
+		deviceContext->PSSetShader(m_pixelShader, nullptr, 0);
+		deviceContext->PSSetShaderResources(0, 1, &source);
+		deviceContext->PSSetSamplers(0, 1, &m_sampler);
+
+		// Opaque, no depth, back faces culled
+		deviceContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+		deviceContext->OMSetDepthStencilState(nullptr, 0);
+		deviceContext->RSSetState(nullptr);
+
+		deviceContext->Draw(3, 0);
+		s_draws.Add();
+
+		// The source is next frame's render target
+		ID3D11ShaderResourceView* const unbound = nullptr;
+		deviceContext->PSSetShaderResources(0, 1, &unbound);
+	}
+
+} // namespace DX
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace DX
+{
+
+	// Stretches the scene, rendered at the dynamic resolution into a smaller target, over the back buffer with
+	// a bilinear fullscreen triangle. Its resources go through the ResourceRegistry.
+	class Upscaler
+	{
+	public:
+		Upscaler();
+		~Upscaler();
+
+		bool							Create(ID3D11Device* device);
+		void							Release();
+
+		bool							IsCreated() const
+		{
+			return !m_resources.empty();
+		}
+
+		// Sets the target and viewport itself; source is sampled over its whole extent
+		void							Draw(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* source, ID3D11RenderTargetView* target,
+											const D3D11_VIEWPORT& viewport);
+
+	private:
+		ID3D11Buffer*					m_vertexBuffer;
+		ID3D11InputLayout*				m_inputLayout;
+		ID3D11VertexShader*				m_vertexShader;
+		ID3D11PixelShader*				m_pixelShader;
+		ID3D11SamplerState*				m_sampler;
+		std::vector<uint32_t>			m_resources; // ResourceRegistry handles
+	};
+
+} // namespace DX
@@ -1,15 +1,20 @@
 #include "red_engine.h"
 #include "device_resources.h"
 #include "view.h"
+#include "perf_counters.h"
+#include "resource_registry.h"
 
 using namespace DirectX;
 
+static utils::PerfCounter s_constantBufferBytes("render.constant_buffer_bytes");
+
 namespace DirectX
 {
 
 	View::View(DeviceResources* deviceResources) :
 		m_deviceResources(deviceResources),
 		m_constantBuffer(nullptr),
+		m_constantBufferHandle(DX::ResourceRegistry::InvalidHandle),
 		m_worldMatrix{},
 		m_viewMatrix{},
 		m_projectionMatrix{}
@@ -23,14 +28,9 @@ namespace DirectX
 	void View::Initialise()
 	{
 		ASSERT(m_deviceResources != nullptr, "Device resources doesn't exist.\n");
-		ID3D11DeviceContext* const deviceContext = m_deviceResources->GetD3DDeviceContext();
-
-		ID3D11Device* device = nullptr;
-		deviceContext->GetDevice(&device);
-		ASSERT(device != nullptr, "Unable to get D3D device.\n");
 
 		CD3D11_BUFFER_DESC bufferDesc(sizeof(ConstantBuffer), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
-		device->CreateBuffer(&bufferDesc, nullptr, &m_constantBuffer);
+		m_constantBufferHandle = DX::ResourceRegistry::Get()->RegisterBuffer(&m_constantBuffer, bufferDesc);
 		ASSERT(m_constantBuffer != nullptr, "Unable to create constant buffer.\n");
 
 		// Initialize the world matrix
@@ -71,13 +71,25 @@ namespace DirectX
 		ASSERT_HANDLE(hr);
 		memcpy(mapped.pData, &sceneParameters, sizeof(ConstantBuffer));
 		deviceContext->Unmap(m_constantBuffer, 0);
+		s_constantBufferBytes.Add(sizeof(ConstantBuffer));
 
 		deviceContext->VSSetConstantBuffers(0, 1, &m_constantBuffer);
 	}
 
+	XMFLOAT3 View::GetCameraPosition() const
+	{
+		// The camera sits at the origin of view space, so its world position is the inverse view's translation
+		const XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&m_viewMatrix));
+
+		XMFLOAT3 position;
+		XMStoreFloat3(&position, inverseView.r[3]);
+		return position;
+	}
+
 	void View::Shutdown()
 	{
-		m_constantBuffer->Release();
+		DX::ResourceRegistry::Get()->Unregister(m_constantBufferHandle);
+		m_constantBufferHandle = DX::ResourceRegistry::InvalidHandle;
 	}
 
 } // namespace DX
\ No newline at end of file
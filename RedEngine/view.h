@@ -33,9 +33,22 @@ namespace DirectXX
 			m_viewMatrix = viewMatrix;
 		}
 
+		DirectX::XMFLOAT3				GetCameraPosition() const;
+
+		const DirectX::XMFLOAT4X4&		GetViewMatrix() const
+		{
+			return m_viewMatrix;
+		}
+
+		const DirectX::XMFLOAT4X4&		GetProjectionMatrix() const
+		{
+			return m_projectionMatrix;
+		}
+
 	private:
 		DeviceResources* m_deviceResources;
 		ID3D11Buffer* m_constantBuffer;
+		uint32_t						m_constantBufferHandle; // In the ResourceRegistry
 
 		DirectX::XMFLOAT4X4				m_worldMatrix;
 		DirectX::XMFLOAT4X4				m_viewMatrix;
@@ -0,0 +1,249 @@
+//--------------------------------------------------------------------
+// asset_packer.cpp - Builds memory-mappable asset packs
+//
+// Build: g++ -std=c++17 -O2 -I../../RedEngine asset_packer.cpp ../../RedEngine/compression.cpp -o asset_packer
+// Usage: asset_packer <output.rpak> [options] <files...>
+//--------------------------------------------------------------------
+
+#include "pack_format.h"
+#include "hash.h"
+#include "compression.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		const char*					outputPath = nullptr;
+		std::string					root;
+		bool						compress = false;
+		float						minSaving = 0.1f; // Store uncompressed unless compression saves at least this fraction
+		std::vector<std::string>	inputs;
+	};
+
+	struct Entry
+	{
+		std::string					name;
+		assets::PackEntry			header;
+		std::vector<uint8_t>		data;
+	};
+
+	void PrintUsage()
+	{
+		fprintf(stderr,
+			"Usage: asset_packer <output.rpak> [options] <files...>\n"
+			"  --root <dir>        Entry names are file paths relative to this directory\n"
+			"  --compress          LZ4 compress entries that shrink enough\n"
+			"  --min-saving <f>    Fraction an entry must shrink by to be stored compressed (default 0.1)\n"
+			"  @<list>             Read further file paths from a text file, one per line\n");
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		FILE* const file = fopen(path.c_str(), "rb");
+		if (file == nullptr)
+			return false;
+
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		data.resize(size_t(size));
+		const bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return ok;
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* const arg = argv[i];
+			if (strcmp(arg, "--root") == 0 && i + 1 < argc)
+				options.root = argv[++i];
+			else if (strcmp(arg, "--compress") == 0)
+				options.compress = true;
+			else if (strcmp(arg, "--min-saving") == 0 && i + 1 < argc)
+				options.minSaving = float(atof(argv[++i]));
+			else if (arg[0] == '@')
+			{
+				FILE* const list = fopen(arg + 1, "r");
+				if (list == nullptr)
+				{
+					fprintf(stderr, "Unable to open list %s\n", arg + 1);
+					return false;
+				}
+
+				char line[1024];
+				while (fgets(line, sizeof(line), list) != nullptr)
+				{
+					line[strcspn(line, "\r\n")] = '\0';
+					if (line[0] != '\0')
+						options.inputs.push_back(line);
+				}
+				fclose(list);
+			}
+			else if (arg[0] == '-')
+				return false;
+			else if (options.outputPath == nullptr)
+				options.outputPath = arg;
+			else
+				options.inputs.push_back(arg);
+		}
+
+		return options.outputPath != nullptr && !options.inputs.empty();
+	}
+
+	// Entries are looked up by the hash of their path relative to the root, with forward slashes
+	std::string EntryName(const std::string& path, const std::string& root)
+	{
+		std::string name = path;
+		std::replace(name.begin(), name.end(), '\\', '/');
+
+		std::string prefix = root;
+		std::replace(prefix.begin(), prefix.end(), '\\', '/');
+		if (!prefix.empty() && prefix.back() != '/')
+			prefix += '/';
+
+		if (!prefix.empty() && name.compare(0, prefix.size(), prefix) == 0)
+			name.erase(0, prefix.size());
+
+		return name;
+	}
+
+	uint64_t Align(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<Entry> entries;
+	entries.reserve(options.inputs.size());
+
+	uint64_t totalRaw = 0;
+	uint64_t totalStored = 0;
+
+	for (const std::string& input : options.inputs)
+	{
+		Entry entry;
+		entry.name = EntryName(input, options.root);
+		entry.header = {};
+		entry.header.nameHash = utils::HashName(entry.name.c_str());
+
+		std::vector<uint8_t> raw;
+		if (!ReadFile(input, raw))
+		{
+			fprintf(stderr, "Unable to read %s\n", input.c_str());
+			return 1;
+		}
+
+		entry.header.uncompressedSize = raw.size();
+
+		if (options.compress && !raw.empty())
+		{
+			std::vector<uint8_t> packed(compression::Lz4CompressBound(raw.size()));
+			const size_t packedSize = compression::Lz4Compress(raw.data(), raw.size(), packed.data(), packed.size());
+			if (packedSize != 0 && float(packedSize) <= float(raw.size()) * (1.0f - options.minSaving))
+			{
+				packed.resize(packedSize);
+				entry.data.swap(packed);
+				entry.header.flags |= assets::PackEntryCompressed;
+			}
+		}
+
+		if (entry.data.empty())
+			entry.data.swap(raw);
+
+		entry.header.size = entry.data.size();
+		totalRaw += entry.header.uncompressedSize;
+		totalStored += entry.header.size;
+
+		entries.push_back(std::move(entry));
+	}
+
+	// Sorted by hash so the same files always make the same pack, which also puts collisions side by side to refuse
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.header.nameHash < b.header.nameHash; });
+	for (size_t i = 1; i < entries.size(); ++i)
+	{
+		if (entries[i].header.nameHash == entries[i - 1].header.nameHash)
+		{
+			fprintf(stderr, "Name hash collision between %s and %s\n", entries[i - 1].name.c_str(), entries[i].name.c_str());
+			return 1;
+		}
+	}
+
+	// Layout: header, aligned entry data, table of contents
+	uint64_t offset = sizeof(assets::PackHeader);
+	for (Entry& entry : entries)
+	{
+		offset = Align(offset, assets::PackEntryAlignment);
+		entry.header.offset = offset;
+		offset += entry.header.size;
+	}
+
+	assets::PackHeader header = {};
+	header.magic = assets::PackMagic;
+	header.version = assets::PackVersion;
+	header.entryCount = uint32_t(entries.size());
+	header.entryAlignment = assets::PackEntryAlignment;
+	header.tocOffset = Align(offset, assets::PackEntryAlignment);
+	header.totalSize = header.tocOffset + entries.size() * sizeof(assets::PackEntry);
+
+	FILE* const file = fopen(options.outputPath, "wb");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Unable to create %s\n", options.outputPath);
+		return 1;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	static const uint8_t padding[assets::PackEntryAlignment] = {};
+	uint64_t written = sizeof(header);
+	for (const Entry& entry : entries)
+	{
+		ok = ok && fwrite(padding, 1, size_t(entry.header.offset - written), file) == size_t(entry.header.offset - written);
+		ok = ok && fwrite(entry.data.data(), 1, entry.data.size(), file) == entry.data.size();
+		written = entry.header.offset + entry.header.size;
+	}
+
+	ok = ok && fwrite(padding, 1, size_t(header.tocOffset - written), file) == size_t(header.tocOffset - written);
+	for (const Entry& entry : entries)
+		ok = ok && fwrite(&entry.header, sizeof(entry.header), 1, file) == 1;
+
+	fclose(file);
+
+	if (!ok)
+	{
+		fprintf(stderr, "Failed writing %s\n", options.outputPath);
+		return 1;
+	}
+
+	for (const Entry& entry : entries)
+	{
+		printf("  %016llx %10llu -> %10llu%s  %s\n", static_cast<unsigned long long>(entry.header.nameHash),
+			static_cast<unsigned long long>(entry.header.uncompressedSize), static_cast<unsigned long long>(entry.header.size),
+			(entry.header.flags & assets::PackEntryCompressed) ? " lz4" : "    ", entry.name.c_str());
+	}
+	printf("Wrote %s: %zu entries, %llu bytes of data stored as %llu\n", options.outputPath, entries.size(),
+		static_cast<unsigned long long>(totalRaw), static_cast<unsigned long long>(totalStored));
+
+	return 0;
+}
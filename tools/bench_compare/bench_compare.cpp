@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------
+// bench_compare.cpp - Compares two replay benchmark reports phase by phase, failing on a regression
+//
+// Build: g++ -std=c++17 -O2 bench_compare.cpp -o bench_compare
+//
+// Usage: bench_compare <baseline.json> <candidate.json> [--tolerance percent] [--stat mean|p50|p90|p99|max]
+// Exits 1 if any phase of the candidate is slower than the baseline by more than the tolerance.
+//--------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		const char*		baseline = nullptr;
+		const char*		candidate = nullptr;
+		double			tolerance = 5.0; // Percent
+		const char*		stat = "p50";
+	};
+
+	struct Phase
+	{
+		std::string		name;
+		double			stats[5]; // mean, p50, p90, p99, max in milliseconds
+	};
+
+	const char* const c_StatNames[] = { "mean", "p50", "p90", "p99", "max" };
+
+	// BenchmarkReport::WriteJson puts each phase on its own line, which is all this reads
+	bool Load(const char* path, std::vector<Phase>& phases, unsigned int& frames)
+	{
+		FILE* const file = fopen(path, "r");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Unable to open %s.\n", path);
+			return false;
+		}
+
+		frames = 0;
+		char line[512];
+		while (fgets(line, sizeof(line), file) != nullptr)
+		{
+			char name[64];
+			Phase phase;
+			if (sscanf(line, " \"frames\": %u", &frames) == 1)
+				continue;
+
+			if (sscanf(line, " \"%63[^\"]\": { \"mean\": %lf, \"p50\": %lf, \"p90\": %lf, \"p99\": %lf, \"max\": %lf", name,
+				&phase.stats[0], &phase.stats[1], &phase.stats[2], &phase.stats[3], &phase.stats[4]) == 6)
+			{
+				phase.name = name;
+				phases.push_back(phase);
+			}
+		}
+
+		fclose(file);
+
+		if (phases.empty())
+		{
+			fprintf(stderr, "%s has no phase timings in it.\n", path);
+			return false;
+		}
+		return true;
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			options.tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--stat") == 0 && i + 1 < argc)
+			options.stat = argv[++i];
+		else if (options.baseline == nullptr)
+			options.baseline = argv[i];
+		else if (options.candidate == nullptr)
+			options.candidate = argv[i];
+		else
+			options.baseline = nullptr;
+	}
+
+	int stat = -1;
+	for (int i = 0; i < 5; ++i)
+	{
+		if (strcmp(options.stat, c_StatNames[i]) == 0)
+			stat = i;
+	}
+
+	if (options.baseline == nullptr || options.candidate == nullptr || stat < 0)
+	{
+		fprintf(stderr, "Usage: bench_compare <baseline.json> <candidate.json> [--tolerance percent] [--stat mean|p50|p90|p99|max]\n");
+		return 2;
+	}
+
+	std::vector<Phase> baseline, candidate;
+	unsigned int baselineFrames = 0, candidateFrames = 0;
+	if (!Load(options.baseline, baseline, baselineFrames) || !Load(options.candidate, candidate, candidateFrames))
+		return 2;
+
+	if (baselineFrames != candidateFrames)
+		printf("Warning: %u frames against %u, the runs may not be the same workload.\n", baselineFrames, candidateFrames);
+
+	printf("%-10s %12s %12s %9s   (%s, tolerance %.1f%%)\n", "phase", "baseline", "candidate", "change", options.stat, options.tolerance);
+
+	int regressions = 0;
+	for (const Phase& before : baseline)
+	{
+		const Phase* after = nullptr;
+		for (const Phase& phase : candidate)
+		{
+			if (phase.name == before.name)
+				after = &phase;
+		}
+
+		if (after == nullptr)
+		{
+			printf("%-10s %9.3f ms %12s\n", before.name.c_str(), before.stats[stat], "missing");
+			continue;
+		}
+
+		const double change = before.stats[stat] > 0.0 ? 100.0 * (after->stats[stat] - before.stats[stat]) / before.stats[stat] : 0.0;
+		const bool regressed = change > options.tolerance;
+		printf("%-10s %9.3f ms %9.3f ms %+8.1f%%%s\n", before.name.c_str(), before.stats[stat], after->stats[stat], change,
+			regressed ? "  REGRESSED" : "");
+		if (regressed)
+			++regressions;
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
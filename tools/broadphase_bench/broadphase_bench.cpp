@@ -0,0 +1,288 @@
+//--------------------------------------------------------------------
+// broadphase_bench.cpp - Sweep and prune benchmark: 1k to 100k boxes moving about a world scaled to keep their
+//                        density, swept serially and across the job system, checked against testing every pair
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h broadphase_bench.cpp
+//            ../../RedEngine/broadphase.cpp ../../RedEngine/job_system.cpp ../../RedEngine/perf_counters.cpp
+//            -o broadphase_bench
+//
+// Usage: broadphase_bench [--bodies n[,n...]] [--frames n] [--workers n] [--check n]
+//--------------------------------------------------------------------
+
+#include "broadphase.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		std::vector<uint32_t>	bodyCounts = { 1000, 10000, 100000 };
+		unsigned int			frames = 30;
+		unsigned int			workers = 0;
+		uint32_t				checkLimit = 20000; // Largest count checked against every pair
+	};
+
+	const float c_TimeStep = 1.0f / 60.0f;
+	const float c_MaxSpeed = 10.0f;
+
+	struct Body
+	{
+		float					centre[3];
+		float					halfSize[3];
+		float					velocity[3];
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+	// About one neighbour each, whatever the count
+	float WorldSize(uint32_t count)
+	{
+		return 4.0f * std::cbrt(float(count));
+	}
+
+	std::vector<Body> MakeBodies(uint32_t count, std::mt19937& random)
+	{
+		const float world = WorldSize(count);
+		std::uniform_real_distribution<float> position(0.0f, world);
+		std::uniform_real_distribution<float> halfSize(0.5f, 1.5f);
+		std::uniform_real_distribution<float> velocity(-c_MaxSpeed, c_MaxSpeed);
+
+		std::vector<Body> bodies(count);
+		for (Body& body : bodies)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				body.centre[axis] = position(random);
+				body.halfSize[axis] = halfSize(random);
+				body.velocity[axis] = velocity(random);
+			}
+		}
+		return bodies;
+	}
+
+	scene::Broadphase::Box BoxOf(const Body& body)
+	{
+		scene::Broadphase::Box box;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			box.min[axis] = body.centre[axis] - body.halfSize[axis];
+			box.max[axis] = body.centre[axis] + body.halfSize[axis];
+		}
+		return box;
+	}
+
+	// Bouncing off the walls of the world
+	void Move(std::vector<Body>& bodies, float world)
+	{
+		for (Body& body : bodies)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				body.centre[axis] += body.velocity[axis] * c_TimeStep;
+				if (body.centre[axis] < 0.0f || body.centre[axis] > world)
+					body.velocity[axis] = -body.velocity[axis];
+			}
+		}
+	}
+
+	uint64_t PairKey(const scene::Broadphase::Pair& pair)
+	{
+		return uint64_t(pair.first) << 32 | pair.second;
+	}
+
+	std::vector<uint64_t> SortedKeys(const std::vector<scene::Broadphase::Pair>& pairs)
+	{
+		std::vector<uint64_t> keys(pairs.size());
+		for (size_t i = 0; i < pairs.size(); ++i)
+			keys[i] = PairKey(pairs[i]);
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+
+	std::vector<uint64_t> ReferencePairs(const scene::Broadphase& broadphase, uint32_t count)
+	{
+		std::vector<uint64_t> keys;
+		for (uint32_t a = 0; a < count; ++a)
+		{
+			const scene::Broadphase::Box& boxA = broadphase.GetBox(a);
+			for (uint32_t b = a + 1; b < count; ++b)
+			{
+				const scene::Broadphase::Box& boxB = broadphase.GetBox(b);
+				bool overlap = true;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+					overlap = overlap && boxA.min[axis] <= boxB.max[axis] && boxB.min[axis] <= boxA.max[axis];
+				if (overlap)
+					keys.push_back(uint64_t(a) << 32 | b);
+			}
+		}
+		return keys;
+	}
+
+	struct Run
+	{
+		double					first; // Sorting from nothing
+		std::vector<double>		frames;
+		uint64_t				shifts;
+		uint32_t				resorts;
+		std::vector<scene::Broadphase::Pair> pairs;
+	};
+
+	// The same bodies and moves every time for a count, so serial and job runs see the same frames
+	bool Simulate(uint32_t count, const Options& options, bool check, Run& run)
+	{
+		std::mt19937 random(count);
+		std::vector<Body> bodies = MakeBodies(count, random);
+		const float world = WorldSize(count);
+
+		scene::Broadphase broadphase;
+		for (const Body& body : bodies)
+			broadphase.AddBody(BoxOf(body));
+
+		run = Run();
+		const double firstStart = Seconds();
+		broadphase.Update();
+		run.first = Seconds() - firstStart;
+
+		bool ok = true;
+		for (unsigned int frame = 0; frame < options.frames; ++frame)
+		{
+			Move(bodies, world);
+			for (uint32_t i = 0; i < count; ++i)
+				broadphase.SetBox(i, BoxOf(bodies[i]));
+
+			const double start = Seconds();
+			broadphase.Update();
+			run.frames.push_back(Seconds() - start);
+			run.shifts += broadphase.GetStats().shifts;
+			run.resorts += broadphase.GetStats().resorts;
+
+			// Found once each, by the body that starts first
+			const std::vector<uint64_t> keys = SortedKeys(broadphase.GetPairs());
+			if (std::adjacent_find(keys.begin(), keys.end()) != keys.end())
+			{
+				fprintf(stderr, "%u bodies, frame %u: a pair is reported twice.\n", count, frame);
+				ok = false;
+			}
+
+			if (check && (frame == 0 || frame + 1 == options.frames) && keys != ReferencePairs(broadphase, count))
+			{
+				fprintf(stderr, "%u bodies, frame %u: pairs disagree with testing every pair.\n", count, frame);
+				ok = false;
+			}
+		}
+
+		run.pairs = broadphase.GetPairs();
+		return ok;
+	}
+
+	bool CheckRemoval()
+	{
+		scene::Broadphase broadphase(1);
+		const scene::Broadphase::Box box = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+		const uint32_t a = broadphase.AddBody(box);
+		const uint32_t b = broadphase.AddBody(box);
+		const uint32_t c = broadphase.AddBody(box);
+		broadphase.Update();
+		if (broadphase.GetPairs().size() != 3)
+			return false;
+
+		// Removed ids aren't handed out again until the order has forgotten them
+		broadphase.RemoveBody(b);
+		const uint32_t d = broadphase.AddBody(box);
+		broadphase.Update();
+		const std::vector<uint64_t> keys = SortedKeys(broadphase.GetPairs());
+		const std::vector<uint64_t> expected = { uint64_t(a) << 32 | c, uint64_t(a) << 32 | d, uint64_t(c) << 32 | d };
+		return d != b && keys == expected && broadphase.AddBody(box) == b;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+		{
+			options.bodyCounts.clear();
+			for (const char* count = argv[++i]; count != nullptr; count = strchr(count, ','))
+			{
+				count += *count == ',';
+				options.bodyCounts.push_back(uint32_t(atoi(count)));
+			}
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			options.workers = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+			options.checkLimit = uint32_t(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: broadphase_bench [--bodies n[,n...]] [--frames n] [--workers n] [--check n]\n");
+			return 2;
+		}
+	}
+
+	if (options.frames == 0 || std::find(options.bodyCounts.begin(), options.bodyCounts.end(), 0u) != options.bodyCounts.end())
+	{
+		fprintf(stderr, "Body counts and frames must be at least 1.\n");
+		return 2;
+	}
+
+	bool ok = CheckRemoval();
+	if (!ok)
+		fprintf(stderr, "Removing and re-adding bodies gave the wrong pairs.\n");
+
+	// Serial first, before there is a job system to spread over
+	std::vector<Run> serial(options.bodyCounts.size());
+	for (size_t i = 0; i < options.bodyCounts.size(); ++i)
+		ok = Simulate(options.bodyCounts[i], options, options.bodyCounts[i] <= options.checkLimit, serial[i]) && ok;
+
+	utils::JobSystem::Create(options.workers);
+
+	printf("%u frames of %.1f ms at up to %.0f units/s, %u workers, p50 (max) ms\n", options.frames, c_TimeStep * 1e3, c_MaxSpeed,
+		utils::JobSystem::Get()->GetWorkerCount());
+	printf("%8s %9s %11s %9s %16s %16s %9s %8s\n", "bodies", "pairs", "shifts", "first", "serial", "jobs", "resorts", "ns/body");
+	for (size_t i = 0; i < options.bodyCounts.size(); ++i)
+	{
+		const uint32_t count = options.bodyCounts[i];
+		Run jobs;
+		ok = Simulate(count, options, false, jobs) && ok;
+		if (jobs.pairs.size() != serial[i].pairs.size() ||
+			memcmp(jobs.pairs.data(), serial[i].pairs.data(), jobs.pairs.size() * sizeof(scene::Broadphase::Pair)) != 0)
+		{
+			fprintf(stderr, "%u bodies: the job system found different pairs to the serial run.\n", count);
+			ok = false;
+		}
+
+		const double p50 = Percentile(jobs.frames, 0.5);
+		printf("%8u %9zu %11.0f %9.3f %7.3f (%6.3f) %7.3f (%6.3f) %9u %8.1f\n", count, jobs.pairs.size(),
+			double(jobs.shifts) / options.frames, jobs.first * 1e3, Percentile(serial[i].frames, 0.5) * 1e3, Percentile(serial[i].frames, 1.0) * 1e3,
+			p50 * 1e3, Percentile(jobs.frames, 1.0) * 1e3, jobs.resorts, p50 * 1e9 / double(count));
+	}
+
+	utils::JobSystem::Destroy();
+
+	printf(ok ? "Broadphase checks passed.\n" : "Broadphase checks failed.\n");
+	return ok ? 0 : 1;
+}
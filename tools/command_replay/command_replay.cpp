@@ -0,0 +1,313 @@
+//--------------------------------------------------------------------
+// command_replay.cpp - Replays a captured frame of device context commands against a null backend, to profile
+//                      submission cost and find redundant state changes without a GPU
+//
+// Build: g++ -std=c++17 -O2 -I../../RedEngine -include ../common/headless_engine.h command_replay.cpp
+//            ../../RedEngine/command_stream.cpp -o command_replay
+//
+// Usage: command_replay <capture.rcmd> [--passes n]
+// Capture with the engine's -capture <file>. The null backend shadows the context's bindings like a driver would, so
+// a set that changes nothing counts as redundant, and copies map and update payloads into per-object memory so the
+// upload traffic is paid for.
+//--------------------------------------------------------------------
+
+#include "command_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		const char*		path = nullptr;
+		unsigned int	passes = 1000;
+	};
+
+	const char* const c_OpNames[DX::CommandOpCount] =
+	{
+		"DeclareObject", "ClearRenderTargetView", "ClearDepthStencilView", "SetRenderTargets", "SetViewports",
+		"SetRasterizerState", "SetBlendState", "SetDepthStencilState", "SetInputLayout", "SetVertexBuffers",
+		"SetIndexBuffer", "SetPrimitiveTopology", "SetVertexShader", "SetPixelShader", "SetVertexConstantBuffers",
+		"SetPixelConstantBuffers", "SetVertexShaderResources", "SetPixelShaderResources", "SetVertexSamplers",
+		"SetPixelSamplers", "MapWrite", "UpdateSubresource", "Draw", "DrawIndexed", "DrawInstanced",
+		"DrawIndexedInstanced", "Unrecorded",
+	};
+
+	// Slot counts from D3D11's limits
+	const uint32_t c_RenderTargets = 8;
+	const uint32_t c_VertexBuffers = 32;
+	const uint32_t c_ConstantBuffers = 14;
+	const uint32_t c_ShaderResources = 128;
+	const uint32_t c_Samplers = 16;
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct OpStats
+	{
+		uint64_t		count = 0;
+		uint64_t		redundant = 0;
+		uint64_t		bytes = 0;
+	};
+
+	// Everything bound to the context. Whole commands are compared, as a driver has to validate a set either way.
+	struct NullContext
+	{
+		uint32_t		renderTargets[c_RenderTargets + 1]; // Depth first
+		uint32_t		viewport[6];
+		uint32_t		rasterizer;
+		uint32_t		blend[6];
+		uint32_t		depthStencil[2];
+		uint32_t		inputLayout;
+		uint32_t		vertexBuffers[c_VertexBuffers * 3];
+		uint32_t		indexBuffer[3];
+		uint32_t		topology;
+		uint32_t		vertexShader;
+		uint32_t		pixelShader;
+		uint32_t		vertexConstants[c_ConstantBuffers];
+		uint32_t		pixelConstants[c_ConstantBuffers];
+		uint32_t		vertexResources[c_ShaderResources];
+		uint32_t		pixelResources[c_ShaderResources];
+		uint32_t		vertexSamplers[c_Samplers];
+		uint32_t		pixelSamplers[c_Samplers];
+	};
+
+	class NullBackend
+	{
+	public:
+		explicit NullBackend(uint32_t objectCount) :
+			m_objects(objectCount + 1),
+			m_stats(),
+			m_drawCalls(0)
+		{
+			memset(&m_context, 0, sizeof(m_context));
+		}
+
+		// ClearState, as the captured frame started from whatever the last one left behind
+		void BeginPass()
+		{
+			memset(&m_context, 0, sizeof(m_context));
+		}
+
+		void Execute(const DX::CommandReader::Command& command)
+		{
+			OpStats& stats = m_stats[command.op];
+			++stats.count;
+
+			bool changed = true;
+			switch (command.op)
+			{
+			case DX::CommandDeclareObject:
+				if (command.argCount >= 3 && command.args[0] < m_objects.size() && command.args[1] == DX::CommandObjectBuffer)
+					m_objects[command.args[0]].resize(command.args[2]);
+				break;
+
+			case DX::CommandSetRenderTargets:
+				changed = SetSlots(m_context.renderTargets, c_RenderTargets + 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetViewports:
+				changed = SetSlots(m_context.viewport, 6, 0, command.args, std::min(command.argCount, 6u));
+				break;
+			case DX::CommandSetRasterizerState:
+				changed = SetSlots(&m_context.rasterizer, 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetBlendState:
+				changed = SetSlots(m_context.blend, 6, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetDepthStencilState:
+				changed = SetSlots(m_context.depthStencil, 2, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetInputLayout:
+				changed = SetSlots(&m_context.inputLayout, 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetVertexBuffers:
+				changed = SetStartSlots(m_context.vertexBuffers, c_VertexBuffers * 3, command, 3);
+				break;
+			case DX::CommandSetIndexBuffer:
+				changed = SetSlots(m_context.indexBuffer, 3, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetPrimitiveTopology:
+				changed = SetSlots(&m_context.topology, 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetVertexShader:
+				changed = SetSlots(&m_context.vertexShader, 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetPixelShader:
+				changed = SetSlots(&m_context.pixelShader, 1, 0, command.args, command.argCount);
+				break;
+			case DX::CommandSetVertexConstantBuffers:
+				changed = SetStartSlots(m_context.vertexConstants, c_ConstantBuffers, command, 1);
+				break;
+			case DX::CommandSetPixelConstantBuffers:
+				changed = SetStartSlots(m_context.pixelConstants, c_ConstantBuffers, command, 1);
+				break;
+			case DX::CommandSetVertexShaderResources:
+				changed = SetStartSlots(m_context.vertexResources, c_ShaderResources, command, 1);
+				break;
+			case DX::CommandSetPixelShaderResources:
+				changed = SetStartSlots(m_context.pixelResources, c_ShaderResources, command, 1);
+				break;
+			case DX::CommandSetVertexSamplers:
+				changed = SetStartSlots(m_context.vertexSamplers, c_Samplers, command, 1);
+				break;
+			case DX::CommandSetPixelSamplers:
+				changed = SetStartSlots(m_context.pixelSamplers, c_Samplers, command, 1);
+				break;
+
+			case DX::CommandMapWrite:
+			case DX::CommandUpdateSubresource:
+				if (command.argCount >= 1 && command.args[0] < m_objects.size())
+				{
+					// Textures aren't declared with a size, so they grow to whatever is written to them
+					std::vector<uint8_t>& contents = m_objects[command.args[0]];
+					if (contents.size() < command.dataSize)
+						contents.resize(command.dataSize);
+					if (command.dataSize > 0)
+						memcpy(contents.data(), command.data, command.dataSize);
+				}
+				stats.bytes += command.dataSize;
+				break;
+
+			case DX::CommandDraw:
+			case DX::CommandDrawIndexed:
+			case DX::CommandDrawInstanced:
+			case DX::CommandDrawIndexedInstanced:
+				++m_drawCalls;
+				break;
+
+			default:
+				break;
+			}
+
+			if (!changed)
+				++stats.redundant;
+		}
+
+		const OpStats&				GetStats(DX::CommandOp op) const
+		{
+			return m_stats[op];
+		}
+
+		uint64_t					GetDrawCalls() const
+		{
+			return m_drawCalls;
+		}
+
+	private:
+		// True if anything changed; slots past the set ones are left alone
+		static bool SetSlots(uint32_t* slots, uint32_t slotCount, uint32_t start, const uint32_t* values, uint32_t count)
+		{
+			if (start >= slotCount)
+				return true;
+			count = std::min(count, slotCount - start);
+			if (memcmp(slots + start, values, count * sizeof(uint32_t)) == 0)
+				return false;
+			memcpy(slots + start, values, count * sizeof(uint32_t));
+			return true;
+		}
+
+		// For the commands that lead with a start slot, each slot being stride arguments wide
+		static bool SetStartSlots(uint32_t* slots, uint32_t slotCount, const DX::CommandReader::Command& command, uint32_t stride)
+		{
+			if (command.argCount < 1)
+				return true;
+			return SetSlots(slots, slotCount, command.args[0] * stride, command.args + 1, command.argCount - 1);
+		}
+
+		std::vector<std::vector<uint8_t>>	m_objects; // Indexed by id, the memory uploads land in
+		NullContext					m_context;
+		OpStats						m_stats[DX::CommandOpCount];
+		uint64_t					m_drawCalls;
+	};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc)
+			options.passes = unsigned(atoi(argv[++i]));
+		else
+			options.path = argv[i];
+	}
+
+	if (options.path == nullptr || options.passes == 0)
+	{
+		fprintf(stderr, "Usage: command_replay <capture.rcmd> [--passes n]\n");
+		return 2;
+	}
+
+	DX::CommandReader reader;
+	if (!reader.Load(options.path))
+		return 2;
+
+	const DX::CommandStreamHeader& header = reader.GetHeader();
+	printf("%s: %u commands, %u objects, %.1f KB\n", options.path, header.commandCount, header.objectCount,
+		double(header.streamSize) / 1024.0);
+
+	// Unrecorded calls are listed once, from the stream rather than every pass
+	std::map<std::string, unsigned int> unrecorded;
+	size_t offset = 0;
+	DX::CommandReader::Command command;
+	while (reader.Next(offset, command))
+	{
+		if (command.op == DX::CommandUnrecorded)
+			++unrecorded[std::string(reinterpret_cast<const char*>(command.data), command.dataSize)];
+	}
+
+	NullBackend backend(header.objectCount);
+	std::vector<double> passTimes;
+	passTimes.reserve(options.passes);
+	for (unsigned int pass = 0; pass < options.passes; ++pass)
+	{
+		const double start = Seconds();
+		backend.BeginPass();
+		offset = 0;
+		while (reader.Next(offset, command))
+			backend.Execute(command);
+		passTimes.push_back(Seconds() - start);
+	}
+
+	std::sort(passTimes.begin(), passTimes.end());
+	double total = 0.0;
+	for (double time : passTimes)
+		total += time;
+	const double mean = total / double(passTimes.size());
+	const double commands = double(std::max(header.commandCount, 1u));
+
+	printf("%u passes: mean %.3f us, min %.3f us, p50 %.3f us per pass, %.1f ns per command\n", options.passes, mean * 1e6,
+		passTimes.front() * 1e6, passTimes[passTimes.size() / 2] * 1e6, mean * 1e9 / commands);
+	printf("%llu draws per pass\n\n", (unsigned long long)(backend.GetDrawCalls() / options.passes));
+
+	// Per pass, as every pass runs the same commands
+	printf("%-28s %8s %10s %12s\n", "command", "count", "redundant", "bytes");
+	for (uint16_t op = 0; op < DX::CommandOpCount; ++op)
+	{
+		const OpStats& stats = backend.GetStats(DX::CommandOp(op));
+		if (stats.count == 0)
+			continue;
+		printf("%-28s %8llu %10llu %12llu\n", c_OpNames[op], (unsigned long long)(stats.count / options.passes),
+			(unsigned long long)(stats.redundant / options.passes), (unsigned long long)(stats.bytes / options.passes));
+	}
+
+	if (!unrecorded.empty())
+	{
+		printf("\nPassed through without recording, so not in the timings above:\n");
+		for (const auto& method : unrecorded)
+			printf("  %-40s %u\n", method.first.c_str(), method.second);
+	}
+
+	return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Force-included (-include) when building engine modules into the Linux tools and benchmarks,
+// standing in for the engine-wide macros the Windows build gets from its precompiled header.
+
+#include <cstdio>
+#include <cstdlib>
+
+#if !defined(ASSERT)
+#define ASSERT(condition, ...) do { if (!(condition)) { fprintf(stderr, __VA_ARGS__); abort(); } } while (0)
+#endif
+
+#if !defined(DEBUG_MESSAGE)
+#define DEBUG_MESSAGE(...) fprintf(stderr, __VA_ARGS__)
+#endif
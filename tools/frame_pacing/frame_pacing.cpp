@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------
+// frame_pacing.cpp - Frame limiter pacing error and CPU cost against a busy-wait loop
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h frame_pacing.cpp
+//            ../../RedEngine/frame_limiter.cpp -o frame_pacing
+//--------------------------------------------------------------------
+
+#include "frame_limiter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		double			frameRate = 75.0;
+		double			latencyBudget = 0.0;
+		double			workMs = 3.0;
+		double			jitterMs = 2.0; // Work varies by up to this much either way
+		unsigned int	frames = 300;
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Spin(double seconds)
+	{
+		const double end = Seconds() + seconds;
+		while (Seconds() < end)
+		{
+		}
+	}
+
+	struct Result
+	{
+		double			wall;
+		double			cpu;
+		double			frameTimeDeviation; // Standard deviation of start to start times
+		double			meanFrameTime;
+	};
+
+	Result Summarise(const std::vector<double>& starts, double wall, double cpu)
+	{
+		Result result = { wall, cpu, 0.0, 0.0 };
+		if (starts.size() < 2)
+			return result;
+
+		const size_t count = starts.size() - 1;
+		for (size_t i = 0; i < count; ++i)
+			result.meanFrameTime += starts[i + 1] - starts[i];
+		result.meanFrameTime /= double(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const double delta = starts[i + 1] - starts[i] - result.meanFrameTime;
+			result.frameTimeDeviation += delta * delta;
+		}
+		result.frameTimeDeviation = sqrt(result.frameTimeDeviation / double(count));
+		return result;
+	}
+
+	void Print(const char* name, const Result& result)
+	{
+		printf("  %-10s frame %.3f ms  stddev %.3f ms  cpu %.0f %% of wall time\n", name, result.meanFrameTime * 1e3,
+			result.frameTimeDeviation * 1e3, 100.0 * result.cpu / result.wall);
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			options.frameRate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc)
+			options.latencyBudget = atof(argv[++i]) * 0.001;
+		else if (strcmp(argv[i], "--work-ms") == 0 && i + 1 < argc)
+			options.workMs = atof(argv[++i]);
+		else if (strcmp(argv[i], "--jitter-ms") == 0 && i + 1 < argc)
+			options.jitterMs = atof(argv[++i]);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: frame_pacing [--fps f] [--latency-ms f] [--work-ms f] [--jitter-ms f] [--frames n]\n");
+			return 1;
+		}
+	}
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> jitter(-options.jitterMs, options.jitterMs);
+	std::vector<double> work(options.frames);
+	for (double& w : work)
+		w = std::max(0.0, options.workMs + jitter(random)) * 0.001;
+
+	std::vector<double> starts;
+	starts.reserve(options.frames);
+
+	// The old loop: spin until the frame time has passed
+	const double period = 1.0 / options.frameRate;
+	double wallStart = Seconds();
+	std::clock_t cpuStart = std::clock();
+	double last = Seconds();
+	for (unsigned int frame = 0; frame < options.frames; ++frame)
+	{
+		while (Seconds() - last < period)
+		{
+		}
+		last = Seconds();
+		starts.push_back(last);
+		Spin(work[frame]);
+	}
+	const Result busy = Summarise(starts, Seconds() - wallStart, double(std::clock() - cpuStart) / CLOCKS_PER_SEC);
+
+	utils::FrameLimiter limiter;
+	limiter.SetTargetFrameRate(options.frameRate);
+	limiter.SetLatencyBudget(options.latencyBudget);
+
+	starts.clear();
+	wallStart = Seconds();
+	cpuStart = std::clock();
+	for (unsigned int frame = 0; frame < options.frames; ++frame)
+	{
+		limiter.BeginFrame();
+		starts.push_back(Seconds());
+		Spin(work[frame]);
+		limiter.EndFrame();
+	}
+	const Result limited = Summarise(starts, Seconds() - wallStart, double(std::clock() - cpuStart) / CLOCKS_PER_SEC);
+
+	const utils::FrameLimiter::Stats stats = limiter.GetStats();
+	printf("%u frames, %.1f ms work +/- %.1f ms, ", options.frames, options.workMs, options.jitterMs);
+	if (options.latencyBudget > 0.0)
+		printf("%.1f ms latency budget\n", options.latencyBudget * 1e3);
+	else
+		printf("%.0f fps target\n", options.frameRate);
+	Print("busy wait", busy);
+	Print("limiter", limited);
+	printf("  pacing error avg %.3f ms  p99 %.3f ms  max %.3f ms, %u missed, spin margin %.3f ms, period %.3f ms\n",
+		stats.averageError * 1e3, stats.p99Error * 1e3, stats.maxError * 1e3, stats.missed, stats.spinMargin * 1e3, stats.period * 1e3);
+
+	return 0;
+}
@@ -0,0 +1,324 @@
+//--------------------------------------------------------------------
+// hash_bench.cpp - containers::HashMap against std::unordered_map: inserts, hits, misses and erases over 1k to
+//                  1M 64-bit keys, a random mix of operations checked against std::unordered_map, and the
+//                  string interner
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h hash_bench.cpp
+//            ../../RedEngine/string_interner.cpp -o hash_bench
+//
+// Usage: hash_bench [--sizes n[,n...]] [--lookups n] [--names n]
+//--------------------------------------------------------------------
+
+#include "hash_map.h"
+#include "string_interner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using containers::operator""_id;
+
+// Literals are hashed by the compiler, to the same value as the packer and the interner give the name
+static_assert("a"_id.Get() == 0xaf63dc4c8601ec8cull, "StringId isn't FNV-1a.");
+static_assert(containers::StringId("textures/stone") == "textures/stone"_id, "Literal ids disagree.");
+
+namespace
+{
+
+	struct Options
+	{
+		std::vector<uint32_t>	sizes = { 1000, 64 * 1024, 1024 * 1024 };
+		uint32_t				lookups = 4 * 1024 * 1024;
+		uint32_t				names = 100000;
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Nanoseconds per operation for each step of filling, searching and emptying a map
+	struct Timings
+	{
+		double					insert;
+		double					hit;
+		double					miss;
+		double					erase;
+		uint64_t				checksum; // Keeps the lookups from being optimised away, and must match between maps
+	};
+
+	// Random keys, the first half inserted and the second half never
+	std::vector<uint64_t> MakeKeys(uint32_t count)
+	{
+		std::mt19937_64 random(count);
+		std::vector<uint64_t> keys(size_t(count) * 2);
+		for (uint64_t& key : keys)
+			key = random();
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		std::shuffle(keys.begin(), keys.end(), random);
+		keys.resize(size_t(count) * 2, 0);
+		return keys;
+	}
+
+	// Lookups in random order, so the big maps miss in cache as real name lookups do
+	std::vector<uint32_t> MakeOrder(uint32_t count, uint32_t lookups)
+	{
+		std::mt19937 random(lookups ^ count);
+		std::uniform_int_distribution<uint32_t> index(0, count - 1);
+		std::vector<uint32_t> order(lookups);
+		for (uint32_t& i : order)
+			i = index(random);
+		return order;
+	}
+
+	template <typename Map>
+	uint32_t* Find(Map& map, uint64_t key);
+
+	template <>
+	uint32_t* Find(containers::HashMap<uint64_t, uint32_t>& map, uint64_t key)
+	{
+		return map.find(key);
+	}
+
+	template <>
+	uint32_t* Find(std::unordered_map<uint64_t, uint32_t>& map, uint64_t key)
+	{
+		const auto found = map.find(key);
+		return found != map.end() ? &found->second : nullptr;
+	}
+
+	template <typename Map>
+	Timings Time(uint32_t count, const std::vector<uint64_t>& keys, const std::vector<uint32_t>& order)
+	{
+		Timings timings = {};
+		Map map;
+
+		double start = Seconds();
+		for (uint32_t i = 0; i < count; ++i)
+			map[keys[i]] = i;
+		timings.insert = (Seconds() - start) * 1e9 / count;
+
+		start = Seconds();
+		for (uint32_t i : order)
+		{
+			const uint32_t* value = Find(map, keys[i]);
+			timings.checksum += value != nullptr ? *value : 0;
+		}
+		timings.hit = (Seconds() - start) * 1e9 / order.size();
+
+		start = Seconds();
+		for (uint32_t i : order)
+			timings.checksum += Find(map, keys[count + i]) != nullptr ? 1 : 0;
+		timings.miss = (Seconds() - start) * 1e9 / order.size();
+
+		start = Seconds();
+		for (uint32_t i = 0; i < count; ++i)
+			map.erase(keys[i]);
+		timings.erase = (Seconds() - start) * 1e9 / count;
+		timings.checksum += map.size();
+		return timings;
+	}
+
+	// Inserts, erases and lookups at random over a small key range, so slots are deleted and reused and the table
+	// grows and rehashes, against std::unordered_map doing the same
+	bool CheckOperations()
+	{
+		std::mt19937 random(7);
+		std::uniform_int_distribution<uint32_t> key(0, 5000);
+		std::uniform_int_distribution<uint32_t> operation(0, 9);
+
+		containers::HashMap<uint32_t, uint32_t> map;
+		std::unordered_map<uint32_t, uint32_t> reference;
+		for (uint32_t step = 0; step < 2000000; ++step)
+		{
+			const uint32_t k = key(random);
+			switch (operation(random))
+			{
+			case 0:
+			case 1:
+			case 2:
+			{
+				const bool added = map.insert(k, step).second;
+				if (added != reference.emplace(k, step).second)
+					return false;
+				break;
+			}
+			case 3:
+			case 4:
+				if (map.erase(k) != (reference.erase(k) != 0))
+					return false;
+				break;
+			case 5:
+				map[k] = step;
+				reference[k] = step;
+				break;
+			case 6:
+				if (step % 100000 == 0)
+				{
+					map.clear();
+					reference.clear();
+				}
+				break;
+			default:
+			{
+				const uint32_t* value = map.find(k);
+				const auto found = reference.find(k);
+				if ((value != nullptr) != (found != reference.end()) || (value != nullptr && *value != found->second))
+					return false;
+				break;
+			}
+			}
+
+			if (map.size() != reference.size())
+				return false;
+		}
+
+		// And everything left, every way round
+		size_t visited = 0;
+		bool ok = true;
+		map.for_each([&](const uint32_t& k, uint32_t& value)
+		{
+			const auto found = reference.find(k);
+			ok = ok && found != reference.end() && found->second == value;
+			++visited;
+		});
+		return ok && visited == reference.size();
+	}
+
+	// Keys that own memory, moved about as the table grows
+	bool CheckStrings()
+	{
+		struct StringHash
+		{
+			uint64_t operator()(const std::string& key) const
+			{
+				return containers::Hash<uint64_t>()(utils::HashBytes(key.data(), key.size()));
+			}
+		};
+
+		containers::HashMap<std::string, std::string, StringHash> map;
+		for (uint32_t i = 0; i < 10000; ++i)
+			map.insert("key " + std::to_string(i), std::string(i % 40, 'x'));
+		for (uint32_t i = 0; i < 10000; i += 2)
+			map.erase("key " + std::to_string(i));
+
+		for (uint32_t i = 0; i < 10000; ++i)
+		{
+			const std::string* value = map.find("key " + std::to_string(i));
+			if ((value != nullptr) != (i % 2 == 1) || (value != nullptr && *value != std::string(i % 40, 'x')))
+				return false;
+		}
+		return map.size() == 5000;
+	}
+
+	bool CheckInterner(uint32_t count, double& nsPerName, double& nsPerFind)
+	{
+		std::vector<std::string> names(count);
+		for (uint32_t i = 0; i < count; ++i)
+			names[i] = "textures/level" + std::to_string(i % 37) + "/surface_" + std::to_string(i) + ".dds";
+
+		std::vector<containers::StringId> ids(count);
+		const double start = Seconds();
+		for (uint32_t i = 0; i < count; ++i)
+			ids[i] = containers::StringInterner::Intern(names[i].c_str());
+		nsPerName = (Seconds() - start) * 1e9 / count;
+
+		// Interning again gives the same id without another copy, and the length form agrees
+		bool ok = containers::StringInterner::GetCount() == count;
+		for (uint32_t i = 0; i < count && ok; i += 97)
+		{
+			const std::string padded = names[i] + "trailing";
+			ok = containers::StringInterner::Intern(padded.c_str(), names[i].size()) == ids[i] &&
+				ids[i] == containers::StringId(utils::HashName(names[i].c_str()));
+		}
+		ok = ok && containers::StringInterner::GetCount() == count;
+
+		const double findStart = Seconds();
+		for (uint32_t i = 0; i < count && ok; ++i)
+		{
+			const char* name = containers::StringInterner::Find(ids[i]);
+			ok = name != nullptr && names[i] == name;
+		}
+		nsPerFind = (Seconds() - findStart) * 1e9 / count;
+
+		return ok && containers::StringInterner::Find("never/interned"_id) == nullptr &&
+			containers::StringInterner::Intern("textures/stone") == "textures/stone"_id;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc)
+		{
+			options.sizes.clear();
+			for (const char* size = argv[++i]; size != nullptr; size = strchr(size, ','))
+			{
+				size += *size == ',';
+				options.sizes.push_back(uint32_t(atoi(size)));
+			}
+		}
+		else if (strcmp(argv[i], "--lookups") == 0 && i + 1 < argc)
+			options.lookups = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--names") == 0 && i + 1 < argc)
+			options.names = uint32_t(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: hash_bench [--sizes n[,n...]] [--lookups n] [--names n]\n");
+			return 2;
+		}
+	}
+
+	if (options.lookups == 0 || options.names == 0 || std::find(options.sizes.begin(), options.sizes.end(), 0u) != options.sizes.end())
+	{
+		fprintf(stderr, "Sizes, lookups and names must be at least 1.\n");
+		return 2;
+	}
+
+	bool ok = CheckOperations();
+	if (!ok)
+		fprintf(stderr, "HashMap disagrees with std::unordered_map over random operations.\n");
+	if (!CheckStrings())
+	{
+		fprintf(stderr, "HashMap lost or mangled string keys.\n");
+		ok = false;
+	}
+
+	printf("%u lookups each, ns per operation, HashMap / std::unordered_map\n", options.lookups);
+	printf("%9s %16s %16s %16s %16s\n", "keys", "insert", "hit", "miss", "erase");
+	for (uint32_t count : options.sizes)
+	{
+		const std::vector<uint64_t> keys = MakeKeys(count);
+		const std::vector<uint32_t> order = MakeOrder(count, options.lookups);
+		const Timings flat = Time<containers::HashMap<uint64_t, uint32_t>>(count, keys, order);
+		const Timings node = Time<std::unordered_map<uint64_t, uint32_t>>(count, keys, order);
+		if (flat.checksum != node.checksum)
+		{
+			fprintf(stderr, "%u keys: HashMap found different values to std::unordered_map.\n", count);
+			ok = false;
+		}
+
+		printf("%9u %7.1f / %6.1f %7.1f / %6.1f %7.1f / %6.1f %7.1f / %6.1f\n", count, flat.insert, node.insert, flat.hit, node.hit,
+			flat.miss, node.miss, flat.erase, node.erase);
+	}
+
+	double nsPerName = 0.0;
+	double nsPerFind = 0.0;
+	if (!CheckInterner(options.names, nsPerName, nsPerFind))
+	{
+		fprintf(stderr, "The string interner lost names or gave the wrong ids.\n");
+		ok = false;
+	}
+	printf("Interned %u names at %.1f ns each, found again at %.1f ns each\n", options.names, nsPerName, nsPerFind);
+
+	printf(ok ? "Hash map checks passed.\n" : "Hash map checks failed.\n");
+	return ok ? 0 : 1;
+}
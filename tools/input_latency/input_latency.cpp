@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------
+// input_latency.cpp - Input event queue throughput and input-to-present latency, without a window
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h input_latency.cpp
+//            ../../RedEngine/input_events.cpp ../../RedEngine/headless_input.cpp -o input_latency
+//--------------------------------------------------------------------
+
+#include "input_events.h"
+#include "headless_input.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+
+	struct Options
+	{
+		double			seconds = 5.0;
+		double			eventsPerSecond = 200.0;
+		double			tickHz = 60.0;
+		double			workMs = 4.0; // Update and render cost per tick
+		unsigned int	throughputEvents = 10000000;
+		const char*		scriptPath = nullptr;
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Spin(double seconds)
+	{
+		const double end = Seconds() + seconds;
+		while (Seconds() < end)
+		{
+		}
+	}
+
+	// Raw queue cost with one thread flat out on each side
+	void MeasureThroughput(unsigned int count)
+	{
+		input::InputEventQueue queue(1024);
+
+		const double start = Seconds();
+		std::thread producer([&queue, count]()
+			{
+				input::InputEvent event = {};
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					event.key = i;
+					while (!queue.Push(event))
+						std::this_thread::yield();
+				}
+			});
+
+		unsigned int received = 0;
+		bool ordered = true;
+		input::InputEvent event;
+		while (received < count)
+		{
+			if (queue.Pop(event))
+			{
+				ordered &= event.key == received;
+				++received;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		producer.join();
+		const double elapsed = Seconds() - start;
+
+		printf("throughput\n");
+		printf("  %u events in %.3f s, %.1f M events/s, %s, %u pushes refused while full\n", count, elapsed,
+			double(count) / elapsed * 1e-6, ordered ? "in order" : "OUT OF ORDER", queue.GetDropped());
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			options.seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			options.eventsPerSecond = atof(argv[++i]);
+		else if (strcmp(argv[i], "--tick-hz") == 0 && i + 1 < argc)
+			options.tickHz = atof(argv[++i]);
+		else if (strcmp(argv[i], "--work-ms") == 0 && i + 1 < argc)
+			options.workMs = atof(argv[++i]);
+		else if (strcmp(argv[i], "--throughput") == 0 && i + 1 < argc)
+			options.throughputEvents = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+			options.scriptPath = argv[++i];
+		else
+		{
+			fprintf(stderr, "Usage: input_latency [--seconds f] [--rate f] [--tick-hz f] [--work-ms f] [--throughput n] [--script file]\n");
+			return 1;
+		}
+	}
+
+	MeasureThroughput(options.throughputEvents);
+
+	input::InputEventQueue queue;
+	input::InputLatency latency(4096);
+	input::HeadlessInputSource source(queue);
+
+	if (options.scriptPath != nullptr)
+	{
+		if (!source.Load(options.scriptPath))
+			return 1;
+	}
+	else
+	{
+		// Alternate presses and releases of a handful of keys at a steady rate
+		const unsigned int count = unsigned(options.seconds * options.eventsPerSecond);
+		for (unsigned int i = 0; i < count; ++i)
+			source.Add(double(i) / options.eventsPerSecond, (i & 1) ? input::InputEvent::KeyUp : input::InputEvent::KeyDown, 'A' + (i / 2) % 8);
+	}
+
+	// The game loop: drain at the top of the tick, do the frame's work, present, wait for the next tick
+	const double tick = 1.0 / options.tickHz;
+	unsigned int consumed = 0;
+	unsigned int ticks = 0;
+
+	source.Start();
+	double nextTick = Seconds();
+	while (!source.IsFinished() || consumed < source.GetEventCount() - queue.GetDropped())
+	{
+		input::InputEvent event;
+		while (queue.Pop(event))
+		{
+			latency.OnConsumed(event);
+			++consumed;
+		}
+
+		Spin(options.workMs * 0.001);
+		latency.OnPresented(input::Now());
+		++ticks;
+
+		nextTick += tick;
+		const double remaining = nextTick - Seconds();
+		if (remaining > 0.0)
+			std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+	}
+	source.Stop();
+
+	const input::InputLatency::Stats stats = latency.GetStats();
+	printf("latency, %u events over %u ticks at %.0f Hz, %.1f ms work per tick\n", consumed, ticks, options.tickHz, options.workMs);
+	printf("  frames with input  %8u\n", stats.samples);
+	printf("  input to present   avg %.2f ms  p50 %.2f ms  p99 %.2f ms  max %.2f ms\n", stats.average * 1e3, stats.p50 * 1e3,
+		stats.p99 * 1e3, stats.max * 1e3);
+	printf("  dropped            %8u\n", queue.GetDropped());
+
+	return 0;
+}
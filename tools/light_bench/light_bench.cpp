@@ -0,0 +1,313 @@
+//--------------------------------------------------------------------
+// light_bench.cpp - Clustered light binning benchmark: 1k to 10k point lights through a 16x9x24 froxel grid,
+//                   serially and across the job system, checked against testing every light against every cluster
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h light_bench.cpp
+//            ../../RedEngine/light_clusters.cpp ../../RedEngine/job_system.cpp ../../RedEngine/perf_counters.cpp
+//            -o light_bench
+//
+// Usage: light_bench [--lights n[,n...]] [--frames n] [--workers n] [--radius min max]
+//--------------------------------------------------------------------
+
+#include "light_clusters.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		std::vector<uint32_t>	lightCounts = { 1000, 2000, 5000, 10000 };
+		unsigned int			frames = 50;
+		unsigned int			workers = 0;
+		float					minRadius = 0.5f;
+		float					maxRadius = 4.0f;
+	};
+
+	const float c_NearZ = 0.1f;
+	const float c_FarZ = 200.0f;
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+	// Left-handed perspective, row vectors, matching XMMatrixPerspectiveFovLH
+	void Perspective(float fovY, float aspect, float nearZ, float farZ, float* m)
+	{
+		const float yScale = 1.0f / tanf(fovY * 0.5f);
+		const float range = farZ / (farZ - nearZ);
+		memset(m, 0, sizeof(float) * 16);
+		m[0] = yScale / aspect;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -range * nearZ;
+	}
+
+	// A camera at (0, 2, -10) looking down +z, as a translation
+	void CameraView(float* m)
+	{
+		memset(m, 0, sizeof(float) * 16);
+		m[0] = m[5] = m[10] = m[15] = 1.0f;
+		m[13] = -2.0f;
+		m[14] = 10.0f;
+	}
+
+	// Lights over a city block in front of the camera, denser near it the way a street of lamps would look
+	std::vector<scene::LightClusters::Light> MakeLights(uint32_t count, const Options& options, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<scene::LightClusters::Light> lights(count);
+		for (scene::LightClusters::Light& light : lights)
+		{
+			const float depth = unit(random);
+			light.position[0] = -120.0f + 240.0f * unit(random);
+			light.position[1] = 20.0f * unit(random);
+			light.position[2] = -20.0f + 200.0f * depth * depth;
+			light.radius = options.minRadius + (options.maxRadius - options.minRadius) * unit(random);
+			light.color[0] = unit(random);
+			light.color[1] = unit(random);
+			light.color[2] = unit(random);
+			light.intensity = 1.0f;
+		}
+		return lights;
+	}
+
+	// Every light against every cluster, one at a time
+	void BinReference(const scene::LightClusters& clusters, const std::vector<scene::LightClusters::Light>& lights,
+		std::vector<std::vector<uint16_t>>& lists)
+	{
+		const std::vector<scene::LightClusters::Box>& bounds = clusters.GetClusterBounds();
+		const std::vector<scene::LightClusters::GpuLight>& viewLights = clusters.GetGpuLights();
+		lists.assign(bounds.size(), std::vector<uint16_t>());
+
+		for (size_t cluster = 0; cluster < bounds.size(); ++cluster)
+		{
+			const scene::LightClusters::Box& box = bounds[cluster];
+			for (size_t light = 0; light < lights.size(); ++light)
+			{
+				const float* const p = viewLights[light].positionRadius;
+				float distanceSquared = 0.0f;
+				for (int k = 0; k < 3; ++k)
+				{
+					const float d = std::max(std::max(box.min[k] - p[k], p[k] - box.max[k]), 0.0f);
+					distanceSquared += d * d;
+				}
+				if (distanceSquared <= p[3] * p[3])
+					lists[cluster].push_back(uint16_t(light));
+			}
+		}
+	}
+
+	// Same lights in the same clusters, in any order
+	bool Matches(const scene::LightClusters& clusters, const std::vector<std::vector<uint16_t>>& reference)
+	{
+		const std::vector<scene::LightClusters::Cluster>& grid = clusters.GetClusters();
+		const std::vector<uint16_t>& indices = clusters.GetLightIndices();
+		for (size_t cluster = 0; cluster < grid.size(); ++cluster)
+		{
+			std::vector<uint16_t> binned(indices.begin() + grid[cluster].offset, indices.begin() + grid[cluster].offset + grid[cluster].count);
+			std::sort(binned.begin(), binned.end());
+			if (binned != reference[cluster])
+			{
+				fprintf(stderr, "Cluster %zu has %zu lights, the reference %zu.\n", cluster, binned.size(), reference[cluster].size());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<double> TimeBuilds(scene::LightClusters& clusters, unsigned int frames)
+	{
+		std::vector<double> times;
+		for (unsigned int frame = 0; frame < frames; ++frame)
+		{
+			const double start = Seconds();
+			clusters.Build();
+			times.push_back(Seconds() - start);
+		}
+		return times;
+	}
+
+	// Clusters made for fewer lights than are set, as Core's are for the GPU buffer: the first maxLights are binned
+	// as usual and no index reaches past them
+	bool CheckCapacity(const float view[16], const float projection[16], const Options& options, std::mt19937& random)
+	{
+		const uint32_t capacity = 1000;
+		const uint32_t count = 1500;
+		scene::LightClusters clusters(capacity);
+		const std::vector<scene::LightClusters::Light> lights = MakeLights(count, options, random);
+		clusters.SetLights(lights.data(), count);
+		clusters.BeginFrame(view, projection);
+		clusters.Build();
+
+		const scene::LightClusters::Stats& stats = clusters.GetStats();
+		if (clusters.GetGpuLights().size() != capacity || stats.lights != capacity || stats.unbinned != count - capacity)
+		{
+			fprintf(stderr, "%u lights into room for %u: %zu uploaded, %u binned, %u left out.\n", count, capacity,
+				clusters.GetGpuLights().size(), stats.lights, stats.unbinned);
+			return false;
+		}
+
+		for (uint16_t index : clusters.GetLightIndices())
+		{
+			if (index >= capacity)
+			{
+				fprintf(stderr, "Light %u binned with room for %u.\n", index, capacity);
+				return false;
+			}
+		}
+
+		std::vector<std::vector<uint16_t>> reference;
+		BinReference(clusters, std::vector<scene::LightClusters::Light>(lights.begin(), lights.begin() + capacity), reference);
+		if (!Matches(clusters, reference))
+		{
+			fprintf(stderr, "%u lights into room for %u: binning disagrees with the reference.\n", count, capacity);
+			return false;
+		}
+		return true;
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+		{
+			options.lightCounts.clear();
+			for (const char* count = argv[++i]; count != nullptr; count = strchr(count, ','))
+			{
+				count += *count == ',';
+				options.lightCounts.push_back(uint32_t(atoi(count)));
+			}
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			options.workers = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--radius") == 0 && i + 2 < argc)
+		{
+			options.minRadius = float(atof(argv[++i]));
+			options.maxRadius = float(atof(argv[++i]));
+		}
+		else
+		{
+			fprintf(stderr, "Usage: light_bench [--lights n[,n...]] [--frames n] [--workers n] [--radius min max]\n");
+			return 2;
+		}
+	}
+
+	for (uint32_t count : options.lightCounts)
+	{
+		if (count == 0 || count > scene::LightClusters::MaxLights)
+		{
+			fprintf(stderr, "Light counts go from 1 to %u.\n", scene::LightClusters::MaxLights);
+			return 2;
+		}
+	}
+
+	float view[16], projection[16];
+	CameraView(view);
+	Perspective(1.0471976f, 16.0f / 9.0f, c_NearZ, c_FarZ, projection);
+
+	std::mt19937 random(1234);
+	scene::LightClusters clusters;
+	bool ok = true;
+
+	struct Row
+	{
+		uint32_t						lights;
+		scene::LightClusters::Stats		stats;
+		double							reference;
+		double							serial;
+		double							serialMax;
+		double							jobs;
+		double							jobsMax;
+	};
+	std::vector<Row> rows;
+
+	// Serial first, before there is a job system to spread over
+	for (uint32_t count : options.lightCounts)
+	{
+		const std::vector<scene::LightClusters::Light> lights = MakeLights(count, options, random);
+		clusters.SetLights(lights.data(), count);
+		clusters.BeginFrame(view, projection);
+
+		const std::vector<double> serial = TimeBuilds(clusters, options.frames);
+
+		std::vector<std::vector<uint16_t>> reference;
+		const double referenceStart = Seconds();
+		BinReference(clusters, lights, reference);
+		const double referenceTime = Seconds() - referenceStart;
+		if (!Matches(clusters, reference))
+		{
+			fprintf(stderr, "%u lights: binning disagrees with the reference.\n", count);
+			ok = false;
+		}
+
+		Row row = {};
+		row.lights = count;
+		row.stats = clusters.GetStats();
+		row.reference = referenceTime;
+		row.serial = Percentile(serial, 0.5);
+		row.serialMax = Percentile(serial, 1.0);
+		rows.push_back(row);
+	}
+
+	if (!CheckCapacity(view, projection, options, random))
+		ok = false;
+
+	utils::JobSystem::Create(options.workers);
+
+	random.seed(1234);
+	for (Row& row : rows)
+	{
+		const std::vector<scene::LightClusters::Light> lights = MakeLights(row.lights, options, random);
+		clusters.SetLights(lights.data(), row.lights);
+
+		const std::vector<double> jobs = TimeBuilds(clusters, options.frames);
+		row.jobs = Percentile(jobs, 0.5);
+		row.jobsMax = Percentile(jobs, 1.0);
+
+		if (memcmp(&clusters.GetStats(), &row.stats, sizeof(row.stats)) != 0)
+		{
+			fprintf(stderr, "%u lights: the job system binned differently to the serial run.\n", row.lights);
+			ok = false;
+		}
+	}
+
+	printf("%ux%ux%u clusters, radius %.1f to %.1f, %u workers, %u frames, p50 (max) ms\n", clusters.GetTilesX(), clusters.GetTilesY(),
+		clusters.GetSlices(), options.minRadius, options.maxRadius, utils::JobSystem::Get()->GetWorkerCount(), options.frames);
+	printf("%8s %9s %8s %8s %8s %16s %16s %11s %8s\n", "lights", "indices", "occupied", "max", "dropped", "serial", "jobs",
+		"reference", "ns/light");
+	for (const Row& row : rows)
+	{
+		printf("%8u %9u %8u %8u %8u %7.3f (%6.3f) %7.3f (%6.3f) %11.2f %8.1f\n", row.lights, row.stats.indices, row.stats.occupiedClusters,
+			row.stats.maxPerCluster, row.stats.dropped, row.serial * 1e3, row.serialMax * 1e3, row.jobs * 1e3, row.jobsMax * 1e3,
+			row.reference * 1e3, row.jobs * 1e9 / double(row.lights));
+	}
+
+	utils::JobSystem::Destroy();
+
+	printf(ok ? "Binning matches the reference.\n" : "Binning checks failed.\n");
+	return ok ? 0 : 1;
+}
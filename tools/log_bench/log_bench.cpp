@@ -0,0 +1,156 @@
+//--------------------------------------------------------------------
+// log_bench.cpp - Logging call cost under multi-thread contention, async logger against synchronous printf
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h log_bench.cpp
+//            ../../RedEngine/logger.cpp -o log_bench
+//--------------------------------------------------------------------
+
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		unsigned int	maxThreads = 8;
+		unsigned int	messages = 10000; // Per thread
+		unsigned int	bufferKilobytes = 1024;
+		const char*		path = "log_bench.log";
+	};
+
+	uint64_t Nanoseconds()
+	{
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// What DEBUG_MESSAGE costs if every call formats and writes under a lock
+	std::mutex g_syncMutex;
+	FILE* g_syncFile = nullptr;
+
+	void SyncLog(const char* format, ...)
+	{
+		char text[1024];
+		va_list args;
+		va_start(args, format);
+		const int length = vsnprintf(text, sizeof(text), format, args);
+		va_end(args);
+
+		std::lock_guard<std::mutex> lock(g_syncMutex);
+		fwrite(text, 1, size_t(std::min(std::max(length, 0), int(sizeof(text) - 1))), g_syncFile);
+	}
+
+	struct Result
+	{
+		double			p50;
+		double			p99;
+		double			average;
+	};
+
+	// Each thread times every call it makes; the clock's own cost is taken off
+	template<typename LogFunction>
+	Result Run(unsigned int threadCount, unsigned int messages, uint64_t clockCost, LogFunction log)
+	{
+		std::vector<std::vector<uint32_t>> samples(threadCount);
+		std::vector<std::thread> threads;
+
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([t, messages, clockCost, &samples, &log]()
+				{
+					const char* const names[] = { "player", "camera", "streamer", "physics" };
+					std::vector<uint32_t>& times = samples[t];
+					times.reserve(messages);
+					for (unsigned int i = 0; i < messages; ++i)
+					{
+						const uint64_t start = Nanoseconds();
+						log(t, i, float(i) * 0.25f, names[i & 3]);
+						const uint64_t elapsed = Nanoseconds() - start;
+						times.push_back(uint32_t(elapsed > clockCost ? elapsed - clockCost : 0));
+					}
+				});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		std::vector<uint32_t> all;
+		for (const std::vector<uint32_t>& times : samples)
+			all.insert(all.end(), times.begin(), times.end());
+		std::sort(all.begin(), all.end());
+
+		double total = 0.0;
+		for (uint32_t sample : all)
+			total += double(sample);
+
+		Result result;
+		result.p50 = double(all[all.size() / 2]);
+		result.p99 = double(all[std::min(all.size() - 1, all.size() * 99 / 100)]);
+		result.average = total / double(all.size());
+		return result;
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			options.maxThreads = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc)
+			options.messages = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--buffer-kb") == 0 && i + 1 < argc)
+			options.bufferKilobytes = unsigned(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: log_bench [--threads n] [--messages n] [--buffer-kb n]\n");
+			return 1;
+		}
+	}
+
+	uint64_t clockCost = ~0ull;
+	for (int i = 0; i < 1000; ++i)
+	{
+		const uint64_t start = Nanoseconds();
+		clockCost = std::min(clockCost, Nanoseconds() - start);
+	}
+
+	g_syncFile = fopen("log_bench_sync.log", "w");
+	utils::Logger::Create(options.path, options.bufferKilobytes * 1024, false);
+
+	printf("%u messages per thread, %u KB rings, times per call in ns\n", options.messages, options.bufferKilobytes);
+	printf("  threads   async p50   p99    avg   |  sync p50   p99    avg\n");
+
+	for (unsigned int threads = 1; threads <= options.maxThreads; threads *= 2)
+	{
+		const Result async = Run(threads, options.messages, clockCost, [](unsigned int t, unsigned int i, float value, const char* name)
+			{
+				utils::Logger::Log("thread %u message %u value %.2f from %s\n", t, i, value, name);
+			});
+		utils::Logger::Get()->Flush();
+
+		const Result sync = Run(threads, options.messages, clockCost, [](unsigned int t, unsigned int i, float value, const char* name)
+			{
+				SyncLog("thread %u message %u value %.2f from %s\n", t, i, double(value), name);
+			});
+
+		printf("  %7u   %9.0f %5.0f %6.0f   | %9.0f %5.0f %6.0f\n", threads, async.p50, async.p99, async.average, sync.p50, sync.p99, sync.average);
+	}
+
+	printf("  dropped %llu\n", static_cast<unsigned long long>(utils::Logger::Get()->GetDropped()));
+
+	utils::Logger::Destroy();
+	fclose(g_syncFile);
+	remove("log_bench_sync.log");
+	remove(options.path);
+
+	return 0;
+}
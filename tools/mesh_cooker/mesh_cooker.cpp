@@ -0,0 +1,339 @@
+//--------------------------------------------------------------------
+// mesh_cooker.cpp - Offline mesh optimiser for the VS/PS pipeline
+//
+// Build: g++ -std=c++17 -O2 -I../../RedEngine *.cpp -o mesh_cooker
+// Usage: mesh_cooker <input.obj> <output.rmesh> [options]
+//--------------------------------------------------------------------
+
+#include "mesh_optimise.h"
+#include "mesh_simplify.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+	struct Options
+	{
+		const char*		inputPath = nullptr;
+		const char*		outputPath = nullptr;
+		unsigned int	cacheSize = 16;
+		float			overdrawThreshold = 1.05f;
+		bool			overdraw = true;
+		bool			meshlets = true;
+		unsigned int	lodCount = 4;
+		float			lodRatio = 0.5f; // Each level aims for this fraction of the previous level's triangles
+		float			lodMaxError = 0.05f; // Relative to the mesh's bounding radius
+	};
+
+	void PrintUsage()
+	{
+		fprintf(stderr,
+			"Usage: mesh_cooker <input.obj> <output.rmesh> [options]\n"
+			"  --cache-size <n>          Post-transform cache size used for reporting and overdraw clustering (default 16)\n"
+			"  --overdraw-threshold <t>  ACMR degradation allowed when splitting for overdraw (default 1.05)\n"
+			"  --no-overdraw             Skip overdraw reordering\n"
+			"  --no-meshlets             Don't emit meshlets\n"
+			"  --lods <n>                Levels of detail including the full mesh (default 4, max 8)\n"
+			"  --lod-ratio <r>           Triangle ratio between successive levels (default 0.5)\n"
+			"  --lod-max-error <e>       Largest simplification error as a fraction of the bounding radius (default 0.05)\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		int positional = 0;
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* const arg = argv[i];
+			if (strcmp(arg, "--cache-size") == 0 && i + 1 < argc)
+				options.cacheSize = unsigned(atoi(argv[++i]));
+			else if (strcmp(arg, "--overdraw-threshold") == 0 && i + 1 < argc)
+				options.overdrawThreshold = float(atof(argv[++i]));
+			else if (strcmp(arg, "--no-overdraw") == 0)
+				options.overdraw = false;
+			else if (strcmp(arg, "--no-meshlets") == 0)
+				options.meshlets = false;
+			else if (strcmp(arg, "--lods") == 0 && i + 1 < argc)
+				options.lodCount = unsigned(atoi(argv[++i]));
+			else if (strcmp(arg, "--lod-ratio") == 0 && i + 1 < argc)
+				options.lodRatio = float(atof(argv[++i]));
+			else if (strcmp(arg, "--lod-max-error") == 0 && i + 1 < argc)
+				options.lodMaxError = float(atof(argv[++i]));
+			else if (arg[0] != '-' && positional == 0)
+				options.inputPath = argv[i], ++positional;
+			else if (arg[0] != '-' && positional == 1)
+				options.outputPath = argv[i], ++positional;
+			else
+				return false;
+		}
+
+		return options.inputPath != nullptr && options.outputPath != nullptr && options.cacheSize >= 3 &&
+			options.lodCount >= 1 && options.lodCount <= assets::MeshMaxLods && options.lodRatio > 0.0f && options.lodRatio < 1.0f;
+	}
+
+	// Reads positions, optional per-vertex colours ("v x y z r g b [a]") and polygon faces.
+	// Faces are fan triangulated; texture and normal references are ignored.
+	bool LoadObj(const char* path, cooker::Mesh& mesh)
+	{
+		FILE* const file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Unable to open %s\n", path);
+			return false;
+		}
+
+		std::vector<assets::MeshVertex> positions;
+		char line[1024];
+		size_t lineNumber = 0;
+		bool ok = true;
+
+		while (ok && fgets(line, sizeof(line), file) != nullptr)
+		{
+			++lineNumber;
+
+			if (line[0] == 'v' && line[1] == ' ')
+			{
+				assets::MeshVertex vertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+				const int read = sscanf(line + 2, "%f %f %f %f %f %f %f",
+					&vertex.position[0], &vertex.position[1], &vertex.position[2],
+					&vertex.color[0], &vertex.color[1], &vertex.color[2], &vertex.color[3]);
+				if (read < 3)
+				{
+					fprintf(stderr, "%s(%zu): malformed vertex\n", path, lineNumber);
+					ok = false;
+				}
+				positions.push_back(vertex);
+			}
+			else if (line[0] == 'f' && line[1] == ' ')
+			{
+				uint32_t polygon[64];
+				size_t count = 0;
+
+				char* cursor = line + 2;
+				while (*cursor != '\0' && count < 64)
+				{
+					char* end = nullptr;
+					const long value = strtol(cursor, &end, 10);
+					if (end == cursor)
+						break;
+
+					// OBJ indices are one based, negative indices count back from the last vertex
+					const long index = value < 0 ? long(positions.size()) + value : value - 1;
+					if (index < 0 || index >= long(positions.size()))
+					{
+						fprintf(stderr, "%s(%zu): face references missing vertex %ld\n", path, lineNumber, value);
+						ok = false;
+						break;
+					}
+					polygon[count++] = uint32_t(index);
+
+					// Skip any /vt/vn part of the reference
+					cursor = end;
+					while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n')
+						++cursor;
+				}
+
+				for (size_t i = 2; ok && i < count; ++i)
+				{
+					mesh.indices.push_back(polygon[0]);
+					mesh.indices.push_back(polygon[i - 1]);
+					mesh.indices.push_back(polygon[i]);
+				}
+			}
+		}
+
+		fclose(file);
+
+		mesh.vertices.swap(positions);
+		return ok && !mesh.indices.empty();
+	}
+
+	bool WriteMesh(const char* path, const cooker::Mesh& mesh, const std::vector<assets::MeshLod>& lods, const cooker::MeshletData& meshlets)
+	{
+		assets::MeshHeader header = {};
+		header.magic = assets::MeshMagic;
+		header.version = assets::MeshVersion;
+		header.vertexCount = uint32_t(mesh.vertices.size());
+		header.indexCount = uint32_t(mesh.indices.size());
+		header.meshletCount = uint32_t(meshlets.meshlets.size());
+		header.meshletVertexCount = uint32_t(meshlets.vertices.size());
+		header.meshletTriangleCount = uint32_t(meshlets.triangles.size() / 3);
+		header.lodCount = uint32_t(lods.size());
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			header.boundsMin[k] = mesh.vertices.empty() ? 0.0f : mesh.vertices[0].position[k];
+			header.boundsMax[k] = header.boundsMin[k];
+		}
+		for (const assets::MeshVertex& vertex : mesh.vertices)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				header.boundsMin[k] = vertex.position[k] < header.boundsMin[k] ? vertex.position[k] : header.boundsMin[k];
+				header.boundsMax[k] = vertex.position[k] > header.boundsMax[k] ? vertex.position[k] : header.boundsMax[k];
+			}
+		}
+
+		uint32_t offset = sizeof(assets::MeshHeader);
+		header.vertexOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.vertexCount * uint32_t(sizeof(assets::MeshVertex)));
+		header.indexOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.indexCount * uint32_t(sizeof(uint32_t)));
+		header.meshletOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.meshletCount * uint32_t(sizeof(assets::Meshlet)));
+		header.meshletVertexOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.meshletVertexCount * uint32_t(sizeof(uint32_t)));
+		header.meshletTriangleOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.meshletTriangleCount * 3);
+		header.lodOffset = offset;
+		offset = assets::AlignMeshOffset(offset + header.lodCount * uint32_t(sizeof(assets::MeshLod)));
+		header.totalSize = offset;
+
+		std::vector<uint8_t> blob(header.totalSize, 0);
+		memcpy(blob.data(), &header, sizeof(header));
+		if (!mesh.vertices.empty())
+			memcpy(blob.data() + header.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(assets::MeshVertex));
+		if (!mesh.indices.empty())
+			memcpy(blob.data() + header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		if (!meshlets.meshlets.empty())
+		{
+			memcpy(blob.data() + header.meshletOffset, meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(assets::Meshlet));
+			memcpy(blob.data() + header.meshletVertexOffset, meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t));
+			memcpy(blob.data() + header.meshletTriangleOffset, meshlets.triangles.data(), meshlets.triangles.size());
+		}
+		memcpy(blob.data() + header.lodOffset, lods.data(), lods.size() * sizeof(assets::MeshLod));
+
+		FILE* const file = fopen(path, "wb");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Unable to create %s\n", path);
+			return false;
+		}
+
+		const bool ok = fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+		fclose(file);
+		return ok;
+	}
+
+	void Report(const char* stage, const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize)
+	{
+		const cooker::CacheStats stats = cooker::AnalyseVertexCache(indices, vertexCount, cacheSize);
+		printf("  %-16s vertices %8zu  triangles %8zu  ACMR %.3f  ATVR %.3f\n",
+			stage, vertexCount, indices.size() / 3, stats.acmr, stats.atvr);
+	}
+
+	float BoundingRadius(const std::vector<assets::MeshVertex>& vertices)
+	{
+		float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+		float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (const assets::MeshVertex& vertex : vertices)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				boundsMin[k] = std::fmin(boundsMin[k], vertex.position[k]);
+				boundsMax[k] = std::fmax(boundsMax[k], vertex.position[k]);
+			}
+		}
+
+		const float dx = boundsMax[0] - boundsMin[0], dy = boundsMax[1] - boundsMin[1], dz = boundsMax[2] - boundsMin[2];
+		return 0.5f * std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	cooker::Mesh mesh;
+	if (!LoadObj(options.inputPath, mesh))
+		return 1;
+
+	printf("%s (cache size %u)\n", options.inputPath, options.cacheSize);
+	Report("input", mesh.indices, mesh.vertices.size(), options.cacheSize);
+
+	cooker::DeduplicateVertices(mesh);
+	Report("deduplicated", mesh.indices, mesh.vertices.size(), options.cacheSize);
+
+	// Every level is simplified from the full mesh so its error is measured against level 0
+	std::vector<std::vector<uint32_t>> levels(1, mesh.indices);
+	std::vector<float> levelErrors(1, 0.0f);
+
+	const float maxError = options.lodMaxError * BoundingRadius(mesh.vertices);
+	for (unsigned int lod = 1; lod < options.lodCount; ++lod)
+	{
+		const size_t previousCount = levels.back().size();
+		const size_t target = size_t(float(previousCount / 3) * options.lodRatio) * 3;
+
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = cooker::Simplify(levels[0], mesh.vertices, target, maxError, error);
+
+		// Not worth a level if it barely saves anything, and later levels would only do worse
+		if (simplified.empty() || simplified.size() > previousCount * 9 / 10)
+			break;
+
+		levels.push_back(std::move(simplified));
+		levelErrors.push_back(error);
+	}
+
+	for (size_t lod = 0; lod < levels.size(); ++lod)
+	{
+		char stage[32];
+		snprintf(stage, sizeof(stage), "lod %zu", lod);
+
+		cooker::OptimiseVertexCache(levels[lod], mesh.vertices.size());
+		if (options.overdraw)
+			cooker::OptimiseOverdraw(levels[lod], mesh.vertices, options.cacheSize, options.overdrawThreshold);
+
+		Report(stage, levels[lod], mesh.vertices.size(), options.cacheSize);
+		if (lod > 0)
+			printf("  %-16s error %.5f\n", "", levelErrors[lod]);
+	}
+
+	// Concatenate the levels, level 0 first so vertex fetch order follows the full mesh
+	std::vector<assets::MeshLod> lods;
+	mesh.indices.clear();
+	for (size_t lod = 0; lod < levels.size(); ++lod)
+	{
+		assets::MeshLod entry = {};
+		entry.indexOffset = uint32_t(mesh.indices.size());
+		entry.indexCount = uint32_t(levels[lod].size());
+		entry.error = levelErrors[lod];
+		lods.push_back(entry);
+
+		mesh.indices.insert(mesh.indices.end(), levels[lod].begin(), levels[lod].end());
+	}
+
+	cooker::OptimiseVertexFetch(mesh);
+	Report("vertex fetch", std::vector<uint32_t>(mesh.indices.begin(), mesh.indices.begin() + lods[0].indexCount),
+		mesh.vertices.size(), options.cacheSize);
+
+	cooker::MeshletData meshlets;
+	if (options.meshlets)
+	{
+		// Meshlets cover the full detail level only
+		cooker::Mesh full;
+		full.vertices = mesh.vertices;
+		full.indices.assign(mesh.indices.begin(), mesh.indices.begin() + lods[0].indexCount);
+
+		meshlets = cooker::BuildMeshlets(full);
+		printf("  %-16s %zu meshlets, %.1f vertices / %.1f triangles average\n", "meshlets", meshlets.meshlets.size(),
+			meshlets.meshlets.empty() ? 0.0 : double(meshlets.vertices.size()) / double(meshlets.meshlets.size()),
+			meshlets.meshlets.empty() ? 0.0 : double(meshlets.triangles.size() / 3) / double(meshlets.meshlets.size()));
+	}
+
+	if (!WriteMesh(options.outputPath, mesh, lods, meshlets))
+		return 1;
+
+	printf("Wrote %s\n", options.outputPath);
+	return 0;
+}
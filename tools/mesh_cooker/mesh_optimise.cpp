@@ -0,0 +1,488 @@
+#include "mesh_optimise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace cooker
+{
+
+	namespace
+	{
+		// Forsyth scoring parameters, see "Linear-Speed Vertex Cache Optimisation"
+		const unsigned int c_ForsythCacheSize = 32;
+		const float c_CacheDecayPower = 1.5f;
+		const float c_LastTriangleScore = 0.75f;
+		const float c_ValenceBoostScale = 2.0f;
+		const float c_ValenceBoostPower = 0.5f;
+
+		// Smallest cluster the overdraw optimiser will split off
+		const size_t c_MinClusterTriangles = 32;
+
+		float VertexScore(int cachePosition, unsigned int remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+				return -1.0f;
+
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					// The most recent triangle gets a fixed score so it isn't favoured over its neighbours
+					score = c_LastTriangleScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / float(c_ForsythCacheSize - 3);
+					score = std::pow(1.0f - float(cachePosition - 3) * scaler, c_CacheDecayPower);
+				}
+			}
+
+			// Boost vertices with few triangles left so lone triangles don't get stranded
+			score += c_ValenceBoostScale * std::pow(float(remainingTriangles), -c_ValenceBoostPower);
+			return score;
+		}
+
+		struct Adjacency
+		{
+			std::vector<uint32_t>	counts;
+			std::vector<uint32_t>	offsets;
+			std::vector<uint32_t>	triangles;
+		};
+
+		void BuildAdjacency(Adjacency& adjacency, const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			const size_t triangleCount = indices.size() / 3;
+
+			adjacency.counts.assign(vertexCount, 0);
+			adjacency.offsets.assign(vertexCount, 0);
+			adjacency.triangles.resize(indices.size());
+
+			for (uint32_t index : indices)
+				++adjacency.counts[index];
+
+			uint32_t offset = 0;
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				adjacency.offsets[i] = offset;
+				offset += adjacency.counts[i];
+			}
+
+			std::vector<uint32_t> fill(adjacency.offsets);
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				for (size_t k = 0; k < 3; ++k)
+					adjacency.triangles[fill[indices[t * 3 + k]]++] = uint32_t(t);
+			}
+		}
+
+		struct Vec3
+		{
+			float x, y, z;
+		};
+
+		Vec3 Position(const assets::MeshVertex& vertex)
+		{
+			return Vec3{ vertex.position[0], vertex.position[1], vertex.position[2] };
+		}
+	}
+
+	void DeduplicateVertices(Mesh& mesh)
+	{
+		const size_t vertexCount = mesh.vertices.size();
+
+		std::vector<uint32_t> order(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+			order[i] = uint32_t(i);
+
+		const assets::MeshVertex* const vertices = mesh.vertices.data();
+		std::sort(order.begin(), order.end(), [vertices](uint32_t a, uint32_t b)
+			{
+				const int result = memcmp(&vertices[a], &vertices[b], sizeof(assets::MeshVertex));
+				return result < 0 || (result == 0 && a < b);
+			});
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<assets::MeshVertex> unique;
+		unique.reserve(vertexCount);
+
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			const uint32_t vertex = order[i];
+			if (i == 0 || memcmp(&vertices[vertex], &vertices[order[i - 1]], sizeof(assets::MeshVertex)) != 0)
+				unique.push_back(vertices[vertex]);
+
+			remap[vertex] = uint32_t(unique.size() - 1);
+		}
+
+		for (uint32_t& index : mesh.indices)
+			index = remap[index];
+
+		mesh.vertices.swap(unique);
+	}
+
+	CacheStats AnalyseVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize)
+	{
+		CacheStats stats = {};
+		if (indices.empty() || vertexCount == 0)
+			return stats;
+
+		// A vertex is resident if fewer than cacheSize misses happened since it was loaded
+		std::vector<unsigned int> loadedAt(vertexCount, 0);
+		unsigned int timestamp = cacheSize + 1;
+		size_t misses = 0;
+
+		for (uint32_t index : indices)
+		{
+			if (timestamp - loadedAt[index] > cacheSize)
+			{
+				loadedAt[index] = timestamp++;
+				++misses;
+			}
+		}
+
+		stats.acmr = float(misses) / float(indices.size() / 3);
+		stats.atvr = float(misses) / float(vertexCount);
+		return stats;
+	}
+
+	void OptimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		Adjacency adjacency;
+		BuildAdjacency(adjacency, indices, vertexCount);
+
+		std::vector<uint32_t> remaining(adjacency.counts);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t i = 0; i < vertexCount; ++i)
+			vertexScore[i] = VertexScore(-1, remaining[i]);
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+
+		// The cache holds three extra entries so the incoming triangle never evicts a vertex we still need to score
+		uint32_t cache[c_ForsythCacheSize + 3];
+		uint32_t newCache[c_ForsythCacheSize + 3];
+		unsigned int cacheCount = 0;
+
+		size_t scanCursor = 0;
+		int bestTriangle = -1;
+
+		for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+		{
+			if (bestTriangle < 0)
+			{
+				// Dead end: restart from the first triangle left in input order, the cursor only moves forward so this stays linear
+				while (emitted[scanCursor])
+					++scanCursor;
+				bestTriangle = int(scanCursor);
+			}
+
+			const uint32_t* const triangle = &indices[size_t(bestTriangle) * 3];
+			result.insert(result.end(), triangle, triangle + 3);
+			emitted[bestTriangle] = true;
+
+			// Remove the triangle from its vertices' live lists
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32_t vertex = triangle[k];
+				uint32_t* const list = &adjacency.triangles[adjacency.offsets[vertex]];
+				const uint32_t count = remaining[vertex];
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					if (list[i] == uint32_t(bestTriangle))
+					{
+						list[i] = list[count - 1];
+						break;
+					}
+				}
+				--remaining[vertex];
+			}
+
+			// Push the triangle's vertices to the front of the cache
+			unsigned int newCount = 0;
+			for (size_t k = 0; k < 3; ++k)
+				newCache[newCount++] = triangle[k];
+			for (unsigned int i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t vertex = cache[i];
+				if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+					newCache[newCount++] = vertex;
+			}
+
+			// Anything that fell off the end is no longer cached
+			for (unsigned int i = c_ForsythCacheSize; i < newCount; ++i)
+				vertexScore[newCache[i]] = VertexScore(-1, remaining[newCache[i]]);
+
+			cacheCount = std::min(newCount, c_ForsythCacheSize);
+			memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+			for (unsigned int i = 0; i < cacheCount; ++i)
+				vertexScore[cache[i]] = VertexScore(int(i), remaining[cache[i]]);
+
+			// Rescore the triangles touching the cache and pick the next one from among them
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for (unsigned int i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t vertex = cache[i];
+				const uint32_t* const list = &adjacency.triangles[adjacency.offsets[vertex]];
+				for (uint32_t j = 0; j < remaining[vertex]; ++j)
+				{
+					const uint32_t t = list[j];
+					const float score = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = int(t);
+					}
+				}
+			}
+
+		}
+
+		indices.swap(result);
+	}
+
+	void OptimiseOverdraw(std::vector<uint32_t>& indices, const std::vector<assets::MeshVertex>& vertices, unsigned int cacheSize, float threshold)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Hard boundaries are where the cache optimiser had to jump: all three vertices missed
+		std::vector<size_t> hardClusters;
+		{
+			std::vector<unsigned int> loadedAt(vertices.size(), 0);
+			unsigned int timestamp = cacheSize + 1;
+
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				unsigned int misses = 0;
+				for (size_t k = 0; k < 3; ++k)
+				{
+					const uint32_t index = indices[t * 3 + k];
+					if (timestamp - loadedAt[index] > cacheSize)
+					{
+						loadedAt[index] = timestamp++;
+						++misses;
+					}
+				}
+
+				if (t == 0 || misses == 3)
+					hardClusters.push_back(t);
+			}
+		}
+		hardClusters.push_back(triangleCount);
+
+		// Split each hard cluster further wherever its running ACMR is already within the threshold
+		std::vector<size_t> clusters;
+		{
+			std::vector<unsigned int> loadedAt(vertices.size(), 0);
+			unsigned int timestamp = cacheSize + 1;
+
+			for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+			{
+				const size_t begin = hardClusters[c];
+				const size_t end = hardClusters[c + 1];
+
+				const std::vector<uint32_t> clusterIndices(indices.begin() + begin * 3, indices.begin() + end * 3);
+				const float clusterThreshold = AnalyseVertexCache(clusterIndices, vertices.size(), cacheSize).acmr * threshold;
+
+				clusters.push_back(begin);
+				timestamp += cacheSize + 1;
+
+				size_t start = begin;
+				size_t misses = 0;
+				for (size_t t = begin; t < end; ++t)
+				{
+					for (size_t k = 0; k < 3; ++k)
+					{
+						const uint32_t index = indices[t * 3 + k];
+						if (timestamp - loadedAt[index] > cacheSize)
+						{
+							loadedAt[index] = timestamp++;
+							++misses;
+						}
+					}
+
+					const size_t count = t + 1 - start;
+					if (t + 1 < end && count >= c_MinClusterTriangles && float(misses) / float(count) <= clusterThreshold)
+					{
+						clusters.push_back(t + 1);
+						start = t + 1;
+						misses = 0;
+						timestamp += cacheSize + 1; // Flush so the next cluster is measured standalone
+					}
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		// Score each cluster by how far its area weighted centroid lies along its average normal
+		Vec3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+		float meshArea = 0.0f;
+
+		const size_t clusterCount = clusters.size() - 1;
+		std::vector<Vec3> clusterCentroid(clusterCount);
+		std::vector<Vec3> clusterNormal(clusterCount);
+
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			Vec3 centroid = { 0.0f, 0.0f, 0.0f };
+			Vec3 normal = { 0.0f, 0.0f, 0.0f };
+			float area = 0.0f;
+
+			for (size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const Vec3 p0 = Position(vertices[indices[t * 3 + 0]]);
+				const Vec3 p1 = Position(vertices[indices[t * 3 + 1]]);
+				const Vec3 p2 = Position(vertices[indices[t * 3 + 2]]);
+
+				const Vec3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+				const Vec3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+				const Vec3 n = { e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+				const float a = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+				centroid.x += (p0.x + p1.x + p2.x) * (a / 3.0f);
+				centroid.y += (p0.y + p1.y + p2.y) * (a / 3.0f);
+				centroid.z += (p0.z + p1.z + p2.z) * (a / 3.0f);
+				normal.x += n.x;
+				normal.y += n.y;
+				normal.z += n.z;
+				area += a;
+			}
+
+			meshCentroid.x += centroid.x;
+			meshCentroid.y += centroid.y;
+			meshCentroid.z += centroid.z;
+			meshArea += area;
+
+			const float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+			clusterCentroid[c] = Vec3{ centroid.x * invArea, centroid.y * invArea, centroid.z * invArea };
+
+			const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			const float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+			clusterNormal[c] = Vec3{ normal.x * invLength, normal.y * invLength, normal.z * invLength };
+		}
+
+		const float invMeshArea = meshArea > 0.0f ? 1.0f / meshArea : 0.0f;
+		meshCentroid = Vec3{ meshCentroid.x * invMeshArea, meshCentroid.y * invMeshArea, meshCentroid.z * invMeshArea };
+
+		std::vector<float> sortKey(clusterCount);
+		std::vector<uint32_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			const Vec3 d = { clusterCentroid[c].x - meshCentroid.x, clusterCentroid[c].y - meshCentroid.y, clusterCentroid[c].z - meshCentroid.z };
+			sortKey[c] = d.x * clusterNormal[c].x + d.y * clusterNormal[c].y + d.z * clusterNormal[c].z;
+			order[c] = uint32_t(c);
+		}
+
+		// Outermost clusters first, they are the most likely to occlude the rest
+		std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t c : order)
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+		indices.swap(result);
+	}
+
+	void OptimiseVertexFetch(Mesh& mesh)
+	{
+		const uint32_t unused = ~0u;
+		std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+		std::vector<assets::MeshVertex> vertices;
+		vertices.reserve(mesh.vertices.size());
+
+		for (uint32_t& index : mesh.indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = uint32_t(vertices.size());
+				vertices.push_back(mesh.vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		// Vertices no triangle references are dropped
+		mesh.vertices.swap(vertices);
+	}
+
+	MeshletData BuildMeshlets(const Mesh& mesh)
+	{
+		MeshletData data;
+
+		const uint8_t notInMeshlet = 0xFF;
+		std::vector<uint8_t> localIndex(mesh.vertices.size(), notInMeshlet);
+
+		assets::Meshlet meshlet = {};
+
+		auto flush = [&]()
+			{
+				if (meshlet.triangleCount == 0)
+					return;
+
+				// Bounding sphere around the meshlet's box, good enough for cluster culling
+				float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+				float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+				for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+				{
+					const uint32_t vertex = data.vertices[meshlet.vertexOffset + i];
+					localIndex[vertex] = notInMeshlet;
+					for (size_t k = 0; k < 3; ++k)
+					{
+						boundsMin[k] = std::min(boundsMin[k], mesh.vertices[vertex].position[k]);
+						boundsMax[k] = std::max(boundsMax[k], mesh.vertices[vertex].position[k]);
+					}
+				}
+
+				float radius = 0.0f;
+				for (size_t k = 0; k < 3; ++k)
+					meshlet.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+				for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+				{
+					const float* const p = mesh.vertices[data.vertices[meshlet.vertexOffset + i]].position;
+					const float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+					radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+				}
+				meshlet.radius = std::sqrt(radius);
+
+				data.meshlets.push_back(meshlet);
+
+				meshlet = {};
+				meshlet.vertexOffset = uint32_t(data.vertices.size());
+				meshlet.triangleOffset = uint32_t(data.triangles.size() / 3);
+			};
+
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			const uint32_t a = mesh.indices[t + 0], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+			const uint32_t newVertices = (localIndex[a] == notInMeshlet) + (localIndex[b] == notInMeshlet) + (localIndex[c] == notInMeshlet);
+
+			if (meshlet.vertexCount + newVertices > assets::MeshletMaxVertices || meshlet.triangleCount + 1 > assets::MeshletMaxTriangles)
+				flush();
+
+			for (uint32_t vertex : { a, b, c })
+			{
+				if (localIndex[vertex] == notInMeshlet)
+				{
+					localIndex[vertex] = uint8_t(meshlet.vertexCount++);
+					data.vertices.push_back(vertex);
+				}
+				data.triangles.push_back(localIndex[vertex]);
+			}
+			++meshlet.triangleCount;
+		}
+		flush();
+
+		return data;
+	}
+
+} // namespace cooker
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mesh_format.h"
+
+#include <vector>
+
+namespace cooker
+{
+
+	struct Mesh
+	{
+		std::vector<assets::MeshVertex>	vertices;
+		std::vector<uint32_t>				indices;
+	};
+
+	struct MeshletData
+	{
+		std::vector<assets::Meshlet>		meshlets;
+		std::vector<uint32_t>				vertices;
+		std::vector<uint8_t>				triangles;
+	};
+
+	struct CacheStats
+	{
+		float		acmr; // Average cache miss ratio, misses per triangle. 0.5 is the best possible
+		float		atvr; // Average transform to vertex ratio, misses per vertex. 1.0 is the best possible
+	};
+
+	// Merges bitwise identical vertices and rewrites the index buffer to match
+	void				DeduplicateVertices(Mesh& mesh);
+
+	// Simulates a FIFO post-transform cache of the given size
+	CacheStats			AnalyseVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize);
+
+	// Reorders triangles for post-transform cache hits (Forsyth, linear-speed vertex cache optimisation)
+	void				OptimiseVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Reorders clusters of cache optimised triangles so outward facing geometry is drawn first.
+	// threshold is how much ACMR may degrade (1.05 = 5%) to buy more clusters.
+	void				OptimiseOverdraw(std::vector<uint32_t>& indices, const std::vector<assets::MeshVertex>& vertices, unsigned int cacheSize, float threshold);
+
+	// Reorders the vertex buffer into first use order so vertex fetch walks memory linearly
+	void				OptimiseVertexFetch(Mesh& mesh);
+
+	// Splits the index buffer into meshlets of at most MeshletMaxVertices / MeshletMaxTriangles
+	MeshletData			BuildMeshlets(const Mesh& mesh);
+
+} // namespace cooker
@@ -0,0 +1,282 @@
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace cooker
+{
+
+	namespace
+	{
+		// Symmetric 4x4 plane quadric, plus the total weight so errors come out as mean squared distances
+		struct Quadric
+		{
+			double		a2, ab, ac, ad;
+			double		b2, bc, bd;
+			double		c2, cd;
+			double		d2;
+			double		weight;
+
+			void Add(const Quadric& other)
+			{
+				a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+				b2 += other.b2; bc += other.bc; bd += other.bd;
+				c2 += other.c2; cd += other.cd;
+				d2 += other.d2;
+				weight += other.weight;
+			}
+
+			double Evaluate(const float* p) const
+			{
+				const double x = p[0], y = p[1], z = p[2];
+				const double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+					b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+					c2 * z * z + 2.0 * cd * z +
+					d2;
+				return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+			}
+		};
+
+		Quadric PlaneQuadric(const float* p0, const float* p1, const float* p2)
+		{
+			const double e0[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+			const double e1[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+			double n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+
+			const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			Quadric q = {};
+			if (length <= 0.0)
+				return q;
+
+			n[0] /= length;
+			n[1] /= length;
+			n[2] /= length;
+			const double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+			// Area weighted so densely tessellated regions don't dominate
+			const double w = length * 0.5;
+			q.a2 = w * n[0] * n[0]; q.ab = w * n[0] * n[1]; q.ac = w * n[0] * n[2]; q.ad = w * n[0] * d;
+			q.b2 = w * n[1] * n[1]; q.bc = w * n[1] * n[2]; q.bd = w * n[1] * d;
+			q.c2 = w * n[2] * n[2]; q.cd = w * n[2] * d;
+			q.d2 = w * d * d;
+			q.weight = w;
+			return q;
+		}
+
+		void TriangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+		{
+			const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+			n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+			n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+		}
+
+		struct Collapse
+		{
+			uint32_t	from;
+			uint32_t	to;
+			float		cost;
+		};
+
+		uint64_t EdgeKey(uint32_t a, uint32_t b)
+		{
+			return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+		}
+	}
+
+	std::vector<uint32_t> Simplify(const std::vector<uint32_t>& sourceIndices, const std::vector<assets::MeshVertex>& vertices,
+		size_t targetIndexCount, float maxError, float& resultError)
+	{
+		const size_t vertexCount = vertices.size();
+		std::vector<uint32_t> indices(sourceIndices);
+		resultError = 0.0f;
+
+		// Weld by position to find colour seams and open borders, both of which stay locked
+		std::vector<uint32_t> positionId(vertexCount);
+		std::vector<uint32_t> positionUses;
+		{
+			struct PositionHash
+			{
+				size_t operator()(const std::array<uint32_t, 3>& p) const
+				{
+					return size_t(p[0] * 73856093u ^ p[1] * 19349663u ^ p[2] * 83492791u);
+				}
+			};
+			std::unordered_map<std::array<uint32_t, 3>, uint32_t, PositionHash> ids;
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				std::array<uint32_t, 3> key;
+				memcpy(key.data(), vertices[i].position, sizeof(float) * 3);
+				const auto inserted = ids.emplace(key, uint32_t(ids.size()));
+				positionId[i] = inserted.first->second;
+				if (inserted.second)
+					positionUses.push_back(0);
+				++positionUses[inserted.first->second];
+			}
+		}
+
+		std::vector<bool> locked(vertexCount, false);
+		for (size_t i = 0; i < vertexCount; ++i)
+			locked[i] = positionUses[positionId[i]] > 1;
+
+		{
+			std::unordered_map<uint64_t, uint32_t> edgeUses;
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				for (size_t k = 0; k < 3; ++k)
+					++edgeUses[EdgeKey(positionId[indices[t + k]], positionId[indices[t + (k + 1) % 3]])];
+			}
+
+			std::vector<bool> borderPosition(positionUses.size(), false);
+			for (const auto& edge : edgeUses)
+			{
+				if (edge.second == 1)
+				{
+					borderPosition[uint32_t(edge.first >> 32)] = true;
+					borderPosition[uint32_t(edge.first & 0xFFFFFFFF)] = true;
+				}
+			}
+
+			for (size_t i = 0; i < vertexCount; ++i)
+				locked[i] = locked[i] || borderPosition[positionId[i]];
+		}
+
+		std::vector<Quadric> quadrics(vertexCount, Quadric{});
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const Quadric q = PlaneQuadric(vertices[indices[t]].position, vertices[indices[t + 1]].position, vertices[indices[t + 2]].position);
+			for (size_t k = 0; k < 3; ++k)
+				quadrics[indices[t + k]].Add(q);
+		}
+
+		const double maxCost = double(maxError) * double(maxError);
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> remap(vertexCount);
+
+		while (indices.size() > targetIndexCount)
+		{
+			// Vertex to triangle adjacency for the current index buffer
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : indices)
+				++adjacencyOffsets[index + 1];
+			for (size_t i = 0; i < vertexCount; ++i)
+				adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+			adjacency.resize(indices.size());
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); ++i)
+					adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+			}
+
+			// Every directed edge out of an unlocked vertex is a candidate
+			collapses.clear();
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				for (size_t k = 0; k < 3; ++k)
+				{
+					const uint32_t from = indices[t + k];
+					const uint32_t to = indices[t + (k + 1) % 3];
+					for (const Collapse candidate : { Collapse{ from, to, 0.0f }, Collapse{ to, from, 0.0f } })
+					{
+						if (locked[candidate.from])
+							continue;
+
+						Quadric q = quadrics[candidate.from];
+						q.Add(quadrics[candidate.to]);
+						collapses.push_back(Collapse{ candidate.from, candidate.to, float(q.Evaluate(vertices[candidate.to].position)) });
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+			// Apply the cheapest independent collapses. Each removes about two triangles.
+			const size_t trianglesToRemove = (indices.size() - targetIndexCount) / 3;
+			size_t removed = 0;
+			size_t applied = 0;
+
+			std::fill(touched.begin(), touched.end(), false);
+			for (size_t i = 0; i < vertexCount; ++i)
+				remap[i] = uint32_t(i);
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (removed >= trianglesToRemove || double(collapse.cost) > maxCost)
+					break;
+
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+
+				// Reject collapses that would flip any surviving triangle around the moved vertex
+				bool flips = false;
+				size_t collapsedTriangles = 0;
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; ++a)
+				{
+					const uint32_t* const triangle = &indices[size_t(adjacency[a]) * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					{
+						++collapsedTriangles;
+						continue;
+					}
+
+					const float* p[3];
+					const float* moved[3];
+					for (size_t k = 0; k < 3; ++k)
+					{
+						p[k] = vertices[triangle[k]].position;
+						moved[k] = triangle[k] == collapse.from ? vertices[collapse.to].position : p[k];
+					}
+
+					float before[3], after[3];
+					TriangleNormal(p[0], p[1], p[2], before);
+					TriangleNormal(moved[0], moved[1], moved[2], after);
+					flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f;
+				}
+
+				if (flips)
+					continue;
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].Add(quadrics[collapse.from]);
+				resultError = std::max(resultError, std::sqrt(collapse.cost));
+				removed += collapsedTriangles;
+				++applied;
+
+				// Anything sharing a triangle with the moved vertex has stale flip checks now
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a)
+				{
+					const uint32_t* const triangle = &indices[size_t(adjacency[a]) * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+				}
+			}
+
+			if (applied == 0)
+				break;
+
+			// Rewrite the index buffer and drop the triangles that collapsed to lines
+			size_t write = 0;
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				const uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+				if (a != b && b != c && a != c)
+				{
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+			}
+			indices.resize(write);
+		}
+
+		return indices;
+	}
+
+} // namespace cooker
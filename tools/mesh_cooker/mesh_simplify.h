@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh_format.h"
+
+#include <vector>
+
+namespace cooker
+{
+
+	// Quadric error edge collapse onto existing vertices, so the result indexes the same vertex buffer.
+	// Colour seams and open borders are kept intact. Stops at targetIndexCount or when the next collapse
+	// would move the surface further than maxError. resultError receives the largest deviation used.
+	std::vector<uint32_t>	Simplify(const std::vector<uint32_t>& indices, const std::vector<assets::MeshVertex>& vertices,
+								size_t targetIndexCount, float maxError, float& resultError);
+
+} // namespace cooker
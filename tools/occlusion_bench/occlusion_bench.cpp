@@ -0,0 +1,395 @@
+//--------------------------------------------------------------------
+// occlusion_bench.cpp - Software occlusion culling benchmark over occluder-heavy scenes, checking every box the
+//                       culler rejects against a full resolution depth buffer of the same occluders
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h occlusion_bench.cpp
+//            ../../RedEngine/occlusion_culler.cpp ../../RedEngine/job_system.cpp ../../RedEngine/perf_counters.cpp
+//            -o occlusion_bench
+//
+// Usage: occlusion_bench [--occluders n] [--occludees n] [--size w h] [--frames n] [--workers n] [--check-scale n]
+//--------------------------------------------------------------------
+
+#include "occlusion_culler.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		unsigned int	occluders = 64;
+		unsigned int	occludees = 20000;
+		unsigned int	width = 256;
+		unsigned int	height = 128;
+		unsigned int	frames = 100;
+		unsigned int	workers = 0;
+		unsigned int	checkScale = 4; // The reference depth buffer is this many times the culler's along each axis
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+	// Left-handed perspective, row vectors, matching XMMatrixPerspectiveFovLH
+	void Perspective(float fovY, float aspect, float nearZ, float farZ, float* m)
+	{
+		const float yScale = 1.0f / tanf(fovY * 0.5f);
+		const float range = farZ / (farZ - nearZ);
+		memset(m, 0, sizeof(float) * 16);
+		m[0] = yScale / aspect;
+		m[5] = yScale;
+		m[10] = range;
+		m[11] = 1.0f;
+		m[14] = -range * nearZ;
+	}
+
+	// Unit cube with clockwise front faces seen from outside, the engine's default cull mode
+	void BuildCube(std::vector<float>& positions, std::vector<uint32_t>& indices)
+	{
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			positions.push_back((corner & 1) ? 0.5f : -0.5f);
+			positions.push_back((corner & 2) ? 0.5f : -0.5f);
+			positions.push_back((corner & 4) ? 0.5f : -0.5f);
+		}
+
+		// Faces as corner quads, each pair of triangles flipped if it winds the wrong way round its normal
+		const uint32_t faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+		const float normals[6][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { 0, -1, 0 }, { 0, 1, 0 }, { -1, 0, 0 }, { 1, 0, 0 } };
+
+		for (int face = 0; face < 6; ++face)
+		{
+			const uint32_t quad[6] = { faces[face][0], faces[face][1], faces[face][2], faces[face][0], faces[face][2], faces[face][3] };
+			for (int t = 0; t < 6; t += 3)
+			{
+				const float* const p0 = &positions[quad[t] * 3];
+				const float* const p1 = &positions[quad[t + 1] * 3];
+				const float* const p2 = &positions[quad[t + 2] * 3];
+				const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				const float cross[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				const bool flip = cross[0] * normals[face][0] + cross[1] * normals[face][1] + cross[2] * normals[face][2] < 0.0f;
+
+				indices.push_back(quad[t]);
+				indices.push_back(flip ? quad[t + 2] : quad[t + 1]);
+				indices.push_back(flip ? quad[t + 1] : quad[t + 2]);
+			}
+		}
+	}
+
+	struct Occluder
+	{
+		float							world[16];
+		scene::OcclusionCuller::Box		bounds;
+	};
+
+	// Scale then translate, so the bounds are just the scaled unit cube moved into place
+	Occluder MakeOccluder(const float scale[3], const float position[3])
+	{
+		Occluder occluder = {};
+		occluder.world[0] = scale[0];
+		occluder.world[5] = scale[1];
+		occluder.world[10] = scale[2];
+		occluder.world[12] = position[0];
+		occluder.world[13] = position[1];
+		occluder.world[14] = position[2];
+		occluder.world[15] = 1.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			occluder.bounds.min[k] = position[k] - scale[k] * 0.5f;
+			occluder.bounds.max[k] = position[k] + scale[k] * 0.5f;
+		}
+		return occluder;
+	}
+
+	// p * m for a row vector p = (xyz, 1)
+	void Transform(const float* p, const float* m, float* result)
+	{
+		for (int column = 0; column < 4; ++column)
+			result[column] = p[0] * m[0 * 4 + column] + p[1] * m[1 * 4 + column] + p[2] * m[2 * 4 + column] + m[3 * 4 + column];
+	}
+
+	// A plain depth buffer, sampled at pixel centres with every triangle drawn whichever way it faces
+	class ReferenceDepth
+	{
+	public:
+		ReferenceDepth(uint32_t width, uint32_t height, const float viewProjection[16]) :
+			m_width(width),
+			m_height(height),
+			m_depth(size_t(width) * height, 1.0f)
+		{
+			memcpy(m_viewProjection, viewProjection, sizeof(m_viewProjection));
+		}
+
+		void Draw(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const float world[16])
+		{
+			Rasterise(positions, indices, world, true);
+		}
+
+		// True if any pixel of the mesh passes the depth test
+		bool IsVisible(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const float world[16])
+		{
+			return Rasterise(positions, indices, world, false);
+		}
+
+	private:
+		bool Rasterise(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const float world[16], bool write)
+		{
+			bool passed = false;
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				float x[3], y[3], z[3];
+				bool behind = false;
+				for (int k = 0; k < 3; ++k)
+				{
+					float worldPosition[4], clip[4];
+					Transform(&positions[indices[i + k] * 3], world, worldPosition);
+					Transform(worldPosition, m_viewProjection, clip);
+					behind = behind || clip[3] <= 0.0f;
+
+					const float invW = 1.0f / clip[3];
+					x[k] = (clip[0] * invW + 1.0f) * float(m_width) * 0.5f;
+					y[k] = (1.0f - clip[1] * invW) * float(m_height) * 0.5f;
+					z[k] = clip[2] * invW;
+				}
+
+				// The scenes keep everything in front of the camera
+				const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+				if (behind || area == 0.0f)
+					continue;
+
+				const int minX = std::max(0, int(std::floor(std::min({ x[0], x[1], x[2] }))));
+				const int maxX = std::min(int(m_width) - 1, int(std::ceil(std::max({ x[0], x[1], x[2] }))));
+				const int minY = std::max(0, int(std::floor(std::min({ y[0], y[1], y[2] }))));
+				const int maxY = std::min(int(m_height) - 1, int(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+				for (int py = minY; py <= maxY; ++py)
+				{
+					for (int px = minX; px <= maxX; ++px)
+					{
+						// Barycentrics from the edge opposite each vertex, divided by the area so either winding works
+						const float cx = float(px) + 0.5f;
+						const float cy = float(py) + 0.5f;
+						float weight[3];
+						bool inside = true;
+						for (int k = 0; k < 3; ++k)
+						{
+							const int a = (k + 1) % 3, b = (k + 2) % 3;
+							weight[k] = ((x[b] - x[a]) * (cy - y[a]) - (y[b] - y[a]) * (cx - x[a])) / area;
+							inside = inside && weight[k] >= 0.0f;
+						}
+						if (!inside)
+							continue;
+
+						const float depth = weight[0] * z[0] + weight[1] * z[1] + weight[2] * z[2];
+						float& stored = m_depth[size_t(py) * m_width + px];
+						if (depth >= stored)
+							continue;
+
+						if (!write)
+							return true;
+						stored = depth;
+						passed = true;
+					}
+				}
+			}
+			return passed;
+		}
+
+		uint32_t						m_width;
+		uint32_t						m_height;
+		float							m_viewProjection[16];
+		std::vector<float>				m_depth;
+	};
+
+	// Culls the boxes once more with every occluder in, size or not, and draws the same occluders into a reference
+	// depth buffer checkScale times the resolution. A box the culler rejected must not have a pixel in front of them.
+	bool CheckCulling(const std::vector<Occluder>& occluders, const std::vector<scene::OcclusionCuller::Box>& boxes,
+		const std::vector<float>& cubePositions, const std::vector<uint32_t>& cubeIndices, const float viewProjection[16],
+		const Options& options, uint32_t& culled, uint32_t& wrong)
+	{
+		scene::OcclusionCuller culler(options.width, options.height);
+		culler.SetMinOccluderScreenFraction(0.0f);
+		culler.BeginFrame(viewProjection);
+		for (const Occluder& occluder : occluders)
+		{
+			culler.AddOccluder(cubePositions.data(), sizeof(float) * 3, cubeIndices.data(), uint32_t(cubeIndices.size()),
+				occluder.world, occluder.bounds);
+		}
+		culler.RenderOccluders();
+
+		std::vector<uint8_t> visible(boxes.size());
+		culler.TestVisibility(boxes.data(), uint32_t(boxes.size()), visible.data());
+
+		ReferenceDepth reference(options.width * options.checkScale, options.height * options.checkScale, viewProjection);
+		for (const Occluder& occluder : occluders)
+			reference.Draw(cubePositions, cubeIndices, occluder.world);
+
+		culled = 0;
+		wrong = 0;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (visible[i] != 0)
+				continue;
+
+			++culled;
+			const scene::OcclusionCuller::Box& box = boxes[i];
+			const float scale[3] = { box.max[0] - box.min[0], box.max[1] - box.min[1], box.max[2] - box.min[2] };
+			const float centre[3] = { (box.min[0] + box.max[0]) * 0.5f, (box.min[1] + box.max[1]) * 0.5f, (box.min[2] + box.max[2]) * 0.5f };
+			if (reference.IsVisible(cubePositions, cubeIndices, MakeOccluder(scale, centre).world) && wrong++ < 5)
+			{
+				fprintf(stderr, "Box %zu, (%.2f %.2f %.2f) to (%.2f %.2f %.2f), was culled but has visible pixels.\n", i,
+					box.min[0], box.min[1], box.min[2], box.max[0], box.max[1], box.max[2]);
+			}
+		}
+		return wrong == 0;
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--occluders") == 0 && i + 1 < argc)
+			options.occluders = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--occludees") == 0 && i + 1 < argc)
+			options.occludees = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			options.width = unsigned(atoi(argv[++i]));
+			options.height = unsigned(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			options.workers = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--check-scale") == 0 && i + 1 < argc)
+			options.checkScale = unsigned(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: occlusion_bench [--occluders n] [--occludees n] [--size w h] [--frames n] [--workers n] [--check-scale n]\n");
+			return 1;
+		}
+	}
+
+	if (options.checkScale == 0)
+	{
+		fprintf(stderr, "The check scale must be at least 1\n");
+		return 1;
+	}
+
+	if (options.width % scene::OcclusionCuller::TileWidth != 0 || options.height % scene::OcclusionCuller::TileHeight != 0)
+	{
+		fprintf(stderr, "Size must be a multiple of %ux%u\n", scene::OcclusionCuller::TileWidth, scene::OcclusionCuller::TileHeight);
+		return 1;
+	}
+
+	utils::JobSystem::Create(options.workers);
+
+	bool ok = true;
+	{
+		std::vector<float> cubePositions;
+		std::vector<uint32_t> cubeIndices;
+		BuildCube(cubePositions, cubeIndices);
+
+		// A street of walls close to the camera with a city of small props behind it
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		std::vector<Occluder> occluders;
+		for (unsigned int i = 0; i < options.occluders; ++i)
+		{
+			const float scale[3] = { 4.0f + 8.0f * unit(random), 3.0f + 6.0f * unit(random), 0.5f };
+			const float position[3] = { -40.0f + 80.0f * unit(random), -6.0f + 12.0f * unit(random), 12.0f + 20.0f * unit(random) };
+			occluders.push_back(MakeOccluder(scale, position));
+		}
+
+		std::vector<scene::OcclusionCuller::Box> boxes(options.occludees);
+		for (scene::OcclusionCuller::Box& box : boxes)
+		{
+			const float size = 0.5f + 1.5f * unit(random);
+			const float centre[3] = { -80.0f + 160.0f * unit(random), -12.0f + 24.0f * unit(random), 35.0f + 165.0f * unit(random) };
+			for (int k = 0; k < 3; ++k)
+			{
+				box.min[k] = centre[k] - size * 0.5f;
+				box.max[k] = centre[k] + size * 0.5f;
+			}
+		}
+
+		float viewProjection[16];
+		Perspective(1.0471976f, float(options.width) / float(options.height), 0.1f, 1000.0f, viewProjection);
+
+		scene::OcclusionCuller culler(options.width, options.height);
+		std::vector<uint8_t> visible(options.occludees);
+		std::vector<double> setupTimes, rasteriseTimes, testTimes;
+
+		for (unsigned int frame = 0; frame < options.frames; ++frame)
+		{
+			const double setupStart = Seconds();
+			culler.BeginFrame(viewProjection);
+			for (const Occluder& occluder : occluders)
+			{
+				culler.AddOccluder(cubePositions.data(), sizeof(float) * 3, cubeIndices.data(), uint32_t(cubeIndices.size()),
+					occluder.world, occluder.bounds);
+			}
+
+			const double rasteriseStart = Seconds();
+			culler.RenderOccluders();
+
+			const double testStart = Seconds();
+			culler.TestVisibility(boxes.data(), uint32_t(boxes.size()), visible.data());
+			const double testEnd = Seconds();
+
+			setupTimes.push_back(rasteriseStart - setupStart);
+			rasteriseTimes.push_back(testStart - rasteriseStart);
+			testTimes.push_back(testEnd - testStart);
+		}
+
+		const scene::OcclusionCuller::Stats& stats = culler.GetStats();
+
+		// Pixel coverage of the final buffer, to show how much of the view the walls fill
+		const float* const depth = culler.GetDepthBuffer();
+		size_t covered = 0;
+		for (size_t i = 0; i < size_t(options.width) * options.height; ++i)
+			covered += depth[i] < 1.0f;
+
+		printf("%u occluders, %u occludees, %ux%u buffer, %u workers, %u frames\n", options.occluders, options.occludees,
+			options.width, options.height, utils::JobSystem::Get()->GetWorkerCount(), options.frames);
+		printf("  occluders used     %8u of %u, %u triangles rasterised\n", stats.occluders, options.occluders, stats.rasterisedTriangles);
+		printf("  screen covered     %8.1f %%\n", 100.0 * double(covered) / double(size_t(options.width) * options.height));
+		printf("  culled             %8u of %u (%.1f %%)\n", stats.culled, stats.tested, 100.0 * double(stats.culled) / double(std::max(stats.tested, 1u)));
+		printf("  setup              p50 %.3f ms  max %.3f ms\n", Percentile(setupTimes, 0.5) * 1e3, Percentile(setupTimes, 1.0) * 1e3);
+		printf("  rasterise          p50 %.3f ms  max %.3f ms\n", Percentile(rasteriseTimes, 0.5) * 1e3, Percentile(rasteriseTimes, 1.0) * 1e3);
+		printf("  test               p50 %.3f ms  max %.3f ms  (%.1f ns per box)\n", Percentile(testTimes, 0.5) * 1e3,
+			Percentile(testTimes, 1.0) * 1e3, Percentile(testTimes, 0.5) * 1e9 / double(std::max(options.occludees, 1u)));
+
+		uint32_t checked = 0;
+		uint32_t wrong = 0;
+		ok = CheckCulling(occluders, boxes, cubePositions, cubeIndices, viewProjection, options, checked, wrong);
+		printf("  reference          %8u culled boxes checked at %ux%u, %u with visible pixels\n", checked,
+			options.width * options.checkScale, options.height * options.checkScale, wrong);
+	}
+
+	utils::JobSystem::Destroy();
+
+	printf(ok ? "Occlusion checks passed.\n" : "Occlusion checks failed.\n");
+	return ok ? 0 : 1;
+}
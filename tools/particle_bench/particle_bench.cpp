@@ -0,0 +1,281 @@
+//--------------------------------------------------------------------
+// particle_bench.cpp - Particle simulation benchmark: a million particles stepped, killed and re-emitted each
+//                      frame with AVX2 and SSE2, serially and across the job system, checked against each other
+//                      and against a scalar trajectory
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h particle_bench.cpp
+//            ../../RedEngine/particle_system.cpp ../../RedEngine/job_system.cpp ../../RedEngine/perf_counters.cpp
+//            -o particle_bench
+//
+// Usage: particle_bench [--particles n] [--frames n] [--workers n] [--emitters n]
+//--------------------------------------------------------------------
+
+#include "particle_system.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		uint32_t				particles = 1000000;
+		unsigned int			frames = 60;
+		unsigned int			workers = 0;
+		uint32_t				emitters = 16;
+	};
+
+	const float c_TimeStep = 1.0f / 60.0f;
+	const float c_MinLife = 1.0f;
+	const float c_MaxLife = 3.0f;
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+	// Emitting at the rate that holds the system at about its capacity once the first particles start dying
+	void AddEmitters(scene::ParticleSystem& particles, const Options& options)
+	{
+		const float rate = float(options.particles) / ((c_MinLife + c_MaxLife) * 0.5f) / float(options.emitters);
+		for (uint32_t i = 0; i < options.emitters; ++i)
+		{
+			scene::ParticleSystem::Emitter emitter = {};
+			emitter.position[0] = float(i % 4) * 10.0f;
+			emitter.position[2] = float(i / 4) * 10.0f;
+			emitter.positionJitter = 0.5f;
+			emitter.velocity[1] = 8.0f;
+			emitter.velocityJitter = 3.0f;
+			emitter.minLife = c_MinLife;
+			emitter.maxLife = c_MaxLife;
+			emitter.size = 0.2f;
+			emitter.growth = -0.05f;
+			emitter.color = 0xff4080ff - i;
+			emitter.rate = rate;
+			particles.AddEmitter(emitter);
+		}
+		particles.SetDrag(0.1f);
+	}
+
+	struct Run
+	{
+		std::vector<double>		update;
+		std::vector<double>		write;
+		std::vector<scene::ParticleSystem::Instance> instances;
+		uint32_t				alive;
+		uint64_t				emitted;
+		uint64_t				killed;
+	};
+
+	// Warms up to the steady state untimed, then times frames of Update and WriteInstances
+	bool Simulate(const Options& options, bool avx2, Run& run)
+	{
+		scene::ParticleSystem particles(options.particles);
+		if (particles.EnableAvx2(avx2) != avx2)
+			return false;
+		AddEmitters(particles, options);
+
+		run = Run();
+		run.instances.resize(particles.GetCapacity());
+		const unsigned int warmup = unsigned(c_MaxLife / c_TimeStep) + 1;
+		for (unsigned int frame = 0; frame < warmup + options.frames; ++frame)
+		{
+			const double updateStart = Seconds();
+			particles.Update(c_TimeStep);
+			const double writeStart = Seconds();
+			particles.WriteInstances(run.instances.data(), uint32_t(run.instances.size()));
+			const double writeEnd = Seconds();
+
+			run.emitted += particles.GetStats().emitted;
+			run.killed += particles.GetStats().killed;
+			if (frame >= warmup)
+			{
+				run.update.push_back(writeStart - updateStart);
+				run.write.push_back(writeEnd - writeStart);
+			}
+		}
+		run.alive = particles.GetCount();
+		run.instances.resize(run.alive);
+		return true;
+	}
+
+	bool SameInstances(const Run& a, const Run& b)
+	{
+		return a.alive == b.alive && memcmp(a.instances.data(), b.instances.data(), a.alive * sizeof(scene::ParticleSystem::Instance)) == 0;
+	}
+
+	// One burst with no jitter follows one path, stepped here the same way; its lives spread so deaths land mid-block
+	bool CheckTrajectory(bool avx2)
+	{
+		const uint32_t count = 50000;
+		scene::ParticleSystem particles(count);
+		particles.EnableAvx2(avx2);
+		particles.SetDrag(0.5f);
+
+		scene::ParticleSystem::Emitter emitter = {};
+		emitter.position[0] = 1.0f;
+		emitter.velocity[0] = 2.0f;
+		emitter.velocity[1] = 5.0f;
+		emitter.minLife = 0.1f;
+		emitter.maxLife = 1.0f;
+		emitter.size = 1.0f;
+		emitter.growth = -0.25f;
+		emitter.rate = float(count) / c_TimeStep + 1.0f;
+		const uint32_t burst = particles.AddEmitter(emitter);
+
+		particles.Update(c_TimeStep);
+		particles.GetEmitter(burst).rate = 0.0f;
+		if (particles.GetCount() != count)
+		{
+			fprintf(stderr, "%u particles emitted of %u.\n", particles.GetCount(), count);
+			return false;
+		}
+
+		float position[3] = { 1.0f, 0.0f, 0.0f }, velocity[3] = { 2.0f, 5.0f, 0.0f }, size = 1.0f;
+		const float gravity[3] = { 0.0f, -9.8f, 0.0f };
+		const float damping = std::max(1.0f - 0.5f * c_TimeStep, 0.0f);
+		std::vector<scene::ParticleSystem::Instance> instances(count);
+		uint32_t previous = count;
+		for (unsigned int frame = 0; frame < 70; ++frame)
+		{
+			particles.Update(c_TimeStep);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				velocity[axis] = velocity[axis] * damping + gravity[axis] * c_TimeStep;
+				position[axis] = position[axis] + velocity[axis] * c_TimeStep;
+			}
+			size = std::max(size + -0.25f * c_TimeStep, 0.0f);
+
+			const uint32_t alive = particles.WriteInstances(instances.data(), count);
+			if (alive > previous || particles.GetStats().killed != previous - alive)
+			{
+				fprintf(stderr, "Frame %u: %u alive after %u with %u killed.\n", frame, alive, previous, particles.GetStats().killed);
+				return false;
+			}
+			for (uint32_t i = 0; i < alive; ++i)
+			{
+				if (memcmp(instances[i].position, position, sizeof(position)) != 0 || instances[i].size != size)
+				{
+					fprintf(stderr, "Frame %u: particle %u is off its path.\n", frame, i);
+					return false;
+				}
+			}
+			previous = alive;
+		}
+
+		if (previous != 0)
+		{
+			fprintf(stderr, "%u particles outlived their longest life.\n", previous);
+			return false;
+		}
+		return true;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+			options.particles = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			options.workers = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--emitters") == 0 && i + 1 < argc)
+			options.emitters = uint32_t(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: particle_bench [--particles n] [--frames n] [--workers n] [--emitters n]\n");
+			return 2;
+		}
+	}
+
+	if (options.particles == 0 || options.frames == 0 || options.emitters == 0)
+	{
+		fprintf(stderr, "Particles, frames and emitters must be at least 1.\n");
+		return 2;
+	}
+
+	const bool avx2 = scene::ParticleSystem::HasAvx2();
+	bool ok = true;
+
+	for (bool useAvx2 : { false, true })
+	{
+		if (useAvx2 && !avx2)
+			continue;
+		if (!CheckTrajectory(useAvx2))
+		{
+			fprintf(stderr, "%s: particles left the scalar path.\n", useAvx2 ? "AVX2" : "SSE2");
+			ok = false;
+		}
+	}
+
+	// Serial first, before there is a job system to spread over
+	Run serialSse2, serialAvx2, jobsSse2, jobsAvx2;
+	Simulate(options, false, serialSse2);
+	if (avx2)
+	{
+		Simulate(options, true, serialAvx2);
+		if (!SameInstances(serialSse2, serialAvx2))
+		{
+			fprintf(stderr, "AVX2 and SSE2 disagree.\n");
+			ok = false;
+		}
+	}
+
+	utils::JobSystem::Create(options.workers);
+	Simulate(options, false, jobsSse2);
+	if (!SameInstances(serialSse2, jobsSse2))
+	{
+		fprintf(stderr, "The job system simulated differently to the serial run.\n");
+		ok = false;
+	}
+	if (avx2)
+		Simulate(options, true, jobsAvx2);
+
+	if (serialSse2.emitted - serialSse2.killed != serialSse2.alive)
+	{
+		fprintf(stderr, "%llu emitted less %llu killed is not the %u alive.\n", (unsigned long long)serialSse2.emitted,
+			(unsigned long long)serialSse2.killed, serialSse2.alive);
+		ok = false;
+	}
+
+	printf("%u particles capacity, %u alive, %u emitters, %u workers, %u frames, p50 (max) ms\n", options.particles, serialSse2.alive,
+		options.emitters, utils::JobSystem::Get()->GetWorkerCount(), options.frames);
+	printf("%-12s %16s %16s %10s\n", "", "update", "write", "ns/particle");
+	const struct
+	{
+		const char*				name;
+		const Run*				run;
+	} rows[] = { { "serial sse2", &serialSse2 }, { "serial avx2", &serialAvx2 }, { "jobs sse2", &jobsSse2 }, { "jobs avx2", &jobsAvx2 } };
+	for (const auto& row : rows)
+	{
+		if (row.run->update.empty())
+			continue;
+		const double update = Percentile(row.run->update, 0.5);
+		printf("%-12s %7.3f (%6.3f) %7.3f (%6.3f) %10.2f\n", row.name, update * 1e3, Percentile(row.run->update, 1.0) * 1e3,
+			Percentile(row.run->write, 0.5) * 1e3, Percentile(row.run->write, 1.0) * 1e3, update * 1e9 / double(std::max(row.run->alive, 1u)));
+	}
+	if (!avx2)
+		printf("No AVX2 on this CPU, SSE2 only.\n");
+
+	utils::JobSystem::Destroy();
+
+	printf(ok ? "Particle checks passed.\n" : "Particle checks failed.\n");
+	return ok ? 0 : 1;
+}
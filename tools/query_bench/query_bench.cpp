@@ -0,0 +1,369 @@
+//--------------------------------------------------------------------
+// query_bench.cpp - Scene query benchmark: rays, spheres and boxes cast in batches against 10k to 100k bodies,
+//                   one at a time, batched serially and batched across the job system, checked against testing
+//                   every body
+//
+// Build: g++ -std=c++17 -O2 -msse2 -pthread -I../../RedEngine -include ../common/headless_engine.h query_bench.cpp
+//            ../../RedEngine/scene_query.cpp ../../RedEngine/broadphase.cpp ../../RedEngine/job_system.cpp
+//            ../../RedEngine/perf_counters.cpp -o query_bench
+//
+// Usage: query_bench [--bodies n[,n...]] [--rays n] [--workers n] [--check n]
+//--------------------------------------------------------------------
+
+#include "scene_query.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		std::vector<uint32_t>	bodyCounts = { 10000, 100000 };
+		uint32_t				rays = 200000;
+		unsigned int			workers = 0;
+		uint32_t				checkLimit = 2000; // Queries of each kind checked against every body
+	};
+
+	// Every so many bodies is removed again, so the tree is built around gaps in the ids
+	const uint32_t c_RemoveEvery = 17;
+
+	typedef scene::SceneQuery::Box Box;
+	typedef scene::SceneQuery::Ray Ray;
+	typedef scene::SceneQuery::RayHit RayHit;
+	typedef scene::SceneQuery::Sphere Sphere;
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// About one neighbour each, whatever the count
+	float WorldSize(uint32_t count)
+	{
+		return 4.0f * std::cbrt(float(count));
+	}
+
+	void MakeBodies(uint32_t count, scene::Broadphase& broadphase)
+	{
+		std::mt19937 random(count);
+		const float world = WorldSize(count);
+		std::uniform_real_distribution<float> position(0.0f, world);
+		std::uniform_real_distribution<float> halfSize(0.5f, 1.5f);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Box box;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const float centre = position(random);
+				const float half = halfSize(random);
+				box.min[axis] = centre - half;
+				box.max[axis] = centre + half;
+			}
+			broadphase.AddBody(box);
+		}
+		for (uint32_t body = 0; body < count; body += c_RemoveEvery)
+			broadphase.RemoveBody(body);
+	}
+
+	// Picking and line of sight: from anywhere in the world, any direction, a third of the way across it
+	std::vector<Ray> MakeRays(uint32_t bodyCount, uint32_t count)
+	{
+		std::mt19937 random(count ^ bodyCount);
+		const float world = WorldSize(bodyCount);
+		std::uniform_real_distribution<float> position(0.0f, world);
+		std::normal_distribution<float> direction(0.0f, 1.0f);
+
+		std::vector<Ray> rays(count);
+		for (Ray& ray : rays)
+		{
+			float length = 0.0f;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				ray.origin[axis] = position(random);
+				ray.direction[axis] = direction(random);
+				length += ray.direction[axis] * ray.direction[axis];
+			}
+			for (uint32_t axis = 0; axis < 3; ++axis)
+				ray.direction[axis] /= std::sqrt(length);
+			ray.maxDistance = world / 3.0f;
+		}
+		return rays;
+	}
+
+	// Proximity: spheres and boxes a few bodies across
+	void MakeShapes(uint32_t bodyCount, uint32_t count, std::vector<Sphere>& spheres, std::vector<Box>& boxes)
+	{
+		std::mt19937 random(count + bodyCount);
+		const float world = WorldSize(bodyCount);
+		std::uniform_real_distribution<float> position(0.0f, world);
+		std::uniform_real_distribution<float> size(1.0f, 4.0f);
+
+		spheres.resize(count);
+		boxes.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				spheres[i].centre[axis] = position(random);
+				boxes[i].min[axis] = position(random);
+				boxes[i].max[axis] = boxes[i].min[axis] + size(random);
+			}
+			spheres[i].radius = size(random);
+		}
+	}
+
+	// The same slab test as the tree, one box at a time
+	RayHit ReferenceRay(const scene::Broadphase& broadphase, const Ray& ray)
+	{
+		RayHit hit = { scene::SceneQuery::NoBody, ray.maxDistance };
+		for (uint32_t body = 0; body < broadphase.GetBodyLimit(); ++body)
+		{
+			if (!broadphase.IsAlive(body))
+				continue;
+
+			const Box& box = broadphase.GetBox(body);
+			float enter = 0.0f;
+			float leave = hit.distance;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float direction = ray.direction[axis];
+				if (std::fabs(direction) < 1e-20f)
+					direction = direction < 0.0f ? -1e-20f : 1e-20f;
+				const float inverse = 1.0f / direction;
+				const float toMin = (box.min[axis] - ray.origin[axis]) * inverse;
+				const float toMax = (box.max[axis] - ray.origin[axis]) * inverse;
+				enter = std::max(enter, std::min(toMin, toMax));
+				leave = std::min(leave, std::max(toMin, toMax));
+			}
+			if (enter <= leave && (enter < hit.distance || (enter == hit.distance && body < hit.body)))
+				hit = { body, enter };
+		}
+		return hit;
+	}
+
+	bool Touches(const Box& box, const Sphere& sphere)
+	{
+		float distanceSquared = 0.0f;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			const float d = std::max(std::max(box.min[axis] - sphere.centre[axis], sphere.centre[axis] - box.max[axis]), 0.0f);
+			distanceSquared += d * d;
+		}
+		return distanceSquared <= sphere.radius * sphere.radius;
+	}
+
+	bool Touches(const Box& box, const Box& other)
+	{
+		bool touching = true;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			touching = touching && box.min[axis] <= other.max[axis] && other.min[axis] <= box.max[axis];
+		return touching;
+	}
+
+	template <typename Shape>
+	bool CheckOverlaps(const scene::Broadphase& broadphase, const std::vector<Shape>& shapes, uint32_t checkCount,
+		const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& bodies)
+	{
+		for (uint32_t i = 0; i < checkCount; ++i)
+		{
+			std::vector<uint32_t> expected;
+			for (uint32_t body = 0; body < broadphase.GetBodyLimit(); ++body)
+			{
+				if (broadphase.IsAlive(body) && Touches(broadphase.GetBox(body), shapes[i]))
+					expected.push_back(body);
+			}
+			if (!std::equal(expected.begin(), expected.end(), bodies.begin() + offsets[i], bodies.begin() + offsets[i + 1]) ||
+				expected.size() != offsets[i + 1] - offsets[i])
+				return false;
+		}
+		return true;
+	}
+
+	struct Run
+	{
+		double					build;
+		double					single; // Seconds for every ray, one call each
+		double					rays;
+		double					occluded;
+		double					spheres;
+		double					boxes;
+		uint32_t				nodes;
+		uint32_t				depth;
+		uint32_t				overlaps;
+		std::vector<RayHit>		hits;
+		std::vector<uint32_t>	sphereBodies;
+		std::vector<uint32_t>	boxBodies;
+	};
+
+	bool Query(uint32_t count, const Options& options, bool check, Run& run)
+	{
+		scene::Broadphase broadphase;
+		MakeBodies(count, broadphase);
+		const std::vector<Ray> rays = MakeRays(count, options.rays);
+		std::vector<Sphere> spheres;
+		std::vector<Box> boxes;
+		MakeShapes(count, options.rays / 4, spheres, boxes);
+
+		run = Run();
+		scene::SceneQuery query;
+		const double buildStart = Seconds();
+		query.Build(broadphase);
+		run.build = Seconds() - buildStart;
+		run.nodes = query.GetStats().nodes;
+		run.depth = query.GetStats().depth;
+
+		// Individually, as gameplay code asking one ray at a time would
+		RayHit single = {};
+		double start = Seconds();
+		for (const Ray& ray : rays)
+			query.Raycast(&ray, 1, &single);
+		run.single = Seconds() - start;
+
+		run.hits.resize(rays.size());
+		start = Seconds();
+		query.Raycast(rays.data(), uint32_t(rays.size()), run.hits.data());
+		run.rays = Seconds() - start;
+
+		std::vector<uint8_t> occluded(rays.size());
+		start = Seconds();
+		query.Occluded(rays.data(), uint32_t(rays.size()), occluded.data());
+		run.occluded = Seconds() - start;
+
+		std::vector<uint32_t> sphereOffsets;
+		start = Seconds();
+		query.OverlapSpheres(spheres.data(), uint32_t(spheres.size()), sphereOffsets, run.sphereBodies);
+		run.spheres = Seconds() - start;
+
+		std::vector<uint32_t> boxOffsets;
+		start = Seconds();
+		query.OverlapBoxes(boxes.data(), uint32_t(boxes.size()), boxOffsets, run.boxBodies);
+		run.boxes = Seconds() - start;
+		run.overlaps = uint32_t(run.sphereBodies.size() + run.boxBodies.size());
+
+		bool ok = true;
+		for (size_t i = 0; i < rays.size(); ++i)
+		{
+			if ((occluded[i] != 0) != (run.hits[i].body != scene::SceneQuery::NoBody))
+			{
+				fprintf(stderr, "%u bodies: ray %zu is occluded but hits nothing, or the other way about.\n", count, i);
+				ok = false;
+				break;
+			}
+		}
+
+		if (!check)
+			return ok;
+
+		const uint32_t checkCount = std::min<uint32_t>(options.checkLimit, uint32_t(spheres.size()));
+		for (uint32_t i = 0; i < std::min<uint32_t>(options.checkLimit, uint32_t(rays.size())); ++i)
+		{
+			const RayHit expected = ReferenceRay(broadphase, rays[i]);
+			if (expected.body != run.hits[i].body || expected.distance != run.hits[i].distance)
+			{
+				fprintf(stderr, "%u bodies: ray %u hits body %u at %f, testing every body hits %u at %f.\n", count, i,
+					run.hits[i].body, run.hits[i].distance, expected.body, expected.distance);
+				ok = false;
+				break;
+			}
+		}
+		if (!CheckOverlaps(broadphase, spheres, checkCount, sphereOffsets, run.sphereBodies))
+		{
+			fprintf(stderr, "%u bodies: sphere overlaps disagree with testing every body.\n", count);
+			ok = false;
+		}
+		if (!CheckOverlaps(broadphase, boxes, checkCount, boxOffsets, run.boxBodies))
+		{
+			fprintf(stderr, "%u bodies: box overlaps disagree with testing every body.\n", count);
+			ok = false;
+		}
+		return ok;
+	}
+
+	double Millions(uint32_t count, double seconds)
+	{
+		return double(count) / seconds * 1e-6;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+		{
+			options.bodyCounts.clear();
+			for (const char* count = argv[++i]; count != nullptr; count = strchr(count, ','))
+			{
+				count += *count == ',';
+				options.bodyCounts.push_back(uint32_t(atoi(count)));
+			}
+		}
+		else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+			options.rays = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			options.workers = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+			options.checkLimit = uint32_t(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: query_bench [--bodies n[,n...]] [--rays n] [--workers n] [--check n]\n");
+			return 2;
+		}
+	}
+
+	if (options.rays < 4 || std::find(options.bodyCounts.begin(), options.bodyCounts.end(), 0u) != options.bodyCounts.end())
+	{
+		fprintf(stderr, "Body counts must be at least 1 and rays at least 4.\n");
+		return 2;
+	}
+
+	// Serial first, before there is a job system to spread over
+	bool ok = true;
+	std::vector<Run> serial(options.bodyCounts.size());
+	for (size_t i = 0; i < options.bodyCounts.size(); ++i)
+		ok = Query(options.bodyCounts[i], options, true, serial[i]) && ok;
+
+	utils::JobSystem::Create(options.workers);
+
+	printf("%u rays and %u each of spheres and boxes, %u workers, millions of queries per second\n", options.rays, options.rays / 4,
+		utils::JobSystem::Get()->GetWorkerCount());
+	printf("%8s %7s %5s %9s %7s %7s %7s %9s %7s %7s %9s\n", "bodies", "nodes", "depth", "build ms", "single", "serial", "jobs",
+		"occluded", "spheres", "boxes", "hit rate");
+	for (size_t i = 0; i < options.bodyCounts.size(); ++i)
+	{
+		const uint32_t count = options.bodyCounts[i];
+		Run jobs;
+		ok = Query(count, options, false, jobs) && ok;
+		if (memcmp(jobs.hits.data(), serial[i].hits.data(), jobs.hits.size() * sizeof(RayHit)) != 0 ||
+			jobs.sphereBodies != serial[i].sphereBodies || jobs.boxBodies != serial[i].boxBodies)
+		{
+			fprintf(stderr, "%u bodies: the job system found different hits to the serial run.\n", count);
+			ok = false;
+		}
+
+		const uint32_t hits = uint32_t(std::count_if(jobs.hits.begin(), jobs.hits.end(), [](const RayHit& hit)
+		{
+			return hit.body != scene::SceneQuery::NoBody;
+		}));
+		const uint32_t shapes = options.rays / 4;
+		printf("%8u %7u %5u %9.3f %7.2f %7.2f %7.2f %9.2f %7.2f %7.2f %8.1f%%\n", count, jobs.nodes, jobs.depth, jobs.build * 1e3,
+			Millions(options.rays, serial[i].single), Millions(options.rays, serial[i].rays), Millions(options.rays, jobs.rays),
+			Millions(options.rays, jobs.occluded), Millions(shapes, jobs.spheres), Millions(shapes, jobs.boxes),
+			100.0 * hits / options.rays);
+	}
+
+	utils::JobSystem::Destroy();
+
+	printf(ok ? "Scene query checks passed.\n" : "Scene query checks failed.\n");
+	return ok ? 0 : 1;
+}
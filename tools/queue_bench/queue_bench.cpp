@@ -0,0 +1,311 @@
+//--------------------------------------------------------------------
+// queue_bench.cpp - Queue contention benchmark: containers::SpscQueue and MpmcQueue against a mutex around a
+//                   std::deque, one value and a batch at a time, across producer and consumer thread counts,
+//                   checking every value arrives once and each producer's values in order
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h queue_bench.cpp
+//            -o queue_bench
+//
+// Usage: queue_bench [--items n] [--batch n] [--capacity n] [--threads PxC[,PxC...]]
+//--------------------------------------------------------------------
+
+#include "spsc_queue.h"
+#include "mpmc_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	struct Threads
+	{
+		unsigned int			producers;
+		unsigned int			consumers;
+	};
+
+	struct Options
+	{
+		uint32_t				items = 1000000; // Per producer
+		uint32_t				batch = 32;
+		uint32_t				capacity = 1024;
+		std::vector<Threads>	threads = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 1, 4 }, { 4, 1 }, { 8, 8 } };
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Producer in the top bits, its count in the rest
+	const uint32_t c_ProducerShift = 40;
+
+	// What the lock-free queues replace
+	class MutexQueue
+	{
+	public:
+		explicit MutexQueue(size_t capacity) :
+			m_capacity(capacity)
+		{
+		}
+
+		bool push(uint64_t value)
+		{
+			return push(&value, 1) == 1;
+		}
+
+		bool pop(uint64_t& value)
+		{
+			return pop(&value, 1) == 1;
+		}
+
+		size_t push(const uint64_t* values, size_t count)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			size_t pushed = 0;
+			for (; pushed < count && m_values.size() < m_capacity; ++pushed)
+				m_values.push_back(values[pushed]);
+			return pushed;
+		}
+
+		size_t pop(uint64_t* values, size_t maxCount)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			size_t popped = 0;
+			for (; popped < maxCount && !m_values.empty(); ++popped)
+			{
+				values[popped] = m_values.front();
+				m_values.pop_front();
+			}
+			return popped;
+		}
+
+	private:
+		std::mutex				m_mutex;
+		std::deque<uint64_t>	m_values;
+		size_t					m_capacity;
+	};
+
+	struct Result
+	{
+		double					seconds;
+		bool					ok;
+	};
+
+	// Every producer pushes items values, batch at a time, retrying what didn't fit; consumers pop until all are in
+	template <typename Queue>
+	Result Run(Queue& queue, const Threads& threads, uint32_t items, uint32_t batch)
+	{
+		const uint64_t total = uint64_t(items) * threads.producers;
+		std::atomic<uint64_t> consumed(0);
+		std::atomic<bool> ok(true);
+		std::atomic<unsigned int> ready(0);
+		std::atomic<bool> go(false);
+
+		std::vector<std::vector<uint64_t>> received(threads.consumers, std::vector<uint64_t>(threads.producers, 0));
+		std::vector<std::thread> workers;
+
+		for (unsigned int producer = 0; producer < threads.producers; ++producer)
+		{
+			workers.emplace_back([&, producer]()
+			{
+				std::vector<uint64_t> values(batch);
+				ready.fetch_add(1);
+				while (!go.load())
+					std::this_thread::yield();
+
+				for (uint32_t next = 0; next < items;)
+				{
+					const uint32_t count = std::min(batch, items - next);
+					for (uint32_t i = 0; i < count; ++i)
+						values[i] = uint64_t(producer) << c_ProducerShift | (next + i);
+
+					size_t pushed = 0;
+					while (pushed < count)
+					{
+						const size_t now = queue.push(values.data() + pushed, count - pushed);
+						if (now == 0)
+							std::this_thread::yield();
+						pushed += now;
+					}
+					next += count;
+				}
+			});
+		}
+
+		for (unsigned int consumer = 0; consumer < threads.consumers; ++consumer)
+		{
+			workers.emplace_back([&, consumer]()
+			{
+				// Each producer's values come out in the order it pushed them, whichever consumer gets them
+				std::vector<uint64_t>& expected = received[consumer];
+				std::vector<int64_t> last(threads.producers, -1);
+				std::vector<uint64_t> values(batch);
+				ready.fetch_add(1);
+				while (!go.load())
+					std::this_thread::yield();
+
+				while (consumed.load(std::memory_order_relaxed) < total)
+				{
+					const size_t popped = queue.pop(values.data(), batch);
+					if (popped == 0)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					for (size_t i = 0; i < popped; ++i)
+					{
+						const uint32_t producer = uint32_t(values[i] >> c_ProducerShift);
+						const int64_t index = int64_t(values[i] & ((uint64_t(1) << c_ProducerShift) - 1));
+						if (producer >= threads.producers || index <= last[producer])
+							ok.store(false);
+						else
+						{
+							last[producer] = index;
+							++expected[producer];
+						}
+					}
+					consumed.fetch_add(popped, std::memory_order_relaxed);
+				}
+			});
+		}
+
+		while (ready.load() < threads.producers + threads.consumers)
+			std::this_thread::yield();
+		const double start = Seconds();
+		go.store(true);
+		for (std::thread& worker : workers)
+			worker.join();
+
+		Result result = { Seconds() - start, ok.load() && consumed.load() == total };
+		for (unsigned int producer = 0; producer < threads.producers; ++producer)
+		{
+			uint64_t count = 0;
+			for (unsigned int consumer = 0; consumer < threads.consumers; ++consumer)
+				count += received[consumer][producer];
+			result.ok = result.ok && count == items;
+		}
+		return result;
+	}
+
+	// The single value forms, behind the batch interface Run uses
+	template <typename Queue>
+	struct OneAtATime
+	{
+		Queue&					queue;
+
+		size_t push(const uint64_t* values, size_t)
+		{
+			return queue.push(values[0]) ? 1 : 0;
+		}
+
+		size_t pop(uint64_t* values, size_t)
+		{
+			return queue.pop(values[0]) ? 1 : 0;
+		}
+	};
+
+	template <typename Queue>
+	bool Measure(const char* name, const Threads& threads, const Options& options, bool batched, double& rate)
+	{
+		Queue queue(options.capacity);
+		Result result;
+		if (batched)
+			result = Run(queue, threads, options.items, options.batch);
+		else
+		{
+			OneAtATime<Queue> single = { queue };
+			result = Run(single, threads, options.items, 1);
+		}
+
+		rate = double(options.items) * threads.producers / result.seconds * 1e-6;
+		if (!result.ok)
+			fprintf(stderr, "%ux%u %s: values were lost, repeated or out of order.\n", threads.producers, threads.consumers, name);
+		return result.ok;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+			options.items = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			options.batch = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+			options.capacity = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			options.threads.clear();
+			for (const char* pair = argv[++i]; pair != nullptr; pair = strchr(pair, ','))
+			{
+				pair += *pair == ',';
+				Threads threads = { 0, 0 };
+				if (sscanf(pair, "%ux%u", &threads.producers, &threads.consumers) != 2)
+					threads = { 0, 0 };
+				options.threads.push_back(threads);
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Usage: queue_bench [--items n] [--batch n] [--capacity n] [--threads PxC[,PxC...]]\n");
+			return 2;
+		}
+	}
+
+	bool valid = options.items > 0 && options.batch > 0 && options.capacity >= 2;
+	for (const Threads& threads : options.threads)
+		valid = valid && threads.producers > 0 && threads.consumers > 0 && threads.producers < 256;
+	if (!valid)
+	{
+		fprintf(stderr, "Items, batch and threads must be at least 1, under 256 producers, and the capacity at least 2.\n");
+		return 2;
+	}
+
+	printf("%u values per producer, batches of %u, capacity %u, %u hardware threads, millions of values per second\n",
+		options.items, options.batch, options.capacity, std::thread::hardware_concurrency());
+	printf("%8s %9s %9s %9s %9s %9s %9s\n", "threads", "mutex", "batched", "spsc", "batched", "mpmc", "batched");
+
+	bool ok = true;
+	for (const Threads& threads : options.threads)
+	{
+		double mutexRate = 0.0;
+		double mutexBatchRate = 0.0;
+		ok = Measure<MutexQueue>("mutex", threads, options, false, mutexRate) && ok;
+		ok = Measure<MutexQueue>("mutex batched", threads, options, true, mutexBatchRate) && ok;
+
+		// Only one producer and one consumer may share an SpscQueue
+		char spsc[16] = "-";
+		char spscBatch[16] = "-";
+		if (threads.producers == 1 && threads.consumers == 1)
+		{
+			double rate = 0.0;
+			ok = Measure<containers::SpscQueue<uint64_t>>("spsc", threads, options, false, rate) && ok;
+			snprintf(spsc, sizeof(spsc), "%.2f", rate);
+			ok = Measure<containers::SpscQueue<uint64_t>>("spsc batched", threads, options, true, rate) && ok;
+			snprintf(spscBatch, sizeof(spscBatch), "%.2f", rate);
+		}
+
+		double mpmcRate = 0.0;
+		double mpmcBatchRate = 0.0;
+		ok = Measure<containers::MpmcQueue<uint64_t>>("mpmc", threads, options, false, mpmcRate) && ok;
+		ok = Measure<containers::MpmcQueue<uint64_t>>("mpmc batched", threads, options, true, mpmcBatchRate) && ok;
+
+		char name[16];
+		snprintf(name, sizeof(name), "%ux%u", threads.producers, threads.consumers);
+		printf("%8s %9.2f %9.2f %9s %9s %9.2f %9.2f\n", name, mutexRate, mutexBatchRate, spsc, spscBatch, mpmcRate, mpmcBatchRate);
+	}
+
+	printf(ok ? "Queue checks passed.\n" : "Queue checks failed.\n");
+	return ok ? 0 : 1;
+}
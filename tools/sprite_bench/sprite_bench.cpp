@@ -0,0 +1,250 @@
+//--------------------------------------------------------------------
+// sprite_bench.cpp - Sprite batching benchmark: 100k sprites a frame spread over atlases and layers in random
+//                    order, batched headless, checked for draw order and counted against drawing as submitted
+//
+// Build: g++ -std=c++17 -O2 -I../../RedEngine -include ../common/headless_engine.h sprite_bench.cpp
+//            ../../RedEngine/sprite_batch.cpp ../../RedEngine/perf_counters.cpp -o sprite_bench
+//
+// Usage: sprite_bench [--sprites n] [--atlases n] [--layers n] [--frames n] [--seed n]
+//--------------------------------------------------------------------
+
+#include "sprite_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		uint32_t				sprites = 100000;
+		uint32_t				atlases = 8;
+		uint32_t				layers = 4;
+		unsigned int			frames = 50;
+		unsigned int			seed = 1234;
+	};
+
+	struct Submitted
+	{
+		uint32_t				atlas;
+		uint32_t				layer;
+		DX::SpriteBatch::Sprite	sprite;
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+	// Layers in runs, as a UI draws panel by panel, with the atlas picked fresh for every sprite
+	std::vector<Submitted> MakeSprites(const Options& options, std::mt19937& random)
+	{
+		std::uniform_int_distribution<uint32_t> atlas(0, options.atlases - 1);
+		std::uniform_int_distribution<uint32_t> layer(0, options.layers - 1);
+		std::uniform_int_distribution<uint32_t> run(1, 64);
+		std::uniform_real_distribution<float> position(0.0f, 1900.0f);
+
+		std::vector<Submitted> sprites(options.sprites);
+		uint32_t currentLayer = 0, left = 0;
+		for (Submitted& submitted : sprites)
+		{
+			if (left-- == 0)
+			{
+				currentLayer = layer(random);
+				left = run(random) - 1;
+			}
+
+			submitted.atlas = atlas(random);
+			submitted.layer = currentLayer;
+			submitted.sprite = { position(random), position(random), 16.0f, 16.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0xffffffff };
+		}
+		return sprites;
+	}
+
+	// One draw per change of atlas, which is what drawing in submission order costs; layers need nothing more
+	uint32_t NaiveDraws(const std::vector<Submitted>& sprites)
+	{
+		uint32_t draws = 0;
+		for (size_t i = 0; i < sprites.size(); ++i)
+			draws += i == 0 || sprites[i].atlas != sprites[i - 1].atlas;
+		return draws;
+	}
+
+	// Every atlas used in a layer, layer by layer
+	uint32_t LayerAtlases(const std::vector<Submitted>& sprites, const Options& options)
+	{
+		std::vector<bool> used(size_t(options.layers) * options.atlases);
+		for (const Submitted& submitted : sprites)
+			used[size_t(submitted.layer) * options.atlases + submitted.atlas] = true;
+		return uint32_t(std::count(used.begin(), used.end(), true));
+	}
+
+	bool Check(const DX::SpriteBatch& batch, const std::vector<Submitted>& sprites, uint32_t layerAtlases)
+	{
+		const std::vector<uint32_t>& order = batch.GetDrawOrder();
+		const std::vector<DX::SpriteBatch::Batch>& batches = batch.GetBatches();
+		if (order.size() != sprites.size())
+		{
+			fprintf(stderr, "%zu sprites drawn of %zu.\n", order.size(), sprites.size());
+			return false;
+		}
+
+		std::vector<bool> seen(sprites.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			if (order[i] >= sprites.size() || seen[order[i]])
+			{
+				fprintf(stderr, "Sprite %u is missing or drawn twice.\n", order[i]);
+				return false;
+			}
+			seen[order[i]] = true;
+
+			if (i == 0)
+				continue;
+
+			const Submitted& previous = sprites[order[i - 1]];
+			const Submitted& current = sprites[order[i]];
+			if (current.layer < previous.layer)
+			{
+				fprintf(stderr, "Layer %u drawn after layer %u.\n", current.layer, previous.layer);
+				return false;
+			}
+		}
+
+		// Each layer's sprites of one atlas in the order they came
+		std::vector<uint32_t> last(256 * 256, 0xffffffff);
+		for (uint32_t index : order)
+		{
+			uint32_t& previous = last[(sprites[index].layer & 0xff) << 8 | (sprites[index].atlas & 0xff)];
+			if (previous != 0xffffffff && previous > index)
+			{
+				fprintf(stderr, "Sprite %u drawn after sprite %u of the same layer and atlas.\n", index, previous);
+				return false;
+			}
+			previous = index;
+		}
+
+		uint32_t covered = 0;
+		for (const DX::SpriteBatch::Batch& draw : batches)
+		{
+			if (draw.first != covered || draw.count == 0)
+			{
+				fprintf(stderr, "Batches leave a gap or overlap at %u.\n", draw.first);
+				return false;
+			}
+			for (uint32_t i = draw.first; i < draw.first + draw.count; ++i)
+			{
+				if (sprites[order[i]].atlas != draw.atlas)
+				{
+					fprintf(stderr, "Sprite %u of atlas %u drawn with atlas %u.\n", order[i], sprites[order[i]].atlas, draw.atlas);
+					return false;
+				}
+			}
+			covered += draw.count;
+		}
+		if (covered != sprites.size())
+		{
+			fprintf(stderr, "Batches cover %u sprites of %zu.\n", covered, sprites.size());
+			return false;
+		}
+
+		if (batches.size() > layerAtlases)
+		{
+			fprintf(stderr, "%zu batches for %u layer atlases.\n", batches.size(), layerAtlases);
+			return false;
+		}
+		return true;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc)
+			options.sprites = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--atlases") == 0 && i + 1 < argc)
+			options.atlases = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--layers") == 0 && i + 1 < argc)
+			options.layers = uint32_t(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			options.seed = unsigned(atoi(argv[++i]));
+		else
+		{
+			fprintf(stderr, "Usage: sprite_bench [--sprites n] [--atlases n] [--layers n] [--frames n] [--seed n]\n");
+			return 2;
+		}
+	}
+
+	// The order check packs layer and atlas in a byte each
+	if (options.atlases == 0 || options.atlases > 256 || options.layers == 0 || options.layers > 256 || options.frames == 0)
+	{
+		fprintf(stderr, "Atlases and layers go from 1 to 256, and at least one frame.\n");
+		return 2;
+	}
+
+	std::mt19937 random(options.seed);
+	DX::SpriteBatch batch;
+	std::vector<ID3D11ShaderResourceView*> views(options.atlases, nullptr);
+	for (ID3D11ShaderResourceView*& view : views)
+		batch.AddAtlas(&view);
+
+	std::vector<double> drawTimes, flushTimes;
+	uint64_t draws = 0, naive = 0, batches = 0, wraps = 0;
+	bool ok = true;
+	for (unsigned int frame = 0; frame < options.frames; ++frame)
+	{
+		const std::vector<Submitted> sprites = MakeSprites(options, random);
+
+		const double drawStart = Seconds();
+		for (const Submitted& submitted : sprites)
+			batch.Draw(submitted.atlas, submitted.layer, submitted.sprite);
+		const double flushStart = Seconds();
+		batch.Flush(nullptr, 1920.0f, 1080.0f);
+		const double flushEnd = Seconds();
+
+		drawTimes.push_back(flushStart - drawStart);
+		flushTimes.push_back(flushEnd - flushStart);
+
+		const DX::SpriteBatch::Stats& stats = batch.GetStats();
+		draws += stats.draws;
+		batches += stats.batches;
+		wraps += stats.wraps;
+		naive += NaiveDraws(sprites);
+
+		if (ok && !Check(batch, sprites, LayerAtlases(sprites, options)))
+		{
+			fprintf(stderr, "Frame %u: batching checks failed.\n", frame);
+			ok = false;
+		}
+	}
+
+	const double flush = Percentile(flushTimes, 0.5);
+	printf("%u sprites, %u atlases, %u layers, %u frames, p50 (max) ms\n", options.sprites, options.atlases, options.layers,
+		options.frames);
+	printf("draw   %7.3f (%6.3f)\n", Percentile(drawTimes, 0.5) * 1e3, Percentile(drawTimes, 1.0) * 1e3);
+	printf("flush  %7.3f (%6.3f)  %.1f ns/sprite\n", flush * 1e3, Percentile(flushTimes, 1.0) * 1e3,
+		flush * 1e9 / double(std::max(options.sprites, 1u)));
+	printf("draws per frame %.1f (%.1f batches, %.2f wraps), %.1f drawn as submitted, %.0fx fewer\n", double(draws) / options.frames,
+		double(batches) / options.frames, double(wraps) / options.frames, double(naive) / options.frames,
+		double(naive) / double(std::max<uint64_t>(draws, 1)));
+
+	printf(ok ? "Batching checks passed.\n" : "Batching checks failed.\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+//--------------------------------------------------------------------
+// stream_bench.cpp - Asset streaming throughput and main thread hitch benchmark
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h stream_bench.cpp
+//            ../../RedEngine/asset_pack.cpp ../../RedEngine/asset_streamer.cpp ../../RedEngine/compression.cpp
+//            ../../RedEngine/job_system.cpp ../../RedEngine/perf_counters.cpp -o stream_bench
+//--------------------------------------------------------------------
+
+#include "asset_pack.h"
+#include "asset_streamer.h"
+#include "compression.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		unsigned int	entries = 512;
+		unsigned int	entryKilobytes = 256;
+		unsigned int	ioThreads = 2;
+		unsigned int	budgetMegabytes = 1024;
+		float			uploadBudgetMs = 2.0f;
+		float			frameMs = 1000.0f / 60.0f;
+		bool			compress = true;
+		const char*		packPath = "stream_bench.rpak";
+	};
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + assets::PackEntryAlignment - 1) & ~uint64_t(assets::PackEntryAlignment - 1);
+	}
+
+	// Half random, half repeating bytes so LZ4 has roughly 2:1 to work with, like real vertex data
+	bool WritePack(const Options& options)
+	{
+		std::mt19937 random(1234);
+		const size_t entrySize = size_t(options.entryKilobytes) * 1024;
+
+		std::vector<assets::PackEntry> toc(options.entries);
+		std::vector<std::vector<uint8_t>> blobs(options.entries);
+
+		uint64_t offset = sizeof(assets::PackHeader);
+		for (unsigned int i = 0; i < options.entries; ++i)
+		{
+			std::vector<uint8_t> raw(entrySize);
+			for (size_t b = 0; b < entrySize; ++b)
+				raw[b] = (b & 64) ? uint8_t(random()) : uint8_t(b >> 6);
+
+			assets::PackEntry& entry = toc[i];
+			entry = {};
+			entry.nameHash = utils::HashName(("bench/" + std::to_string(i)).c_str());
+			entry.uncompressedSize = entrySize;
+
+			if (options.compress)
+			{
+				blobs[i].resize(compression::Lz4CompressBound(entrySize));
+				blobs[i].resize(compression::Lz4Compress(raw.data(), raw.size(), blobs[i].data(), blobs[i].size()));
+				entry.flags = assets::PackEntryCompressed;
+			}
+			else
+			{
+				blobs[i].swap(raw);
+			}
+
+			offset = Align(offset);
+			entry.offset = offset;
+			entry.size = blobs[i].size();
+			offset += entry.size;
+		}
+
+		std::vector<unsigned int> order(options.entries);
+		for (unsigned int i = 0; i < options.entries; ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&toc](unsigned int a, unsigned int b) { return toc[a].nameHash < toc[b].nameHash; });
+
+		assets::PackHeader header = {};
+		header.magic = assets::PackMagic;
+		header.version = assets::PackVersion;
+		header.entryCount = options.entries;
+		header.entryAlignment = assets::PackEntryAlignment;
+		header.tocOffset = Align(offset);
+		header.totalSize = header.tocOffset + options.entries * sizeof(assets::PackEntry);
+
+		std::vector<uint8_t> file(size_t(header.totalSize), 0);
+		memcpy(file.data(), &header, sizeof(header));
+		for (unsigned int i = 0; i < options.entries; ++i)
+			memcpy(file.data() + toc[i].offset, blobs[i].data(), blobs[i].size());
+		for (unsigned int i = 0; i < options.entries; ++i)
+			memcpy(file.data() + header.tocOffset + i * sizeof(assets::PackEntry), &toc[order[i]], sizeof(assets::PackEntry));
+
+		FILE* const out = fopen(options.packPath, "wb");
+		if (out == nullptr)
+			return false;
+		const bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+		fclose(out);
+		return ok;
+	}
+
+	struct Asset
+	{
+		std::vector<uint8_t>	gpuCopy; // Stands in for the buffer the upload would create
+		bool					resident;
+	};
+
+	std::atomic<unsigned int> g_uploaded(0);
+
+	void Upload(const void* data, size_t size, void* userData)
+	{
+		Asset* const asset = static_cast<Asset*>(userData);
+		asset->gpuCopy.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+		asset->resident = true;
+		++g_uploaded;
+	}
+
+	void Evict(void* userData)
+	{
+		Asset* const asset = static_cast<Asset*>(userData);
+		std::vector<uint8_t>().swap(asset->gpuCopy);
+		asset->resident = false;
+	}
+
+	double Percentile(std::vector<double> values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(percentile * double(values.size())))];
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc)
+			options.entries = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--entry-kb") == 0 && i + 1 < argc)
+			options.entryKilobytes = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc)
+			options.ioThreads = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--budget-mb") == 0 && i + 1 < argc)
+			options.budgetMegabytes = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--upload-budget-ms") == 0 && i + 1 < argc)
+			options.uploadBudgetMs = float(atof(argv[++i]));
+		else if (strcmp(argv[i], "--stored") == 0)
+			options.compress = false;
+		else
+		{
+			fprintf(stderr, "Usage: stream_bench [--entries n] [--entry-kb n] [--io-threads n] [--budget-mb n] [--upload-budget-ms f] [--stored]\n");
+			return 1;
+		}
+	}
+
+	if (!WritePack(options))
+	{
+		fprintf(stderr, "Unable to write %s\n", options.packPath);
+		return 1;
+	}
+
+	utils::JobSystem::Create();
+
+	{
+		assets::AssetPack pack;
+		if (!pack.Mount(options.packPath))
+			return 1;
+
+		assets::AssetStreamer streamer(pack, uint64_t(options.budgetMegabytes) * 1024 * 1024, options.ioThreads);
+
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> coordinate(-500.0f, 500.0f);
+
+		std::vector<Asset> assetsInFlight(options.entries);
+		std::vector<double> requestTimes;
+		std::vector<double> pumpTimes;
+
+		const double start = Seconds();
+		for (unsigned int i = 0; i < options.entries; ++i)
+		{
+			const float position[3] = { coordinate(random), 0.0f, coordinate(random) };
+			assets::AssetStreamer::Callbacks callbacks = { &Upload, &Evict, &assetsInFlight[i] };
+
+			const double requestStart = Seconds();
+			streamer.Request(utils::HashName(("bench/" + std::to_string(i)).c_str()), position, callbacks);
+			requestTimes.push_back(Seconds() - requestStart);
+		}
+
+		// Play the part of the render thread until everything has landed
+		const double uploadBudget = options.uploadBudgetMs / 1000.0;
+		while (g_uploaded.load() < options.entries)
+		{
+			const double frameStart = Seconds();
+			streamer.PumpUploads(uploadBudget);
+			pumpTimes.push_back(Seconds() - frameStart);
+
+			const double remaining = options.frameMs / 1000.0 - (Seconds() - frameStart);
+			if (remaining > 0.0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+		}
+		const double elapsed = Seconds() - start;
+
+		const assets::AssetStreamer::Stats stats = streamer.GetStats();
+		const double megabytes = double(stats.bytesDecompressed) / (1024.0 * 1024.0);
+
+		printf("entries %u x %u KB, %s, %u I/O threads, budget %u MB\n", options.entries, options.entryKilobytes,
+			options.compress ? "lz4" : "stored", options.ioThreads, options.budgetMegabytes);
+		printf("  load time          %8.3f s over %zu frames\n", elapsed, pumpTimes.size());
+		printf("  throughput         %8.1f MB/s delivered, %.1f MB/s read from disk\n", megabytes / elapsed,
+			double(stats.bytesRead) / (1024.0 * 1024.0) / elapsed);
+		printf("  evictions          %8u\n", stats.evictions);
+		printf("  Request()          p50 %.3f us  max %.3f us\n", Percentile(requestTimes, 0.5) * 1e6, Percentile(requestTimes, 1.0) * 1e6);
+		printf("  PumpUploads()      p50 %.3f ms  p99 %.3f ms  max %.3f ms\n", Percentile(pumpTimes, 0.5) * 1e3,
+			Percentile(pumpTimes, 0.99) * 1e3, Percentile(pumpTimes, 1.0) * 1e3);
+	}
+
+	utils::JobSystem::Destroy();
+	remove(options.packPath);
+
+	return 0;
+}
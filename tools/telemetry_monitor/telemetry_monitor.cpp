@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------
+// telemetry_monitor.cpp - Live view of a running engine's frame times and perf counters over shared memory
+//
+// Build: g++ -std=c++17 -O2 -pthread -I../../RedEngine -include ../common/headless_engine.h telemetry_monitor.cpp
+//            ../../RedEngine/telemetry.cpp ../../RedEngine/perf_counters.cpp -o telemetry_monitor -lrt
+//--------------------------------------------------------------------
+
+#include "perf_counters.h"
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+	struct Options
+	{
+		const char*		name = "red_engine_telemetry";
+		unsigned int	intervalMs = 500;
+		unsigned int	samples = 0; // 0 runs until interrupted
+		bool			clear = true;
+	};
+
+	struct FrameTimes
+	{
+		uint32_t		count;
+		double			average;
+		double			p50;
+		double			p99;
+		double			max;
+	};
+
+	FrameTimes Summarise(const utils::TelemetryPayload& payload)
+	{
+		const uint32_t count = uint32_t(std::min<uint64_t>(payload.frame, utils::TelemetryFrameHistory));
+		std::vector<float> sorted(payload.frameTimes, payload.frameTimes + utils::TelemetryFrameHistory);
+
+		// The ring is only full once frame has passed its size, before that the tail is zeros
+		if (count < utils::TelemetryFrameHistory)
+			sorted.resize(count);
+		std::sort(sorted.begin(), sorted.end());
+
+		FrameTimes times = { count, 0.0, 0.0, 0.0, 0.0 };
+		if (count == 0)
+			return times;
+
+		for (float time : sorted)
+			times.average += time;
+		times.average /= double(count);
+		times.p50 = sorted[count / 2];
+		times.p99 = sorted[std::min(count - 1, count * 99 / 100)];
+		times.max = sorted.back();
+		return times;
+	}
+
+	// Bytes counters read better scaled
+	void PrintValue(const char* name, int64_t value)
+	{
+		if (strstr(name, "bytes") != nullptr && (value >= 1024 || value <= -1024))
+			printf("%14.1f KB", double(value) / 1024.0);
+		else
+			printf("%17lld", static_cast<long long>(value));
+	}
+
+	void Print(const utils::TelemetryHeader& header, const utils::TelemetryPayload& payload, uint64_t previousFrame, double elapsed)
+	{
+		const FrameTimes times = Summarise(payload);
+		const double rate = elapsed > 0.0 ? double(payload.frame - previousFrame) / elapsed : 0.0;
+
+		printf("pid %llu  up %.1f s  frame %llu  %.1f fps\n", static_cast<unsigned long long>(header.processId), payload.uptime,
+			static_cast<unsigned long long>(payload.frame), rate);
+		printf("frame time  avg %.2f ms  p50 %.2f ms  p99 %.2f ms  max %.2f ms  (last %u frames)\n\n", times.average, times.p50,
+			times.p99, times.max, times.count);
+
+		for (uint32_t id = 0; id < payload.counterCount; ++id)
+		{
+			const utils::TelemetryCounter& counter = payload.counters[id];
+			printf("  %-40s", counter.name);
+			PrintValue(counter.name, counter.value);
+			printf("%s\n", counter.kind == utils::PerfCounter::Gauge ? "  (gauge)" : "");
+		}
+		fflush(stdout);
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+			options.name = argv[++i];
+		else if (strcmp(argv[i], "--interval-ms") == 0 && i + 1 < argc)
+			options.intervalMs = unsigned(std::max(1, atoi(argv[++i])));
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			options.samples = unsigned(atoi(argv[++i]));
+		else if (strcmp(argv[i], "--no-clear") == 0)
+			options.clear = false;
+		else
+		{
+			fprintf(stderr, "Usage: telemetry_monitor [--name segment] [--interval-ms n] [--samples n] [--no-clear]\n");
+			return 1;
+		}
+	}
+
+	const std::chrono::milliseconds interval(options.intervalMs);
+	utils::TelemetryReader reader;
+	utils::TelemetryPayload* const payload = new utils::TelemetryPayload();
+
+	uint64_t previousFrame = 0;
+	auto previousTime = std::chrono::steady_clock::now();
+	bool waiting = false;
+	unsigned int samples = 0;
+
+	while (options.samples == 0 || samples < options.samples)
+	{
+		// Wait for the engine to start, or to come back after it has gone
+		if (!reader.IsOpen())
+		{
+			if (!reader.Open(options.name))
+			{
+				if (!waiting)
+					fprintf(stderr, "Waiting for %s...\n", options.name);
+				waiting = true;
+				std::this_thread::sleep_for(interval);
+				continue;
+			}
+
+			waiting = false;
+			previousFrame = 0;
+			previousTime = std::chrono::steady_clock::now();
+		}
+
+		if (reader.GetHeader().magic != utils::TelemetryMagic)
+		{
+			fprintf(stderr, "Engine process %llu has exited.\n", static_cast<unsigned long long>(reader.GetHeader().processId));
+			reader.Close();
+			continue;
+		}
+
+		if (reader.Read(*payload))
+		{
+			const auto now = std::chrono::steady_clock::now();
+			const double elapsed = std::chrono::duration<double>(now - previousTime).count();
+
+			if (options.clear)
+				printf("\x1b[H\x1b[2J");
+			Print(reader.GetHeader(), *payload, previousFrame > 0 ? previousFrame : payload->frame, elapsed);
+			if (!options.clear)
+				printf("\n");
+
+			previousFrame = payload->frame;
+			previousTime = now;
+			++samples;
+		}
+
+		std::this_thread::sleep_for(interval);
+	}
+
+	delete payload;
+	return 0;
+}